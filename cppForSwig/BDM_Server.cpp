@@ -9,6 +9,13 @@
 #include "BDM_Server.h"
 #include "BDM_seder.h"
 
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#endif
+
 
 ///////////////////////////////////////////////////////////////////////////////
 void BDV_Server_Object::buildMethodMap()
@@ -995,6 +1002,15 @@ Arguments Clients::runCommand(const string& cmdStr)
    Command cmdObj(cmdStr);
    cmdObj.deserialize();
 
+   return runCommand(cmdObj);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+Arguments Clients::runCommand(Command& cmdObj)
+{
+   if (!run_.load(memory_order_relaxed))
+      return Arguments();
+
    if (cmdObj.method_ == "shutdown" || cmdObj.method_ == "shutdownNode")
    {
       return processShutdownCommand(cmdObj);
@@ -1030,6 +1046,28 @@ Arguments Clients::runCommand(const string& cmdStr)
    return result;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+shared_ptr<SocketCallback> Clients::getCallback(const Command& cmdObj)
+{
+   if (!run_.load(memory_order_relaxed))
+      return nullptr;
+
+   if (bdmT_->bdm()->hasException())
+      rethrow_exception(bdmT_->bdm()->getException());
+
+   if (cmdObj.ids_.size() == 0)
+      throw runtime_error("malformed command");
+
+   auto bdv = get(cmdObj.ids_[0]);
+   bdv->resetCounter();
+
+   auto cbPtr = bdv->cb_;
+   if (cbPtr == nullptr || !cbPtr->isValid())
+      return nullptr;
+
+   return cbPtr;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void Clients::shutdown()
 {
@@ -1102,6 +1140,13 @@ Arguments Clients::registerBDV(Arguments& arg)
       throw DbErrorMsg("invalid magic word");
    }
 
+   //clients that can use the binary wire say so after the magic word
+   bool binaryWire = false;
+   if (arg.hasArgs())
+   {
+      auto&& wireVersion = arg.get<IntType>();
+      binaryWire = wireVersion.getVal() >= WIRE_BINARY_VERSION;
+   }
 
    shared_ptr<BDV_Server_Object> newBDV
       = make_shared<BDV_Server_Object>(bdmT_);
@@ -1116,6 +1161,10 @@ Arguments Clients::registerBDV(Arguments& arg)
    Arguments args;
    BinaryDataObject bdo(newID);
    args.push_back(move(bdo));
+
+   if (binaryWire)
+      args.push_back(move(IntType(WIRE_BINARY_VERSION)));
+
    return args;
 }
 
@@ -1242,6 +1291,31 @@ Arguments BDV_Server_Object::executeCommand(const string& method,
    return iter->second(ids, args);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+FCGI_Server::FCGI_Server(BlockDataManagerThread* bdmT, string port) :
+   clients_(bdmT, getShutdownCallback()),
+   ip_("127.0.0.1"), port_(port)
+{
+   LOGINFO << "Listening on port " << port;
+   liveThreads_.store(0, memory_order_relaxed);
+
+   auto& config = bdmT->bdm()->config();
+   requestPool_ = make_unique<WorkerPool>(
+      "fcgi pool", config.fcgiThreadCount_);
+   longPollPool_ = make_unique<WorkerPool>(
+      "long poll pool", config.longPollThreadCount_);
+
+   try
+   {
+      notificationHub_ = make_unique<NotificationHub>();
+   }
+   catch (runtime_error& e)
+   {
+      LOGWARN << "notification hub unavailable (" << e.what() << 
+         "), callback requests will wait in the long poll pool";
+   }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void FCGI_Server::init()
 {
@@ -1329,92 +1403,210 @@ void FCGI_Server::enterLoop()
          throw runtime_error("accept error");
       }
 
-      auto processRequestLambda = [this](FCGX_Request* req)->void
+      auto processRequestLambda = [this, request](void)->void
       {
-         this->processRequest(req);
+         this->processRequest(request);
       };
 
       liveThreads_.fetch_add(1, memory_order_relaxed);
-      thread thr(processRequestLambda, request);
-      if (thr.joinable())
-         thr.detach();
-
-      //TODO: implement thread recycling
+      requestPool_->push(processRequestLambda);
    }
+
+   //serve what was queued before exiting. Parked callbacks are released 
+   //first, their replies go through the request pool, which may in turn
+   //still hand long polls over
+   if (notificationHub_ != nullptr)
+      notificationHub_->shutdown();
+   requestPool_->shutdown();
+   longPollPool_->shutdown();
+
+   auto logStats = [](const string& name,
+      const WorkerPool::Stats& stats)->void
+   {
+      LOGINFO << name << ": " << stats.completed_ << " requests, " <<
+         "max queue depth: " << stats.maxQueueDepth_ << 
+         ", avg wait: " << stats.avgWaitMs_ << "ms" <<
+         ", max wait: " << stats.maxWaitMs_ << "ms" << 
+         ", avg run: " << stats.avgRunMs_ << "ms";
+   };
+
+   logStats("fcgi pool", requestPool_->getStats());
+   logStats("long poll pool", longPollPool_->getStats());
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 void FCGI_Server::processRequest(FCGX_Request* req)
 {
-   //extract the string command from the fgci request
-   stringstream ss;
-   stringstream retStream;
-   char* content = nullptr;
- 
-   //pass to clients_
-   char* content_length = FCGX_GetParam("CONTENT_LENGTH", req->envp);
-   if (content_length != nullptr)
+   string content;
+   if (!readContent(req, content))
    {
-      auto a = atoi(content_length);
-      content = new char[a + 1];
-      FCGX_GetStr(content, a, req->in);
-      content[a] = 0;
+      LOGERR << "empty content_length";
+      FCGX_Finish_r(req);
+      delete req;
 
-      string contentStr(content);
+      liveThreads_.fetch_sub(1, memory_order_relaxed);
+      return;
+   }
 
-      //print HTML header
-      ss << "HTTP/1.1 200 OK\r\n";
-      ss << "Content-Type: text/html; charset=UTF-8\r\n";
+   //reply in the encoding of the request
+   auto encoding = BinaryWireFrame::getEncoding(content);
+   auto cmdObj = make_shared<Command>(move(content));
 
-      try
-      {
-         auto&& retVal = clients_.runCommand(contentStr);
-         retStream << retVal.serialize();
+   exception_ptr deserError = nullptr;
+   try
+   {
+      cmdObj->deserialize();
+   }
+   catch (...)
+   {
+      deserError = current_exception();
+   }
 
-      }
-      catch (exception& e)
+   auto runLbd = [this, req, cmdObj, encoding, deserError](void)->void
+   {
+      auto cmdLbd = [this, cmdObj, deserError](void)->Arguments
       {
-         ErrorType err(e.what());
-         Arguments arg;
-         arg.push_back(move(err));
+         if (deserError != nullptr)
+            rethrow_exception(deserError);
 
-         retStream << arg.serialize();
-      }
-      catch (DbErrorMsg &e)
-      {
-         ErrorType err(e.what());
-         Arguments arg;
-         arg.push_back(move(err));
+         return clients_.runCommand(*cmdObj);
+      };
 
-         retStream << arg.serialize();
-      }
-      catch (...)
-      {
-         ErrorType err("unknown error");
-         Arguments arg;
-         arg.push_back(move(err));
-         
-         retStream << arg.serialize();
-      }
-      
-      //complete HTML header
-      ss << "Content-Length: " << retStream.str().size();
-      ss << "\r\n\r\n";
+      writeReply(req, getReply(cmdLbd, encoding));
+   };
+
+   //callback requests wait until there is a notification to return. They
+   //are parked in the hub, or run in their own pool so they can't starve 
+   //regular requests
+   if (deserError == nullptr && cmdObj->method_ == "registerCallback")
+   {
+      if (notificationHub_ != nullptr)
+         parkCallback(req, cmdObj, encoding);
+      else
+         longPollPool_->push(runLbd);
    }
    else
    {
-      LOGERR << "empty content_length";
-      FCGX_Finish_r(req);
-      delete req;
+      runLbd();
+   }
+}
 
-      liveThreads_.fetch_sub(1, memory_order_relaxed);
+///////////////////////////////////////////////////////////////////////////////
+void FCGI_Server::parkCallback(
+   FCGX_Request* req, shared_ptr<Command> cmdObj, WireEncoding encoding)
+{
+   shared_ptr<SocketCallback> cbPtr;
+   string command;
+
+   try
+   {
+      cbPtr = clients_.getCallback(*cmdObj);
+      if (cbPtr != nullptr)
+         command = cmdObj->args_.get<BinaryDataObject>().toStr();
+   }
+   catch (...)
+   {
+      auto errPtr = current_exception();
+      auto errLbd = [errPtr](void)->Arguments
+      {
+         rethrow_exception(errPtr);
+      };
+
+      writeReply(req, getReply(errLbd, encoding));
       return;
    }
 
-   delete[] content;
-   
+   if (cbPtr == nullptr)
+   {
+      writeReply(req, Arguments().serialize(encoding));
+      return;
+   }
+
+   //runs in the hub thread, hand the socket write over to the request pool
+   auto replyLbd = [this, req, encoding](Arguments& arg)->void
+   {
+      auto reply = make_shared<string>(arg.serialize(encoding));
+      auto writeLbd = [this, req, reply](void)->void
+      {
+         this->writeReply(req, *reply);
+      };
+
+      requestPool_->push(writeLbd);
+   };
+
+   notificationHub_->park(cbPtr, command, replyLbd);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool FCGI_Server::readContent(FCGX_Request* req, string& content)
+{
+   //extract the string command from the fgci request
+   char* content_length = FCGX_GetParam("CONTENT_LENGTH", req->envp);
+   if (content_length == nullptr)
+      return false;
+
+   auto a = atoi(content_length);
+   if (a < 0)
+      return false;
+
+   //binary commands may carry null bytes
+   content.resize(a);
+   if (a > 0)
+   {
+      auto readCount = FCGX_GetStr(&content[0], a, req->in);
+      content.resize(max(readCount, 0));
+   }
+
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+string FCGI_Server::getReply(
+   function<Arguments(void)> cmdLbd, WireEncoding encoding)
+{
+   try
+   {
+      auto&& retVal = cmdLbd();
+      return retVal.serialize(encoding);
+   }
+   catch (exception& e)
+   {
+      ErrorType err(e.what());
+      Arguments arg;
+      arg.push_back(move(err));
+
+      return arg.serialize(encoding);
+   }
+   catch (DbErrorMsg &e)
+   {
+      ErrorType err(e.what());
+      Arguments arg;
+      arg.push_back(move(err));
+
+      return arg.serialize(encoding);
+   }
+   catch (...)
+   {
+      ErrorType err("unknown error");
+      Arguments arg;
+      arg.push_back(move(err));
+
+      return arg.serialize(encoding);
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FCGI_Server::writeReply(FCGX_Request* req, const string& reply)
+{
+   //print HTML header
+   stringstream ss;
+   ss << "HTTP/1.1 200 OK\r\n";
+   ss << "Content-Type: text/html; charset=UTF-8\r\n";
+   ss << "Content-Length: " << reply.size();
+   ss << "\r\n\r\n";
+
    //print serialized retVal
-   ss << retStream.str();
+   ss << reply;
 
    auto&& retStr = ss.str();
    vector<pair<size_t, size_t>> msgOffsetVec;
@@ -1449,6 +1641,414 @@ void FCGI_Server::processRequest(FCGX_Request* req)
    liveThreads_.fetch_sub(1, memory_order_relaxed);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//
+// WorkerPool
+//
+///////////////////////////////////////////////////////////////////////////////
+WorkerPool::WorkerPool(const string& name, unsigned threadCount) :
+   name_(name)
+{
+   queueDepth_.store(0, memory_order_relaxed);
+   maxQueueDepth_.store(0, memory_order_relaxed);
+   completed_.store(0, memory_order_relaxed);
+   totalWaitUs_.store(0, memory_order_relaxed);
+   maxWaitUs_.store(0, memory_order_relaxed);
+   totalRunUs_.store(0, memory_order_relaxed);
+
+   if (threadCount == 0)
+      threadCount = 1;
+
+   auto workerLbd = [this](void)->void
+   {
+      this->workerThread();
+   };
+
+   for (unsigned i = 0; i < threadCount; i++)
+      threads_.push_back(thread(workerLbd));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+WorkerPool::~WorkerPool()
+{
+   shutdown();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void WorkerPool::push(function<void(void)> job)
+{
+   Job jobObj;
+   jobObj.job_ = move(job);
+   jobObj.queuedAt_ = chrono::steady_clock::now();
+
+   auto depth = queueDepth_.fetch_add(1, memory_order_relaxed) + 1;
+   auto maxDepth = maxQueueDepth_.load(memory_order_relaxed);
+   while (depth > maxDepth && 
+      !maxQueueDepth_.compare_exchange_weak(maxDepth, depth,
+         memory_order_relaxed))
+   {}
+
+   queue_.push_back(move(jobObj));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void WorkerPool::workerThread()
+{
+   while (1)
+   {
+      Job jobObj;
+      try
+      {
+         jobObj = move(queue_.pop_front());
+      }
+      catch (StopBlockingLoop&)
+      {
+         break;
+      }
+
+      queueDepth_.fetch_sub(1, memory_order_relaxed);
+
+      auto start = chrono::steady_clock::now();
+      uint64_t waitUs = chrono::duration_cast<chrono::microseconds>(
+         start - jobObj.queuedAt_).count();
+
+      try
+      {
+         jobObj.job_();
+      }
+      catch (exception& e)
+      {
+         LOGERR << name_ << " job error: " << e.what();
+      }
+      catch (...)
+      {
+         LOGERR << name_ << " job error";
+      }
+
+      uint64_t runUs = chrono::duration_cast<chrono::microseconds>(
+         chrono::steady_clock::now() - start).count();
+
+      totalWaitUs_.fetch_add(waitUs, memory_order_relaxed);
+      totalRunUs_.fetch_add(runUs, memory_order_relaxed);
+      auto maxWait = maxWaitUs_.load(memory_order_relaxed);
+      while (waitUs > maxWait &&
+         !maxWaitUs_.compare_exchange_weak(maxWait, waitUs,
+            memory_order_relaxed))
+      {}
+
+      completed_.fetch_add(1, memory_order_relaxed);
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void WorkerPool::shutdown()
+{
+   queue_.completed();
+
+   for (auto& thr : threads_)
+   {
+      if (thr.joinable())
+         thr.join();
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+WorkerPool::Stats WorkerPool::getStats() const
+{
+   Stats stats;
+   stats.queueDepth_ = queueDepth_.load(memory_order_relaxed);
+   stats.maxQueueDepth_ = maxQueueDepth_.load(memory_order_relaxed);
+   stats.completed_ = completed_.load(memory_order_relaxed);
+   stats.maxWaitMs_ = maxWaitUs_.load(memory_order_relaxed) / 1000.0;
+
+   if (stats.completed_ > 0)
+   {
+      stats.avgWaitMs_ = totalWaitUs_.load(memory_order_relaxed) / 1000.0 /
+         stats.completed_;
+      stats.avgRunMs_ = totalRunUs_.load(memory_order_relaxed) / 1000.0 /
+         stats.completed_;
+   }
+
+   return stats;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// NotificationHub
+//
+///////////////////////////////////////////////////////////////////////////////
+NotificationHub::NotificationHub(chrono::milliseconds timeout) :
+   timeout_(timeout)
+{
+   run_.store(false, memory_order_relaxed);
+
+#ifdef __linux__
+   epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+   eventFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   timerFd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+   if (epollFd_ == -1 || eventFd_ == -1 || timerFd_ == -1)
+   {
+      closeFds();
+      throw runtime_error("failed to create notification hub descriptors");
+   }
+
+   //expiry tick, never coarser than the timeout itself
+   auto tick = min(timeout_, chrono::milliseconds(1000));
+   itimerspec timerSpec;
+   timerSpec.it_interval.tv_sec = tick.count() / 1000;
+   timerSpec.it_interval.tv_nsec = (tick.count() % 1000) * 1000000;
+   timerSpec.it_value = timerSpec.it_interval;
+
+   epoll_event eventEv, timerEv;
+   eventEv.events = timerEv.events = EPOLLIN;
+   eventEv.data.fd = eventFd_;
+   timerEv.data.fd = timerFd_;
+
+   if (timerfd_settime(timerFd_, 0, &timerSpec, nullptr) != 0 ||
+      epoll_ctl(epollFd_, EPOLL_CTL_ADD, eventFd_, &eventEv) != 0 ||
+      epoll_ctl(epollFd_, EPOLL_CTL_ADD, timerFd_, &timerEv) != 0)
+   {
+      closeFds();
+      throw runtime_error("failed to setup notification hub descriptors");
+   }
+
+   run_.store(true, memory_order_relaxed);
+
+   auto thrLbd = [this](void)->void
+   {
+      this->hubThread();
+   };
+
+   thr_ = thread(thrLbd);
+#else
+   throw runtime_error("notification hub requires epoll");
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+NotificationHub::~NotificationHub()
+{
+   shutdown();
+   closeFds();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void NotificationHub::closeFds()
+{
+#ifdef __linux__
+   for (auto fdPtr : { &epollFd_, &eventFd_, &timerFd_ })
+   {
+      if (*fdPtr != -1)
+         close(*fdPtr);
+      *fdPtr = -1;
+   }
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void NotificationHub::wakeUp()
+{
+#ifdef __linux__
+   uint64_t val = 1;
+   auto rc = write(eventFd_, &val, sizeof(val));
+   (void)rc;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void NotificationHub::replyContinue(ReplyLambda& replyLbd)
+{
+   Arguments arg;
+   BinaryDataObject bdo("continue");
+   arg.push_back(move(bdo));
+   replyLbd(arg);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void NotificationHub::park(shared_ptr<SocketCallback> cbPtr, 
+   const string& command, ReplyLambda replyLbd)
+{
+   ParkedRequest request;
+   request.cbPtr_ = cbPtr;
+   request.command_ = command;
+   request.reply_ = replyLbd;
+   request.expiresAt_ = chrono::steady_clock::now() + timeout_;
+
+   ReplyLambda replaced;
+   {
+      unique_lock<mutex> lock(mu_);
+      if (!run_.load(memory_order_relaxed))
+      {
+         lock.unlock();
+         replyContinue(replyLbd);
+         return;
+      }
+
+      //a client only waits on one callback request at a time, the one
+      //already parked is most likely from a dropped connection
+      auto iter = parked_.find(cbPtr.get());
+      if (iter != parked_.end())
+      {
+         replaced = move(iter->second.reply_);
+         iter->second = move(request);
+      }
+      else
+      {
+         parked_.insert(make_pair(cbPtr.get(), move(request)));
+      }
+
+      //orders that came in before the hub was set have not signaled, 
+      //have the hub thread check this callback once
+      cbPtr->setHub(this);
+      signaled_.insert(cbPtr.get());
+   }
+
+   wakeUp();
+
+   if (replaced)
+      replyContinue(replaced);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void NotificationHub::signal(SocketCallback* cbPtr)
+{
+   bool wake;
+   {
+      unique_lock<mutex> lock(mu_);
+      wake = signaled_.size() == 0;
+      signaled_.insert(cbPtr);
+   }
+
+   //the hub thread takes the whole signaled set per wake up
+   if (wake)
+      wakeUp();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void NotificationHub::hubThread()
+{
+#ifdef __linux__
+   epoll_event events[2];
+
+   while (run_.load(memory_order_relaxed))
+   {
+      auto count = epoll_wait(epollFd_, events, 2, -1);
+      if (count == -1)
+      {
+         if (errno == EINTR)
+            continue;
+
+         LOGERR << "notification hub epoll_wait failed with error: " <<
+            strerror(errno);
+         break;
+      }
+
+      bool checkExpiry = false;
+      for (int i = 0; i < count; i++)
+      {
+         uint64_t val;
+         if (events[i].data.fd == timerFd_)
+         {
+            checkExpiry = true;
+            auto rc = read(timerFd_, &val, sizeof(val));
+            (void)rc;
+         }
+         else
+         {
+            auto rc = read(eventFd_, &val, sizeof(val));
+            (void)rc;
+         }
+      }
+
+      if (!run_.load(memory_order_relaxed))
+         break;
+
+      //collect replies under the lock, send them outside of it
+      vector<pair<ReplyLambda, Arguments>> replies;
+      {
+         unique_lock<mutex> lock(mu_);
+         set<SocketCallback*> signaled;
+         signaled.swap(signaled_);
+
+         for (auto cbPtr : signaled)
+         {
+            auto iter = parked_.find(cbPtr);
+            if (iter == parked_.end())
+               continue;
+
+            auto& request = iter->second;
+            Arguments arg;
+            if (!request.cbPtr_->tryRespond(request.command_, arg))
+               continue;
+
+            request.cbPtr_->setHub(nullptr);
+            replies.push_back(make_pair(move(request.reply_), move(arg)));
+            parked_.erase(iter);
+         }
+
+         if (checkExpiry)
+         {
+            auto now = chrono::steady_clock::now();
+            auto iter = parked_.begin();
+            while (iter != parked_.end())
+            {
+               if (iter->second.expiresAt_ > now)
+               {
+                  ++iter;
+                  continue;
+               }
+
+               Arguments arg;
+               BinaryDataObject bdo("continue");
+               arg.push_back(move(bdo));
+
+               iter->second.cbPtr_->setHub(nullptr);
+               replies.push_back(
+                  make_pair(move(iter->second.reply_), move(arg)));
+               parked_.erase(iter++);
+            }
+         }
+      }
+
+      for (auto& reply : replies)
+         reply.first(reply.second);
+   }
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void NotificationHub::shutdown()
+{
+   {
+      unique_lock<mutex> lock(mu_);
+      run_.store(false, memory_order_relaxed);
+   }
+
+   wakeUp();
+   if (thr_.joinable())
+      thr_.join();
+
+   map<SocketCallback*, ParkedRequest> parked;
+   {
+      unique_lock<mutex> lock(mu_);
+      parked.swap(parked_);
+      signaled_.clear();
+   }
+
+   for (auto& request : parked)
+   {
+      request.second.cbPtr_->setHub(nullptr);
+      replyContinue(request.second.reply_);
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+size_t NotificationHub::parkedCount()
+{
+   unique_lock<mutex> lock(mu_);
+   return parked_.size();
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 BDV_Server_Object::BDV_Server_Object(
@@ -1820,32 +2420,18 @@ bool BDV_Server_Object::registerLockbox(
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-Arguments SocketCallback::respond(const string& command)
+bool SocketCallback::getReadyReply(const string& command, Arguments& arg)
 {
-   unique_lock<mutex> lock(mu_, defer_lock);
-
-   if (!lock.try_lock())
-   {
-      Arguments arg;
-      BinaryDataObject bdo("continue");
-      arg.push_back(move(bdo));
-      return move(arg);
-   }
-   
-   count_ = 0;
-   vector<Callback::OrderStruct> orderVec;
-
    if (command == "waitOnBDV")
    {
       //test if ready
       auto topheight = isReady_();
       if (topheight != UINT32_MAX)
       {
-         Arguments arg;
          BinaryDataObject bdo("BDM_Ready");
          arg.push_back(move(bdo));
          arg.push_back(move(IntType(topheight)));
-         return move(arg);
+         return true;
       }
 
       //otherwise wait on callback stack as usual
@@ -1855,6 +2441,31 @@ Arguments SocketCallback::respond(const string& command)
       //throw unknown command error
    }
 
+   return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+Arguments SocketCallback::respond(const string& command)
+{
+   unique_lock<mutex> lock(mu_, defer_lock);
+
+   if (!lock.try_lock())
+   {
+      Arguments arg;
+      BinaryDataObject bdo("continue");
+      arg.push_back(move(bdo));
+      return move(arg);
+   }
+   
+   count_ = 0;
+   vector<Callback::OrderStruct> orderVec;
+
+   {
+      Arguments arg;
+      if (getReadyReply(command, arg))
+         return arg;
+   }
+
    try
    {
       orderVec = move(cbStack_.pop_all(std::chrono::seconds(50)));
@@ -1884,6 +2495,53 @@ Arguments SocketCallback::respond(const string& command)
       terminateOrder.otype_ = OrderOther;
    }
 
+   return buildReply(orderVec);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool SocketCallback::tryRespond(const string& command, Arguments& arg)
+{
+   unique_lock<mutex> lock(mu_, defer_lock);
+   if (!lock.try_lock())
+      return false;
+
+   count_ = 0;
+   if (getReadyReply(command, arg))
+      return true;
+
+   vector<Callback::OrderStruct> orderVec;
+   try
+   {
+      //the non blocking pop, TimedStack::pop_front always waits
+      while (1)
+         orderVec.push_back(move(cbStack_.Stack<OrderStruct>::pop_front()));
+   }
+   catch (IsEmpty&)
+   {}
+
+   if (!cbStack_.isValid())
+      orderVec.push_back(move(OrderStruct(Arguments(), OrderTerminate)));
+
+   if (orderVec.size() == 0)
+      return false;
+
+   arg = move(buildReply(orderVec));
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void SocketCallback::callback(Arguments&& cmd, OrderType type)
+{
+   Callback::callback(move(cmd), type);
+
+   auto hub = hub_.load(memory_order_acquire);
+   if (hub != nullptr)
+      hub->signal(this);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+Arguments SocketCallback::buildReply(vector<Callback::OrderStruct>& orderVec)
+{
    //consolidate NewBlock and Refresh notifications
    Arguments* refreshOrderPtr = nullptr;
    int32_t newBlock = -1;
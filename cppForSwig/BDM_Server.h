@@ -11,6 +11,7 @@
 
 #include <vector>
 #include <map>
+#include <set>
 #include <mutex>
 #include <thread>
 #include <future>
@@ -36,6 +37,8 @@ enum WalletType
    TypeLockbox
 };
 
+class NotificationHub;
+
 ///////////////////////////////////////////////////////////////////////////////
 class SocketCallback : public Callback
 {
@@ -45,18 +48,40 @@ private:
 
    function<unsigned(void)> isReady_;
 
+   //set while a callback request is parked in that hub
+   atomic<NotificationHub*> hub_;
+
+private:
+   bool getReadyReply(const string&, Arguments&);
+   Arguments buildReply(vector<Callback::OrderStruct>&);
+
 public:
    SocketCallback(function<unsigned(void)> isReady) :
       Callback(), isReady_(isReady)
    {
       count_.store(0, memory_order_relaxed);
+      hub_.store(nullptr, memory_order_relaxed);
    }
 
    void emit(void);
    Arguments respond(const string&);
 
+   //non blocking respond, returns false if there is nothing to reply yet
+   bool tryRespond(const string&, Arguments&);
+
+   //signals the hub this callback is parked in, if any
+   void callback(Arguments&& cmd, OrderType type = OrderOther);
+   void setHub(NotificationHub* hub) { hub_.store(hub, memory_order_release); }
+
    bool isValid(void)
    {
+      //a parked request is a client waiting on us
+      if (hub_.load(memory_order_acquire) != nullptr)
+      {
+         count_.store(0, memory_order_relaxed);
+         return true;
+      }
+
       unique_lock<mutex> lock(mu_, defer_lock);
 
       if (lock.try_lock())
@@ -217,6 +242,11 @@ public:
 
    const shared_ptr<BDV_Server_Object>& get(const string& id) const;
    Arguments runCommand(const string& cmd);
+   Arguments runCommand(Command&);
+
+   //callback of the BDV a registerCallback command is for, nullptr if 
+   //that callback has expired
+   shared_ptr<SocketCallback> getCallback(const Command&);
    Arguments processShutdownCommand(Command&);
    Arguments registerBDV(Arguments& arg);
    void unregisterBDV(const string& bdvId);
@@ -224,6 +254,124 @@ public:
    void exitRequestLoop(void);
 };
 
+///////////////////////////////////////////////////////////////////////////////
+class WorkerPool
+{
+   /***
+   Fixed count of threads running queued jobs. The thread count is bounded,
+   the queue is not. Tracks the queue depth and how long jobs wait in the
+   queue and take to run.
+   ***/
+
+public:
+   struct Stats
+   {
+      size_t queueDepth_ = 0;
+      size_t maxQueueDepth_ = 0;
+      uint64_t completed_ = 0;
+
+      double avgWaitMs_ = 0.0;
+      double maxWaitMs_ = 0.0;
+      double avgRunMs_ = 0.0;
+   };
+
+private:
+   struct Job
+   {
+      function<void(void)> job_;
+      chrono::steady_clock::time_point queuedAt_;
+   };
+
+   const string name_;
+   BlockingStack<Job> queue_;
+   vector<thread> threads_;
+
+   atomic<size_t> queueDepth_;
+   atomic<size_t> maxQueueDepth_;
+   atomic<uint64_t> completed_;
+   atomic<uint64_t> totalWaitUs_;
+   atomic<uint64_t> maxWaitUs_;
+   atomic<uint64_t> totalRunUs_;
+
+private:
+   void workerThread(void);
+
+public:
+   WorkerPool(const string& name, unsigned threadCount);
+   ~WorkerPool(void);
+
+   void push(function<void(void)>);
+
+   //runs the jobs already queued, then joins the threads
+   void shutdown(void);
+
+   Stats getStats(void) const;
+   size_t threadCount(void) const { return threads_.size(); }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+class NotificationHub
+{
+   /***
+   Parks callback requests (registerCallback long polls) until their BDV has
+   something to return, without holding a thread per request. A single 
+   thread waits on an epoll set of:
+      - an eventfd, written to when the callback of a parked request gets
+        new orders
+      - a timerfd, ticking to expire the requests that waited too long
+
+   Replies go through the lambda the request was parked with, from the hub
+   thread. Linux only, the constructor throws elsewhere.
+   ***/
+
+public:
+   typedef function<void(Arguments&)> ReplyLambda;
+
+private:
+   struct ParkedRequest
+   {
+      shared_ptr<SocketCallback> cbPtr_;
+      string command_;
+      ReplyLambda reply_;
+      chrono::steady_clock::time_point expiresAt_;
+   };
+
+   const chrono::milliseconds timeout_;
+
+   int epollFd_ = -1;
+   int eventFd_ = -1;
+   int timerFd_ = -1;
+
+   mutex mu_;
+   map<SocketCallback*, ParkedRequest> parked_;
+   set<SocketCallback*> signaled_;
+
+   atomic<bool> run_;
+   thread thr_;
+
+private:
+   NotificationHub(const NotificationHub&) = delete;
+
+   void hubThread(void);
+   void wakeUp(void);
+   void closeFds(void);
+   static void replyContinue(ReplyLambda&);
+
+public:
+   NotificationHub(chrono::milliseconds timeout = chrono::seconds(50));
+   ~NotificationHub(void);
+
+   void park(shared_ptr<SocketCallback>, const string&, ReplyLambda);
+
+   //called by parked callbacks when they get new orders
+   void signal(SocketCallback*);
+
+   //replies "continue" to all parked requests, then joins the hub thread
+   void shutdown(void);
+
+   size_t parkedCount(void);
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 class FCGI_Server
 {
@@ -244,6 +392,13 @@ private:
 
    Clients clients_;
 
+   //regular requests, and the callback requests that wait on notifications
+   unique_ptr<WorkerPool> requestPool_;
+   unique_ptr<WorkerPool> longPollPool_;
+
+   //parks callback requests instead of the long poll pool where available
+   unique_ptr<NotificationHub> notificationHub_;
+
 private:
    function<void(void)> getShutdownCallback(void)
    {
@@ -255,14 +410,13 @@ private:
       return shutdownCallback;
    }
 
+   bool readContent(FCGX_Request* req, string& content);
+   string getReply(function<Arguments(void)>, WireEncoding);
+   void writeReply(FCGX_Request* req, const string& reply);
+   void parkCallback(FCGX_Request*, shared_ptr<Command>, WireEncoding);
+
 public:
-   FCGI_Server(BlockDataManagerThread* bdmT, string port) :
-      clients_(bdmT, getShutdownCallback()),
-      ip_("127.0.0.1"), port_(port)
-   {
-      LOGINFO << "Listening on port " << port;
-      liveThreads_.store(0, memory_order_relaxed);
-   }
+   FCGI_Server(BlockDataManagerThread* bdmT, string port);
 
    void init(void);
    void enterLoop(void);
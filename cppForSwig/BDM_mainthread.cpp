@@ -300,6 +300,9 @@ try
          break;
       }
    }
+
+   //new block scans drop the utxo snapshot, leave one for the next start
+   bdm->writeUtxoSnapshot();
 }
 catch (std::exception &e)
 {
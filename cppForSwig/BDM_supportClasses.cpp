@@ -349,10 +349,10 @@ bool ScrAddrFilter::registerAddressBatch(
 
    struct pred
    {
-      shared_ptr<map<AddrAndHash, int>> saMap_;
+      shared_ptr<const PersistentMap<AddrAndHash, int>> saMap_;
       function<void(shared_ptr<WalletInfo>)> eraseLambda_;
 
-      pred(shared_ptr<map<AddrAndHash, int>> saMap,
+      pred(shared_ptr<const PersistentMap<AddrAndHash, int>> saMap,
          function<void(shared_ptr<WalletInfo>)> eraselambda)
          : saMap_(saMap), eraseLambda_(eraselambda)
       {}
@@ -791,6 +791,202 @@ bool ScrAddrFilter::hasNewAddresses(void) const
    return false;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//MempoolGraph Methods
+///////////////////////////////////////////////////////////////////////////////
+const map<unsigned, BinaryData> MempoolGraph::emptySpenderMap_;
+
+///////////////////////////////////////////////////////////////////////////////
+void MempoolGraph::addTx(const BinaryData& zcKey, const BinaryData& txHash,
+   const FlatHashMap<32, map<unsigned, BinaryData>>& spentOutPoints,
+   const map<BinaryData, shared_ptr<map<BinaryData, TxIOPair>>>& txios,
+   const set<BinaryData>& spentTxOutKeys)
+{
+   //a key is never reused for a different tx, but play it safe
+   removeTx(zcKey);
+
+   Node node;
+   node.txHash_ = txHash;
+   node.spentTxOutKeys_ = spentTxOutKeys;
+
+   for (auto& saPair : txios)
+   {
+      auto& keySet = node.txioKeys_[saPair.first];
+      for (auto& txioPair : *saPair.second)
+         keySet.insert(txioPair.first);
+   }
+
+   for (auto& opPair : spentOutPoints)
+   {
+      BinaryData opHash(opPair.first.getRef());
+
+      auto& idSet = node.spentOutPoints_[opHash];
+      auto& spenderMap = spenders_[opHash];
+      for (auto& idPair : opPair.second)
+      {
+         idSet.insert(idPair.first);
+         spenderMap[idPair.first] = zcKey;
+      }
+
+      auto parentIter = hashToKey_.find(opHash);
+      if (parentIter != hashToKey_.end())
+         node.parents_.insert(parentIter->second);
+   }
+
+   //ZCs spending this tx may have been added before it
+   auto childIter = spenders_.find(txHash);
+   if (childIter != spenders_.end())
+   {
+      for (auto& idPair : childIter->second)
+         node.children_.insert(idPair.second);
+   }
+
+   for (auto& parentKey : node.parents_)
+   {
+      auto parentIter = nodes_.find(parentKey);
+      if (parentIter != nodes_.end())
+         parentIter->second.children_.insert(zcKey);
+   }
+
+   for (auto& childKey : node.children_)
+   {
+      auto nodeIter = nodes_.find(childKey);
+      if (nodeIter != nodes_.end())
+         nodeIter->second.parents_.insert(zcKey);
+   }
+
+   hashToKey_[txHash] = zcKey;
+   nodes_[zcKey] = move(node);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void MempoolGraph::removeTx(const BinaryData& zcKey)
+{
+   auto nodeIter = nodes_.find(zcKey);
+   if (nodeIter == nodes_.end())
+      return;
+
+   auto& node = nodeIter->second;
+
+   //unlink from parents and children
+   for (auto& parentKey : node.parents_)
+   {
+      auto parentIter = nodes_.find(parentKey);
+      if (parentIter != nodes_.end())
+         parentIter->second.children_.erase(zcKey);
+   }
+
+   for (auto& childKey : node.children_)
+   {
+      auto childIter = nodes_.find(childKey);
+      if (childIter != nodes_.end())
+         childIter->second.parents_.erase(zcKey);
+   }
+
+   //release the outpoints it spends, unless another ZC took them over
+   for (auto& opPair : node.spentOutPoints_)
+   {
+      auto spenderIter = spenders_.find(opPair.first);
+      if (spenderIter == spenders_.end())
+         continue;
+
+      auto& spenderMap = spenderIter->second;
+      for (auto& id : opPair.second)
+      {
+         auto idIter = spenderMap.find(id);
+         if (idIter != spenderMap.end() && idIter->second == zcKey)
+            spenderMap.erase(idIter);
+      }
+
+      if (spenderMap.size() == 0)
+         spenders_.erase(spenderIter);
+   }
+
+   auto hashIter = hashToKey_.find(node.txHash_);
+   if (hashIter != hashToKey_.end() && hashIter->second == zcKey)
+      hashToKey_.erase(hashIter);
+
+   nodes_.erase(nodeIter);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void MempoolGraph::clear()
+{
+   nodes_.clear();
+   hashToKey_.clear();
+   spenders_.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool MempoolGraph::hasTx(const BinaryData& zcKey) const
+{
+   return nodes_.find(zcKey) != nodes_.end();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+const MempoolGraph::Node& MempoolGraph::getNode(const BinaryData& zcKey) const
+{
+   auto iter = nodes_.find(zcKey);
+   if (iter == nodes_.end())
+      throw runtime_error("unknown zc key");
+
+   return iter->second;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool MempoolGraph::getKeyForHash(
+   const BinaryData& txHash, BinaryData& zcKey) const
+{
+   auto iter = hashToKey_.find(txHash);
+   if (iter == hashToKey_.end())
+      return false;
+
+   zcKey = iter->second;
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+const map<unsigned, BinaryData>& MempoolGraph::getSpenders(
+   const BinaryDataRef& txHash) const
+{
+   auto iter = spenders_.find(txHash);
+   if (iter == spenders_.end())
+      return emptySpenderMap_;
+
+   return iter->second;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+set<BinaryData> MempoolGraph::getDescendants(
+   const set<BinaryData>& zcKeys) const
+{
+   set<BinaryData> result;
+   vector<BinaryData> toVisit;
+
+   for (auto& zcKey : zcKeys)
+   {
+      if (!hasTx(zcKey))
+         continue;
+
+      if (result.insert(zcKey).second)
+         toVisit.push_back(zcKey);
+   }
+
+   while (toVisit.size() > 0)
+   {
+      auto zcKey = move(toVisit.back());
+      toVisit.pop_back();
+
+      for (auto& childKey : getNode(zcKey).children_)
+      {
+         if (result.insert(childKey).second)
+            toVisit.push_back(childKey);
+      }
+   }
+
+   return result;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //ZeroConfContainer Methods
 ///////////////////////////////////////////////////////////////////////////////
@@ -820,7 +1016,8 @@ Tx ZeroConfContainer::getTxByHash(const BinaryData& txHash) const
    if (txiter == txmap->end())
       return Tx();
 
-   auto& theTx = txiter->second;
+   //the snapshot is shared, set the TxRef on a copy
+   auto theTx = txiter->second;
    theTx.setTxRef(TxRef(keyIter->second));
 
    return theTx;
@@ -833,227 +1030,292 @@ bool ZeroConfContainer::hasTxByHash(const BinaryData& txHash) const
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-set<BinaryData> ZeroConfContainer::purge()
+map<BinaryData, Tx> ZeroConfContainer::purge()
 {
    if (!db_)
-      return set<BinaryData>();
+      return map<BinaryData, Tx>();
 
    /***
+   Drops the ZCs invalidated by the new blocks and returns the ones that have
+   to be parsed again. Only mined ZCs, ZCs double spending an outpoint 
+   consumed by the new blocks and the descendants of both are touched, the
+   rest of the mempool is left as is.
+
    For ZC chains to be parsed properly, it is important ZC transactions are
    parsed in the order they appeared.
    ***/
-   LMDBEnv::Transaction tx;
-   db_->beginDBTransaction(&tx, ZERO_CONF, LMDB::ReadOnly);
 
-   //get all txhashes for the new blocks
+   //get all txhashes and consumed outpoints for the new blocks
    set<BinaryData> minedHashes;
-   auto bcPtr = db_->blockchain();
-   try
+   map<BinaryData, map<unsigned, BinaryData>> outPointsSpentByBlocks;
+   bool reorg = false;
+
    {
-      auto lastKnownHeader =
-         bcPtr->getHeaderByHash(lastParsedBlockHash_);
+      LMDBEnv::Transaction tx;
+      db_->beginDBTransaction(&tx, ZERO_CONF, LMDB::ReadOnly);
 
-      while (!lastKnownHeader->isMainBranch())
+      auto bcPtr = db_->blockchain();
+      try
       {
-         //trace back to the branch point
-         auto&& bhash = lastKnownHeader->getPrevHash();
-         lastKnownHeader = bcPtr->getHeaderByHash(bhash);
-      }
+         auto lastKnownHeader =
+            bcPtr->getHeaderByHash(lastParsedBlockHash_);
+
+         while (!lastKnownHeader->isMainBranch())
+         {
+            //trace back to the branch point
+            reorg = true;
+            auto&& bhash = lastKnownHeader->getPrevHash();
+            lastKnownHeader = bcPtr->getHeaderByHash(bhash);
+         }
 
-      //get the next header
-      auto height = lastKnownHeader->getBlockHeight() + 1;
-      lastKnownHeader = bcPtr->getHeaderByHeight(height);
+         //get the next header
+         auto height = lastKnownHeader->getBlockHeight() + 1;
+         lastKnownHeader = bcPtr->getHeaderByHeight(height);
 
-      while (lastKnownHeader != nullptr)
+         while (lastKnownHeader != nullptr)
+         {
+            //grab block
+            StoredHeader sbh;
+            db_->getStoredHeader(sbh,
+               lastKnownHeader->getBlockHeight(),
+               lastKnownHeader->getDuplicateID());
+
+            //build up hash set and spent outpoints
+            for (auto& stx : sbh.stxMap_)
+            {
+               minedHashes.insert(stx.second.thisHash_);
+
+               auto&& minedTx = stx.second.getTxCopy();
+               auto txPtr = minedTx.getPtr();
+               for (unsigned i = 0; i < minedTx.getNumTxIn(); i++)
+               {
+                  OutPoint op;
+                  op.unserialize(txPtr + minedTx.getTxInOffset(i), 36);
+
+                  auto& idMap = outPointsSpentByBlocks[op.getTxHash()];
+                  idMap[op.getTxOutIndex()] = stx.second.thisHash_;
+               }
+            }
+
+            //next block
+            auto& bhash = lastKnownHeader->getNextHash();
+            lastKnownHeader = bcPtr->getHeaderByHash(bhash);
+         }
+      }
+      catch (...)
       {
-         //grab block
-         StoredHeader sbh;
-         db_->getStoredHeader(sbh,
-            lastKnownHeader->getBlockHeight(),
-            lastKnownHeader->getDuplicateID(),
-            false);
-
-         //build up hash set
-         for (auto& stx : sbh.stxMap_)
-            minedHashes.insert(stx.second.thisHash_);
-
-         //next block
-         auto& bhash = lastKnownHeader->getNextHash();
-         lastKnownHeader = bcPtr->getHeaderByHash(bhash);
       }
    }
-   catch (...)
-   {
-   }
 
-   set<BinaryData> keysToDelete;
-   vector<BinaryData> ktdVec;
+   auto txhashmap = txHashToDBKey_.get();
+   auto txmap = txMap_.get();
 
+   if (reorg)
    {
-      auto txhashmap = txHashToDBKey_.get();
+      /***
+      Blocks were reorged out from under the ZCs, the outputs they spend may
+      have new DB keys. Drop the mined ZCs and parse the rest of the mempool
+      again.
+      ***/
+
+      map<BinaryData, Tx> zcMap(txmap->begin(), txmap->end());
+      vector<BinaryData> ktdVec;
 
-      //compare minedHashes to allZCTxHashes_
       for (auto& minedHash : minedHashes)
       {
          auto iter = allZcTxHashes_.find(minedHash);
-         if (iter != allZcTxHashes_.end())
-         {
-            auto zckeyIter = txhashmap->find(*iter);
-            if (zckeyIter != txhashmap->end())
-            {
-               keysToDelete.insert(zckeyIter->second);
-               ktdVec.push_back(zckeyIter->second);
-            }
+         if (iter == allZcTxHashes_.end())
+            continue;
 
-            allZcTxHashes_.erase(iter);
+         auto zckeyIter = txhashmap->find(*iter);
+         if (zckeyIter != txhashmap->end())
+         {
+            zcMap.erase(zckeyIter->second);
+            ktdVec.push_back(zckeyIter->second);
          }
+
+         allZcTxHashes_.erase(iter);
       }
-   }
 
-   //reset containers
-   txHashToDBKey_.clear();
-   txMap_.clear();
-   txioMap_.clear();
-   keyToSpentScrAddr_.clear();
-   txOutsSpentByZC_.clear();
-   outPointsSpentByKey_.clear();
+      //reset containers
+      txHashToDBKey_.clear();
+      txMap_.clear();
+      txioMap_.clear();
+      keyToSpentScrAddr_.clear();
+      txOutsSpentByZC_.clear();
+      mempoolGraph_.clear();
 
-   //delete keys from DB
-   auto deleteKeys = [&](void)->void
+      //delete keys from DB
+      auto deleteKeys = [&](void)->void
+      {
+         this->updateZCinDB(vector<BinaryData>(), ktdVec);
+      };
+
+      thread deleteKeyThread(deleteKeys);
+      if (deleteKeyThread.joinable())
+         deleteKeyThread.join();
+
+      return zcMap;
+   }
+
+   //ZCs spending an outpoint consumed by another tx in the new blocks
+   set<BinaryData> conflictingHashes;
+   for (auto& opPair : outPointsSpentByBlocks)
    {
-      this->updateZCinDB(vector<BinaryData>(), ktdVec);
-   };
+      auto& spenders = mempoolGraph_.getSpenders(opPair.first);
 
-   thread deleteKeyThread(deleteKeys);
-   if (deleteKeyThread.joinable())
-      deleteKeyThread.join();
+      for (auto& idPair : opPair.second)
+      {
+         auto idIter = spenders.find(idPair.first);
+         if (idIter == spenders.end())
+            continue;
 
-   return keysToDelete;
-}
+         auto& zcHash = mempoolGraph_.getNode(idIter->second).txHash_;
+         if (zcHash != idPair.second)
+            conflictingHashes.insert(zcHash);
+      }
+   }
 
-///////////////////////////////////////////////////////////////////////////////
-void ZeroConfContainer::dropZC(const set<BinaryData>& txHashes)
-{
-   if (txHashes.size() == 0)
-      return;
+   //mined ZCs and ZCs spending the output of a mined tx
+   set<BinaryData> minedZcHashes;
+   set<BinaryData> dependentHashes;
+   for (auto& minedHash : minedHashes)
+   {
+      for (auto& keyPair : mempoolGraph_.getSpenders(minedHash))
+         dependentHashes.insert(mempoolGraph_.getNode(keyPair.second).txHash_);
 
-   vector<BinaryData> keysToDelete;
-   vector<BinaryData> hashesToDelete;
+      auto iter = allZcTxHashes_.find(minedHash);
+      if (iter == allZcTxHashes_.end())
+         continue;
 
-   auto keytospendsaPtr = keyToSpentScrAddr_.get();
-   auto txiomapPtr = txioMap_.get();
-   auto txmapPtr = txMap_.get();
-   auto txhashmapPtr = txHashToDBKey_.get();
+      if (txhashmap->find(minedHash) != txhashmap->end())
+         minedZcHashes.insert(minedHash);
 
-   map<BinaryData, shared_ptr<map<BinaryData, TxIOPair>>> updateMap;
-   vector<BinaryData> delKeys;
+      allZcTxHashes_.erase(iter);
+   }
 
-   set<BinaryData> childHashes;
+   //conflicting ZCs and their descendants are invalid
+   auto&& invalidHashes = dropZC(conflictingHashes);
+   for (auto& hash : invalidHashes)
+      allZcTxHashes_.erase(hash);
 
-   for (auto& hash : txHashes)
+   /***
+   ZCs spending the outputs of mined txs are still valid but their txios
+   point to the keys of their parents as they were when the ZC was parsed,
+   either a ZC key or nothing at all. They are dropped along with the mined
+   ZCs and returned to be parsed again, which resolves the parent outputs to
+   their new DB keys.
+   ***/
+   map<BinaryData, Tx> zcMap;
+   dependentHashes.insert(minedZcHashes.begin(), minedZcHashes.end());
+   auto&& droppedHashes = dropZC(dependentHashes);
+   for (auto& hash : droppedHashes)
    {
-      //resolve zcKey
-      auto hashIter = txhashmapPtr->find(hash);
-      if (hashIter == txhashmapPtr->end())
+      if (minedZcHashes.find(hash) != minedZcHashes.end())
          continue;
 
-      auto zcKey = hashIter->second;
-      hashesToDelete.push_back(hash);
-
-      //gather hashes of children
-      auto spentOP_iter = outPointsSpentByKey_.find(hash);
-      if (spentOP_iter != outPointsSpentByKey_.end())
-      {
-         auto& keymap = spentOP_iter->second;
+      auto keyIter = txhashmap->find(hash);
+      if (keyIter == txhashmap->end())
+         continue;
 
-         for (auto& keypair : keymap)
-         {
-            auto hash_iter = txmapPtr->find(keypair.second);
-            if (hash_iter != txmapPtr->end())
-               childHashes.insert(hash_iter->second.getThisHash());
-         }
-      }
+      auto txIter = txmap->find(keyIter->second);
+      if (txIter == txmap->end())
+         continue;
 
-      //drop from keyToSpendScrAddr_
-      auto&& scrAddrSet = (*keytospendsaPtr)[zcKey];
-      keyToSpentScrAddr_.erase(zcKey);
+      zcMap.insert(make_pair(keyIter->second, txIter->second));
 
-      //drop from keyToFundedScrAddr_
-      auto fundedIter = keyToFundedScrAddr_.find(zcKey);
-      if (fundedIter != keyToFundedScrAddr_.end())
-      {
-         auto& fundedScrAddrSet = fundedIter->second;
-         if (fundedScrAddrSet.size())
-            scrAddrSet.insert(
-               fundedScrAddrSet.begin(),
-               fundedScrAddrSet.end()
-               );
-
-         keyToFundedScrAddr_.erase(fundedIter);
-      }
+      //dropZC wiped it from the DB, clear the hash so that it is written back
+      allZcTxHashes_.erase(hash);
+   }
 
-      set<BinaryData> rkeys;
-      //drop from txioMap_
-      for (auto& sa : scrAddrSet)
-      {
-         auto mapIter = txiomapPtr->find(sa);
-         if (mapIter == txiomapPtr->end())
-            continue;
+   return zcMap;
+}
 
-         auto& txiomap = mapIter->second;
+///////////////////////////////////////////////////////////////////////////////
+set<BinaryData> ZeroConfContainer::dropZC(const set<BinaryData>& txHashes)
+{
+   //returns the hashes of all dropped ZCs, descendants included
+   set<BinaryData> rootKeys;
+   for (auto& hash : txHashes)
+   {
+      BinaryData zcKey;
+      if (mempoolGraph_.getKeyForHash(hash, zcKey))
+         rootKeys.insert(move(zcKey));
+   }
 
-         for (auto& txioPair : *txiomap)
-         {
-            if (txioPair.first.startsWith(zcKey))
-            {
-               rkeys.insert(txioPair.first);
-               continue;
-            }
+   if (rootKeys.size() == 0)
+      return set<BinaryData>();
 
-            if (txioPair.second.hasTxIn() &&
-               txioPair.second.getDBKeyOfInput().startsWith(zcKey))
-               rkeys.insert(txioPair.first);
-         }
+   //ZCs spending the outputs of dropped ZCs are invalid as well
+   auto&& dropKeys = mempoolGraph_.getDescendants(rootKeys);
 
-         if (rkeys.size() > 0)
-         {
-            if (rkeys.size() == txiomap->size())
-            {
-               delKeys.push_back(sa);
-               continue;
-            }
+   vector<BinaryData> keysToDelete;
+   vector<BinaryData> hashesToDelete;
+   vector<BinaryData> txoutsToDelete;
 
-            auto newmap = make_shared<map<BinaryData, TxIOPair>>(
-               *txiomap);
+   auto txiomapPtr = txioMap_.get();
 
-            for (auto& rkey : rkeys)
-               newmap->erase(rkey);
+   map<BinaryData, shared_ptr<map<BinaryData, TxIOPair>>> updateMap;
+   vector<BinaryData> delKeys;
 
-            updateMap[sa] = newmap;
-         }
-      }
+   for (auto& zcKey : dropKeys)
+   {
+      auto& node = mempoolGraph_.getNode(zcKey);
+      hashesToDelete.push_back(node.txHash_);
+      keysToDelete.push_back(zcKey);
 
-      //drop from txOutsSpentByZC_
+      //drop the txios this ZC wrote
+      for (auto& saKeys : node.txioKeys_)
       {
-         auto txoutset = txOutsSpentByZC_.get();
-         vector<BinaryData> txoutsToDelete;
-         for (auto txoutkey : *txoutset)
+         //pick up the copy if a previous ZC in this batch touched this
+         //scrAddr already, otherwise its changes would be overwritten
+         shared_ptr<map<BinaryData, TxIOPair>> txiomap;
+         auto updateIter = updateMap.find(saKeys.first);
+         if (updateIter != updateMap.end())
          {
-            if (txoutkey.startsWith(zcKey))
-               txoutsToDelete.push_back(txoutkey);
+            txiomap = updateIter->second;
+         }
+         else
+         {
+            auto mapIter = txiomapPtr->find(saKeys.first);
+            if (mapIter == txiomapPtr->end())
+               continue;
+
+            txiomap = make_shared<map<BinaryData, TxIOPair>>(
+               *mapIter->second);
+            updateMap[saKeys.first] = txiomap;
          }
 
-         txOutsSpentByZC_.erase(txoutsToDelete);
+         for (auto& txioKey : saKeys.second)
+            txiomap->erase(txioKey);
       }
 
-      //mark for deletion
-      keysToDelete.push_back(zcKey);
+      //outputs of this ZC spent by other ZCs are covered by its descendants
+      txoutsToDelete.insert(txoutsToDelete.end(),
+         node.spentTxOutKeys_.begin(), node.spentTxOutKeys_.end());
+
+      keyToFundedScrAddr_.erase(zcKey);
+      mempoolGraph_.removeTx(zcKey);
    }
 
    //drop from containers
+   txOutsSpentByZC_.erase(txoutsToDelete);
+   keyToSpentScrAddr_.erase(keysToDelete);
    txMap_.erase(keysToDelete);
    txHashToDBKey_.erase(hashesToDelete);
 
+   auto updateIter = updateMap.begin();
+   while (updateIter != updateMap.end())
+   {
+      if (updateIter->second->size() == 0)
+      {
+         delKeys.push_back(updateIter->first);
+         updateMap.erase(updateIter++);
+      }
+      else
+         ++updateIter;
+   }
+
    txioMap_.erase(delKeys);
    txioMap_.update(updateMap);
 
@@ -1067,57 +1329,86 @@ void ZeroConfContainer::dropZC(const set<BinaryData>& txHashes)
    if (deleteKeyThread.joinable())
       deleteKeyThread.join();
 
-   if (childHashes.size() > 0)
-      dropZC(childHashes);
+   return set<BinaryData>(hashesToDelete.begin(), hashesToDelete.end());
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 void ZeroConfContainer::parseNewZC(void)
 {
+   ZcActionStruct nextAction;
+   bool hasNextAction = false;
+
    while (1)
    {
       ZcActionStruct zcAction;
       map<BinaryData, Tx> zcMap;
-      try
+      if (hasNextAction)
       {
-         zcAction = move(newZcStack_.pop_front());
+         zcAction = move(nextAction);
+         hasNextAction = false;
       }
-      catch (StopBlockingLoop&)
+      else
       {
-         break;
+         try
+         {
+            zcAction = move(newZcStack_.pop_front());
+         }
+         catch (StopBlockingLoop&)
+         {
+            break;
+         }
       }
 
       bool notify = true;
+      vector<shared_ptr<promise<bool>>> promises;
+      if (zcAction.finishedPromise_ != nullptr)
+         promises.push_back(zcAction.finishedPromise_);
 
       switch (zcAction.action_)
       {
       case Zc_Purge:
       {
-         {
-            auto txmap = txMap_.get();
-            zcAction.zcMap_ = *txmap;
-         }
-
-         auto&& keysToDelete = purge();
-         auto keyIter = zcAction.zcMap_.begin();
-         while (keyIter != zcAction.zcMap_.end())
-         {
-            if (keysToDelete.find(keyIter->first)
-               != keysToDelete.end())
-            {
-               zcAction.zcMap_.erase(keyIter++);
-            }
-            else
-               ++keyIter;
-         }
+         //only the ZCs affected by the new blocks are parsed again
+         zcMap = purge();
 
          flaggedBDVs_.clear();
          notify = false;
+         break;
       }
 
       case Zc_NewTx:
+      {
          zcMap = move(zcAction.zcMap_);
+
+         //drain the backlog of new ZCs into a single batch so that it can
+         //be classified in parallel
+         while (zcMap.size() < ZC_PARSER_BATCH_MAX)
+         {
+            try
+            {
+               nextAction = move(newZcStack_.try_pop_front());
+            }
+            catch (IsEmpty&)
+            {
+               break;
+            }
+
+            if (nextAction.action_ != Zc_NewTx)
+            {
+               hasNextAction = true;
+               break;
+            }
+
+            zcMap.insert(
+               make_move_iterator(nextAction.zcMap_.begin()),
+               make_move_iterator(nextAction.zcMap_.end()));
+
+            if (nextAction.finishedPromise_ != nullptr)
+               promises.push_back(nextAction.finishedPromise_);
+         }
+
          break;
+      }
 
       case Zc_Shutdown:
          purge();
@@ -1128,8 +1419,8 @@ void ZeroConfContainer::parseNewZC(void)
       }
 
       parseNewZC(move(zcMap), true, notify);
-      if(zcAction.finishedPromise_ != nullptr)
-         zcAction.finishedPromise_->set_value(true);
+      for (auto& finishedPromise : promises)
+         finishedPromise->set_value(true);
    }
 }
 
@@ -1147,17 +1438,47 @@ void ZeroConfContainer::parseNewZC(map<BinaryData, Tx> zcMap,
 
    vector<BinaryData> keysToWrite;
 
-   for (auto& newZCPair : zcMap)
+   struct ZcBatchEntry
+   {
+      map<BinaryData, Tx>::iterator zcIter_;
+      BinaryData txHash_;
+      bool isKnown_ = false;
+      shared_ptr<BulkFilterData> bulkData_;
+   };
+
+   vector<ZcBatchEntry> batch;
+   batch.reserve(zcMap.size());
+   set<BinaryData> batchHashes;
+
+   for (auto zcIter = zcMap.begin(); zcIter != zcMap.end(); ++zcIter)
    {
-      const BinaryData&& txHash = newZCPair.second.getThisHash();
-      auto insertIter = allZcTxHashes_.insert(txHash);
+      ZcBatchEntry entry;
+      entry.zcIter_ = zcIter;
+      entry.txHash_ = zcIter->second.getThisHash();
+
+      auto insertIter = allZcTxHashes_.insert(entry.txHash_);
       if (insertIter.second)
-         keysToWrite.push_back(newZCPair.first);
+         keysToWrite.push_back(zcIter->first);
+
+      batchHashes.insert(entry.txHash_);
+      batch.push_back(move(entry));
    }
 
    map<BinaryData, BinaryData> txhashmap_update;
    map<BinaryData, Tx> txmap_update;
 
+   //txios merged by this batch, published to txioMap_ in one go rather
+   //than copying each scrAddr's map once per ZC
+   map<BinaryData, shared_ptr<map<BinaryData, TxIOPair>>> batchTxioMap;
+   auto commitTxios = [this, &batchTxioMap](void)->void
+   {
+      if (batchTxioMap.size() == 0)
+         return;
+
+      txioMap_.update(move(batchTxioMap));
+      batchTxioMap.clear();
+   };
+
    bool hasChanges = false;
 
    {
@@ -1198,14 +1519,21 @@ void ZeroConfContainer::parseNewZC(map<BinaryData, Tx> zcMap,
          return global_iter->second;
       };
 
-      for (auto& newZCPair : zcMap)
+      //address filter snapshots, shared by all classification threads
+      auto addrMap = scrAddrMap_->get();
+      auto bdvcallbacks = bdvCallbacks_.get();
+
+      auto classifyZc = [&](ZcBatchEntry& entry)->void
       {
-         const BinaryData&& txHash = newZCPair.second.getThisHash();
-         if (txhashmap_ptr->find(txHash) != txhashmap_ptr->end())
-            continue; //already have this ZC
+         if (txhashmap_ptr->find(entry.txHash_) != txhashmap_ptr->end())
+         {
+            //already have this ZC
+            entry.isKnown_ = true;
+            return;
+         }
 
          //flag RBF on whole tx
-         auto& zctx = newZCPair.second;
+         auto& zctx = entry.zcIter_->second;
          zctx.setChainedZC(false);
          auto datacopy = zctx.getPtr();
          unsigned txinCount = zctx.getNumTxIn();
@@ -1246,69 +1574,144 @@ void ZeroConfContainer::parseNewZC(map<BinaryData, Tx> zcMap,
             }
          }
 
+         //ZCs spending the output of another ZC in this batch need their
+         //parents merged first, leave them to the sequential pass
+         for (unsigned i = 0; i < txinCount; i++)
+         {
+            BinaryData consumedHash(datacopy + zctx.getTxInOffset(i), 32);
+            if (batchHashes.find(consumedHash) != batchHashes.end())
+               return;
+         }
+
+         entry.bulkData_ = make_shared<BulkFilterData>(
+            ZCisMineBulkFilter(zctx, entry.zcIter_->first,
+            zctx.getTxTime(), getzckeyfortxhash, getzctxforkey,
+            *addrMap, *bdvcallbacks));
+      };
+
+      /***
+      Classify the batch in parallel. Workers only read the snapshots and
+      their own batch entry, the local update maps are left untouched until
+      the sequential pass below merges the results in key order.
+      ***/
+      unsigned threadCount = 1;
+      if (batch.size() >= ZC_PARALLEL_BATCH_MIN)
+      {
+         threadCount = max(thread::hardware_concurrency(), 1U);
+         threadCount = min(threadCount, maxZcThreadCount_);
+      }
+
+      atomic<unsigned> entryCounter;
+      entryCounter.store(0, memory_order_relaxed);
+      exception_ptr classifyError = nullptr;
+      mutex errorMutex;
+
+      auto classifyThread = [&](void)->void
+      {
+         try
+         {
+            while (1)
+            {
+               auto id = entryCounter.fetch_add(1, memory_order_relaxed);
+               if (id >= batch.size())
+                  return;
+
+               classifyZc(batch[id]);
+            }
+         }
+         catch (...)
+         {
+            unique_lock<mutex> errorLock(errorMutex);
+            classifyError = current_exception();
+            entryCounter.store(batch.size(), memory_order_relaxed);
+         }
+      };
+
+      vector<thread> classifyThreads;
+      for (unsigned i = 1; i < threadCount; i++)
+         classifyThreads.push_back(thread(classifyThread));
+      classifyThread();
+
+      for (auto& thr : classifyThreads)
+      {
+         if (thr.joinable())
+            thr.join();
+      }
+
+      if (classifyError != nullptr)
+         rethrow_exception(classifyError);
+
+      for (auto& entry : batch)
+      {
+         if (entry.isKnown_)
+            continue;
+
+         auto& newZCPair = *entry.zcIter_;
+         auto& txHash = entry.txHash_;
+         if (txhashmap_update.find(txHash) != txhashmap_update.end())
+            continue; //duplicate within this batch
+
          {
             //TODO: cover replacement case where ZC gets doubled spent to an address we 
             //don't control (and thus don't scan ZCs for)
 
-            auto&& bulkData =
-               ZCisMineBulkFilter(newZCPair.second,
-               newZCPair.first,
-               newZCPair.second.getTxTime(), 
-               getzckeyfortxhash,
-               getzctxforkey);
+            if (entry.bulkData_ == nullptr)
+            {
+               entry.bulkData_ = make_shared<BulkFilterData>(
+                  ZCisMineBulkFilter(newZCPair.second,
+                  newZCPair.first,
+                  newZCPair.second.getTxTime(), 
+                  getzckeyfortxhash,
+                  getzctxforkey,
+                  *addrMap, *bdvcallbacks));
+            }
+
+            auto& bulkData = *entry.bulkData_;
 
             //check for replacement
             {
-               //loop through all outpoints consumed by this ZC
+               //ZCs spending any of the outpoints this ZC consumes are
+               //replaced by it
                set<BinaryData> replacedHashes;
                for (auto& idSet : bulkData.outPointsSpentByKey_)
                {
-                  //compare them to the list of currently spent outpoints
-                  auto hashIter = outPointsSpentByKey_.find(idSet.first);
-                  if (hashIter == outPointsSpentByKey_.end())
-                     continue;
+                  auto& spenders = 
+                     mempoolGraph_.getSpenders(idSet.first);
 
-                  for (auto opId : idSet.second)
+                  for (auto& opId : idSet.second)
                   {
-                     auto idIter = hashIter->second.find(opId.first);
-                     if (idIter != hashIter->second.end())
-                     {
-                        //if 2 outpoints match, this ZC is replacing another
-                        //flag the replaced key and clean up the entry
-
-                        try
-                        {
-                           //check local container first
-                           auto& txToReplace = getzctxforkey(idIter->second);
-                           auto&& txhashtoreplace = txToReplace.getThisHash();
-
-                           auto txhashmapiter = txhashmap_update.find(txhashtoreplace);
-                           if (txhashmapiter != txhashmap_update.end())
-                           {
-                              //was in local container, delete it and move on
-                              txhashmap_update.erase(txhashmapiter);
-                              txmap_update.erase(idIter->second);
-                           }
-                           else
-                           {
-                              //is in global container, save hash to deletion
-                              replacedHashes.insert(txhashtoreplace);
-                           }
-                        }
-                        catch (runtime_error&)
-                        {
-                           continue;
-                        }
-
-                        hashIter->second.erase(idIter);
-                     }
+                     auto idIter = spenders.find(opId.first);
+                     if (idIter == spenders.end())
+                        continue;
+
+                     replacedHashes.insert(
+                        mempoolGraph_.getNode(idIter->second).txHash_);
                   }
                }
 
-               //drop the replacedKeys if any
+               //drop the replaced ZCs and their descendants if any
                if (replacedHashes.size() > 0)
                {
-                  dropZC(replacedHashes);
+                  //dropZC works on the published txio maps
+                  commitTxios();
+                  auto&& droppedHashes = dropZC(replacedHashes);
+
+                  //some may be from this batch and not published yet
+                  for (auto& hash : droppedHashes)
+                  {
+                     auto txhashmapiter = txhashmap_update.find(hash);
+                     if (txhashmapiter == txhashmap_update.end())
+                        continue;
+
+                     auto& droppedKey = txhashmapiter->second;
+                     txmap_update.erase(droppedKey);
+                     keysToWrite.erase(
+                        remove(keysToWrite.begin(), keysToWrite.end(), 
+                        droppedKey), keysToWrite.end());
+                     newZcByHash.erase(hash);
+                     txhashmap_update.erase(txhashmapiter);
+                  }
+
                   hasChanges = true;
                }
             }
@@ -1321,41 +1724,50 @@ void ZeroConfContainer::parseNewZC(map<BinaryData, Tx> zcMap,
                //merge spent outpoints
                txOutsSpentByZC_.insert(bulkData.txOutsSpentByZC_);
 
-               for (auto& idmap : bulkData.outPointsSpentByKey_)
-               {
-                  //cant use insert, have to replace values if they already exist
-                  auto& thisIdMap = outPointsSpentByKey_[idmap.first];
-                  for (auto& idpair : idmap.second)
-                     thisIdMap[idpair.first] = idpair.second;
-               }
+               mempoolGraph_.addTx(newZCPair.first, txHash,
+                  bulkData.outPointsSpentByKey_, bulkData.scrAddrTxioMap_,
+                  bulkData.txOutsSpentByZC_);
 
                //merge scrAddr spent by key
                keyToSpentScrAddr_.update(move(bulkData.keyToSpentScrAddr_));
 
                //merge scrAddr funded by key
-               typedef map<BinaryData, set<BinaryData>>::iterator mapbd_setbd_iter;
-               keyToFundedScrAddr_.insert(
-                  move_iterator<mapbd_setbd_iter>(bulkData.keyToFundedScrAddr_.begin()),
-                  move_iterator<mapbd_setbd_iter>(bulkData.keyToFundedScrAddr_.end())
-                  );
+               for (auto& funded_pair : bulkData.keyToFundedScrAddr_)
+               {
+                  keyToFundedScrAddr_.emplace(
+                     funded_pair.first, move(funded_pair.second));
+               }
 
                //merge new txios
                txhashmap_update[txHash] = newZCPair.first;
                txmap_update[newZCPair.first] = newZCPair.second;
 
-               map<HashString, shared_ptr<map<BinaryData, TxIOPair>>> newtxiomap;
                auto txiomapPtr = txioMap_.get();
 
                for (const auto& saTxio : bulkData.scrAddrTxioMap_)
                {
-                  auto saIter = txiomapPtr->find(saTxio.first);
-                  if (saIter != txiomapPtr->end())
-                     saTxio.second->insert(saIter->second->begin(), saIter->second->end());
+                  auto& batchMap = batchTxioMap[saTxio.first];
+                  if (batchMap == nullptr)
+                  {
+                     //first hit on this scrAddr in the batch, copy the 
+                     //published map once
+                     auto saIter = txiomapPtr->find(saTxio.first);
+                     if (saIter != txiomapPtr->end())
+                     {
+                        batchMap = make_shared<map<BinaryData, TxIOPair>>(
+                           *saIter->second);
+                     }
+                     else
+                     {
+                        batchMap = make_shared<map<BinaryData, TxIOPair>>();
+                     }
+                  }
 
-                  newtxiomap.insert(move(make_pair(saTxio.first, saTxio.second)));
+                  //new txios replace existing ones
+                  for (auto& txioPair : *saTxio.second)
+                     (*batchMap)[txioPair.first] = txioPair.second;
                }
 
-               txioMap_.update(move(newtxiomap));
                newZcByHash.insert(txHash);
 
                //notify BDVs
@@ -1370,6 +1782,7 @@ void ZeroConfContainer::parseNewZC(map<BinaryData, Tx> zcMap,
       }
    }
 
+   commitTxios();
    txHashToDBKey_.update(txhashmap_update);
    txMap_.update(txmap_update);
 
@@ -1427,24 +1840,25 @@ ZeroConfContainer::BulkFilterData
 ZeroConfContainer::ZCisMineBulkFilter(const Tx & tx,
    const BinaryData & ZCkey, uint32_t txtime,
    function<bool(const BinaryData&, BinaryData&)> getzckeyfortxhash,
-   function<const Tx&(const BinaryData&)> getzctxforkey)
+   function<const Tx&(const BinaryData&)> getzctxforkey,
+   const PersistentMap<ScrAddrFilter::AddrAndHash, int>& mainAddressSet,
+   const PersistentMap<string, BDV_Callbacks>& bdvcallbacks)
 {
-   auto mainAddressSet = scrAddrMap_->get();
-
-   auto bdvcallbacks = bdvCallbacks_.get();
+   //can run concurrently for different txs, it only reads the snapshots
+   //and the lookup lambdas it is passed
    auto filter = [&mainAddressSet, &bdvcallbacks]
       (const BinaryData& addr)->pair<bool, set<string>>
    {
       pair<bool, set<string>> flaggedBDVs;
       flaggedBDVs.first = false;
 
-      auto addrIter = mainAddressSet->find(addr);
-      if (addrIter == mainAddressSet->end())
+      auto addrIter = mainAddressSet.find(addr);
+      if (addrIter == mainAddressSet.end())
          return flaggedBDVs;
 
       flaggedBDVs.first = true;
 
-      for (auto& callbacks : *bdvcallbacks)
+      for (auto& callbacks : bdvcallbacks)
       {
          if (callbacks.second.addressFilter_(addr))
             flaggedBDVs.second.insert(callbacks.first);
@@ -1734,7 +2148,7 @@ const set<BinaryData>& ZeroConfContainer::getSpentSAforZCKey(
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-const shared_ptr<map<BinaryData, set<BinaryData>>> 
+shared_ptr<const PersistentMap<BinaryData, set<BinaryData>>> 
    ZeroConfContainer::getKeyToSpentScrAddrMap() const
 {
    return keyToSpentScrAddr_.get();
@@ -1760,7 +2174,8 @@ void ZeroConfContainer::updateZCinDB(const vector<BinaryData>& keysToWrite,
       if (iter != txmap->end())
       {
          StoredTx zcTx;
-         zcTx.createFromTx((*txmap)[key], true, true);
+         auto theTx = iter->second;
+         zcTx.createFromTx(theTx, true, true);
          db_->putStoredZC(zcTx, key);
       }
       else
@@ -20,6 +20,7 @@
 #include <memory>
 
 #include "ThreadSafeClasses.h"
+#include "FlatHashMap.h"
 #include "BitcoinP2p.h"
 #include "BinaryData.h"
 #include "ScrAddrObj.h"
@@ -27,6 +28,8 @@
 
 #define GETZC_THREADCOUNT 5
 #define TXGETDATA_TIMEOUT_MS 10000
+#define ZC_PARALLEL_BATCH_MIN 16
+#define ZC_PARSER_BATCH_MAX 5000
 
 enum ZcAction
 {
@@ -250,7 +253,7 @@ public:
    
    LMDBBlockDatabase* lmdb() { return lmdb_; }
 
-   shared_ptr<map<AddrAndHash, int>> getScrAddrMap(void) const
+   shared_ptr<const PersistentMap<AddrAndHash, int>> getScrAddrMap(void) const
    { 
       if (!run_.load(memory_order_relaxed))
       {
@@ -360,6 +363,68 @@ private:
       const vector<shared_ptr<WalletInfo>>& wltInfoSet, bool areNew);
 };
 
+////////////////////////////////////////////////////////////////////////////////
+class MempoolGraph
+{
+   /***
+   Spending relationships between the ZCs of a ZeroConfContainer, keyed by 
+   zc key: which ZC spends a given outpoint, which ZCs spend the outputs of 
+   a given ZC, and what each ZC wrote to the container's txio and spent 
+   txout sets, so that dropping a ZC does not involve scanning them.
+
+   Edges are added in both directions as ZCs come in, a child parsed before 
+   its parent is linked once the parent shows up.
+
+   Not thread safe, it is only touched by the ZC parser thread.
+   ***/
+
+public:
+   struct Node
+   {
+      BinaryData txHash_;
+      set<BinaryData> parents_;
+      set<BinaryData> children_;
+
+      //<txHash, txOutIds> of the outpoints this ZC consumes
+      map<BinaryData, set<unsigned>> spentOutPoints_;
+
+      //<scrAddr, txio keys> this ZC wrote to the txio map
+      map<BinaryData, set<BinaryData>> txioKeys_;
+
+      //txout keys this ZC flagged as spent
+      set<BinaryData> spentTxOutKeys_;
+   };
+
+private:
+   FlatHashMap<6, Node> nodes_;
+   FlatHashMap<32, BinaryData> hashToKey_;
+
+   //<txHash, <txOutId, zcKey>>
+   FlatHashMap<32, map<unsigned, BinaryData>> spenders_;
+
+   static const map<unsigned, BinaryData> emptySpenderMap_;
+
+public:
+   void addTx(const BinaryData& zcKey, const BinaryData& txHash,
+      const FlatHashMap<32, map<unsigned, BinaryData>>& spentOutPoints,
+      const map<BinaryData, shared_ptr<map<BinaryData, TxIOPair>>>& txios,
+      const set<BinaryData>& spentTxOutKeys);
+   void removeTx(const BinaryData& zcKey);
+   void clear(void);
+
+   size_t size(void) const { return nodes_.size(); }
+   bool hasTx(const BinaryData& zcKey) const;
+   const Node& getNode(const BinaryData& zcKey) const;
+   bool getKeyForHash(const BinaryData& txHash, BinaryData& zcKey) const;
+
+   //<txOutId, zcKey> of the ZCs spending outputs of txHash
+   const map<unsigned, BinaryData>& getSpenders(
+      const BinaryDataRef& txHash) const;
+
+   //zcKeys and all ZCs descending from them
+   set<BinaryData> getDescendants(const set<BinaryData>& zcKeys) const;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 class ZeroConfContainer
 {
@@ -367,10 +432,10 @@ private:
    struct BulkFilterData
    {
       map<BinaryData, shared_ptr<map<BinaryData, TxIOPair>>> scrAddrTxioMap_;
-      map<BinaryData, map<unsigned, BinaryData>> outPointsSpentByKey_;
+      FlatHashMap<32, map<unsigned, BinaryData>> outPointsSpentByKey_;
       set<BinaryData> txOutsSpentByZC_;
       map<BinaryData, set<BinaryData>> keyToSpentScrAddr_;
-      map<BinaryData, set<BinaryData>> keyToFundedScrAddr_;
+      FlatHashMap<6, set<BinaryData>> keyToFundedScrAddr_;
 
       map<string, set<BinaryData>> flaggedBDVs_;
 
@@ -405,14 +470,14 @@ private:
    TransactionalMap<HashString, Tx>             txMap_;              //<zcKey, zcTx>
    TransactionalSet<HashString>                 txOutsSpentByZC_;    //<txOutDbKeys>
    set<HashString>                              allZcTxHashes_;
-   map<BinaryData, map<unsigned, BinaryData>>   outPointsSpentByKey_; //<txHash, map<opId, ZcKeys>>
+   MempoolGraph                                 mempoolGraph_;
 
    //<scrAddr,  <dbKeyOfOutput, TxIOPair>>
    TransactionalMap<BinaryData, shared_ptr<map<BinaryData, TxIOPair>>>  txioMap_;
    
    //<zcKey, vector<ScrAddr>>
    TransactionalMap<HashString, set<HashString>> keyToSpentScrAddr_;
-   map<BinaryData, set<BinaryData>> keyToFundedScrAddr_;
+   FlatHashMap<6, set<BinaryData>> keyToFundedScrAddr_;
 
    //
    map<string, pair<bool, set<BinaryData>>> flaggedBDVs_;
@@ -444,10 +509,12 @@ private:
       const BinaryData& ZCkey,
       uint32_t txtime,
       function<bool(const BinaryData&, BinaryData&)> getzckeyfortxhash,
-      function<const Tx&(const BinaryData&)> getzctxbykey);
+      function<const Tx&(const BinaryData&)> getzctxbykey,
+      const PersistentMap<ScrAddrFilter::AddrAndHash, int>& addrMap,
+      const PersistentMap<string, BDV_Callbacks>& bdvCallbacks);
 
    void loadZeroConfMempool(bool clearMempool);
-   set<BinaryData> purge(void);
+   map<BinaryData, Tx> purge(void);
 
    void processInvTxThread(void);
    bool processInvTxThread(InvEntry, unsigned timeout_ms);
@@ -476,10 +543,10 @@ public:
    bool hasTxByHash(const BinaryData& txHash) const;
    Tx getTxByHash(const BinaryData& txHash) const;
 
-   shared_ptr<map<BinaryData, shared_ptr<map<BinaryData, TxIOPair>>>>
+   shared_ptr<const PersistentMap<BinaryData, shared_ptr<map<BinaryData, TxIOPair>>>>
       getFullTxioMap(void) const { return txioMap_.get(); }
 
-   void dropZC(const set<BinaryData>& txHashes);
+   set<BinaryData> dropZC(const set<BinaryData>& txHashes);
    void parseNewZC(void);
    void parseNewZC(map<BinaryData, Tx> zcMap, bool updateDB, bool notify);
    bool isTxOutSpentByZC(const BinaryData& dbKey) const;
@@ -492,7 +559,8 @@ public:
    vector<TxOut> getZcTxOutsForKey(const set<BinaryData>&) const;
 
    const set<BinaryData>& getSpentSAforZCKey(const BinaryData& zcKey) const;
-   const shared_ptr<map<BinaryData, set<HashString>>> getKeyToSpentScrAddrMap(void) const;
+   shared_ptr<const PersistentMap<BinaryData, set<HashString>>> 
+      getKeyToSpentScrAddrMap(void) const;
 
    void updateZCinDB(
       const vector<BinaryData>& keysToWrite, const vector<BinaryData>& keysToDel);
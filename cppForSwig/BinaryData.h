@@ -99,6 +99,237 @@ using namespace std;
 
 class BinaryDataRef;
 
+#define BINARYDATA_INLINE_SIZE 40
+
+////////////////////////////////////////////////////////////////////////////////
+class SmallByteVector
+{
+   /***
+   Byte buffer backing BinaryData. Mimics the subset of vector<uint8_t> 
+   BinaryData uses, but keeps up to BINARYDATA_INLINE_SIZE bytes inline so 
+   that hints, db keys, hash160s, hashes and compressed pubkeys (33 bytes) 
+   don't go through the allocator. Larger buffers live on the heap, and stay
+   there until the object dies, as with vector.
+
+   Like vector, resize() zeroes the new bytes and clear() keeps the 
+   capacity.
+
+   Unlike vector, moving an inline buffer copies the bytes to the new 
+   object: pointers and refs taken on the source do not follow the move.
+   Buffers that need a stable address (SecureBinaryData) go through 
+   moveToHeap(), which also wipes the inline bytes it leaves behind.
+   ***/
+
+private:
+   union
+   {
+      uint8_t inline_[BINARYDATA_INLINE_SIZE];
+      uint8_t* heap_;
+   };
+
+   size_t size_ = 0;
+   size_t capacity_ = BINARYDATA_INLINE_SIZE;
+
+private:
+   bool isInline(void) const 
+   { return capacity_ == BINARYDATA_INLINE_SIZE; }
+
+   void grow(size_t minCapacity, bool wipe = false)
+   {
+      auto newCapacity = max(capacity_ * 2, minCapacity);
+      auto newPtr = new uint8_t[newCapacity];
+      if (size_ > 0)
+         memcpy(newPtr, ptr(), size_);
+
+      //heap_ aliases the inline bytes, secure buffers wipe them first
+      if (isInline())
+      {
+         if (wipe)
+            memset(inline_, 0, BINARYDATA_INLINE_SIZE);
+      }
+      else
+      {
+         delete[] heap_;
+      }
+
+      heap_ = newPtr;
+      capacity_ = newCapacity;
+   }
+
+   void release(void)
+   {
+      if (!isInline())
+         delete[] heap_;
+
+      size_ = 0;
+      capacity_ = BINARYDATA_INLINE_SIZE;
+   }
+
+   void moveFrom(SmallByteVector& rhs)
+   {
+      if (rhs.isInline())
+         memcpy(inline_, rhs.inline_, rhs.size_);
+      else
+         heap_ = rhs.heap_;
+
+      size_ = rhs.size_;
+      capacity_ = rhs.capacity_;
+
+      rhs.size_ = 0;
+      rhs.capacity_ = BINARYDATA_INLINE_SIZE;
+   }
+
+   uint8_t* ptr(void) { return isInline() ? inline_ : heap_; }
+   const uint8_t* ptr(void) const { return isInline() ? inline_ : heap_; }
+
+public:
+   SmallByteVector(void)
+   {}
+
+   SmallByteVector(const SmallByteVector& rhs)
+   {
+      assign(rhs.ptr(), rhs.size_);
+   }
+
+   SmallByteVector(SmallByteVector&& rhs)
+   {
+      moveFrom(rhs);
+   }
+
+   ~SmallByteVector(void)
+   {
+      release();
+   }
+
+   SmallByteVector& operator=(const SmallByteVector& rhs)
+   {
+      if (this != &rhs)
+         assign(rhs.ptr(), rhs.size_);
+      return *this;
+   }
+
+   SmallByteVector& operator=(SmallByteVector&& rhs)
+   {
+      if (this != &rhs)
+      {
+         release();
+         moveFrom(rhs);
+      }
+
+      return *this;
+   }
+
+   size_t size(void) const { return size_; }
+   size_t capacity(void) const { return capacity_; }
+   bool empty(void) const { return size_ == 0; }
+
+   uint8_t* data(void) { return ptr(); }
+   const uint8_t* data(void) const { return ptr(); }
+
+   uint8_t* begin(void) { return ptr(); }
+   uint8_t* end(void) { return ptr() + size_; }
+   const uint8_t* begin(void) const { return ptr(); }
+   const uint8_t* end(void) const { return ptr() + size_; }
+
+   uint8_t& operator[](size_t i) { return ptr()[i]; }
+   const uint8_t& operator[](size_t i) const { return ptr()[i]; }
+
+   void clear(void) { size_ = 0; }
+
+   void reserve(size_t sz)
+   {
+      if (sz > capacity_)
+         grow(sz);
+   }
+
+   void moveToHeap(void)
+   {
+      if (isInline())
+         grow(BINARYDATA_INLINE_SIZE + 1, true);
+   }
+
+   void resize(size_t sz)
+   {
+      reserve(sz);
+      if (sz > size_)
+         memset(ptr() + size_, 0, sz - size_);
+      size_ = sz;
+   }
+
+   void assign(const uint8_t* src, size_t sz)
+   {
+      size_ = 0;
+      reserve(sz);
+      if (sz > 0)
+         memcpy(ptr(), src, sz);
+      size_ = sz;
+   }
+
+   //appends only, pos has to be end()
+   uint8_t* insert(uint8_t* pos, const uint8_t* first, const uint8_t* last)
+   {
+      if (pos != end())
+         throw runtime_error("SmallByteVector only inserts at the end");
+
+      size_t count = last - first;
+      if (size_ + count > capacity_)
+      {
+         //the source may be this buffer
+         auto srcOffset = first - ptr();
+         bool fromSelf = first >= ptr() && first < ptr() + size_;
+
+         grow(size_ + count);
+         if (fromSelf)
+            first = ptr() + srcOffset;
+      }
+
+      if (count > 0)
+         memmove(ptr() + size_, first, count);
+
+      auto insertPos = ptr() + size_;
+      size_ += count;
+      return insertPos;
+   }
+
+   uint8_t* insert(uint8_t* pos, uint8_t* first, uint8_t* last)
+   {
+      return insert(pos, (const uint8_t*)first, (const uint8_t*)last);
+   }
+
+   template<typename InputIt> 
+   uint8_t* insert(uint8_t* pos, InputIt first, InputIt last)
+   {
+      //iterators over another container (string), copy to a flat buffer
+      vector<uint8_t> copy(first, last);
+      if (copy.size() == 0)
+         return end();
+
+      return insert(pos, &copy[0], &copy[0] + copy.size());
+   }
+
+   uint8_t* insert(uint8_t* pos, uint8_t byte)
+   {
+      return insert(pos, &byte, &byte + 1);
+   }
+
+   void push_back(uint8_t byte)
+   {
+      insert(end(), byte);
+   }
+
+   void swap(SmallByteVector& rhs)
+   {
+      SmallByteVector tmp(move(rhs));
+      rhs = move(*this);
+      *this = move(tmp);
+   }
+};
+
+inline void swap(SmallByteVector& lhs, SmallByteVector& rhs)
+{
+   lhs.swap(rhs);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 class BinaryData
@@ -107,7 +338,7 @@ public:
 
 
    /////////////////////////////////////////////////////////////////////////////
-   BinaryData(void) : data_(0)                 {                         }
+   BinaryData(void)                            {                         }
    explicit BinaryData(size_t sz)              { alloc(sz);              }
    BinaryData(uint8_t const * inData, size_t sz)      
                                                { copyFrom(inData, sz);   }
@@ -384,6 +615,7 @@ public:
 
    void resize(size_t sz) { data_.resize(sz); }
    void reserve(size_t sz) { data_.reserve(sz); }
+   void keepOnHeap(void) { data_.moveToHeap(); }
 
    /////////////////////////////////////////////////////////////////////////////
    // Swap endianness of the bytes in the index range [pos1, pos2)
@@ -582,7 +814,7 @@ public:
    static BinaryData EmptyBinData_;
 
 private:
-   vector<uint8_t> data_;
+   SmallByteVector data_;
 
 private:
    void alloc(size_t sz) 
@@ -200,6 +200,20 @@ void BlockDataManagerConfig::parseArgs(int argc, char* argv[])
    --zcthread-count: defines the maximum number on threads the zc parser can
    create for processing incoming transcations from the network node
 
+   --fcgi-threads: how many threads serve client requests. Defaults to 16.
+
+   --longpoll-threads: how many client callback requests (long polls) can be
+   waited on at once. Further callback requests are queued. Defaults to 256.
+
+   --blkfile-reader: how block files are read during scans:
+   mmap: map whole blkXXXXX.dat files in memory. Default.
+   stream: read the block ranges each scan batch needs into private buffers,
+   dropping the pages from the system cache behind the reads. Keeps scans 
+   within --stream-budget on low RAM machines.
+
+   --stream-budget: max MB of block data held in memory at once by the stream
+   reader. Defaults to 256. Can't be lower than 1.
+
    --db-type: sets the db type:
    DB_BARE: tracks wallet history only. Smallest DB.
    DB_FULL: tracks wallet history and resolves all relevant tx hashes.
@@ -218,6 +232,16 @@ void BlockDataManagerConfig::parseArgs(int argc, char* argv[])
 
    --clear-mempool: delete all zero confirmation transactions from the DB.
 
+   --no-txhash-index: do not maintain the full txid index (fullnode DBs). 
+   Tx lookups by hash then go through the 4 byte hash hints only. Entries
+   already written stay in the DB, they are used again once the index is 
+   turned back on.
+
+   --compact-db-values: write STXO and SUBSSH entries in the compact value
+   encoding (varints, delta coded keys, standard scripts reduced to their 
+   hash). Only applies to DBs created with the flag set, existing DBs keep 
+   the encoding they were built with.
+
    --satoshirpc-port: set node rpc port
 
    ***/
@@ -459,6 +483,14 @@ void BlockDataManagerConfig::processArgs(const map<string, string>& args,
    if (iter != args.end())
       clearMempool_ = true;
 
+   iter = args.find("no-txhash-index");
+   if (iter != args.end())
+      txHashIndex_ = false;
+
+   iter = args.find("compact-db-values");
+   if (iter != args.end())
+      compactDbValues_ = true;
+
    //db type
    iter = args.find("db-type");
    if (iter != args.end())
@@ -538,6 +570,65 @@ void BlockDataManagerConfig::processArgs(const map<string, string>& args,
          zcThreadCount_ = val;
    }
 
+   iter = args.find("fcgi-threads");
+   if (iter != args.end())
+   {
+      int val = 0;
+      try
+      {
+         val = stoi(iter->second);
+      }
+      catch (...)
+      {
+      }
+
+      if (val > 0)
+         fcgiThreadCount_ = val;
+   }
+
+   iter = args.find("longpoll-threads");
+   if (iter != args.end())
+   {
+      int val = 0;
+      try
+      {
+         val = stoi(iter->second);
+      }
+      catch (...)
+      {
+      }
+
+      if (val > 0)
+         longPollThreadCount_ = val;
+   }
+
+   iter = args.find("blkfile-reader");
+   if (iter != args.end())
+   {
+      if (iter->second == "stream")
+         blkFileReadMode_ = BlockFileRead_Stream;
+      else if (iter->second == "mmap")
+         blkFileReadMode_ = BlockFileRead_Mmap;
+      else
+         throw DbErrorMsg("invalid blkfile-reader");
+   }
+
+   iter = args.find("stream-budget");
+   if (iter != args.end())
+   {
+      int val = 0;
+      try
+      {
+         val = stoi(iter->second);
+      }
+      catch (...)
+      {
+      }
+
+      if (val > 0)
+         streamBudget_ = val * 1024 * 1024ULL;
+   }
+
    //cookie
    iter = args.find("cookie");
    if (iter != args.end())
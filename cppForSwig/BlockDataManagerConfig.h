@@ -28,6 +28,10 @@
 #endif
 
 #define DEFAULT_ZCTHREAD_COUNT 100
+#define DEFAULT_FCGI_THREAD_COUNT 16
+#define DEFAULT_LONGPOLL_THREAD_COUNT 256
+#define DEFAULT_STREAM_BUDGET_MB 256
+#define DEFAULT_RAM_LEVEL_MB 128
 
 ////////////////////////////////////////////////////////////////////////////////
 struct BlockDataManagerConfig
@@ -65,15 +69,26 @@ struct BlockDataManagerConfig
 
 
    unsigned ramUsage_ = 4;
+   //parsed scan data allowed per ram usage level
+   size_t ramLevelSize_ = DEFAULT_RAM_LEVEL_MB * 1024 * 1024ULL;
    unsigned threadCount_ = thread::hardware_concurrency();
    unsigned zcThreadCount_ = DEFAULT_ZCTHREAD_COUNT;
 
+   //FCGI request workers, long polls (registerCallback) have their own
+   unsigned fcgiThreadCount_ = DEFAULT_FCGI_THREAD_COUNT;
+   unsigned longPollThreadCount_ = DEFAULT_LONGPOLL_THREAD_COUNT;
+
+   BlockFileReadMode blkFileReadMode_ = BlockFileRead_Mmap;
+   size_t streamBudget_ = DEFAULT_STREAM_BUDGET_MB * 1024 * 1024ULL;
+
    exception_ptr exceptionPtr_ = nullptr;
 
    bool reportProgress_ = true;
 
    bool checkChain_ = false;
    bool clearMempool_ = false;
+   bool txHashIndex_ = true;
+   bool compactDbValues_ = false;
 
    const string cookie_;
    bool useCookie_ = false;
@@ -41,15 +41,40 @@ void BlockData::deserialize(const uint8_t* data, size_t size,
          "tx count mismatch in deser header");
    }
 
+   //all txs and their offsets go in a single arena, numTx comes from the 
+   //raw block so don't trust it blindly when reserving
+   auto arena = make_shared<BCTXArena>();
+   auto reserveCount = min<size_t>(numTx, brr.getSizeRemaining() / 60 + 1);
+   arena->txns_.reserve(reserveCount);
+   arena->offsets_.reserve(reserveCount * 5);
+
+   //scratch offset vectors, reused across txs
+   vector<size_t> offsetIns, offsetOuts, offsetsWitness;
+
    for (unsigned i = 0; i < numTx; i++)
    {
       //light tx deserialization, just figure out the offset and size of
       //txins and txouts
-      auto tx = BCTX::parse(brr);
-      brr.advance(tx->size_);
+      auto txPtr = brr.getCurrPtr();
+      auto txlen = BtcUtils::TxCalcLength(
+         txPtr, brr.getSizeRemaining(),
+         &offsetIns, &offsetOuts, &offsetsWitness);
+
+      arena->txns_.emplace_back(txPtr, txlen);
+      arena->txns_.back().setOffsets(
+         offsetIns, offsetOuts, offsetsWitness, 
+         UINT32_MAX, arena->offsets_);
 
-      //move it to BlockData object vector
-      txns_.push_back(move(tx));
+      brr.advance(txlen);
+   }
+
+   //the arena won't move anymore, bind the offset arrays and hand out
+   //pointers sharing ownership of the arena
+   txns_.reserve(numTx);
+   for (auto& tx : arena->txns_)
+   {
+      tx.bindOffsets(arena->offsets_.data());
+      txns_.push_back(shared_ptr<BCTX>(arena, &tx));
    }
 
    data_ = data;
@@ -58,23 +83,22 @@ void BlockData::deserialize(const uint8_t* data, size_t size,
    if (!checkMerkle)
       return;
 
-   //let's check the merkle root
-   vector<BinaryData> allhashes;
+   //let's check the merkle root, txids are laid out flat so the tree
+   //can be hashed in batches
+   BinaryData allhashes(txns_.size() * 32);
+   auto hashPtr = allhashes.getPtr();
    for (auto& txn : txns_)
    {
       if (!keepHashes)
-      {
-         auto txhash = txn->moveHash();
-         allhashes.push_back(move(txhash));
-      }
+         txn->computeHash(hashPtr);
       else
-      {
-         txn->getHash();
-         allhashes.push_back(txn->txHash_);
-      }
+         txn->getHash().copyTo(hashPtr, 32);
+
+      hashPtr += 32;
    }
 
-   auto&& merkleroot = BtcUtils::calculateMerkleRoot(allhashes);
+   auto&& merkleroot = BtcUtils::calculateMerkleRoot(
+      allhashes.getPtr(), txns_.size());
    if (merkleroot != bh.getMerkleRoot())
    {
       LOGERR << "merkle root mismatch!";
@@ -90,10 +114,11 @@ void BlockData::deserialize(const uint8_t* data, size_t size,
 
 /////////////////////////////////////////////////////////////////////////////
 TxFilter<TxFilterType> 
-BlockData::computeTxFilter(const vector<BinaryData>& allHashes) const
+BlockData::computeTxFilter(const BinaryData& allHashes) const
 {
-   TxFilter<TxFilterType> txFilter(uniqueID_, allHashes.size());
-   txFilter.update(allHashes);
+   auto count = allHashes.getSize() / 32;
+   TxFilter<TxFilterType> txFilter(uniqueID_, count);
+   txFilter.update(allHashes.getPtr(), count);
 
    return move(txFilter);
 }
@@ -153,8 +178,9 @@ void BlockFiles::detectAllBlockFiles()
 }
 
 /////////////////////////////////////////////////////////////////////////////
-BlockDataLoader::BlockDataLoader(const string& path) :
-   path_(path), prefix_("blk")
+BlockDataLoader::BlockDataLoader(const string& path,
+   BlockFileReadMode readMode) :
+   path_(path), prefix_("blk"), readMode_(readMode)
 {}
 
 /////////////////////////////////////////////////////////////////////////////
@@ -174,6 +200,17 @@ shared_ptr<BlockDataFileMap> BlockDataLoader::get(uint32_t fileid)
    return getNewBlockDataMap(fileid);
 }
 
+/////////////////////////////////////////////////////////////////////////////
+shared_ptr<BlockDataFileMap> BlockDataLoader::get(
+   uint32_t fileid, size_t offset, size_t length)
+{
+   if (readMode_ != BlockFileRead_Stream)
+      return get(fileid);
+
+   string filename = move(intIDToName(fileid));
+   return make_shared<BlockDataFileMap>(filename, offset, length);
+}
+
 /////////////////////////////////////////////////////////////////////////////
 uint32_t BlockDataLoader::nameToIntID(const string& filename)
 {
@@ -316,3 +353,108 @@ BlockDataFileMap::BlockDataFileMap(const string& filename)
       }
    }
 }
+
+/////////////////////////////////////////////////////////////////////////////
+BlockDataFileMap::BlockDataFileMap(
+   const string& filename, size_t offset, size_t length)
+{
+   useCounter_.store(0, memory_order_relaxed);
+
+   if (!DBUtils::fileExists(filename, 2))
+      return;
+
+   readWindow(filename, offset, length);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+void BlockDataFileMap::readWindow(
+   const string& filename, size_t offset, size_t length)
+{
+   /***
+   Reads [offset, offset + length) of the file in chunks. The pages read are
+   dropped from the system cache right behind the copy: the data lives in 
+   our buffer now, a scan reads each block once and keeping it cached only 
+   evicts pages other processes need.
+   ***/
+
+   const size_t chunkSize = 8 * 1024 * 1024;
+
+#ifdef _WIN32
+   int fd = _open(filename.c_str(), _O_RDONLY | _O_BINARY);
+#else
+   int fd = open(filename.c_str(), O_RDONLY);
+#endif
+   if (fd == -1)
+      throw runtime_error("failed to open file");
+
+   try
+   {
+#ifdef _WIN32
+      auto fileSize = (size_t)_lseeki64(fd, 0, SEEK_END);
+#else
+      auto fileSize = (size_t)lseek(fd, 0, SEEK_END);
+#endif
+      if (offset > fileSize)
+         throw runtime_error("window offset past end of file");
+
+      if (offset + length > fileSize)
+         length = fileSize - offset;
+      if (length == 0)
+         throw runtime_error("empty block file window");
+
+#if !defined(_WIN32) && defined(POSIX_FADV_SEQUENTIAL)
+      posix_fadvise(fd, offset, length, POSIX_FADV_SEQUENTIAL);
+#endif
+
+      window_.reset(new uint8_t[length]);
+      windowOffset_ = offset;
+      size_ = length;
+
+      size_t pos = 0;
+#ifdef _WIN32
+      _lseeki64(fd, offset, SEEK_SET);
+#endif
+      while (pos < length)
+      {
+         auto toRead = min(chunkSize, length - pos);
+
+#ifdef _WIN32
+         auto readCount = _read(fd, window_.get() + pos, (unsigned)toRead);
+#else
+         auto readCount = pread(fd, window_.get() + pos, toRead, offset + pos);
+         if (readCount == -1 && errno == EINTR)
+            continue;
+#endif
+         if (readCount <= 0)
+         {
+            stringstream errStr;
+            errStr << "Failed to read block file window. Error Code: " <<
+               errno << " (" << strerror(errno) << ")";
+            throw runtime_error(errStr.str());
+         }
+
+#if !defined(_WIN32) && defined(POSIX_FADV_DONTNEED)
+         posix_fadvise(fd, offset + pos, readCount, POSIX_FADV_DONTNEED);
+#endif
+         pos += readCount;
+      }
+   }
+   catch (exception&)
+   {
+      window_.reset();
+      size_ = 0;
+      windowOffset_ = 0;
+#ifdef _WIN32
+      _close(fd);
+#else
+      close(fd);
+#endif
+      throw;
+   }
+
+#ifdef _WIN32
+   _close(fd);
+#else
+   close(fd);
+#endif
+}
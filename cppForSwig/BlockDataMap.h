@@ -40,28 +40,104 @@ using namespace std;
 
 #include "BlockObj.h"
 #include "BinaryData.h"
+#include "bdmenums.h"
 
 #define OffsetAndSize pair<size_t, size_t>
 
+////////////////////////////////////////////////////////////////////////////////
+class OffsetAndSizeArray
+{
+   /***
+   Read only view over a run of offset/size pairs. The pairs live either in 
+   the owning BCTX (standalone parse) or in the offset arena of the parent
+   BlockData, so that parsing a block does not allocate per tx.
+   ***/
+
+private:
+   size_t start_ = 0;
+   size_t count_ = 0;
+   const OffsetAndSize* ptr_ = nullptr;
+
+public:
+   OffsetAndSizeArray(void)
+   {}
+
+   OffsetAndSizeArray(size_t start, size_t count) :
+      start_(start), count_(count)
+   {}
+
+   void bind(const OffsetAndSize* base) { ptr_ = base + start_; }
+
+   size_t size(void) const { return count_; }
+   bool empty(void) const { return count_ == 0; }
+
+   const OffsetAndSize& operator[](size_t i) const { return ptr_[i]; }
+   const OffsetAndSize& back(void) const { return ptr_[count_ - 1]; }
+
+   const OffsetAndSize* begin(void) const { return ptr_; }
+   const OffsetAndSize* end(void) const { return ptr_ + count_; }
+   const OffsetAndSize* cbegin(void) const { return ptr_; }
+   const OffsetAndSize* cend(void) const { return ptr_ + count_; }
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 struct BCTX
 {
    const uint8_t* data_;
-   const size_t size_;
+   size_t size_;
 
    uint32_t version_;
    uint32_t lockTime_;
 
    bool usesWitness_ = false;
 
-   vector<OffsetAndSize> txins_;
-   vector<OffsetAndSize> txouts_;
-   vector<OffsetAndSize> witnesses_;
+   OffsetAndSizeArray txins_;
+   OffsetAndSizeArray txouts_;
+   OffsetAndSizeArray witnesses_;
 
    mutable BinaryData txHash_;
 
    bool isCoinbase_ = false;
 
+private:
+   //backing storage for the offset arrays of standalone txs, 
+   //empty when the arrays point into a block arena
+   vector<OffsetAndSize> offsets_;
+
+private:
+   void bindOffsets(const OffsetAndSize* base)
+   {
+      txins_.bind(base);
+      txouts_.bind(base);
+      witnesses_.bind(base);
+   }
+
+   void copyOffsets(const BCTX& rhs)
+   {
+      /***
+      A copy always owns its offsets: rhs may point into the arena of a
+      block that won't outlive the copy, so the pairs are deep copied into
+      offsets_ and the arrays rebound to it.
+      ***/
+
+      offsets_.clear();
+      offsets_.reserve(
+         rhs.txins_.size() + rhs.txouts_.size() + rhs.witnesses_.size());
+
+      txins_ = OffsetAndSizeArray(offsets_.size(), rhs.txins_.size());
+      offsets_.insert(offsets_.end(), rhs.txins_.begin(), rhs.txins_.end());
+
+      txouts_ = OffsetAndSizeArray(offsets_.size(), rhs.txouts_.size());
+      offsets_.insert(offsets_.end(), rhs.txouts_.begin(), rhs.txouts_.end());
+
+      witnesses_ = OffsetAndSizeArray(offsets_.size(), rhs.witnesses_.size());
+      offsets_.insert(offsets_.end(), 
+         rhs.witnesses_.begin(), rhs.witnesses_.end());
+
+      bindOffsets(offsets_.data());
+   }
+
+public:
    BCTX(const uint8_t* data, size_t size) :
       data_(data), size_(size)
    {}
@@ -70,31 +146,68 @@ struct BCTX
       data_(bdr.getPtr()), size_(bdr.getSize())
    {}
 
+   BCTX(const BCTX& rhs) :
+      data_(rhs.data_), size_(rhs.size_),
+      version_(rhs.version_), lockTime_(rhs.lockTime_),
+      usesWitness_(rhs.usesWitness_),
+      txHash_(rhs.txHash_), isCoinbase_(rhs.isCoinbase_)
+   {
+      copyOffsets(rhs);
+   }
+
+   BCTX(BCTX&&) = default;
+
+   BCTX& operator=(const BCTX& rhs)
+   {
+      if (this == &rhs)
+         return *this;
+
+      data_ = rhs.data_;
+      size_ = rhs.size_;
+      version_ = rhs.version_;
+      lockTime_ = rhs.lockTime_;
+      usesWitness_ = rhs.usesWitness_;
+      txHash_ = rhs.txHash_;
+      isCoinbase_ = rhs.isCoinbase_;
+
+      copyOffsets(rhs);
+      return *this;
+   }
+
+   //moving offsets_ keeps its buffer, the arrays remain valid
+   BCTX& operator=(BCTX&&) = default;
+
+   void computeHash(uint8_t* out) const
+   {
+      //writes the 32 byte txid to out, doesn't touch txHash_
+      if (usesWitness_)
+      {
+         BinaryData noWitData;
+         BinaryDataRef version(data_, 4);
+        
+         auto& lastTxOut = txouts_.back();
+         auto witnessOffset = lastTxOut.first + lastTxOut.second;
+         BinaryDataRef txinout(data_ + 6, witnessOffset - 6);
+         BinaryDataRef locktime(data_ + size_ - 4, 4);
+        
+         noWitData.append(version);
+         noWitData.append(txinout);
+         noWitData.append(locktime);
+         
+         SHA256d::getHash256(noWitData.getPtr(), noWitData.getSize(), out);
+      }
+      else
+      {
+         SHA256d::getHash256(data_, size_, out);
+      }
+   }
+
    const BinaryData& getHash(void) const
    {
       if(txHash_.getSize() == 0)
       {
-         if (usesWitness_)
-         {
-            BinaryData noWitData;
-            BinaryDataRef version(data_, 4);
-           
-            auto& lastTxOut = txouts_.back();
-            auto witnessOffset = lastTxOut.first + lastTxOut.second;
-            BinaryDataRef txinout(data_ + 6, witnessOffset - 6);
-            BinaryDataRef locktime(data_ + size_ - 4, 4);
-           
-            noWitData.append(version);
-            noWitData.append(txinout);
-            noWitData.append(locktime);
-            
-            BtcUtils::getHash256(noWitData, txHash_);
-         }
-         else
-         {
-            BinaryDataRef hashdata(data_, size_);
-            BtcUtils::getHash256(hashdata, txHash_);
-         }
+         txHash_.resize(32);
+         computeHash(txHash_.getPtr());
       }
 
       return txHash_;
@@ -144,54 +257,82 @@ struct BCTX
          &offsetIns, &offsetOuts, &offsetsWitness);
 
       auto txPtr = make_shared<BCTX>(data, txlen);
+      txPtr->setOffsets(offsetIns, offsetOuts, offsetsWitness, 
+         id, txPtr->offsets_);
+      txPtr->bindOffsets(txPtr->offsets_.data());
+
+      return txPtr;
+   }
 
-      //create BCTX object and fill it up
-      txPtr->version_ = READ_UINT32_LE(data);
+   void setOffsets(
+      const vector<size_t>& offsetIns, 
+      const vector<size_t>& offsetOuts, 
+      const vector<size_t>& offsetsWitness,
+      unsigned id, vector<OffsetAndSize>& storage)
+   {
+      /***
+      Converts the offsets from TxCalcLength to offset + size pairs appended
+      to storage. The arrays have to be bound to the final storage pointer
+      once it won't move anymore (bindOffsets/BlockData::deserialize)
+      ***/
+
+      version_ = READ_UINT32_LE(data_);
 
       // Check the marker and flag for witness transaction
-      auto brrPtr = data + 4;
+      auto brrPtr = data_ + 4;
       auto marker = (const uint16_t*)brrPtr;
       if (*marker == 0x0100)
-         txPtr->usesWitness_ = true;
+         usesWitness_ = true;
 
-      //convert offsets to offset + size pairs
+      txins_ = OffsetAndSizeArray(storage.size(), offsetIns.size() - 1);
       for (int y = 0; y < offsetIns.size() - 1; y++)
-         txPtr->txins_.push_back(
+         storage.push_back(
          make_pair(
          offsetIns[y],
          offsetIns[y + 1] - offsetIns[y]));
 
+      txouts_ = OffsetAndSizeArray(storage.size(), offsetOuts.size() - 1);
       for (int y = 0; y < offsetOuts.size() - 1; y++)
-         txPtr->txouts_.push_back(
+         storage.push_back(
          make_pair(
          offsetOuts[y],
          offsetOuts[y + 1] - offsetOuts[y]));
 
-      if (txPtr->usesWitness_)
+      if (usesWitness_)
       {
+         witnesses_ = OffsetAndSizeArray(
+            storage.size(), offsetsWitness.size() - 1);
          for (int y = 0; y < offsetsWitness.size() - 1; y++)
-            txPtr->witnesses_.push_back(
+            storage.push_back(
             make_pair(
             offsetsWitness[y],
             offsetsWitness[y + 1] - offsetsWitness[y]));
       }
 
-      txPtr->lockTime_ = READ_UINT32_LE(data + offsetsWitness.back());
+      lockTime_ = READ_UINT32_LE(data_ + offsetsWitness.back());
 
       if (id != UINT32_MAX)
       {
-         txPtr->isCoinbase_ = (id == 0);
+         isCoinbase_ = (id == 0);
       }
-      else if (txPtr->txins_.size() == 1)
+      else if (txins_.size() == 1)
       {
-         auto txinref = txPtr->getTxInRef(0);
-         auto bdr = txinref.getSliceRef(0, 32);
+         BinaryDataRef bdr(data_ + offsetIns[0], 32);
          if (bdr == BtcUtils::EmptyHash_)
-            txPtr->isCoinbase_ = true;
+            isCoinbase_ = true;
       }
-
-      return txPtr;
    }
+
+   friend class BlockData;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+struct BCTXArena
+{
+   //single allocation backing all txs of a block, BlockData hands out 
+   //shared_ptr<BCTX> aliasing this object instead of one per tx
+   vector<BCTX> txns_;
+   vector<OffsetAndSize> offsets_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -250,7 +391,7 @@ public:
    shared_ptr<BlockHeader> createBlockHeader(void) const;
    const BinaryData& getHash(void) const { return blockHash_; }
    
-   TxFilter<TxFilterType> computeTxFilter(const vector<BinaryData>&) const;
+   TxFilter<TxFilterType> computeTxFilter(const BinaryData&) const;
    const TxFilter<TxFilterType>& getTxFilter(void) const { return txFilter_; }
    uint32_t uniqueID(void) const { return uniqueID_; }
    shared_ptr<BlockHeader> getHeaderPtr(void) const { return headerPtr_; }
@@ -307,6 +448,14 @@ public:
 /////////////////////////////////////////////////////////////////////////////
 class BlockDataFileMap
 {
+   /***
+   Block data for one blkXXXXX.dat file. Either the whole file, mmapped, or
+   a window of it streamed into a private buffer (see BlockDataLoader).
+   
+   getPtr(offset, size) reaches block data in both cases. getPtr() only 
+   applies to whole file maps.
+   ***/
+
    friend class BlockFileMapPointer;
    friend class BlockDataLoader;
 
@@ -314,10 +463,18 @@ private:
    uint8_t* fileMap_ = nullptr;
    size_t size_ = 0;
 
+   //stream windows only
+   unique_ptr<uint8_t[]> window_;
+   size_t windowOffset_ = 0;
+
    atomic<int> useCounter_;
 
+private:
+   void readWindow(const string& filename, size_t offset, size_t length);
+
 public:
    BlockDataFileMap(const string& filename);
+   BlockDataFileMap(const string& filename, size_t offset, size_t length);
 
    ~BlockDataFileMap(void)
    {
@@ -338,7 +495,90 @@ public:
       return fileMap_;
    }
 
+   const uint8_t* getPtr(size_t offset, size_t size) const
+   {
+      //offset is relative to the start of the file
+      if (offset < windowOffset_ || 
+          offset + size > windowOffset_ + size_)
+         throw runtime_error("block data out of file map range");
+
+      if (window_ != nullptr)
+         return window_.get() + offset - windowOffset_;
+
+      if (fileMap_ == nullptr)
+         throw runtime_error("empty file map");
+
+      return fileMap_ + offset;
+   }
+
    size_t size(void) const { return size_; }
+   bool isWindow(void) const { return window_ != nullptr; }
+};
+
+/////////////////////////////////////////////////////////////////////////////
+class BlockStreamBudget
+{
+   /***
+   Caps the bytes of block data held in stream windows at once. Scans 
+   acquire the size of a batch before loading it and release it once the 
+   batch is committed. 
+   
+   acquire() blocks until enough is released. Up to 2 holders always go 
+   through regardless of size: the scanner only hands a batch down the 
+   pipeline once the next one is queued, blocking the 2nd would stall it.
+   ***/
+
+private:
+   mutex mu_;
+   condition_variable cv_;
+
+   const size_t budget_;
+   size_t inFlight_ = 0;
+   size_t peak_ = 0;
+   unsigned holders_ = 0;
+
+public:
+   BlockStreamBudget(size_t budget) :
+      budget_(budget)
+   {}
+
+   void acquire(size_t bytes)
+   {
+      unique_lock<mutex> lock(mu_);
+      while (holders_ >= 2 && inFlight_ + bytes > budget_)
+         cv_.wait(lock);
+
+      inFlight_ += bytes;
+      ++holders_;
+      if (inFlight_ > peak_)
+         peak_ = inFlight_;
+   }
+
+   void release(size_t bytes)
+   {
+      {
+         unique_lock<mutex> lock(mu_);
+         inFlight_ -= min(bytes, inFlight_);
+         if (holders_ > 0)
+            --holders_;
+      }
+
+      cv_.notify_all();
+   }
+
+   size_t budget(void) const { return budget_; }
+
+   size_t inFlight(void)
+   {
+      unique_lock<mutex> lock(mu_);
+      return inFlight_;
+   }
+
+   size_t peak(void)
+   {
+      unique_lock<mutex> lock(mu_);
+      return peak_;
+   }
 };
 
 /////////////////////////////////////////////////////////////////////////////
@@ -347,6 +587,7 @@ class BlockDataLoader
 private:     
    const string path_;
    const string prefix_;
+   const BlockFileReadMode readMode_;
 
 private:   
 
@@ -359,13 +600,21 @@ private:
       getNewBlockDataMap(uint32_t fileid);
 
 public:
-   BlockDataLoader(const string& path);
+   BlockDataLoader(const string& path, 
+      BlockFileReadMode readMode = BlockFileRead_Mmap);
 
    ~BlockDataLoader(void)
    {}
 
    shared_ptr<BlockDataFileMap> get(const string& filename);
    shared_ptr<BlockDataFileMap> get(uint32_t fileid);
+
+   //[offset, offset + length) of the file. In stream mode it is read in 
+   //its own buffer, in mmap mode this is the whole file map.
+   shared_ptr<BlockDataFileMap> get(
+      uint32_t fileid, size_t offset, size_t length);
+
+   BlockFileReadMode readMode(void) const { return readMode_; }
 };
 
 #endif
@@ -6,6 +6,7 @@
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 #include "BlockDataViewer.h"
+#include "UtxoSnapshot.h"
 
 
 /////////////////////////////////////////////////////////////////////////////
@@ -471,17 +472,60 @@ vector<UnspentTxOut> BlockDataViewer::getUnspentTxoutsForAddr160List(
       }
    }
 
+   //the utxo snapshot holds every tracked utxo at the tip, one pass over it
+   //replaces the per address SSH and STXO lookups
+   map<BinaryData, map<BinaryData, UnspentTxOut>> snapshotUtxoMap;
+   shared_ptr<UtxoSnapshot> snapshot;
+   if (bdmPtr_->config().armoryDbType_ != ARMORY_DB_SUPER)
+      snapshot = db_->getUtxoSnapshot();
+
+   if (snapshot != nullptr)
+   {
+      for (const auto& scrAddr : scrAddrVec)
+         snapshotUtxoMap[scrAddr];
+
+      snapshot->forEach(
+         [&snapshotUtxoMap](const UtxoSnapshot::Entry& entry)->void
+      {
+         auto iter = snapshotUtxoMap.find(entry.scrAddr_);
+         if (iter == snapshotUtxoMap.end())
+            return;
+
+         auto&& stxo = entry.getStoredTxOut();
+         iter->second.insert(make_pair(stxo.getDBKey(false),
+            UnspentTxOut(entry.txHash_, stxo.txOutIndex_, 
+               stxo.blockHeight_, stxo.getValue(), stxo.getScriptRef())));
+      });
+   }
+
+   //without a snapshot, hold the read txns for the whole list so the per
+   //address lookups nest in them rather than renewing their own
+   LMDBEnv::Transaction sshTx, subsshTx, stxoTx, hintTx;
+   if (snapshot == nullptr)
+   {
+      db_->beginDBTransaction(&sshTx, SSH, LMDB::ReadOnly);
+      db_->beginDBTransaction(&subsshTx, SUBSSH, LMDB::ReadOnly);
+      db_->beginDBTransaction(&stxoTx, STXO, LMDB::ReadOnly);
+      db_->beginDBTransaction(&hintTx, TXHINTS, LMDB::ReadOnly);
+   }
+
    vector<UnspentTxOut> UTXOs;
 
    for (const auto& scrAddr : scrAddrVec)
    {
       const auto& zcTxioMap = zeroConfCont_->getUnspentZCforScrAddr(scrAddr);
 
-      StoredScriptHistory ssh;
-      db_->getStoredScriptHistory(ssh, scrAddr);
-
       map<BinaryData, UnspentTxOut> scrAddrUtxoMap;
-      db_->getFullUTXOMapForSSH(ssh, scrAddrUtxoMap);
+      if (snapshot != nullptr)
+      {
+         scrAddrUtxoMap = move(snapshotUtxoMap[scrAddr]);
+      }
+      else
+      {
+         StoredScriptHistory ssh;
+         db_->getStoredScriptHistory(ssh, scrAddr);
+         db_->getFullUTXOMapForSSH(ssh, scrAddrUtxoMap);
+      }
 
       for (const auto& utxoPair : scrAddrUtxoMap)
       {
@@ -86,7 +86,7 @@ public:
    void registerArbitraryAddressVec(const vector<BinaryData>& saVec,
       const string& walletID);
 
-   const shared_ptr<map<BinaryData, shared_ptr<map<BinaryData, TxIOPair>>>>
+   shared_ptr<const PersistentMap<BinaryData, shared_ptr<map<BinaryData, TxIOPair>>>>
       getFullZeroConfTxIOMap() const
    { return zeroConfCont_->getFullTxioMap(); }
 
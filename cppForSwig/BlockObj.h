@@ -23,6 +23,11 @@
 #include <cassert>
 #include <functional>
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TXFILTER_SSE2
+#endif
+
 #include "BinaryData.h"
 #include "BtcUtils.h"
 #include "TxClasses.h"
@@ -36,6 +41,78 @@ class Tx;
 class TxIn;
 class TxOut;
 
+////////////////////////////////////////////////////////////////////////////////
+template<typename T> class TxFilterPrefixSet
+{
+   /***
+   Flat, sorted array of the hash prefixes a filter scan is looking for,
+   fronted by a 64kbit presence bitmap indexed by the low 16 bits of the 
+   prefix. The bitmap is 8kB and stays in L1, so the vast majority of filter
+   entries are rejected with a single bit test, and only candidates pay for 
+   the binary search in the prefix array.
+   ***/
+
+private:
+   vector<T> prefixes_;
+   vector<uint64_t> bitmap_;
+
+private:
+   static uint32_t bucket(const T& key)
+   {
+      return uint32_t(key) & 0xFFFF;
+   }
+
+public:
+   TxFilterPrefixSet(void) :
+      bitmap_(1024, 0)
+   {}
+
+   TxFilterPrefixSet(const vector<BinaryData>& hashVec) :
+      bitmap_(1024, 0)
+   {
+      prefixes_.reserve(hashVec.size());
+      for (auto& hash : hashVec)
+         insert(hash);
+
+      finalize();
+   }
+
+   void insert(const BinaryData& hash)
+   {
+      if (hash.getSize() < sizeof(T))
+         throw range_error("unexpected hash length");
+
+      T key;
+      memcpy(&key, hash.getPtr(), sizeof(T));
+      prefixes_.push_back(key);
+   }
+
+   void finalize(void)
+   {
+      sort(prefixes_.begin(), prefixes_.end());
+      prefixes_.erase(
+         unique(prefixes_.begin(), prefixes_.end()), prefixes_.end());
+
+      for (auto& key : prefixes_)
+      {
+         auto bit = bucket(key);
+         bitmap_[bit >> 6] |= uint64_t(1) << (bit & 63);
+      }
+   }
+
+   bool contains(const T& key) const
+   {
+      auto bit = bucket(key);
+      if ((bitmap_[bit >> 6] & (uint64_t(1) << (bit & 63))) == 0)
+         return false;
+
+      return binary_search(prefixes_.begin(), prefixes_.end(), key);
+   }
+
+   const vector<T>& getPrefixes(void) const { return prefixes_; }
+   size_t size(void) const { return prefixes_.size(); }
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 template<typename T> class TxFilter
 {
@@ -161,6 +238,20 @@ public:
          update(hash);
       }
    }   
+
+   void update(const uint8_t* hashes, size_t count)
+   {
+      //count contiguous 32 byte hashes
+      if (!isValid())
+         throw runtime_error("txfilter needs initialized first");
+
+      for (size_t i = 0; i < count; i++)
+      {
+         T hashHead;
+         memcpy(&hashHead, hashes + i * 32, sizeof(T));
+         filterVector_.push_back(hashHead);
+      }
+   }
    
    set<uint32_t> compare(const BinaryData& hash) const
    {
@@ -171,25 +262,58 @@ public:
    set<uint32_t> compare(const T& key) const
    {
       set<uint32_t> resultSet;
+      if (filterVector_.size() != 0)
+         scan(&filterVector_[0], filterVector_.size(), key, resultSet);
+      else if (filterPtr_ != nullptr)
+         scan((const T*)(filterPtr_ + 12), len_, key, resultSet);
+      else
+         throw runtime_error("invalid filter");
+
+      return resultSet;
+   }
+
+   void compare(const TxFilterPrefixSet<T>& prefixSet,
+      map<T, set<uint32_t>>& hits) const
+   {
+      //single pass over the filter for a whole set of prefixes
+      const T* ptr;
+      size_t count;
+
       if (filterVector_.size() != 0)
       {
-         for (unsigned i = 0; i < filterVector_.size(); i++)
-         {
-            if (filterVector_[i] == key)
-               resultSet.insert(i);
-         }
+         ptr = &filterVector_[0];
+         count = filterVector_.size();
       }
       else if (filterPtr_ != nullptr)
       {
-         auto ptr = (T*)(filterPtr_ + 12);
-         for (unsigned i = 0; i < len_; i++)
-            if (ptr[i] == key)
-               resultSet.insert(i);
+         ptr = (const T*)(filterPtr_ + 12);
+         count = len_;
       }
       else
          throw runtime_error("invalid filter");
 
-      return resultSet;
+      //few prefixes: cheaper to run a vectorized scan per prefix
+      if (prefixSet.size() <= 4)
+      {
+         for (auto& key : prefixSet.getPrefixes())
+         {
+            set<uint32_t> resultSet;
+            scan(ptr, count, key, resultSet);
+            if (resultSet.size() > 0)
+               hits[key] = move(resultSet);
+         }
+
+         return;
+      }
+
+      for (unsigned i = 0; i < count; i++)
+      {
+         T key;
+         memcpy(&key, ptr + i, sizeof(T));
+
+         if (prefixSet.contains(key))
+            hits[key].insert(i);
+      }
    }
 
    uint32_t getBlockKey(void) const { return blockKey_; }
@@ -214,8 +338,54 @@ public:
       //we want higher blocks to appear earlier in sets/maps
       return blockKey_ > rhs.blockKey_;
    }
+
+private:
+   static void scan(const T* ptr, size_t count, const T& key,
+      set<uint32_t>& resultSet)
+   {
+      for (unsigned i = 0; i < count; i++)
+      {
+         if (ptr[i] == key)
+            resultSet.insert(i);
+      }
+   }
 };
 
+#ifdef TXFILTER_SSE2
+////////////////////////////////////////////////////////////////////////////////
+template<> inline void TxFilter<uint32_t>::scan(
+   const uint32_t* ptr, size_t count, const uint32_t& key,
+   set<uint32_t>& resultSet)
+{
+   //compare 4 prefixes per instruction, pool pointers are not aligned
+   auto keyVec = _mm_set1_epi32((int)key);
+
+   size_t i = 0;
+   for (; i + 4 <= count; i += 4)
+   {
+      auto entries = _mm_loadu_si128((const __m128i*)(ptr + i));
+      auto mask = _mm_movemask_ps(
+         _mm_castsi128_ps(_mm_cmpeq_epi32(entries, keyVec)));
+
+      while (mask != 0)
+      {
+         auto lane = 0;
+         while ((mask & (1 << lane)) == 0)
+            ++lane;
+
+         resultSet.insert(i + lane);
+         mask &= ~(1 << lane);
+      }
+   }
+
+   for (; i < count; i++)
+   {
+      if (ptr[i] == key)
+         resultSet.insert(i);
+   }
+}
+#endif
+
 class BlockHeader
 {
    friend class Blockchain;
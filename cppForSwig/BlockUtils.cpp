@@ -868,6 +868,9 @@ BlockDataManager::BlockDataManager(
 
    iface_ = new LMDBBlockDatabase(blockchain_, 
       config_.blkFileLocation_, config_.armoryDbType_);
+   iface_->setTxHashIndex(config_.txHashIndex_);
+   iface_->setValueEncoding(config_.compactDbValues_ ?
+      DB_ENCODING_COMPACT : DB_ENCODING_LEGACY);
 
    readBlockHeaders_ = make_shared<BitcoinQtBlockFiles>(
       config_.blkFileLocation_,
@@ -967,7 +970,12 @@ BinaryData BlockDataManager::applyBlockRangeToDB(
    // Start scanning and timer
    BlockchainScanner bcs(blockchain_, iface_, &scrAddrData, 
       *blockFiles_.get(), config_.threadCount_, config_.ramUsage_,
-      prog, config_.reportProgress_);
+      prog, config_.reportProgress_, 
+      config_.blkFileReadMode_, config_.streamBudget_,
+      config_.ramLevelSize_);
+
+   //address registration scans are rare and cover the whole chain
+   bcs.enableUtxoSnapshot();
    bcs.scan_nocheck(blk0);
    bcs.updateSSH(true);
    bcs.resolveTxHashes();
@@ -1063,9 +1071,29 @@ vector<TxRef*> BlockDataManager::findAllNonStdTx(void)
 // untouched
 
 
+/////////////////////////////////////////////////////////////////////////////
+void BlockDataManager::writeUtxoSnapshot()
+{
+   if (dbBuilder_ == nullptr)
+      return;
+
+   try
+   {
+      dbBuilder_->writeUtxoSnapshot();
+   }
+   catch (exception& e)
+   {
+      LOGWARN << "failed to snapshot utxos: " << e.what();
+   }
+}
+
 /////////////////////////////////////////////////////////////////////////////
 void BlockDataManager::resetDatabases(ResetDBMode mode)
 {
+   //the filter compaction writes to TXFILTERS, it can't outlive the DBs
+   if (dbBuilder_ != nullptr)
+      dbBuilder_->waitOnTxFilterCompaction();
+
    if (mode == Reset_SSH)
    {
       iface_->resetSSHdb();
@@ -238,6 +238,7 @@ public:
    vector<string> getNextWalletIDToScan(void);
    
    void resetDatabases(ResetDBMode mode);
+   void writeUtxoSnapshot(void);
    
    void terminateAllScans(void) 
    {
@@ -14,6 +14,9 @@
 #include "Blockchain.h"
 #include "util.h"
 
+#include <thread>
+#include <algorithm>
+
 #ifdef max
 #undef max
 #endif
@@ -35,6 +38,7 @@ Blockchain::Blockchain(const HashString &genesisHash)
 void Blockchain::clear()
 {
    newlyParsedBlocks_.clear();
+   unorganizedHeaders_.clear();
    headersByHeight_.resize(0);
    headersById_.clear();
    headerMap_.clear();
@@ -59,6 +63,7 @@ void Blockchain::addBlock(
    }
    
    headerMap_[blockhash] = header;
+   unorganizedHeaders_.push_back(header);
    auto insertIter = headersById_.insert(make_pair(header->getThisID(), header));
    if (insertIter.second == false)
       LOGWARN << "block id duplicate: " << header->getThisID();
@@ -171,11 +176,10 @@ shared_ptr<BlockHeader> Blockchain::getHeaderByHeight(unsigned index)
 
 const shared_ptr<BlockHeader> Blockchain::getHeaderByHeight(unsigned index) const
 {
-   auto headerIter = headersByHeight_.cbegin() + index;
-   if (headerIter == headersByHeight_.cend())
+   if (index >= headersByHeight_.size())
       throw std::range_error("Cannot get block at height " + to_string(index));
 
-   return (*headerIter);
+   return headersByHeight_[index];
 }
 
 
@@ -250,18 +254,24 @@ shared_ptr<BlockHeader> Blockchain::organizeChain(bool forceRebuild, bool verbos
 
    
    // If rebuild, we zero out any original organization data and do a 
-   // rebuild of the chain from scratch.  This will need to be done in
-   // the event that our first call to organizeChain returns false, which
-   // means part of blockchain that was previously valid, has become
-   // invalid.  Rather than get fancy, just rebuild all which takes less
-   // than a second, anyway.
+   // rebuild of the chain from scratch. Otherwise only the headers added
+   // since the last run are traced, and a reorg only unwinds the previous
+   // branch down to the fork point.
+   // A rebuild looks up every parent, these go through a hash index rather
+   // than the ordered map.
+   HeaderIndex headerIndex;
    if(forceRebuild)
    {
+      headerIndex.headers_.reserve(headerMap_.size());
+      headerIndex.ids_.reserve(headerMap_.size());
       map<HashString, shared_ptr<BlockHeader>>::iterator iter;
       for( iter  = headerMap_.begin(); 
            iter != headerMap_.end(); 
            iter++)
       {
+         headerIndex.ids_.emplace(
+            iter->first.getRef(), headerIndex.headers_.size());
+         headerIndex.headers_.push_back(iter->second);
          iter->second->difficultySum_  = -1;
          iter->second->blockHeight_ = 0;
          iter->second->isFinishedCalc_ = false;
@@ -297,9 +307,10 @@ shared_ptr<BlockHeader> Blockchain::organizeChain(bool forceRebuild, bool verbos
 
    const auto prevTopBlock = top();
    
-   // Iterate over all blocks, track the maximum difficulty-sum block
+   // Trace the candidates, track the maximum difficulty-sum block
    double   maxDiffSum     = prevTopBlock->getDifficultySum();
-   for( auto &header : values(headerMap_))
+   vector<shared_ptr<BlockHeader>> orphans;
+   auto pickTop = [&](const shared_ptr<BlockHeader>& header)->void
    {
       // *** Walk down the chain following prevHash fields, until
       //     you find a "solved" block.  Then walk back up and 
@@ -310,7 +321,8 @@ shared_ptr<BlockHeader> Blockchain::organizeChain(bool forceRebuild, bool verbos
 
       if (header->isOrphan_)
       {
-         // disregard this block
+         // disregard this block, retry once its parent shows up
+         orphans.push_back(header);
       }
       // Determine if this is the top block.  If it's the same diffsum
       // as the prev top block, don't do anything
@@ -320,11 +332,34 @@ shared_ptr<BlockHeader> Blockchain::organizeChain(bool forceRebuild, bool verbos
          topBlockPtr_   = header;
          topBlockId_    = header->getThisID();
       }
+   };
+
+   if (forceRebuild)
+   {
+      traceAllChains(headerIndex);
+      for (auto& header : headerIndex.headers_)
+         pickTop(header);
+   }
+   else
+   {
+      for (auto& header : unorganizedHeaders_)
+         pickTop(header);
    }
 
+   unorganizedHeaders_ = move(orphans);
+
+   auto getParent = [this, &headerIndex](
+      const shared_ptr<BlockHeader>& header)->shared_ptr<BlockHeader>
+   {
+      if (headerIndex.headers_.empty())
+         return getHeaderByHash(header->getPrevHash());
+
+      return headerIndex.getParent(*header);
+   };
    
-   // Walk down the list one more time, set nextHash fields
-   // Also set headersByHeight_;
+   // Walk down the new branch until we hit the main chain, set nextHash 
+   // fields and headersByHeight_. Blocks below the fork point are already 
+   // set.
    bool prevChainStillValid = (topBlockPtr_ == prevTopBlock);
    topBlockPtr_->nextHash_ = BtcUtils::EmptyHash();
    auto thisHeaderPtr = topBlockPtr_;
@@ -340,7 +375,7 @@ shared_ptr<BlockHeader> Blockchain::organizeChain(bool forceRebuild, bool verbos
          topID = thisHeaderPtr->uniqueID_;
 
       HashString & childHash    = thisHeaderPtr->thisHash_;
-      thisHeaderPtr             = headerMap_[thisHeaderPtr->getPrevHash()];
+      thisHeaderPtr             = getParent(thisHeaderPtr);
       thisHeaderPtr->nextHash_  = childHash;
 
       if(thisHeaderPtr == prevTopBlock)
@@ -353,13 +388,25 @@ shared_ptr<BlockHeader> Blockchain::organizeChain(bool forceRebuild, bool verbos
 
    topID_.store(topID + 1, memory_order_relaxed);
 
-   // Force a full rebuild to make sure everything is marked properly
-   // On a full rebuild, prevChainStillValid should ALWAYS be true
    if( !prevChainStillValid )
    {
       LOGWARN << "Reorg detected!";
 
-      organizeChain(true); // force-rebuild blockchain (takes less than 1s)
+      // Unmark the previous branch down to the fork point. Heights and 
+      // difficulty sums don't depend on the main branch, they stay valid.
+      // A rebuild reset all flags already.
+      if (!forceRebuild)
+      {
+         auto stalePtr = prevTopBlock;
+         while (stalePtr != thisHeaderPtr)
+         {
+            stalePtr->isMainBranch_ = false;
+            stalePtr->isFinishedCalc_ = false;
+            stalePtr->nextHash_ = BtcUtils::EmptyHash();
+            stalePtr = getParent(stalePtr);
+         }
+      }
+
       return thisHeaderPtr;
    }
 
@@ -383,46 +430,41 @@ double Blockchain::traceChainDown(shared_ptr<BlockHeader> bhpStart)
    if(bhpStart->difficultySum_ > 0)
       return bhpStart->difficultySum_;
 
-   // Prepare some data structures for walking down the chain
-   vector<shared_ptr<BlockHeader>>   headerPtrStack(headerMap_.size());
-   vector<double>         difficultyStack(headerMap_.size());
-   uint32_t blkIdx = 0;
-
    // Walk down the chain of prevHash_ values, until we find a block
-   // that has a definitive difficultySum value (i.e. >0). 
-   auto thisPtr = bhpStart;
+   // that has a definitive difficultySum value (i.e. >0). The stack only
+   // grows as deep as the unsolved part of the branch.
+   vector<BlockHeader*> headerPtrStack;
+   auto thisPtr = bhpStart.get();
    while( thisPtr->difficultySum_ < 0)
    {
-      double thisDiff         = thisPtr->difficultyDbl_;
-      difficultyStack[blkIdx] = thisDiff;
-      headerPtrStack[blkIdx]  = thisPtr;
-      blkIdx++;
+      headerPtrStack.push_back(thisPtr);
 
       auto iter = headerMap_.find(thisPtr->getPrevHash());
       if(ITER_IN_MAP(iter, headerMap_))
       {
-         thisPtr = iter->second;
+         thisPtr = iter->second.get();
       }
       else
       {
-         thisPtr->isOrphan_ = true;
          // this block is an orphan, possibly caused by a HeadersFirst
-         // blockchain. Nothing to do about that
+         // blockchain. Nothing to do about that, flag the whole branch
+         for (auto headerPtr : headerPtrStack)
+            headerPtr->isOrphan_ = true;
          return numeric_limits<double>::max();
       }
    }
 
 
-   // Now we have a stack of difficulties and pointers.  Walk back up
-   // (by pointer) and accumulate the difficulty values 
+   // Now we have a stack of pointers.  Walk back up and accumulate the 
+   // difficulty values 
    double   seedDiffSum = thisPtr->difficultySum_;
    uint32_t blkHeight   = thisPtr->blockHeight_;
-   for(int32_t i=blkIdx-1; i>=0; i--)
+   for (auto iter = headerPtrStack.rbegin(); iter != headerPtrStack.rend(); 
+      ++iter)
    {
-      seedDiffSum += difficultyStack[i];
+      thisPtr = *iter;
+      seedDiffSum += thisPtr->difficultyDbl_;
       blkHeight++;
-      thisPtr                 = headerPtrStack[i];
-      thisPtr->difficultyDbl_ = difficultyStack[i];
       thisPtr->difficultySum_ = seedDiffSum;
       thisPtr->blockHeight_   = blkHeight;
       thisPtr->isOrphan_ = false;
@@ -433,6 +475,106 @@ double Blockchain::traceChainDown(shared_ptr<BlockHeader> bhpStart)
   
 }
 
+/////////////////////////////////////////////////////////////////////////////
+shared_ptr<BlockHeader> Blockchain::HeaderIndex::getParent(
+   const BlockHeader& header) const
+{
+   auto iter = ids_.find(header.getPrevHashRef());
+   if (iter == ids_.end())
+      throw std::range_error("Cannot find block with hash " + 
+         header.getPrevHash().copySwapEndian().toHexStr());
+
+   return headers_[iter->second];
+}
+
+/////////////////////////////////////////////////////////////////////////////
+void Blockchain::traceAllChains(const HeaderIndex& headerIndex)
+{
+   /***
+   Resolving a parent is a hash lookup, that's the bulk of the work for a 
+   full trace. The lookups only read the index, so they are split across 
+   threads. The difficulty sums then follow the resolved parent indexes, 
+   no more hashing.
+   ***/
+
+   auto& headers = headerIndex.headers_;
+   auto& ids = headerIndex.ids_;
+
+   vector<size_t> parents(headers.size(), SIZE_MAX);
+   auto resolveParents = [&ids, &headers, &parents](
+      size_t start, size_t end)->void
+   {
+      for (size_t i = start; i < end; i++)
+      {
+         //genesis is solved, placeholders have no header data
+         if (headers[i]->difficultySum_ > 0 || !headers[i]->isInitialized())
+            continue;
+
+         auto iter = ids.find(headers[i]->getPrevHashRef());
+         if (iter != ids.end())
+            parents[i] = iter->second;
+      }
+   };
+
+   const size_t minPerThread = 10000;
+   size_t threadCount = min(
+      (size_t)max(thread::hardware_concurrency(), 1U),
+      headers.size() / minPerThread + 1);
+   size_t perThread = headers.size() / threadCount + 1;
+
+   vector<thread> threads;
+   for (size_t i = 1; i < threadCount; i++)
+   {
+      auto start = min(i * perThread, headers.size());
+      auto end = min(start + perThread, headers.size());
+      threads.push_back(thread(resolveParents, start, end));
+   }
+   resolveParents(0, min(perThread, headers.size()));
+
+   for (auto& thr : threads)
+   {
+      if (thr.joinable())
+         thr.join();
+   }
+
+   //accumulate difficulty sums, same as traceChainDown over indexes
+   vector<size_t> idStack;
+   for (size_t i = 0; i < headers.size(); i++)
+   {
+      if (headers[i]->difficultySum_ > 0)
+         continue;
+
+      idStack.clear();
+      auto id = i;
+      while (headers[id]->difficultySum_ < 0)
+      {
+         idStack.push_back(id);
+         id = parents[id];
+         if (id == SIZE_MAX)
+            break;
+      }
+
+      if (id == SIZE_MAX)
+      {
+         for (auto& stackId : idStack)
+            headers[stackId]->isOrphan_ = true;
+         continue;
+      }
+
+      double   seedDiffSum = headers[id]->difficultySum_;
+      uint32_t blkHeight   = headers[id]->blockHeight_;
+      for (auto iter = idStack.rbegin(); iter != idStack.rend(); ++iter)
+      {
+         auto& headerPtr = headers[*iter];
+         seedDiffSum += headerPtr->difficultyDbl_;
+         blkHeight++;
+         headerPtr->difficultySum_ = seedDiffSum;
+         headerPtr->blockHeight_   = blkHeight;
+         headerPtr->isOrphan_ = false;
+      }
+   }
+}
+
 /////////////////////////////////////////////////////////////////////////////
 void Blockchain::putBareHeaders(LMDBBlockDatabase *db, bool updateDupID)
 {
@@ -526,6 +668,7 @@ set<uint32_t> Blockchain::addBlocksInBulk(
 
       headersById_[header_pair.second->getThisID()] = header_pair.second;
       newlyParsedBlocks_.push_back(header_pair.second);
+      unorganizedHeaders_.push_back(header_pair.second);
       returnSet.insert(header_pair.second->getThisID());
    }
 
@@ -545,6 +688,7 @@ void Blockchain::forceAddBlocksInBulk(
 
       headersById_[header->getThisID()] = header;
       newlyParsedBlocks_.push_back(header);
+      unorganizedHeaders_.push_back(header);
    }
 }
 
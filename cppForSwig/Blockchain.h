@@ -16,9 +16,11 @@
 
 #include "BlockObj.h"
 #include "lmdb_wrapper.h"
+#include "FlatHashMap.h"
 
 #include <memory>
 #include <deque>
+#include <vector>
 #include <map>
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -120,13 +122,32 @@ private:
    // this block.
    double traceChainDown(shared_ptr<BlockHeader> bhpStart);
 
+   // Flat copy of headerMap_ for full rebuilds, with a hash index into it
+   struct HeaderIndex
+   {
+      vector<shared_ptr<BlockHeader>> headers_;
+      FlatHashMap<32, size_t> ids_;
+
+      shared_ptr<BlockHeader> getParent(const BlockHeader&) const;
+   };
+
+   // Full rebuild flavor of traceChainDown: parents are resolved for all
+   // headers at once across threads, then difficulty sums are accumulated
+   // over the resolved indexes.
+   void traceAllChains(const HeaderIndex&);
+
 private:
    //TODO: make this whole class thread safe
 
    const HashString genesisHash_;
    map<HashString, shared_ptr<BlockHeader>> headerMap_;
    vector<shared_ptr<BlockHeader>> newlyParsedBlocks_;
-   deque<shared_ptr<BlockHeader>> headersByHeight_;
+
+   //headers added since the last organize, plus the orphans that haven't
+   //found their parent yet. Only these can change the top.
+   vector<shared_ptr<BlockHeader>> unorganizedHeaders_;
+
+   vector<shared_ptr<BlockHeader>> headersByHeight_;
    map<uint32_t, shared_ptr<BlockHeader>> headersById_;
    shared_ptr<BlockHeader> topBlockPtr_;
    unsigned topBlockId_ = 0;
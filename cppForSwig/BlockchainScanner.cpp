@@ -9,6 +9,37 @@
 #include "BlockchainScanner.h"
 #include "log.h"
 
+//rough per entry cost of std::map nodes, used for batch memory estimates
+#define SCAN_MAP_NODE_SIZE 48
+
+////////////////////////////////////////////////////////////////////////////////
+unique_ptr<ParserBatch> ParserBatch::splitAfterProcessed()
+{
+   //blockCounter_ went past every block an output thread picked up
+   auto processedEnd = blockCounter_.load(memory_order_relaxed) - 1;
+   if (processedEnd >= end_ || processedEnd < start_)
+      return nullptr;
+
+   auto remainder = make_unique<ParserBatch>(
+      processedEnd + 1, end_, 
+      startBlockFileID_, targetBlockFileID_,
+      scriptRefMap_);
+
+   //the remainder reads from the same block data and holds the stream
+   //budget until it is committed
+   remainder->fileMaps_ = fileMaps_;
+   remainder->streamBudget_ = move(streamBudget_);
+   remainder->budgetBytes_ = budgetBytes_;
+   budgetBytes_ = 0;
+
+   remainder->memTracker_ = memTracker_;
+   remainder->memCap_ = memCap_;
+   remainder->count_ = count_;
+
+   end_ = processedEnd;
+   return remainder;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void BlockchainScanner::scan(int32_t scanFrom)
 {
@@ -65,6 +96,7 @@ void BlockchainScanner::scan_nocheck(int32_t scanFrom)
 
    startAt_ = scanFrom;
    auto topBlock = blockchain_->top();
+   scanTopHeight_ = topBlock->getBlockHeight();
 
    preloadUtxos();
 
@@ -103,7 +135,13 @@ void BlockchainScanner::scan_nocheck(int32_t scanFrom)
          //batches try to grab up nBlockFilesPerBatch_ worth of block data
          unsigned targetHeight = 0;
          size_t targetSize = BATCH_SIZE;
-         size_t tallySize;
+         size_t tallySize = 0;
+
+         //leave room in the stream budget for the next batch to preload
+         //while this one is processed
+         if (streamBudget_ != nullptr)
+            targetSize = min(targetSize, streamBudget_->budget() / 2);
+
          try
          {
             shared_ptr<BlockHeader> currentHeader =
@@ -153,6 +191,17 @@ void BlockchainScanner::scan_nocheck(int32_t scanFrom)
             startHeight, endHeight, 
             firstBlockFileID, targetBlockFileID,
             scrRefMap);
+         batch->memTracker_ = memTracker_;
+         batch->memCap_ = batchMemCap_;
+
+         //wait on committed batches to free enough of the budget
+         if (streamBudget_ != nullptr)
+         {
+            streamBudget_->acquire(tallySize);
+
+            batch->streamBudget_ = streamBudget_;
+            batch->budgetBytes_ = tallySize;
+         }
 
 
          completedFutures.push_back(batch->completedPromise_.get_future());
@@ -205,6 +254,9 @@ void BlockchainScanner::scan_nocheck(int32_t scanFrom)
    if (commit_tID.joinable())
       commit_tID.join();
 
+   //new block scans run on every block, only report the verbose ones
+   if (reportProgress_)
+      db_->logBulkWriteStats();
    topScannedBlockHash_ = topBlock->getThisHash();
 
    TIMER_STOP("scan_nocheck");
@@ -218,6 +270,20 @@ void BlockchainScanner::scan_nocheck(int32_t scanFrom)
    if (timeSpent > 5)
       LOGINFO << "throttling for " << timeSpent << "s";
 
+   if (reportProgress_)
+   {
+      LOGINFO << "scan batches peaked at " <<
+         memTracker_->peak() / (1024 * 1024) << "MB, budget is " <<
+         memTracker_->budget() / (1024 * 1024) << "MB";
+
+      if (streamBudget_ != nullptr)
+      {
+         LOGINFO << "block stream reader peaked at " <<
+            streamBudget_->peak() / (1024 * 1024) << "MB, budget is " <<
+            streamBudget_->budget() / (1024 * 1024) << "MB";
+      }
+   }
+
    /*timeSpent = TIMER_READ_SEC("outputs");
    LOGINFO << "outputs: " << timeSpent << "s";
    
@@ -247,11 +313,48 @@ void BlockchainScanner::processOutputs()
 
    auto preloadBlockDataFiles = [&](ParserBatch* batch)->void
    {
-      if (batch == nullptr)
+      //batches split off a flushed batch already carry their file maps
+      if (batch == nullptr || batch->fileMaps_.size() > 0)
          return;
 
       TIMER_START("preload");
 
+      if (blockDataLoader_.readMode() == BlockFileRead_Stream)
+      {
+         //only read the block ranges this batch covers
+         map<unsigned, pair<size_t, size_t>> fileRanges;
+         for (auto height = batch->start_; height <= batch->end_; height++)
+         {
+            auto header = blockchain_->getHeaderByHeight(height);
+            auto blockEnd = header->getOffset() + header->getBlockSize();
+
+            auto rangeIter = fileRanges.find(header->getBlockFileNum());
+            if (rangeIter == fileRanges.end())
+            {
+               fileRanges.insert(make_pair(header->getBlockFileNum(),
+                  make_pair(header->getOffset(), blockEnd)));
+               continue;
+            }
+
+            auto& range = rangeIter->second;
+            if (header->getOffset() < range.first)
+               range.first = header->getOffset();
+            if (blockEnd > range.second)
+               range.second = blockEnd;
+         }
+
+         for (auto& range_pair : fileRanges)
+         {
+            auto& range = range_pair.second;
+            batch->fileMaps_.insert(make_pair(range_pair.first, 
+               blockDataLoader_.get(range_pair.first,
+                  range.first, range.second - range.first)));
+         }
+
+         TIMER_STOP("preload");
+         return;
+      }
+
       auto file_id = batch->startBlockFileID_;
       while (file_id <= batch->targetBlockFileID_)
       {
@@ -290,8 +393,18 @@ void BlockchainScanner::processOutputs()
 
    preloadBlockDataFiles(batch.get());
 
+   //next batch popped while a flushed batch was being processed
+   unique_ptr<ParserBatch> pendingBatch;
+   bool hasPending = false;
+
    while (1)
    {
+      //hold off until the batches down the pipeline are committed if 
+      //parsed data is over budget
+      TIMER_START("throttling");
+      memTracker_->waitBelowBudget();
+      TIMER_STOP("throttling");
+
       //start processing threads
       vector<thread> thr_vec;
       for (unsigned i = 0; i < totalThreadCount_; i++)
@@ -299,14 +412,22 @@ void BlockchainScanner::processOutputs()
 
       unique_ptr<ParserBatch> nextBatch;
 
-      TIMER_START("throttling");
-      try
+      if (hasPending)
       {
-         nextBatch = move(outputQueue_.pop_front());
+         nextBatch = move(pendingBatch);
+         hasPending = false;
+      }
+      else
+      {
+         TIMER_START("throttling");
+         try
+         {
+            nextBatch = move(outputQueue_.pop_front());
+         }
+         catch (StopBlockingLoop&)
+         {}
+         TIMER_STOP("throttling");
       }
-      catch (StopBlockingLoop&)
-      {}
-      TIMER_STOP("throttling");
 
       TIMER_START("outputs");
 
@@ -320,10 +441,26 @@ void BlockchainScanner::processOutputs()
          if (thr.joinable())
             thr.join();
       }
+
+      //a batch that went over its memory cap is cut short, the blocks
+      //that were not parsed go in a new batch that runs before nextBatch
+      unique_ptr<ParserBatch> remainder;
+      if (batch->flush_.load(memory_order_relaxed))
+         remainder = batch->splitAfterProcessed();
       
       //push first batch for input processing
       inputQueue_.push_back(move(batch));
 
+      if (remainder != nullptr)
+      {
+         pendingBatch = move(nextBatch);
+         hasPending = true;
+
+         batch = move(remainder);
+         TIMER_STOP("outputs");
+         continue;
+      }
+
       //exit loop condition
       if (nextBatch == nullptr)
       {
@@ -463,7 +600,8 @@ shared_ptr<BlockData> BlockchainScanner::getBlockData(
 
    auto bdata = make_shared<BlockData>();
    bdata->deserialize(
-      filemap->getPtr() + blockheader->getOffset(),
+      filemap->getPtr(
+         blockheader->getOffset(), blockheader->getBlockSize()),
       blockheader->getBlockSize(),
       blockheader, getID, false, false);
 
@@ -474,11 +612,16 @@ shared_ptr<BlockData> BlockchainScanner::getBlockData(
 void BlockchainScanner::processOutputsThread(ParserBatch* batch)
 {
    map<unsigned, shared_ptr<BlockData>> blockMap;
-   map<BinaryData, map<unsigned, StoredTxOut>> outputMap;
+   FlatHashMap<32, map<unsigned, StoredTxOut>> outputMap;
    map<BinaryData, map<BinaryData, StoredSubHistory>> sshMap;
 
    while (1)
    {
+      //stop picking up blocks once the batch is over its memory cap,
+      //the rest is split off into a new batch
+      if (batch->flush_.load(memory_order_relaxed))
+         break;
+
       auto currentBlock =
          batch->blockCounter_.fetch_add(1, memory_order_relaxed);
 
@@ -493,6 +636,7 @@ void BlockchainScanner::processOutputsThread(ParserBatch* batch)
       }
 
       blockMap.insert(make_pair(currentBlock, blockdata));
+      size_t memUsage = sizeof(BlockData) + SCAN_MAP_NODE_SIZE;
 
       //TODO: flag isMultisig
       const auto header = blockdata->header();
@@ -504,6 +648,10 @@ void BlockchainScanner::processOutputsThread(ParserBatch* batch)
       for (unsigned i = 0; i < txns.size(); i++)
       {
          const BCTX& txn = *(txns[i].get());
+         memUsage += sizeof(BCTX) + sizeof(shared_ptr<BCTX>) +
+            (txn.txins_.size() + txn.txouts_.size()) * 
+            sizeof(OffsetAndSize);
+
          for (unsigned y = 0; y < txn.txouts_.size(); y++)
          {
             auto& txout = txn.txouts_[y];
@@ -550,6 +698,11 @@ void BlockchainScanner::processOutputsThread(ParserBatch* batch)
                stxo.blockHeight_, stxo.duplicateID_,
                i, y);
 
+            memUsage += sizeof(StoredTxOut) + sizeof(TxIOPair) +
+               sizeof(StoredSubHistory) + txout.second + 
+               txHash.getSize() * 2 + scrAddr.getSize() * 2 +
+               txioKey.getSize() * 2 + SCAN_MAP_NODE_SIZE * 4;
+
             //update utxos_
             auto& stxoHashMap = outputMap[txHash];
             stxoHashMap.insert(make_pair(y, move(stxo)));
@@ -566,13 +719,16 @@ void BlockchainScanner::processOutputsThread(ParserBatch* batch)
             subssh.txioMap_.insert(make_pair(txioKey, move(txio)));
          }
       }
+
+      batch->addMemUsage(memUsage);
    }
 
    //grab batch mutex and merge processed data in
    unique_lock<mutex> lock(batch->mergeMutex_);
 
    batch->blockMap_.insert(blockMap.begin(), blockMap.end());
-   batch->outputMap_.insert(outputMap.begin(), outputMap.end());
+   for (auto& hash_map : outputMap)
+      batch->outputMap_.emplace(hash_map.first, move(hash_map.second));
 
    for (auto& ssh_pair : sshMap)
    {
@@ -613,6 +769,7 @@ void BlockchainScanner::processInputsThread(ParserBatch* batch)
 
       const auto header = blockdata->header();
       auto& txns = blockdata->getTxns();
+      size_t memUsage = 0;
 
       for (unsigned i = 0; i < txns.size(); i++)
       {
@@ -666,10 +823,18 @@ void BlockchainScanner::processInputsThread(ParserBatch* batch)
             txio.setValue(stxo.getValue());
             subssh.txioMap_[txoutkey] = move(txio);
 
+            memUsage += sizeof(StoredTxOut) + sizeof(TxIOPair) +
+               stxo.dataCopy_.getSize() + txinkey.getSize() * 3 +
+               txoutkey.getSize() + SCAN_MAP_NODE_SIZE * 2;
+
             //add to spentTxOuts_
             spentOutputs.push_back(move(stxo));
          }
       }
+
+      //inputs are never cut short, this only feeds the backpressure
+      if (memUsage > 0)
+         batch->addMemUsage(memUsage);
    }
 
    //merge process data into batch
@@ -767,6 +932,9 @@ void BlockchainScanner::writeBlockData()
       map<BinaryData, BinaryWriter> serializedSubSSH;
       map<BinaryData, BinaryWriter> serializedStxo;
 
+      auto stxoEncoding = db_->getValueEncoding(STXO);
+      auto subsshEncoding = db_->getValueEncoding(SUBSSH);
+
       {
          for (auto& ssh : batch->sshMap_)
          {
@@ -781,7 +949,7 @@ void BlockchainScanner::writeBlockData()
 
                auto& bw = serializedSubSSH[subsshkey.getDataRef()];
                subssh.second.serializeDBValue(
-                  bw, db_, ARMORY_DB_BARE);
+                  bw, db_, ARMORY_DB_BARE, subsshEncoding);
             }
          }
 
@@ -791,7 +959,7 @@ void BlockchainScanner::writeBlockData()
             {
                auto& bw = serializedStxo[utxo.second.getDBKey()];
                utxo.second.serializeDBValue(
-                  bw, ARMORY_DB_BARE, true);
+                  bw, ARMORY_DB_BARE, true, stxoEncoding);
             }
          }
       }
@@ -805,7 +973,7 @@ void BlockchainScanner::writeBlockData()
          if (bw.getSize() > 0)
             bw.reset();
          stxo.serializeDBValue(
-            bw, ARMORY_DB_BARE, true);
+            bw, ARMORY_DB_BARE, true, stxoEncoding);
       }
 
       //write data
@@ -814,13 +982,10 @@ void BlockchainScanner::writeBlockData()
          LMDBEnv::Transaction tx;
          db_->beginDBTransaction(&tx, STXO, LMDB::ReadWrite);
 
-         for (auto& stxo : serializedStxo)
-         { 
-            //TODO: dont rewrite utxos, check if they are already in DB first
-            db_->putValue(STXO,
-               stxo.first.getRef(),
-               stxo.second.getDataRef());
-         }
+         //TODO: dont rewrite utxos, check if they are already in DB first
+         db_->putValues(STXO, serializedStxo);
+
+         ownStxoWrites_ += serializedStxo.size();
       }
 
       {
@@ -828,13 +993,7 @@ void BlockchainScanner::writeBlockData()
          LMDBEnv::Transaction tx;
          db_->beginDBTransaction(&tx, SUBSSH, LMDB::ReadWrite);
 
-         for (auto& subssh : serializedSubSSH)
-         {
-            db_->putValue(
-               SUBSSH,
-               subssh.first.getRef(),
-               subssh.second.getDataRef());
-         }
+         db_->putValues(SUBSSH, serializedSubSSH);
 
          //update SUBSSH sdbi
          auto&& sdbi = scrAddrFilter_->getSubSshSDBI();
@@ -847,6 +1006,11 @@ void BlockchainScanner::writeBlockData()
       if (writeHintsThreadId.joinable())
          writeHintsThreadId.join();
 
+      //the input thread is done with utxoMap_ once the top batch is out,
+      //it now matches STXO at the tip
+      if (snapshotAtTip_ && batch->end_ == scanTopHeight_)
+         writeUtxoSnapshot(topheader->getThisHash());
+
       if (batch->start_ != batch->end_)
       {
          LOGINFO << "scanned from block #" << batch->start_
@@ -893,9 +1057,10 @@ void BlockchainScanner::processAndCommitTxHints(ParserBatch* batch)
    };
 
    auto addTxHintMap = 
-      [&](const pair<BinaryData, map<unsigned, StoredTxOut>>& utxomap)->void
+      [&](const FlatHashMap<32, map<unsigned, StoredTxOut>>::value_type& 
+      utxomap)->void
    {
-      auto&& txHashPrefix = utxomap.first.getSliceCopy(0, 4);
+      BinaryData txHashPrefix(utxomap.first.getPtr(), 4);
       StoredTxHints& stxh = txHints[txHashPrefix];
 
       //pull txHint from DB first, don't want to override 
@@ -917,7 +1082,7 @@ void BlockchainScanner::processAndCommitTxHints(ParserBatch* batch)
          return;
 
       bw.put_uint32_t(stxo.parentTxOutCount_);
-      bw.put_BinaryData(utxomap.first);
+      bw.put_BinaryDataRef(utxomap.first.getRef());
    };
 
    {
@@ -929,7 +1094,7 @@ void BlockchainScanner::processAndCommitTxHints(ParserBatch* batch)
          addTxHintMap(utxomap);
       }
 
-      map<BinaryData, map<unsigned, StoredTxOut>> spentTxOutMap;
+      FlatHashMap<32, map<unsigned, StoredTxOut>> spentTxOutMap;
       for (auto& stxo : batch->spentOutputs_)
       {
          auto& stxomap = spentTxOutMap[stxo.spenderHash_];
@@ -969,19 +1134,8 @@ void BlockchainScanner::processAndCommitTxHints(ParserBatch* batch)
       LMDBEnv::Transaction hintdbtx;
       db_->beginDBTransaction(&hintdbtx, TXHINTS, LMDB::ReadWrite);
 
-      for (auto& txhint : serializedHints)
-      {
-         db_->putValue(TXHINTS,
-            txhint.first.getRef(),
-            txhint.second.getDataRef());
-      }
-
-      for (auto& cah : countAndHash)
-      {
-         db_->putValue(TXHINTS,
-            cah.first.getRef(),
-            cah.second.getDataRef());
-      }
+      db_->putValues(TXHINTS, serializedHints);
+      db_->putValues(TXHINTS, countAndHash);
    }
 }
 
@@ -1264,6 +1418,26 @@ void BlockchainScanner::updateSSH(bool force)
 ////////////////////////////////////////////////////////////////////////////////
 void BlockchainScanner::preloadUtxos()
 {
+   //the utxo snapshot is only worth rewriting if utxoMap_ ends up holding
+   //exactly what STXO holds, track the writes this scan doesn't account for
+   preloadWriteCount_ = db_->getStxoWriteCount();
+   ownStxoWrites_ = 0;
+   utxoSetComplete_ = true;
+
+   auto snapshot = db_->getUtxoSnapshot();
+   if (snapshot != nullptr)
+   {
+      snapshot->forEach([this](const UtxoSnapshot::Entry& entry)->void
+      {
+         auto&& stxo = entry.getStoredTxOut();
+         auto& idMap = utxoMap_[entry.txHash_];
+         idMap.insert(make_pair(stxo.txOutIndex_, move(stxo)));
+      });
+
+      LOGINFO << "loaded " << snapshot->count() << " utxos from snapshot";
+      return;
+   }
+
    //TODO: check utxos pulled vs scraddrfilter (to reduce dataset for side scans)
    LMDBEnv::Transaction tx;
    db_->beginDBTransaction(&tx, STXO, LMDB::ReadOnly);
@@ -1281,11 +1455,50 @@ void BlockchainScanner::preloadUtxos()
 
       stxo.parentHash_ = move(db_->getTxHashForLdbKey(
          stxo.getDBKeyOfParentTx(false)));
+      if (stxo.parentHash_.getSize() != 32)
+      {
+         LOGWARN << "missing tx hash for utxo";
+         utxoSetComplete_ = false;
+         continue;
+      }
+
       auto& idMap = utxoMap_[stxo.parentHash_];
       idMap.insert(make_pair(stxo.txOutIndex_, move(stxo)));
    }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void BlockchainScanner::writeUtxoSnapshot(const BinaryData& topHash)
+{
+   if (!utxoSetComplete_)
+      return;
+
+   vector<const StoredTxOut*> utxos;
+   for (auto& idMap : utxoMap_)
+   {
+      for (auto& utxo : idMap.second)
+         utxos.push_back(&utxo.second);
+   }
+
+   if (db_->putUtxoSnapshot(
+      topHash, utxos, preloadWriteCount_ + ownStxoWrites_))
+      LOGINFO << "wrote snapshot of " << utxos.size() << " utxos";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void BlockchainScanner::snapshotUtxos()
+{
+   //no scan, load the utxo set as one would and write it for the block 
+   //STXO was last scanned up to
+   preloadUtxos();
+
+   auto&& sdbi = scrAddrFilter_->getSubSshSDBI();
+   if (sdbi.topScannedBlkHash_.getSize() != 32)
+      return;
+
+   writeUtxoSnapshot(sdbi.topScannedBlkHash_);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void BlockchainScanner::undo(Blockchain::ReorganizationState& reorgState)
 {
@@ -1530,7 +1743,8 @@ void BlockchainScanner::undo(Blockchain::ReorganizationState& reorgState)
 
 ////////////////////////////////////////////////////////////////////////////////
 void BlockchainScanner::getFilterHitsThread(
-   const set<BinaryData>& hashSet,
+   const vector<BinaryData>& hashVec,
+   const TxFilterPrefixSet<TxFilterType>& prefixSet,
    atomic<int>& counter,
    map<uint32_t, set<TxFilterResults>>& resultMap)
 {
@@ -1550,19 +1764,19 @@ void BlockchainScanner::getFilterHitsThread(
          try
          {
             auto&& pool = db_->getFilterPoolRefForFileNum<TxFilterType>(fileNum);
-            for (auto& hash : hashSet)
+            auto&& hashHits = pool.compareBatch(hashVec, prefixSet);
+
+            for (unsigned i = 0; i < hashHits.size(); i++)
             {
-               auto&& blockKeys = pool.compare(hash);
-               if (blockKeys.size() > 0)
-               {
-                  auto& fileNumEntry = localResults[fileNum];
+               if (hashHits[i].size() == 0)
+                  continue;
 
-                  TxFilterResults filterResult;
-                  filterResult.hash_ = hash;
-                  filterResult.filterHits_ = move(blockKeys);
+               TxFilterResults filterResult;
+               filterResult.hash_ = hashVec[i];
+               filterResult.filterHits_ = move(hashHits[i]);
 
-                  fileNumEntry.insert(move(filterResult));
-               }
+               auto& fileNumEntry = localResults[fileNum];
+               fileNumEntry.insert(move(filterResult));
             }
          }
          catch (runtime_error&)
@@ -1592,8 +1806,10 @@ void BlockchainScanner::processFilterHitsThread(
    auto resolveHashes = 
       [&](uint32_t fileNum,
       map<uint32_t, set<const TxFilterResults*>> filterHit,
-      set<BinaryData>& hashSet)->void
+      const PersistentSet<BinaryData>& hashSet)->void
    {
+      //the snapshot is shared with other threads, track what we resolve
+      set<BinaryData> resolvedHashes;
       auto fileptr = blockDataLoader_.get(fileNum);
       
       for (auto& blockkey : filterHit)
@@ -1632,7 +1848,7 @@ void BlockchainScanner::processFilterHitsThread(
             continue;
          }
             
-         auto txns = bdata.getTxns();
+         auto& txns = bdata.getTxns();
 
          for (auto& filterhit : filterSet)
          {
@@ -1650,31 +1866,23 @@ void BlockchainScanner::processFilterHitsThread(
                auto& txn = txns[txid];
                auto& txnHash = txn->getHash();
 
-               auto hashIter = hashSet.begin();
+               if (hashSet.find(txnHash) == hashSet.end() ||
+                  resolvedHashes.find(txnHash) != resolvedHashes.end())
+                  continue;
 
-               while (hashIter != hashSet.end())
-               {
-                  if (txnHash == *hashIter)
-                  {
-                     auto&& countAndHash = WRITE_UINT32_LE(txids.size());
-                     countAndHash.append(txnHash);
-                     result[countAndHash] = move(
-                        DBUtils::getBlkDataKeyNoPrefix(
-                        headerPtr->getBlockHeight(),
-                        headerPtr->getDuplicateID(),
-                        txid));
-
-                     missingHashes.erase(txnHash);
-                     auto count = missingHashes.size();
-                     prog(count);
-
-                     hashSet.erase(hashIter++);
-                     continue;
-                  }
+               auto&& countAndHash = WRITE_UINT32_LE(txids.size());
+               countAndHash.append(txnHash);
+               result[countAndHash] = move(
+                  DBUtils::getBlkDataKeyNoPrefix(
+                  headerPtr->getBlockHeight(),
+                  headerPtr->getDuplicateID(),
+                  txid));
 
-                  ++hashIter;
-               }
+               missingHashes.erase(txnHash);
+               auto count = missingHashes.size();
+               prog(count);
 
+               resolvedHashes.insert(txnHash);
             }
          }
       }
@@ -1793,9 +2001,14 @@ bool BlockchainScanner::resolveTxHashes()
    vector<thread> filterThreads;
    map<uint32_t, set<TxFilterResults>> resultMap;
 
+   //the batch is the same for every pool, build the prefix set once
+   vector<BinaryData> hashVec(missingHashes.begin(), missingHashes.end());
+   TxFilterPool<TxFilterType>::checkHashSizes(hashVec);
+   TxFilterPrefixSet<TxFilterType> prefixSet(hashVec);
+
    auto filterThr = [&](void)->void
    {
-      getFilterHitsThread(missingHashes, counter, resultMap);
+      getFilterHitsThread(hashVec, prefixSet, counter, resultMap);
    };
 
    for (unsigned i = 1; i < totalThreadCount_; i++)
@@ -16,6 +16,8 @@
 #include "Progress.h"
 #include "bdmenums.h"
 #include "ThreadSafeClasses.h"
+#include "FlatHashMap.h"
+#include "UtxoSnapshot.h"
 
 #include <future>
 #include <atomic>
@@ -34,6 +36,71 @@ public:
    { }
 };
 
+////////////////////////////////////////////////////////////////////////////////
+class ScanMemoryTracker
+{
+   /***
+   Tallies the estimated size of the data parsed by the batches in the scan
+   pipeline (blocks, outputs, ssh, spent outputs). Batches add to it as they
+   grow and take their share out when they are committed.
+
+   The output stage waits on it before starting a new batch, so a slow 
+   writer holds back parsing instead of letting batches pile up in RAM.
+   ***/
+
+private:
+   mutex mu_;
+   condition_variable cv_;
+
+   const size_t budget_;
+   size_t current_ = 0;
+   size_t peak_ = 0;
+
+public:
+   ScanMemoryTracker(size_t budget) :
+      budget_(budget)
+   {}
+
+   void add(size_t bytes)
+   {
+      unique_lock<mutex> lock(mu_);
+      current_ += bytes;
+      if (current_ > peak_)
+         peak_ = current_;
+   }
+
+   void remove(size_t bytes)
+   {
+      {
+         unique_lock<mutex> lock(mu_);
+         current_ -= min(bytes, current_);
+      }
+
+      cv_.notify_all();
+   }
+
+   void waitBelowBudget(void)
+   {
+      unique_lock<mutex> lock(mu_);
+      while (current_ > budget_)
+         cv_.wait(lock);
+   }
+
+   size_t budget(void) const { return budget_; }
+
+   size_t current(void)
+   {
+      unique_lock<mutex> lock(mu_);
+      return current_;
+   }
+
+   size_t peak(void)
+   {
+      unique_lock<mutex> lock(mu_);
+      return peak_;
+   }
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 struct ParserBatch
 {
@@ -44,13 +111,13 @@ public:
    mutex mergeMutex_;
 
    const unsigned start_;
-   const unsigned end_;
+   unsigned end_;
 
    const unsigned startBlockFileID_;
    const unsigned targetBlockFileID_;
 
    map<unsigned, shared_ptr<BlockData>> blockMap_;
-   map<BinaryData, map<unsigned, StoredTxOut>> outputMap_;
+   FlatHashMap<32, map<unsigned, StoredTxOut>> outputMap_;
    map<BinaryData, map<BinaryData, StoredSubHistory>> sshMap_;
    vector<StoredTxOut> spentOutputs_;
 
@@ -58,6 +125,16 @@ public:
    promise<bool> completedPromise_;
    unsigned count_;
 
+   //stream reader budget held by this batch, if any
+   shared_ptr<BlockStreamBudget> streamBudget_;
+   size_t budgetBytes_ = 0;
+
+   //parsed data size estimate, output parsing stops early past memCap_
+   shared_ptr<ScanMemoryTracker> memTracker_;
+   atomic<size_t> memUsage_;
+   size_t memCap_ = SIZE_MAX;
+   atomic<bool> flush_;
+
 public:
    ParserBatch(unsigned start, unsigned end, 
       unsigned startID, unsigned endID,
@@ -70,7 +147,32 @@ public:
          throw runtime_error("end > start");
 
       blockCounter_.store(start_, memory_order_relaxed);
+      memUsage_.store(0, memory_order_relaxed);
+      flush_.store(false, memory_order_relaxed);
+   }
+
+   ~ParserBatch(void)
+   {
+      if (streamBudget_ != nullptr)
+         streamBudget_->release(budgetBytes_);
+
+      if (memTracker_ != nullptr)
+         memTracker_->remove(memUsage_.load(memory_order_relaxed));
+   }
+
+   void addMemUsage(size_t bytes)
+   {
+      auto total = memUsage_.fetch_add(bytes, memory_order_relaxed) + bytes;
+      if (memTracker_ != nullptr)
+         memTracker_->add(bytes);
+
+      if (total > memCap_)
+         flush_.store(true, memory_order_relaxed);
    }
+
+   //cut the batch after the last block processed by the output stage, 
+   //returns the rest as a new batch or nullptr if there is nothing left
+   unique_ptr<ParserBatch> splitAfterProcessed(void);
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -95,6 +197,9 @@ private:
    LMDBBlockDatabase* db_;
    ScrAddrFilter* scrAddrFilter_;
    BlockDataLoader blockDataLoader_;
+   shared_ptr<BlockStreamBudget> streamBudget_;
+   shared_ptr<ScanMemoryTracker> memTracker_;
+   size_t batchMemCap_;
 
    const unsigned totalThreadCount_;
    const unsigned writeQueueDepth_;
@@ -107,9 +212,16 @@ private:
    bool reportProgress_ = false;
 
    //only for relevant utxos
-   map<BinaryData, map<unsigned, StoredTxOut>> utxoMap_;
+   FlatHashMap<32, map<unsigned, StoredTxOut>> utxoMap_;
+
+   //STXO write count seen by preloadUtxos, and the writes this scan added
+   uint64_t preloadWriteCount_ = 0;
+   uint64_t ownStxoWrites_ = 0;
+   bool utxoSetComplete_ = false;
+   bool snapshotAtTip_ = false;
 
    unsigned startAt_ = 0;
+   unsigned scanTopHeight_ = UINT32_MAX;
 
    mutex resolverMutex_;
 
@@ -121,11 +233,13 @@ private:
    void writeBlockData(void);
    void processAndCommitTxHints(ParserBatch*);
    void preloadUtxos(void);
+   void writeUtxoSnapshot(const BinaryData&);
 
    int32_t check_merkle(int32_t startHeight);
 
    void getFilterHitsThread(
-      const set<BinaryData>& hashSet,
+      const vector<BinaryData>& hashVec,
+      const TxFilterPrefixSet<TxFilterType>& prefixSet,
       atomic<int>& counter,
       map<uint32_t, set<TxFilterResults>>& resultMap);
 
@@ -151,25 +265,45 @@ public:
       ScrAddrFilter* saf,
       BlockFiles& bf,
       unsigned threadcount, unsigned queue_depth, 
-      ProgressCallback prg, bool reportProgress) :
+      ProgressCallback prg, bool reportProgress,
+      BlockFileReadMode readMode, size_t streamBudget,
+      size_t memPerRamLevel) :
       blockchain_(bc), db_(db), scrAddrFilter_(saf),
       totalThreadCount_(threadcount), writeQueueDepth_(queue_depth),
-      blockDataLoader_(bf.folderPath()),
+      blockDataLoader_(bf.folderPath(), readMode),
       progress_(prg), reportProgress_(reportProgress),
       totalBlockFileCount_(bf.fileCount())
-   {}
+   {
+      if (readMode == BlockFileRead_Stream)
+         streamBudget_ = make_shared<BlockStreamBudget>(streamBudget);
+
+      //queue_depth is the ram usage level, each level gets one batch worth
+      //of parsed data
+      batchMemCap_ = memPerRamLevel;
+      memTracker_ = make_shared<ScanMemoryTracker>(
+         memPerRamLevel * max(queue_depth, 1U));
+   }
 
    void scan(int32_t startHeight);
    void scan_nocheck(int32_t startHeight);
 
    void undo(Blockchain::ReorganizationState& reorgState);
    void updateSSH(bool);
+
+   //write the utxo snapshot once the scan reaches the tip
+   void enableUtxoSnapshot(void) { snapshotAtTip_ = true; }
+   void snapshotUtxos(void);
    bool resolveTxHashes();
 
    const BinaryData& getTopScannedBlockHash(void) const
    {
       return topScannedBlockHash_;
    }
+
+   size_t getPeakScanMemory(void) const
+   {
+      return memTracker_->peak();
+   }
 };
 
 #endif
\ No newline at end of file
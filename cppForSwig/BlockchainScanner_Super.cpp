@@ -330,7 +330,8 @@ void BlockchainScanner_Super::processInputs()
                bw_pair.first.put_BinaryData(subssh.first);
 
                subssh.second.serializeDBValue(
-                  bw_pair.second, db_, ARMORY_DB_SUPER);
+                  bw_pair.second, db_, ARMORY_DB_SUPER, 
+                  db_->getValueEncoding(SUBSSH));
 
                ++subsshCount;
             }
@@ -846,28 +847,10 @@ void BlockchainScanner_Super::updateSSH(bool force)
    if (!withUpdateSshHints_)
       LOGINFO << "updating SSH";
 
-   auto processSshLambda = [this, scanFrom](void)->void
-   {
-      updateSSHThread(scanFrom);
-   };
-
-   auto temp_db = SecureBinaryData().GenerateRandom(8).toHexStr();
-   auto writeLambda = [this, &temp_db](void)->void
-   {
-      putSSH(temp_db);
-   };
-
-   if (reportProgress_)
-      progress_(BDMPhase_Balance, 0, 0, 0);
-
-   thread writeThr = thread(writeLambda);
-
-   vector<thread> processSshVec;
+   //key ranges, in key order
+   vector<pair<BinaryData, BinaryData>> sshBounds;
    if (!withUpdateSshHints_)
    {
-      for (unsigned i = 0; i < totalThreadCount_; i++)
-         processSshVec.push_back(thread(processSshLambda));
-
       set<uint8_t> special_bytes;
       special_bytes.insert(BlockDataManagerConfig::getPubkeyHashPrefix());
       special_bytes.insert(BlockDataManagerConfig::getScriptHashPrefix());
@@ -889,7 +872,7 @@ void BlockchainScanner_Super::updateSSH(bool force)
                bw_last.put_uint8_t(0xFF);
 
                auto&& bounds = make_pair(bw_first.getData(), bw_last.getData());
-               sshBoundsQueue_.push_back(move(bounds));
+               sshBounds.push_back(move(bounds));
             }
 
             continue;
@@ -906,13 +889,11 @@ void BlockchainScanner_Super::updateSSH(bool force)
 
          auto&& bounds = make_pair(bw_first.getData(), bw_last.getData());
 
-         sshBoundsQueue_.push_back(move(bounds));
+         sshBounds.push_back(move(bounds));
       }
    }
    else
    {
-      processSshVec.push_back(thread(processSshLambda));
-
       for (auto& ssh : updateSshHints_)
       {
          pair<BinaryData, BinaryData> bounds;
@@ -924,10 +905,36 @@ void BlockchainScanner_Super::updateSSH(bool force)
          bounds.first = bw_first.getData();
          bounds.second = bw_first.getData();
 
-         sshBoundsQueue_.push_back(move(bounds));
+         sshBounds.push_back(move(bounds));
       }
    }
 
+   auto processSshLambda = [this, scanFrom](void)->void
+   {
+      updateSSHThread(scanFrom);
+   };
+
+   unsigned rangeCount = sshBounds.size();
+   auto temp_db = SecureBinaryData().GenerateRandom(8).toHexStr();
+   auto writeLambda = [this, &temp_db, rangeCount](void)->void
+   {
+      putSSH(temp_db, rangeCount);
+   };
+
+   if (reportProgress_)
+      progress_(BDMPhase_Balance, 0, UINT32_MAX, 0);
+
+   auto aggregateStart = chrono::steady_clock::now();
+   thread writeThr = thread(writeLambda);
+
+   //workers grab the ranges in order, each range goes to a single worker
+   vector<thread> processSshVec;
+   unsigned workerCount = withUpdateSshHints_ ? 1 : totalThreadCount_;
+   for (unsigned i = 0; i < workerCount; i++)
+      processSshVec.push_back(thread(processSshLambda));
+
+   for (unsigned i = 0; i < sshBounds.size(); i++)
+      sshBoundsQueue_.push_back(make_pair(i, move(sshBounds[i])));
 
    //wait on process threads
    sshBoundsQueue_.completed();
@@ -938,11 +945,16 @@ void BlockchainScanner_Super::updateSSH(bool force)
          thr.join();
    }
 
+   auto aggregateTime = chrono::duration<double>(
+      chrono::steady_clock::now() - aggregateStart).count();
+
    //wait on write thread
    serializedSshQueue_.completed();
    if (writeThr.joinable())
       writeThr.join();
 
+   auto mergeStart = chrono::steady_clock::now();
+
    //merge in temp db dataset
    if (sshSdbi.topBlkHgt_ <= 0)
    {
@@ -1017,14 +1029,20 @@ void BlockchainScanner_Super::updateSSH(bool force)
       db_->putStoredDBInfo(SSH, sshSdbi, 0);
    }
 
+   auto mergeTime = chrono::duration<double>(
+      chrono::steady_clock::now() - mergeStart).count();
+
    TIMER_STOP("updateSSH");
    auto timeSpent = TIMER_READ_SEC("updateSSH");
    if (timeSpent >= 5)
-      LOGINFO << "updated SSH in " << timeSpent << "s";
+   {
+      LOGINFO << "updated SSH in " << timeSpent << "s (aggregate: " <<
+         aggregateTime << "s, merge: " << mergeTime << "s)";
+   }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void BlockchainScanner_Super::putSSH(const string& dbname)
+void BlockchainScanner_Super::putSSH(const string& dbname, unsigned rangeCount)
 {
    //create temp ssh db
    LMDBEnv dbEnv;
@@ -1036,39 +1054,155 @@ void BlockchainScanner_Super::putSSH(const string& dbname)
       db.open(&dbEnv, db_->getDbName(SSH));
    }
 
-   //loop over serialized ssh queue
+   //runs are written in key order so they can be appended to the db. Runs 
+   //of ranges ahead of the next one wait here, up to one commit worth of 
+   //data (runs are COMMIT_SSH_SIZE / totalThreadCount_ at most)
+   map<unsigned, vector<unique_ptr<SshRun>>> pendingRuns;
+   size_t pendingCount = 0;
+   const size_t maxPending = max(totalThreadCount_, 1U);
+
+   //ranges that got written out of order in full
+   set<unsigned> flushedRanges;
+   unsigned nextRange = 0;
+
+   ProgressCalculator calc(max(rangeCount, 1U));
+   calc.init(0);
+
+   uint64_t appendCount = 0, insertCount = 0, byteCount = 0;
+   chrono::duration<double> writeTime(0);
+
+   auto writeRun = [&](SshRun& run)->void
+   {
+      if (run.sshMap_->size() == 0)
+         return;
+
+      auto start = chrono::steady_clock::now();
+      LMDBEnv::Transaction tx(&dbEnv, LMDB::ReadWrite);
+      for (auto& ssh_pair : *run.sshMap_)
+      {
+         CharacterArrayRef key(
+            ssh_pair.first.getSize(), ssh_pair.first.getPtr());
+         CharacterArrayRef data(
+            ssh_pair.second.getSize(), ssh_pair.second.getData().getPtr());
+
+         //ranges overlapping on their edges break the order, put those 
+         //where they belong
+         if (db.append(key, data))
+         {
+            ++appendCount;
+         }
+         else
+         {
+            db.insert(key, data);
+            ++insertCount;
+         }
+
+         byteCount += key.len + data.len;
+      }
+
+      writeTime += chrono::steady_clock::now() - start;
+   };
+
+   auto flushPending = [&](void)->void
+   {
+      //a slow range holds the others back, insert what is waiting rather
+      //than let it grow unbounded
+      for (auto& pendingPair : pendingRuns)
+      {
+         for (auto& pendingRun : pendingPair.second)
+         {
+            writeRun(*pendingRun);
+            if (pendingRun->lastRun_)
+               flushedRanges.insert(pendingPair.first);
+         }
+      }
+
+      pendingRuns.clear();
+      pendingCount = 0;
+   };
+
+   auto rangeCompleted = [&](void)->void
+   {
+      ++nextRange;
 
+      if (!reportProgress_)
+         return;
+
+      calc.advance(nextRange);
+      progress_(BDMPhase_Balance,
+         calc.fractionCompleted(), calc.remainingSeconds(), nextRange);
+   };
+
+   //loop over serialized ssh queue
    while (1)
    {
-      unique_ptr<map<BinaryData, BinaryWriter>> sshMap;
+      unique_ptr<SshRun> run;
 
       try
       {
-         sshMap = move(serializedSshQueue_.pop_front());
+         run = move(serializedSshQueue_.pop_front());
       }
       catch (StopBlockingLoop&)
       {
          break;
       }
 
-      if (sshMap->size() == 0)
+      if (run->rangeId_ != nextRange)
+      {
+         pendingRuns[run->rangeId_].push_back(move(run));
+         if (++pendingCount > maxPending)
+            flushPending();
+         continue;
+      }
+
+      writeRun(*run);
+      if (!run->lastRun_)
          continue;
 
-      LMDBEnv::Transaction tx(&dbEnv, LMDB::ReadWrite);
-      for (auto& ssh_pair : *sshMap)
+      rangeCompleted();
+
+      //flush the waiting ranges that are next in line
+      while (1)
       {
-         CharacterArrayRef key(
-            ssh_pair.first.getSize(), ssh_pair.first.getPtr());
-         CharacterArrayRef data(
-            ssh_pair.second.getSize(), ssh_pair.second.getData().getPtr());
+         bool complete = flushedRanges.erase(nextRange) > 0;
+
+         auto pendingIter = pendingRuns.find(nextRange);
+         if (pendingIter != pendingRuns.end())
+         {
+            for (auto& pendingRun : pendingIter->second)
+            {
+               writeRun(*pendingRun);
+               complete |= pendingRun->lastRun_;
+            }
+
+            pendingCount -= pendingIter->second.size();
+            pendingRuns.erase(pendingIter);
+         }
 
-         db.insert(key, data);
+         if (!complete)
+            break;
+
+         rangeCompleted();
       }
    }
 
+   //only left with runs if a range never completed
+   for (auto& pendingPair : pendingRuns)
+   {
+      for (auto& pendingRun : pendingPair.second)
+         writeRun(*pendingRun);
+   }
+
    //close db
    db.close();
    dbEnv.close();
+
+   if (writeTime.count() >= 1)
+   {
+      LOGINFO << "wrote " << appendCount + insertCount << " ssh entries (" <<
+         insertCount << " out of order) in " << writeTime.count() << "s, " <<
+         byteCount / (1024.0 * 1024.0) / writeTime.count() << " MB/s";
+   }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1098,10 +1232,13 @@ void BlockchainScanner_Super::updateSSHThread(int scanFrom)
 
    while (1)
    {
+      unsigned rangeId;
       pair<BinaryData, BinaryData> bounds;
       try
       {
-         bounds = move(sshBoundsQueue_.pop_front());
+         auto&& range = sshBoundsQueue_.pop_front();
+         rangeId = range.first;
+         bounds = move(range.second);
       }
       catch (StopBlockingLoop&)
       {
@@ -1118,7 +1255,12 @@ void BlockchainScanner_Super::updateSSHThread(int scanFrom)
 
       auto sshIter = SshIterator(db_, bounds);
       if (!sshIter.isValid())
+      {
+         //the writer waits on every range, even empty ones
+         serializedSshQueue_.push_back(make_unique<SshRun>(
+            rangeId, true, move(serializedSshMap)));
          continue;
+      }
 
       while (1)
       {
@@ -1146,7 +1288,8 @@ void BlockchainScanner_Super::updateSSHThread(int scanFrom)
 
             if (tally > size_per_batch)
             {
-               serializedSshQueue_.push_back(move(serializedSshMap));
+               serializedSshQueue_.push_back(make_unique<SshRun>(
+                  rangeId, false, move(serializedSshMap)));
                serializedSshMap = 
                   move(make_unique<map<BinaryData, BinaryWriter>>());
                tally = 0;
@@ -1249,8 +1392,8 @@ void BlockchainScanner_Super::updateSSHThread(int scanFrom)
          }
       } 
 
-      if (serializedSshMap->size() > 0)
-         serializedSshQueue_.push_back(move(serializedSshMap));
+      serializedSshQueue_.push_back(make_unique<SshRun>(
+         rangeId, true, move(serializedSshMap)));
    }
 }
 
@@ -62,6 +62,26 @@ public:
    }
 };
 
+////////////////////////////////////////////////////////////////////////////////
+struct SshRun
+{
+   /***
+   Serialized ssh entries out of one updateSSH key range. Ranges are numbered
+   in key order and a single worker walks each range, so the runs of a range
+   come out sorted and in order. The writer puts the ranges back in order to
+   append everything to the temp ssh db.
+   ***/
+
+   const unsigned rangeId_;
+   const bool lastRun_;
+   unique_ptr<map<BinaryData, BinaryWriter>> sshMap_;
+
+   SshRun(unsigned rangeId, bool lastRun,
+      unique_ptr<map<BinaryData, BinaryWriter>> sshMap) :
+      rangeId_(rangeId), lastRun_(lastRun), sshMap_(move(sshMap))
+   {}
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 class SshIterator
 {
@@ -141,8 +161,8 @@ private:
    BlockingStack<unique_ptr<ParserBatch_Super>> inputQueue_;
    BlockingStack<unique_ptr<ParserBatch_Super>> commitQueue_;
    
-   BlockingStack<pair<BinaryData, BinaryData>>  sshBoundsQueue_;
-   BlockingStack<unique_ptr<map<BinaryData, BinaryWriter>>> serializedSshQueue_;
+   BlockingStack<pair<unsigned, pair<BinaryData, BinaryData>>> sshBoundsQueue_;
+   BlockingStack<unique_ptr<SshRun>> serializedSshQueue_;
 
    set<BinaryData> updateSshHints_;
 
@@ -170,7 +190,7 @@ private:
    void processInputsThread(ParserBatch_Super*);
 
    void updateSSHThread(int);
-   void putSSH(const string& dbname);
+   void putSSH(const string& dbname, unsigned rangeCount);
    void putSpentness(ParserBatch_Super*);
 
    StoredTxOut getStxoByHash(
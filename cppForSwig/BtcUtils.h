@@ -34,6 +34,7 @@
 #include "integer.h"
 #include "ripemd.h"
 #include "UniversalTimer.h"
+#include "SHA256d.h"
 #include "log.h"
 
 class LedgerEntryData;
@@ -488,11 +489,10 @@ public:
                          size_t len, 
                          BinaryData& hashOutput)
    {
-      CryptoPP::SHA256 sha256_;
       if (hashOutput.getSize() != 32)
          hashOutput.resize(32);
 
-      sha256_.CalculateDigest(hashOutput.getPtr(), data, len);
+      SHA256d::getSha256(data, len, hashOutput.getPtr());
    }
    
    /////////////////////////////////////////////////////////////////////////////
@@ -508,12 +508,10 @@ public:
                           size_t          nBytes,
                           BinaryData &    hashOutput)
    {
-      CryptoPP::SHA256 sha256_;
       if(hashOutput.getSize() != 32)
          hashOutput.resize(32);
 
-      sha256_.CalculateDigest(hashOutput.getPtr(), strToHash, nBytes);
-      sha256_.CalculateDigest(hashOutput.getPtr(), hashOutput.getPtr(), 32);
+      SHA256d::getHash256(strToHash, nBytes, hashOutput.getPtr());
    }
 
    /////////////////////////////////////////////////////////////////////////////
@@ -522,21 +520,15 @@ public:
                           uint32_t        nBytes,
                           BinaryData &    hashOutput)
    {
-      CryptoPP::SHA256 sha256_;
-
-      sha256_.CalculateDigest(hashOutput.getPtr(), strToHash, nBytes);
-      sha256_.CalculateDigest(hashOutput.getPtr(), hashOutput.getPtr(), 32);
+      SHA256d::getHash256(strToHash, nBytes, hashOutput.getPtr());
    }
 
    /////////////////////////////////////////////////////////////////////////////
    static BinaryData getHash256(uint8_t const * strToHash,
                                 uint32_t        nBytes)
    {
-      CryptoPP::SHA256 sha256_;
-
       BinaryData hashOutput(32);
-      sha256_.CalculateDigest(hashOutput.getPtr(), strToHash, nBytes);
-      sha256_.CalculateDigest(hashOutput.getPtr(), hashOutput.getPtr(), 32);
+      SHA256d::getHash256(strToHash, nBytes, hashOutput.getPtr());
       return hashOutput;
    }
 
@@ -657,8 +649,45 @@ public:
    /////////////////////////////////////////////////////////////////////////////
    static BinaryData calculateMerkleRoot(vector<BinaryData> const & txhashlist)
    {
-      vector<BinaryData> mtree = calculateMerkleTree(txhashlist);
-      return mtree[mtree.size()-1];
+      BinaryData flatHashes(txhashlist.size() * 32);
+      for (size_t i = 0; i < txhashlist.size(); i++)
+         txhashlist[i].copyTo(flatHashes.getPtr() + i * 32, 32);
+
+      return calculateMerkleRoot(flatHashes.getPtr(), txhashlist.size());
+   }
+
+   /////////////////////////////////////////////////////////////////////////////
+   static BinaryData calculateMerkleRoot(const uint8_t* hashes, size_t count)
+   {
+      /***
+      hashes points to count contiguous 32 byte hashes. Each level is 
+      built in place in a scratch buffer: pairs are laid out as 64 byte
+      messages, which get double hashed in one batch, back into the head
+      of the buffer.
+      ***/
+
+      if (count == 0)
+         return BinaryData();
+
+      //+1 slot to duplicate the last hash of odd levels
+      BinaryData scratch((count + 1) * 32);
+      memcpy(scratch.getPtr(), hashes, count * 32);
+
+      auto ptr = scratch.getPtr();
+      while (count > 1)
+      {
+         if (count % 2)
+         {
+            memcpy(ptr + count * 32, ptr + (count - 1) * 32, 32);
+            ++count;
+         }
+
+         count /= 2;
+         SHA256d::getHash256_64(ptr, ptr, count);
+      }
+
+      scratch.resize(32);
+      return scratch;
    }
 
    /////////////////////////////////////////////////////////////////////////////
@@ -668,7 +697,6 @@ public:
       // and copy the result to the right size list afterwards
       size_t numTx = txhashlist.size();
       vector<BinaryData> merkleTree(3*numTx);
-      CryptoPP::SHA256 sha256_;
       BinaryData hashInput(64);
       BinaryData hashOutput(32);
    
@@ -696,8 +724,8 @@ public:
                merkleTree[nextLevelStart-1].copyTo(half2Ptr, 32);
             }
             
-            sha256_.CalculateDigest(hashOutput.getPtr(), hashInput.getPtr(),  64);
-            sha256_.CalculateDigest(hashOutput.getPtr(), hashOutput.getPtr(), 32);
+            SHA256d::getHash256_64(
+               hashInput.getPtr(), hashOutput.getPtr(), 1);
             merkleTree[nextLevelStart+j] = hashOutput;
          }
          levelSize = (levelSize+1)/2;
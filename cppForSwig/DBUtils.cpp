@@ -130,6 +130,7 @@ string DBUtils::getPrefixName(DB_PREFIX pref)
    case DB_PREFIX_TXDATA:    return string("TXDATA");
    case DB_PREFIX_SCRIPT:    return string("SCRIPT");
    case DB_PREFIX_TXHINTS:   return string("TXHINTS");
+   case DB_PREFIX_TXHASH:    return string("TXHASH");
    case DB_PREFIX_TRIENODES: return string("TRIENODES");
    case DB_PREFIX_HEADHASH:  return string("HEADHASH");
    case DB_PREFIX_HEADHGT:   return string("HEADHGT");
@@ -269,6 +270,17 @@ BinaryData DBUtils::getFilterPoolKey(uint32_t filenum)
    return WRITE_UINT32_BE(bucketKey);
 }
 
+/////////////////////////////////////////////////////////////////////////////
+BinaryData DBUtils::getFilterPoolAppendKey(uint32_t filenum, uint32_t blockId)
+{
+   //pool key followed by the block id, appended filters sort right after 
+   //the compacted pool of their blk file
+   BinaryWriter bw(8);
+   bw.put_BinaryData(getFilterPoolKey(filenum));
+   bw.put_uint32_t(blockId, BE);
+   return bw.getData();
+}
+
 /////////////////////////////////////////////////////////////////////////////
 BinaryData DBUtils::getMissingHashesKey(uint32_t id)
 {
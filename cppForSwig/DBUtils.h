@@ -37,7 +37,8 @@ enum DB_PREFIX
    DB_PREFIX_COUNT,
    DB_PREFIX_ZCDATA,
    DB_PREFIX_POOL,
-   DB_PREFIX_MISSING_HASHES
+   DB_PREFIX_MISSING_HASHES,
+   DB_PREFIX_TXHASH
 };
 
 class DBUtils
@@ -134,6 +135,7 @@ public:
       bool rewindWhenDone = false);
 
    static BinaryData getFilterPoolKey(uint32_t filenum);
+   static BinaryData getFilterPoolAppendKey(uint32_t filenum, uint32_t blockId);
    static BinaryData getMissingHashesKey(uint32_t id);
 
    static bool fileExists(const string& path, int mode);
@@ -264,6 +264,55 @@ IntType IntType::deserialize(BinaryRefReader& brr)
    return IntType(brr.get_var_int());
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//
+// BinaryWireFrame
+//
+///////////////////////////////////////////////////////////////////////////////
+WireEncoding BinaryWireFrame::getEncoding(const string& msg)
+{
+   if (msg.size() > 0 && (uint8_t)msg[0] == WIRE_BINARY_MAGIC)
+      return WireBinary;
+
+   return WireHex;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void BinaryWireFrame::frame(const BinaryDataRef& payload, string& out)
+{
+   if (payload.getSize() > UINT32_MAX)
+      throw runtime_error("payload is too large for binary frame");
+
+   uint32_t len = payload.getSize();
+   char header[WIRE_BINARY_HEADER_SIZE];
+   header[0] = (char)WIRE_BINARY_MAGIC;
+   for (unsigned i = 0; i < 4; i++)
+      header[i + 1] = (char)((len >> (i * 8)) & 0xFF);
+
+   out.clear();
+   out.reserve(WIRE_BINARY_HEADER_SIZE + len);
+   out.append(header, WIRE_BINARY_HEADER_SIZE);
+   out.append((const char*)payload.getPtr(), len);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+BinaryDataRef BinaryWireFrame::getPayload(const string& msg)
+{
+   if (msg.size() < WIRE_BINARY_HEADER_SIZE || 
+      (uint8_t)msg[0] != WIRE_BINARY_MAGIC)
+      throw runtime_error("invalid binary frame");
+
+   uint32_t len = 0;
+   for (unsigned i = 0; i < 4; i++)
+      len |= (uint32_t)(uint8_t)msg[i + 1] << (i * 8);
+
+   if (len != msg.size() - WIRE_BINARY_HEADER_SIZE)
+      throw runtime_error("binary frame length mismatch");
+
+   return BinaryDataRef(
+      (const uint8_t*)msg.c_str() + WIRE_BINARY_HEADER_SIZE, len);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // Arguments
@@ -291,25 +340,42 @@ void Arguments::init()
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-const string& Arguments::serialize()
+const string& Arguments::serialize(WireEncoding encoding)
 {
-   if (argStr_.size() != 0)
+   if (argStr_.size() != 0 && encoding_ == encoding)
       return argStr_;
 
    BinaryWriter bw;
-   for (auto& arg : argData_)
-      arg->serialize(bw);
+   if (argData_.size() != 0)
+   {
+      for (auto& arg : argData_)
+         arg->serialize(bw);
+   }
+   else
+   {
+      //parsed from the other encoding, convert the raw data
+      bw.put_BinaryData(rawBinary_);
+   }
 
    auto& bdser = bw.getData();
-   argStr_ = move(bdser.toHexStr());
+   if (encoding == WireBinary)
+      BinaryWireFrame::frame(bdser.getRef(), argStr_);
+   else
+      argStr_ = move(bdser.toHexStr());
 
+   encoding_ = encoding;
    return argStr_;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 void Arguments::setRawData()
 {
-   rawBinary_ = READHEX(argStr_);
+   encoding_ = BinaryWireFrame::getEncoding(argStr_);
+   if (encoding_ == WireBinary)
+      rawBinary_ = BinaryWireFrame::getPayload(argStr_);
+   else
+      rawBinary_ = READHEX(argStr_);
+
    rawRefReader_.setNewData(rawBinary_);
 }
 
@@ -320,6 +386,14 @@ void Arguments::setRawData()
 ///////////////////////////////////////////////////////////////////////////////
 void Command::deserialize()
 {
+   if (BinaryWireFrame::getEncoding(command_) == WireBinary)
+   {
+      deserializeBinary();
+      return;
+   }
+
+   encoding_ = WireHex;
+
    //sanity check
    if (command_.size() < 8)
       throw runtime_error("command is too short");
@@ -374,11 +448,81 @@ void Command::deserialize()
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void Command::serialize()
+void Command::deserializeBinary()
+{
+   /***
+   payload:
+      id count (varint) | ids (varint len | id) | method (varint len | method)
+      args frame, if any
+   ***/
+
+   encoding_ = WireBinary;
+   BinaryRefReader brr(BinaryWireFrame::getPayload(command_));
+
+   auto readString = [&brr](void)->string
+   {
+      auto len = brr.get_var_int();
+      if (len > brr.getSizeRemaining())
+         throw range_error("invalid id len");
+
+      auto strRef = brr.get_BinaryDataRef(len);
+      return string((const char*)strRef.getPtr(), len);
+   };
+
+   auto idCount = brr.get_var_int();
+   if (idCount > brr.getSizeRemaining())
+      throw runtime_error("invalid id count");
+
+   for (unsigned i = 0; i < idCount; i++)
+      ids_.push_back(readString());
+
+   method_ = readString();
+   if (method_.size() == 0)
+      throw runtime_error("empty command");
+
+   if (brr.getSizeRemaining() != 0)
+   {
+      args_ = move(Arguments(string(
+         (const char*)brr.getCurrPtr(), brr.getSizeRemaining())));
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Command::serializeBinary()
+{
+   BinaryWriter bw;
+   bw.put_var_int(ids_.size());
+   for (auto& id : ids_)
+   {
+      bw.put_var_int(id.size());
+      bw.put_BinaryData((const uint8_t*)id.c_str(), id.size());
+   }
+
+   bw.put_var_int(method_.size());
+   bw.put_BinaryData((const uint8_t*)method_.c_str(), method_.size());
+
+   if (args_.hasArgs())
+   {
+      auto& argStr = args_.serialize(WireBinary);
+      bw.put_BinaryData((const uint8_t*)argStr.c_str(), argStr.size());
+   }
+
+   BinaryWireFrame::frame(bw.getDataRef(), command_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Command::serialize(WireEncoding encoding)
 {
    if (method_.size() == 0)
       throw runtime_error("empty command");
 
+   encoding_ = encoding;
+   if (encoding == WireBinary)
+   {
+      serializeBinary();
+      return;
+   }
+
    stringstream ss;
 
    for (auto id : ids_)
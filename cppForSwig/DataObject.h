@@ -23,6 +23,7 @@
 #include "DbHeader.h"
 #include "BDM_seder.h"
 #include "ThreadSafeClasses.h"
+#include "bdmenums.h"
 
 #define ERRTYPE_CODE             1
 #define INTTYPE_CODE             2
@@ -32,6 +33,13 @@
 #define LEDGERENTRYVECTOR_CODE   6
 #define PROGRESSDATA_CODE        7
 
+//binary frames open with a byte that is never a hex char
+#define WIRE_BINARY_MAGIC        0xBF
+#define WIRE_BINARY_HEADER_SIZE  5
+
+//binary wire version offered by clients at registerBDV
+#define WIRE_BINARY_VERSION      1
+
 using namespace std;
 
 enum OrderType
@@ -160,12 +168,31 @@ public:
    int64_t getSignedVal(void) const { return *(int64_t*)&val_; }
 };
 
+///////////////////////////////////////////////////////////////////////////////
+struct BinaryWireFrame
+{
+   /***
+   Length prefixed framing for raw binary messages:
+      magic (1) | payload length (uint32 LE) | payload
+
+   Hex encoded messages never start with the magic byte, which is how 
+   either side tells the encodings apart.
+   ***/
+
+   static WireEncoding getEncoding(const string&);
+   static void frame(const BinaryDataRef& payload, string& out);
+
+   //throws runtime_error if the frame length doesn't match the message
+   static BinaryDataRef getPayload(const string&);
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 class Arguments
 {
 private:
    bool initialized_ = false;
    string argStr_;
+   WireEncoding encoding_ = WireHex;
    vector<shared_ptr<DataMeta>> argData_;
    BinaryData rawBinary_;
    BinaryRefReader rawRefReader_;
@@ -177,6 +204,7 @@ private:
    {
       initialized_ = arg.initialized_;
       argStr_ = move(arg.argStr_);
+      encoding_ = arg.encoding_;
       argData_ = move(arg.argData_);
       rawBinary_ = move(arg.rawBinary_);
       rawRefReader_.setNewData(rawBinary_);
@@ -187,6 +215,7 @@ private:
    {
       initialized_ = arg.initialized_;
       argStr_ = arg.argStr_;
+      encoding_ = arg.encoding_;
       argData_ = arg.argData_;
       rawBinary_ = arg.rawBinary_;
       rawRefReader_.setNewData(rawBinary_);
@@ -247,8 +276,9 @@ public:
       return *this;
    }
 
+   //picks the encoding from the first byte of argStr_
    void setRawData();
-   const string& serialize();
+   const string& serialize(WireEncoding encoding = WireHex);
 
    ///////////////////////////////////////////////////////////////////////////////
    void merge(const Arguments& argIn)
@@ -321,6 +351,9 @@ struct Command
 
    string command_;
 
+   //hex packets carry a checksum, binary ones are length prefixed instead
+   WireEncoding encoding_ = WireHex;
+
    Command()
    {}
 
@@ -329,7 +362,11 @@ struct Command
    {}
 
    void deserialize(void);
-   void serialize(void);
+   void serialize(WireEncoding encoding = WireHex);
+
+private:
+   void deserializeBinary(void);
+   void serializeBinary(void);
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -24,6 +24,12 @@ DatabaseBuilder::DatabaseBuilder(BlockFiles& blockFiles,
    magicBytes_(db_->getMagicBytes()), topBlockOffset_(0, 0)
 {}
 
+/////////////////////////////////////////////////////////////////////////////
+DatabaseBuilder::~DatabaseBuilder()
+{
+   waitOnTxFilterCompaction();
+}
+
 /////////////////////////////////////////////////////////////////////////////
 void DatabaseBuilder::init()
 {
@@ -83,6 +89,7 @@ void DatabaseBuilder::init()
    if (bdmConfig_.armoryDbType_ != ARMORY_DB_SUPER)
    {
       verifyTxFilters();
+      scheduleTxFilterCompaction();
 
       //blockchain object now has the longest chain, update address history
       //retrieve all tracked addresses from DB
@@ -321,6 +328,9 @@ Blockchain::ReorganizationState DatabaseBuilder::updateBlocksInDB(
          topBlockOffset_ = *blockoffset;
    }
 
+   if (verbose)
+      db_->logBulkWriteStats();
+
    //done parsing new blocks, reorg and add to DB
    if (verbose)
       progress_(BDMPhase_OrganizingChain, 0, UINT32_MAX, 0);
@@ -411,23 +421,31 @@ bool DatabaseBuilder::addBlocksToDB(BlockDataLoader& bdl,
       //process filters
       if (bdmConfig_.armoryDbType_ == ARMORY_DB_FULL)
       {
-        //pull existing file filter bucket from db (if any)
-         auto&& pool = db_->getFilterPoolForFileNum<TxFilterType>(fileID);
-
-         if (insertedBlocks.size() == 0)
+         if (db_->hasFilterPoolForFileNum(fileID))
          {
-            if (pool.isValid())
-            {
-               //this block has a filter pool and there is no data to append,
-               //we can return
+            //this block file has a filter pool already, append the filters
+            //of the new blocks instead of rewriting the pool. they are 
+            //folded back in by the compaction thread
+            if (insertedBlocks.size() == 0)
                return true;
+
+            {
+               LMDBEnv::Transaction tx;
+               db_->beginDBTransaction(&tx, TXFILTERS, LMDB::ReadWrite);
+
+               for (auto& bdId : insertedBlocks)
+                  db_->appendFilterForFileNum(fileID, bdMap[bdId].getTxFilter());
             }
 
-            //if we got this far, this block file does not add any new blocks 
-            //to the chain, but it still needs an empty filter pool for the 
-            //resolver to fetch. we simply let it run on an empty block set
+            unique_lock<mutex> lock(txFilterCompactionMutex_);
+            appendedTxFilters_[fileID] += insertedBlocks.size();
+            return true;
          }
 
+         //if we got this far, this block file has no pool yet. it needs
+         //one even if it does not add any new blocks to the chain, for the
+         //resolver to fetch. we simply let it run on an empty block set
+
          //tally all block filters
          set<TxFilter<TxFilterType>> allFilters;
 
@@ -436,8 +454,8 @@ bool DatabaseBuilder::addBlocksToDB(BlockDataLoader& bdl,
             allFilters.insert(move(bdMap[bdId].getTxFilter()));
          }
 
-         //update bucket
-         pool.update(allFilters);
+         //create bucket
+         TxFilterPool<TxFilterType> pool(allFilters);
 
          //update db entry
          db_->putFilterPoolForFileNum(fileID, pool);
@@ -529,7 +547,7 @@ BinaryData DatabaseBuilder::updateTransactionHistory(int32_t startHeight)
 {
    //Scan history
    auto topScannedBlockHash = 
-      scanHistory(startHeight, bdmConfig_.reportProgress_);
+      scanHistory(startHeight, bdmConfig_.reportProgress_, true);
 
    //return the hash of the last scanned block
    return topScannedBlockHash;
@@ -537,13 +555,23 @@ BinaryData DatabaseBuilder::updateTransactionHistory(int32_t startHeight)
 
 /////////////////////////////////////////////////////////////////////////////
 BinaryData DatabaseBuilder::scanHistory(int32_t startHeight,
-   bool reportprogress)
+   bool reportprogress, bool initialScan)
 {
    if (bdmConfig_.armoryDbType_ != ARMORY_DB_SUPER)
    {
       BlockchainScanner bcs(blockchain_, db_, scrAddrFilter_.get(),
          blockFiles_, bdmConfig_.threadCount_, bdmConfig_.ramUsage_,
-         progress_, reportprogress);
+         progress_, reportprogress, 
+         bdmConfig_.blkFileReadMode_, bdmConfig_.streamBudget_,
+         bdmConfig_.ramLevelSize_);
+
+      //rewriting the full utxo set on every new block costs more than the
+      //preload it saves, new block scans only refresh it once in a while
+      auto sinceLastSnapshot = 
+         chrono::steady_clock::now() - db_->getLastUtxoSnapshotTime();
+      if (initialScan || 
+         sinceLastSnapshot >= chrono::seconds(UTXO_SNAPSHOT_INTERVAL))
+         bcs.enableUtxoSnapshot();
 
       bcs.scan(startHeight);
       bcs.updateSSH(false);
@@ -589,6 +617,7 @@ Blockchain::ReorganizationState DatabaseBuilder::update(void)
    //update db
    auto&& reorgState = updateBlocksInDB(progress_, false, 
       bdmConfig_.armoryDbType_ == ARMORY_DB_SUPER);
+   scheduleTxFilterCompaction();
 
    if (!reorgState.hasNewTop_)
       return reorgState;
@@ -605,7 +634,7 @@ Blockchain::ReorganizationState DatabaseBuilder::update(void)
    }
 
    //scan new blocks   
-   BinaryData&& topScannedHash = scanHistory(startHeight, false);
+   BinaryData&& topScannedHash = scanHistory(startHeight, false, false);
    if (topScannedHash != blockchain_->top()->getThisHash())
       throw runtime_error("scan failure during DatabaseBuilder::update");
 
@@ -622,7 +651,9 @@ void DatabaseBuilder::undoHistory(
    {
       BlockchainScanner bcs(blockchain_, db_, scrAddrFilter_.get(),
          blockFiles_, bdmConfig_.threadCount_, bdmConfig_.ramUsage_,
-         progress_, false);
+         progress_, false,
+         bdmConfig_.blkFileReadMode_, bdmConfig_.streamBudget_,
+         bdmConfig_.ramLevelSize_);
       bcs.undo(reorgState);
    }
    else
@@ -884,14 +915,7 @@ void DatabaseBuilder::commitAllTxHints(
    }
 
    //write
-   {
-      for (auto& txhint : serializedHints)
-      {
-         db_->putValue(TXHINTS,
-            txhint.first.getRef(),
-            txhint.second.getDataRef());
-      }
-   }
+   db_->putValues(TXHINTS, serializedHints);
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -906,6 +930,7 @@ void DatabaseBuilder::commitAllStxos(
    auto blockPtr = blockDataPtr->getPtr();
 
    vector<pair<BinaryData, BinaryWriter>> serializedStxos;
+   auto stxoEncoding = db_->getValueEncoding(STXO);
 
    for (auto& id : insertedBlocks)
    {
@@ -945,19 +970,25 @@ void DatabaseBuilder::commitAllStxos(
 
             StoredTxOut::serializeDBValue(bwPair.second, ARMORY_DB_SUPER, false,
                0, isCoinbase, TXOUT_SPENTUNK, txoutDataRef, 
-               emptyRef, hash.getRef(), y);
+               emptyRef, hash.getRef(), y, stxoEncoding);
 
             serializedStxos.push_back(move(bwPair));
          }
       }
    }
 
+   //already in key order: block id, tx index, txout index
+   vector<pair<BinaryDataRef, BinaryDataRef>> keyValPairs;
+   keyValPairs.reserve(serializedStxos.size());
+   for (auto& bwPair : serializedStxos)
+   {
+      keyValPairs.push_back(make_pair(
+         bwPair.first.getRef(), bwPair.second.getDataRef()));
+   }
+
    LMDBEnv::Transaction tx;
    db_->beginDBTransaction(&tx, STXO, LMDB::ReadWrite);
-
-   for (auto& bwPair : serializedStxos)
-      db_->putValue(
-         STXO, bwPair.first.getRef(), bwPair.second.getDataRef());
+   db_->putValues(STXO, keyValPairs);
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -1234,6 +1265,7 @@ void DatabaseBuilder::verifyTxFilters()
    fileCounter.store(0, memory_order_relaxed);
 
    set<unsigned> damagedFilters;
+   mutex resultMutex;
 
    auto&& file_id_map = blockchain_->mapIDsPerBlockFile();
 
@@ -1243,6 +1275,7 @@ void DatabaseBuilder::verifyTxFilters()
       db_->beginDBTransaction(&tx, TXFILTERS, LMDB::ReadOnly);
 
       set<unsigned> mismatchedFilters;
+      map<unsigned, unsigned> appendedFilters;
 
       while (1)
       {
@@ -1260,11 +1293,19 @@ void DatabaseBuilder::verifyTxFilters()
 
             if (mismatchedFilters.size() > 0)
             {
-               unique_lock<mutex>(resultMutex);
+               unique_lock<mutex> lock(resultMutex);
                damagedFilters.insert(
                   mismatchedFilters.begin(), mismatchedFilters.end());
             }
 
+            if (appendedFilters.size() > 0)
+            {
+               //leftover appended filters get compacted once verified
+               unique_lock<mutex> lock(txFilterCompactionMutex_);
+               for (auto& appended : appendedFilters)
+                  appendedTxFilters_[appended.first] += appended.second;
+            }
+
             return;
          }
 
@@ -1291,6 +1332,10 @@ void DatabaseBuilder::verifyTxFilters()
                mismatchedFilters.insert(fileNum);
                LOGWARN << mismatchCount << " mismatches in txfilter for file #" << fileNum;
             }
+            else if (pool.getAppendedCount() > 0)
+            {
+               appendedFilters[fileNum] = pool.getAppendedCount();
+            }
          }
          catch (runtime_error&)
          {
@@ -1329,10 +1374,7 @@ void DatabaseBuilder::repairTxFilters(const set<unsigned>& badFilters)
       db_->beginDBTransaction(&tx, TXFILTERS, LMDB::ReadWrite);
 
       for (auto& filter : badFilters)
-      {
-         auto&& dbkey = DBUtils::getFilterPoolKey(filter);
-         db_->deleteValue(TXFILTERS, dbkey);
-      }
+         db_->deleteFilterPoolForFileNum(filter);
    }
 
    //no preload nor prefetch
@@ -1439,8 +1481,7 @@ void DatabaseBuilder::reprocessTxFilter(
       //delete existing txfilter
       LMDBEnv::Transaction tx;
       db_->beginDBTransaction(&tx, TXFILTERS, LMDB::ReadWrite);
-      auto&& dbkey = DBUtils::getFilterPoolKey(fileID);
-      db_->deleteValue(TXFILTERS, dbkey);
+      db_->deleteFilterPoolForFileNum(fileID);
 
       //tally all block filters
       set<TxFilter<TxFilterType>> allFilters;
@@ -1459,6 +1500,8 @@ void DatabaseBuilder::reprocessTxFilter(
 /////////////////////////////////////////////////////////////////////////////
 void DatabaseBuilder::cycleDatabases()
 {
+   waitOnTxFilterCompaction();
+
    db_->closeDatabases();
    db_->openDatabases(
       bdmConfig_.dbDir_,
@@ -1466,3 +1509,91 @@ void DatabaseBuilder::cycleDatabases()
       bdmConfig_.genesisTxHash_,
       bdmConfig_.magicBytes_);
 }
+
+/////////////////////////////////////////////////////////////////////////////
+void DatabaseBuilder::scheduleTxFilterCompaction()
+{
+   /***
+   New blocks append their txfilter to the pool of their blk file rather 
+   than rewriting it. Pools of blk files the chain has moved past, and 
+   pools carrying too many appended filters, are compacted on a 
+   background thread, so that tip updates do not wait on it.
+   ***/
+
+   set<unsigned> fileIDs;
+
+   {
+      unique_lock<mutex> lock(txFilterCompactionMutex_);
+
+      auto iter = appendedTxFilters_.begin();
+      while (iter != appendedTxFilters_.end())
+      {
+         if (iter->first < topBlockOffset_.fileID_ ||
+            iter->second >= TXFILTER_COMPACTION_THRESHOLD)
+         {
+            fileIDs.insert(iter->first);
+            appendedTxFilters_.erase(iter++);
+            continue;
+         }
+
+         ++iter;
+      }
+   }
+
+   if (fileIDs.size() == 0)
+      return;
+
+   //one compaction at a time, the previous run is short lived
+   waitOnTxFilterCompaction();
+   txFilterCompactionThread_ = thread(
+      &DatabaseBuilder::compactTxFilters, this, move(fileIDs));
+}
+
+/////////////////////////////////////////////////////////////////////////////
+void DatabaseBuilder::compactTxFilters(const set<unsigned>& fileIDs)
+{
+   for (auto& fileID : fileIDs)
+   {
+      try
+      {
+         auto count = 
+            db_->compactFilterPoolForFileNum<TxFilterType>(fileID);
+
+         if (count > 0)
+         {
+            LOGINFO << "compacted " << count << 
+               " appended txfilters for file #" << fileID;
+         }
+      }
+      catch (exception& e)
+      {
+         //the pool is left as is, verifyTxFilters will catch it on 
+         //the next run
+         LOGWARN << "failed to compact txfilters for file #" << fileID <<
+            ": " << e.what();
+      }
+   }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+void DatabaseBuilder::waitOnTxFilterCompaction()
+{
+   if (txFilterCompactionThread_.joinable())
+      txFilterCompactionThread_.join();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+void DatabaseBuilder::writeUtxoSnapshot()
+{
+   //new block scans drop the snapshot and only rewrite it once in a while,
+   //put it back so that the next start can preload from it
+   if (bdmConfig_.armoryDbType_ == ARMORY_DB_SUPER || db_->hasUtxoSnapshot())
+      return;
+
+   BlockchainScanner bcs(blockchain_, db_, scrAddrFilter_.get(),
+      blockFiles_, bdmConfig_.threadCount_, bdmConfig_.ramUsage_,
+      progress_, false,
+      bdmConfig_.blkFileReadMode_, bdmConfig_.streamBudget_,
+      bdmConfig_.ramLevelSize_);
+   bcs.snapshotUtxos();
+}
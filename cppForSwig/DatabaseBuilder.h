@@ -17,6 +17,9 @@ class UnresolvedHashException {};
 
 typedef function<void(BDMPhase, double, unsigned, unsigned)> ProgressCallback;
 
+//appended txfilters a blk file can carry before its pool gets compacted
+#define TXFILTER_COMPACTION_THRESHOLD 32
+
 /////////////////////////////////////////////////////////////////////////////
 class DatabaseBuilder
 {
@@ -33,6 +36,11 @@ private:
 
    unsigned checkedTransactions_ = 0;
 
+   //fileID to count of filters appended to its pool since the last compaction
+   map<unsigned, unsigned> appendedTxFilters_;
+   mutex txFilterCompactionMutex_;
+   thread txFilterCompactionThread_;
+
 private:
    void findLastKnownBlockPos();
    BlockOffset loadBlockHeadersFromDB(const ProgressCallback &progress);
@@ -46,7 +54,8 @@ private:
    Blockchain::ReorganizationState updateBlocksInDB(
       const ProgressCallback &progress, bool verbose, bool fullHints);
    BinaryData updateTransactionHistory(int32_t startHeight);
-   BinaryData scanHistory(int32_t startHeight, bool reportprogress);
+   BinaryData scanHistory(int32_t startHeight, 
+      bool reportprogress, bool initialScan);
    void undoHistory(Blockchain::ReorganizationState& reorgState);
 
    void resetHistory(void);
@@ -65,11 +74,15 @@ private:
    void repairTxFilters(const set<unsigned>&);
    void reprocessTxFilter(shared_ptr<BlockDataFileMap>, unsigned);
 
+   void scheduleTxFilterCompaction(void);
+   void compactTxFilters(const set<unsigned>&);
+
    void cycleDatabases(void);
 
 public:
    DatabaseBuilder(BlockFiles&, BlockDataManager&,
       const ProgressCallback&);
+   ~DatabaseBuilder(void);
 
    void init(void);
    Blockchain::ReorganizationState update(void);
@@ -78,4 +91,10 @@ public:
    unsigned getCheckedTxCount(void) const { return checkedTransactions_; }
 
    void verifyTxFilters(void);
+
+   //joins the background TXFILTERS compaction, if any
+   void waitOnTxFilterCompaction(void);
+
+   //writes the utxo snapshot at the top scanned block if there is none
+   void writeUtxoSnapshot(void);
 };
@@ -872,6 +872,77 @@ SecureBinaryData CryptoECDSA::ComputeChainedPublicKey(
    return CryptoECDSA::SerializePublicKey(newPubKey);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+vector<ChainedKey> CryptoECDSA::ComputeChainedKeys(
+                                SecureBinaryData const & binPubKey,
+                                SecureBinaryData const & binPrivKey,
+                                SecureBinaryData const & chainCode,
+                                unsigned count)
+{
+   static SecureBinaryData SECP256K1_ORDER_BE = SecureBinaryData::CreateFromHex(
+           "fffffffffffffffffffffffffffffffebaaedce6af48a03bbfd25e8cd0364141");
+
+   if (binPubKey.getSize() != 65 || chainCode.getSize() != 32)
+      throw runtime_error("invalid pubkey or chaincode size");
+
+   CryptoPP::ECP ecp = Get_secp256k1_ECP();
+
+   BTC_ECPOINT pubPoint;
+   if (!ecp.DecodePoint(pubPoint, (byte*)binPubKey.getPtr(), 65) ||
+      !ecp.VerifyPoint(pubPoint))
+      throw runtime_error("invalid pubkey");
+
+   //links are products of valid points and scalars, they are valid as well
+   bool hasPrivKey = binPrivKey.getSize() > 0;
+   CryptoPP::Integer privExp, ecOrder;
+   if (hasPrivKey)
+   {
+      privExp.Decode(binPrivKey.getPtr(), binPrivKey.getSize(), UNSIGNED);
+      ecOrder.Decode(
+         SECP256K1_ORDER_BE.getPtr(), SECP256K1_ORDER_BE.getSize(), UNSIGNED);
+   }
+
+   vector<ChainedKey> result;
+   result.reserve(count);
+
+   BinaryData chainMod(32);
+   BinaryData chainXor(32);
+   const SecureBinaryData* currentPubKey = &binPubKey;
+
+   for (unsigned i = 0; i < count; i++)
+   {
+      //multiplier is the chaincode xor'ed with hash256 of the pubkey
+      BtcUtils::getHash256(
+         currentPubKey->getPtr(), currentPubKey->getSize(), chainMod);
+
+      for (unsigned y = 0; y < 32; y++)
+         chainXor[y] = chainMod[y] ^ chainCode[y];
+
+      CryptoPP::Integer mult;
+      mult.Decode(chainXor.getPtr(), chainXor.getSize(), UNSIGNED);
+
+      pubPoint = ecp.ScalarMultiply(pubPoint, mult);
+
+      ChainedKey link;
+      link.pubKey_.resize(65);
+      ecp.EncodePoint((byte*)link.pubKey_.getPtr(), pubPoint, false);
+      link.pubKeyCompressed_.resize(33);
+      ecp.EncodePoint((byte*)link.pubKeyCompressed_.getPtr(), pubPoint, true);
+
+      if (hasPrivKey)
+      {
+         privExp = a_times_b_mod_c(mult, privExp, ecOrder);
+         link.privKey_.resize(32);
+         privExp.Encode(link.privKey_.getPtr(), 32, UNSIGNED);
+      }
+
+      result.push_back(move(link));
+      currentPubKey = &result.back().pubKey_;
+   }
+
+   return result;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 SecureBinaryData CryptoECDSA::InvMod(const SecureBinaryData& m)
 {
@@ -195,7 +195,11 @@ public:
    void lockData(void)
    {
       if(getSize() > 0)
+      {
+         //inline bytes would be copied around by moves
+         keepOnHeap();
          mlock(getPtr(), getSize());
+      }
    }
 
    void destroy(void)
@@ -306,6 +310,15 @@ public:
 
 
 
+////////////////////////////////////////////////////////////////////////////////
+// One link of a key chain, as computed by CryptoECDSA::ComputeChainedKeys
+struct ChainedKey
+{
+   SecureBinaryData pubKey_;           //65 bytes
+   SecureBinaryData pubKeyCompressed_; //33 bytes
+   SecureBinaryData privKey_;          //empty if chained from a pubkey only
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // Create a C++ interface to the Crypto++ ECDSA ops:  should be more secure
 // and much faster than the pure-python methods created by Lis
@@ -423,6 +436,19 @@ public:
                            SecureBinaryData const & chainCode,
                            SecureBinaryData* multiplierOut=NULL);
 
+   /////////////////////////////////////////////////////////////////////////////
+   // Extend a chain by *count* links in one call. Same output as chaining
+   // ComputeChainedPublicKey and ComputeChainedPrivateKey count times, but 
+   // the curve is set up once, the seed point is validated once instead of 
+   // parsing and validating every link, and each private key only costs a
+   // modular multiplication. Pass an empty binPrivKey for a pubkey only 
+   // chain.
+   vector<ChainedKey> ComputeChainedKeys(
+                           SecureBinaryData const & binPubKey,
+                           SecureBinaryData const & binPrivKey,
+                           SecureBinaryData const & chainCode,
+                           unsigned count);
+
    /////////////////////////////////////////////////////////////////////////////
    // We need some direct access to Crypto++ math functions
    SecureBinaryData InvMod(const SecureBinaryData& m);
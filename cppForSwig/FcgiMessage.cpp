@@ -162,11 +162,18 @@ uint16_t FcgiMessage::beginRequest(void)
 ///////////////////////////////////////////////////////////////////////////////
 FcgiMessage FcgiMessage::makePacket(const char *msg)
 {
+   return makePacket(msg, strlen(msg));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+FcgiMessage FcgiMessage::makePacket(const char *msg, size_t msglen)
+{
+   //msg may carry null bytes (binary wire), only trust msglen
    FcgiMessage fcgiMsg;
    auto requestID = fcgiMsg.beginRequest();
 
    stringstream msglength;
-   msglength << strlen(msg);
+   msglength << msglen;
 
    //params
    auto& params = fcgiMsg.getNewPacket();
@@ -179,7 +186,6 @@ FcgiMessage FcgiMessage::makePacket(const char *msg)
    paramterminator.buildHeader(FCGI_PARAMS, requestID);
 
    //data
-   auto msglen = strlen(msg);
    size_t offset = 0;
    size_t uint16max = UINT16_MAX;
    while (msglen > offset)
@@ -56,6 +56,7 @@ private:
 
 public:
    static FcgiMessage makePacket(const char* msg);
+   static FcgiMessage makePacket(const char* msg, size_t len);
 
    uint8_t* serialize(void);
    size_t getSerializedDataLength(void) const { return serData_.size(); }
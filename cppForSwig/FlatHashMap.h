@@ -0,0 +1,548 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (C) 2017, goatpig.                                              //
+//  Distributed under the MIT license                                         //
+//  See LICENSE-MIT or https://opensource.org/licenses/MIT                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _H_FLATHASHMAP_
+#define _H_FLATHASHMAP_
+
+#include <stdint.h>
+#include <string.h>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <stdexcept>
+#include <type_traits>
+#include <tuple>
+
+#include "BinaryData.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+template<size_t N> struct FlatKey
+{
+   //fixed size key stored inline in the map slots
+   uint8_t data_[N];
+
+   FlatKey(void)
+   {}
+
+   explicit FlatKey(const uint8_t* ptr)
+   {
+      memcpy(data_, ptr, N);
+   }
+
+   const uint8_t* getPtr(void) const { return data_; }
+   size_t getSize(void) const { return N; }
+
+   BinaryDataRef getRef(void) const { return BinaryDataRef(data_, N); }
+   operator BinaryDataRef() const { return getRef(); }
+
+   bool operator==(const FlatKey<N>& rhs) const
+   {
+      return memcmp(data_, rhs.data_, N) == 0;
+   }
+
+   bool operator!=(const FlatKey<N>& rhs) const
+   {
+      return !(*this == rhs);
+   }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+template<size_t N, typename T> class FlatHashMap
+{
+   /***
+   Open addressing (linear probing) hash map for fixed size BinaryData keys,
+   meant for tx hashes (N = 32) and db keys (N = 8). Keys and values live
+   in a single slot array, there is no allocation per entry.
+
+   Lookups take anything that converts to BinaryDataRef. A key of the wrong
+   size is never found, inserting one throws.
+
+   Erased slots are tombstoned, so erasing does not move other entries and
+   only invalidates iterators to the erased entry. Inserting may rehash,
+   which invalidates all iterators, same as unordered_map. Iteration order
+   is unspecified.
+   ***/
+
+public:
+   typedef FlatKey<N> key_type;
+   typedef T mapped_type;
+   typedef pair<const FlatKey<N>, T> value_type;
+
+private:
+   enum SlotState : uint8_t
+   {
+      Slot_Empty,
+      Slot_Full,
+      Slot_Deleted
+   };
+
+   typedef typename aligned_storage<
+      sizeof(value_type), alignof(value_type)>::type SlotStorage;
+
+   unique_ptr<SlotStorage[]> slots_;
+   vector<uint8_t> states_;
+
+   size_t capacity_ = 0;
+   size_t size_ = 0;
+   size_t deleted_ = 0;
+
+public:
+   /////////////////////////////////////////////////////////////////////////////
+   template<bool IsConst> class iterator_base
+   {
+      friend class FlatHashMap<N, T>;
+
+      typedef typename conditional<IsConst,
+         const FlatHashMap<N, T>*, FlatHashMap<N, T>*>::type map_ptr;
+      typedef typename conditional<IsConst,
+         const value_type, value_type>::type ref_type;
+
+   private:
+      map_ptr map_ = nullptr;
+      size_t index_ = 0;
+
+   private:
+      void skipEmpty(void)
+      {
+         while (index_ < map_->capacity_ &&
+            map_->states_[index_] != Slot_Full)
+            ++index_;
+      }
+
+   public:
+      iterator_base(void)
+      {}
+
+      iterator_base(map_ptr mapPtr, size_t index) :
+         map_(mapPtr), index_(index)
+      {}
+
+      //iterator to const_iterator
+      template<bool C, typename = typename enable_if<IsConst && !C>::type>
+      iterator_base(const iterator_base<C>& rhs) :
+         map_(rhs.map_), index_(rhs.index_)
+      {}
+
+      ref_type& operator*(void) const { return map_->slot(index_); }
+      ref_type* operator->(void) const { return &map_->slot(index_); }
+
+      iterator_base& operator++(void)
+      {
+         ++index_;
+         skipEmpty();
+         return *this;
+      }
+
+      iterator_base operator++(int)
+      {
+         auto copy = *this;
+         ++(*this);
+         return copy;
+      }
+
+      bool operator==(const iterator_base& rhs) const
+      {
+         return index_ == rhs.index_;
+      }
+
+      bool operator!=(const iterator_base& rhs) const
+      {
+         return index_ != rhs.index_;
+      }
+
+      template<bool> friend class iterator_base;
+   };
+
+   typedef iterator_base<false> iterator;
+   typedef iterator_base<true> const_iterator;
+
+private:
+   /////////////////////////////////////////////////////////////////////////////
+   value_type& slot(size_t index)
+   {
+      return *reinterpret_cast<value_type*>(&slots_[index]);
+   }
+
+   const value_type& slot(size_t index) const
+   {
+      return *reinterpret_cast<const value_type*>(&slots_[index]);
+   }
+
+   static size_t hashKey(const uint8_t* ptr)
+   {
+      //keys are mostly hashes already, fold them in 8 byte words and mix
+      //so that structured keys (db keys) spread as well
+      uint64_t h = N;
+      size_t i = 0;
+      for (; i + 8 <= N; i += 8)
+      {
+         uint64_t word;
+         memcpy(&word, ptr + i, 8);
+         h = (h ^ word) * 0x9E3779B97F4A7C15ULL;
+      }
+
+      if (i < N)
+      {
+         uint64_t word = 0;
+         memcpy(&word, ptr + i, N - i);
+         h = (h ^ word) * 0x9E3779B97F4A7C15ULL;
+      }
+
+      return size_t(h ^ (h >> 29));
+   }
+
+   size_t findIndex(const uint8_t* key) const
+   {
+      //returns capacity_ if the key is not in the map
+      if (size_ == 0)
+         return capacity_;
+
+      auto mask = capacity_ - 1;
+      auto index = hashKey(key) & mask;
+      while (1)
+      {
+         auto state = states_[index];
+         if (state == Slot_Empty)
+            return capacity_;
+
+         if (state == Slot_Full &&
+            memcmp(slot(index).first.data_, key, N) == 0)
+            return index;
+
+         index = (index + 1) & mask;
+      }
+   }
+
+   size_t findInsertIndex(const uint8_t* key, bool& found)
+   {
+      auto probe = [this, key, &found](void)->size_t
+      {
+         auto mask = capacity_ - 1;
+         auto index = hashKey(key) & mask;
+         size_t tombstone = capacity_;
+         while (1)
+         {
+            auto state = states_[index];
+            if (state == Slot_Empty)
+               break;
+
+            if (state == Slot_Deleted)
+            {
+               if (tombstone == capacity_)
+                  tombstone = index;
+            }
+            else if (memcmp(slot(index).first.data_, key, N) == 0)
+            {
+               found = true;
+               return index;
+            }
+
+            index = (index + 1) & mask;
+         }
+
+         found = false;
+         return tombstone != capacity_ ? tombstone : index;
+      };
+
+      size_t index = capacity_;
+      if (capacity_ > 0)
+      {
+         index = probe();
+         if (found)
+            return index;
+      }
+
+      //new entry, grow if it would take the last free slots past 3/4
+      if (capacity_ == 0 || 
+         (states_[index] == Slot_Empty &&
+         (size_ + deleted_ + 1) * 4 > capacity_ * 3))
+      {
+         //mostly tombstones, rehash in place
+         if ((size_ + 1) * 2 <= capacity_)
+            rehash(capacity_);
+         else
+            rehash(max(capacity_ * 2, size_t(16)));
+
+         index = probe();
+      }
+
+      if (states_[index] == Slot_Deleted)
+         --deleted_;
+
+      return index;
+   }
+
+   void rehash(size_t newCapacity)
+   {
+      auto oldSlots = move(slots_);
+      auto oldStates = move(states_);
+      auto oldCapacity = capacity_;
+
+      slots_.reset(new SlotStorage[newCapacity]);
+      states_.assign(newCapacity, Slot_Empty);
+      capacity_ = newCapacity;
+      deleted_ = 0;
+
+      auto mask = capacity_ - 1;
+      for (size_t i = 0; i < oldCapacity; i++)
+      {
+         if (oldStates[i] != Slot_Full)
+            continue;
+
+         auto& oldSlot = *reinterpret_cast<value_type*>(&oldSlots[i]);
+         auto index = hashKey(oldSlot.first.data_) & mask;
+         while (states_[index] != Slot_Empty)
+            index = (index + 1) & mask;
+
+         new (&slots_[index]) value_type(
+            oldSlot.first, move(oldSlot.second));
+         states_[index] = Slot_Full;
+         oldSlot.~value_type();
+      }
+   }
+
+   static const uint8_t* checkKey(const BinaryDataRef& key)
+   {
+      if (key.getSize() != N)
+         throw runtime_error("invalid key size for FlatHashMap");
+
+      return key.getPtr();
+   }
+
+   void destroyAll(void)
+   {
+      for (size_t i = 0; i < capacity_; i++)
+      {
+         if (states_[i] == Slot_Full)
+            slot(i).~value_type();
+      }
+   }
+
+   void copyFrom(const FlatHashMap<N, T>& rhs)
+   {
+      capacity_ = rhs.capacity_;
+      size_ = rhs.size_;
+      deleted_ = rhs.deleted_;
+      states_ = rhs.states_;
+
+      if (capacity_ == 0)
+         return;
+
+      slots_.reset(new SlotStorage[capacity_]);
+      for (size_t i = 0; i < capacity_; i++)
+      {
+         if (states_[i] == Slot_Full)
+            new (&slots_[i]) value_type(rhs.slot(i));
+      }
+   }
+
+   void moveFrom(FlatHashMap<N, T>& rhs)
+   {
+      slots_ = move(rhs.slots_);
+      states_ = move(rhs.states_);
+      capacity_ = rhs.capacity_;
+      size_ = rhs.size_;
+      deleted_ = rhs.deleted_;
+
+      rhs.states_.clear();
+      rhs.capacity_ = rhs.size_ = rhs.deleted_ = 0;
+   }
+
+public:
+   /////////////////////////////////////////////////////////////////////////////
+   FlatHashMap(void)
+   {}
+
+   FlatHashMap(const FlatHashMap<N, T>& rhs)
+   {
+      copyFrom(rhs);
+   }
+
+   FlatHashMap(FlatHashMap<N, T>&& rhs)
+   {
+      moveFrom(rhs);
+   }
+
+   ~FlatHashMap(void)
+   {
+      destroyAll();
+   }
+
+   FlatHashMap<N, T>& operator=(const FlatHashMap<N, T>& rhs)
+   {
+      if (this != &rhs)
+      {
+         clear();
+         copyFrom(rhs);
+      }
+
+      return *this;
+   }
+
+   FlatHashMap<N, T>& operator=(FlatHashMap<N, T>&& rhs)
+   {
+      if (this != &rhs)
+      {
+         clear();
+         moveFrom(rhs);
+      }
+
+      return *this;
+   }
+
+   /////////////////////////////////////////////////////////////////////////////
+   size_t size(void) const { return size_; }
+   bool empty(void) const { return size_ == 0; }
+
+   iterator begin(void)
+   {
+      iterator iter(this, 0);
+      iter.skipEmpty();
+      return iter;
+   }
+
+   const_iterator begin(void) const
+   {
+      const_iterator iter(this, 0);
+      iter.skipEmpty();
+      return iter;
+   }
+
+   iterator end(void) { return iterator(this, capacity_); }
+   const_iterator end(void) const { return const_iterator(this, capacity_); }
+
+   iterator find(const BinaryDataRef& key)
+   {
+      if (key.getSize() != N)
+         return end();
+
+      return iterator(this, findIndex(key.getPtr()));
+   }
+
+   const_iterator find(const BinaryDataRef& key) const
+   {
+      if (key.getSize() != N)
+         return end();
+
+      return const_iterator(this, findIndex(key.getPtr()));
+   }
+
+   size_t count(const BinaryDataRef& key) const
+   {
+      return find(key) == end() ? 0 : 1;
+   }
+
+   /////////////////////////////////////////////////////////////////////////////
+   template<typename... Args>
+   pair<iterator, bool> emplace(const BinaryDataRef& key, Args&&... args)
+   {
+      //key may point into this map's storage, which a rehash would move
+      uint8_t keyPtr[N];
+      memcpy(keyPtr, checkKey(key), N);
+
+      bool found;
+      auto index = findInsertIndex(keyPtr, found);
+      if (found)
+         return make_pair(iterator(this, index), false);
+
+      new (&slots_[index]) value_type(piecewise_construct,
+         forward_as_tuple(keyPtr), forward_as_tuple(forward<Args>(args)...));
+      states_[index] = Slot_Full;
+      ++size_;
+
+      return make_pair(iterator(this, index), true);
+   }
+
+   pair<iterator, bool> insert(const value_type& val)
+   {
+      return emplace(val.first.getRef(), val.second);
+   }
+
+   pair<iterator, bool> insert(value_type&& val)
+   {
+      return emplace(val.first.getRef(), move(val.second));
+   }
+
+   template<typename K, typename V>
+   pair<iterator, bool> insert(pair<K, V>&& val)
+   {
+      return emplace(BinaryDataRef(val.first), move(val.second));
+   }
+
+   template<typename InputIt> void insert(InputIt first, InputIt last)
+   {
+      for (; first != last; ++first)
+         emplace(BinaryDataRef(first->first), first->second);
+   }
+
+   T& operator[](const BinaryDataRef& key)
+   {
+      return emplace(key).first->second;
+   }
+
+   T& at(const BinaryDataRef& key)
+   {
+      auto iter = find(key);
+      if (iter == end())
+         throw range_error("key not in FlatHashMap");
+
+      return iter->second;
+   }
+
+   /////////////////////////////////////////////////////////////////////////////
+   iterator erase(const_iterator iter)
+   {
+      auto index = iter.index_;
+      slot(index).~value_type();
+      states_[index] = Slot_Deleted;
+      --size_;
+      ++deleted_;
+
+      iterator next(this, index);
+      ++next;
+      return next;
+   }
+
+   iterator erase(iterator iter)
+   {
+      return erase(const_iterator(iter));
+   }
+
+   size_t erase(const BinaryDataRef& key)
+   {
+      auto iter = find(key);
+      if (iter == end())
+         return 0;
+
+      erase(iter);
+      return 1;
+   }
+
+   void clear(void)
+   {
+      destroyAll();
+      slots_.reset();
+      states_.clear();
+      capacity_ = size_ = deleted_ = 0;
+   }
+
+   void reserve(size_t count)
+   {
+      //keep the load under 3/4
+      size_t newCapacity = 16;
+      while (newCapacity * 3 < count * 4)
+         newCapacity *= 2;
+
+      if (newCapacity > capacity_)
+         rehash(newCapacity);
+   }
+};
+
+#endif
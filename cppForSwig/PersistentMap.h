@@ -0,0 +1,623 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (C) 2017, goatpig.                                              //
+//  Distributed under the MIT license                                         //
+//  See LICENSE-MIT or https://opensource.org/licenses/MIT                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _H_PERSISTENTMAP_
+#define _H_PERSISTENTMAP_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#include <initializer_list>
+
+using namespace std;
+
+//an AVL tree of 2^44 entries is at most 63 levels deep
+#define PERSISTENT_TREE_MAX_DEPTH 64
+
+////////////////////////////////////////////////////////////////////////////////
+template<typename Entry, typename Key, typename KeyOf> class PersistentTree
+{
+   /***
+   Ordered AVL tree with structure sharing. Nodes are immutable once built:
+   writes copy the path from the root down to the modified node and share
+   every other subtree with the previous version, so copying a tree is
+   O(1) and a write costs O(log n) node allocations instead of a copy of
+   the whole container.
+
+   Entries are held by shared_ptr so path copies do not copy values.
+
+   A tree object is not thread safe for writes, but a copy taken before a
+   write is never affected by it. Iterators point into the nodes and stay
+   valid for as long as the tree they were taken from (or any copy of it)
+   is alive.
+   ***/
+
+protected:
+   struct Node
+   {
+      shared_ptr<const Entry> entry_;
+      shared_ptr<const Node> left_;
+      shared_ptr<const Node> right_;
+      int height_;
+   };
+
+   typedef shared_ptr<const Node> NodePtr;
+
+public:
+   typedef Key key_type;
+   typedef Entry value_type;
+   typedef size_t size_type;
+
+   ////////////////////////////////////////////////////////////////////////////
+   class const_iterator
+   {
+      friend class PersistentTree;
+
+   private:
+      //path from the root to the current node, empty at end()
+      const Node* path_[PERSISTENT_TREE_MAX_DEPTH];
+      unsigned depth_ = 0;
+      const Node* root_ = nullptr;
+
+   private:
+      void push(const Node* node)
+      {
+         if (depth_ >= PERSISTENT_TREE_MAX_DEPTH)
+            throw runtime_error("persistent tree is too deep");
+
+         path_[depth_++] = node;
+      }
+
+      void pushLeftmost(const Node* node)
+      {
+         while (node != nullptr)
+         {
+            push(node);
+            node = node->left_.get();
+         }
+      }
+
+      void pushRightmost(const Node* node)
+      {
+         while (node != nullptr)
+         {
+            push(node);
+            node = node->right_.get();
+         }
+      }
+
+   public:
+      typedef bidirectional_iterator_tag iterator_category;
+      typedef Entry value_type;
+      typedef ptrdiff_t difference_type;
+      typedef const Entry* pointer;
+      typedef const Entry& reference;
+
+      const_iterator(void)
+      {}
+
+      const_iterator(const const_iterator& rhs) :
+         depth_(rhs.depth_), root_(rhs.root_)
+      {
+         copy(rhs.path_, rhs.path_ + depth_, path_);
+      }
+
+      const_iterator& operator=(const const_iterator& rhs)
+      {
+         depth_ = rhs.depth_;
+         root_ = rhs.root_;
+         copy(rhs.path_, rhs.path_ + depth_, path_);
+         return *this;
+      }
+
+      reference operator*(void) const { return *path_[depth_ - 1]->entry_; }
+      pointer operator->(void) const { return path_[depth_ - 1]->entry_.get(); }
+
+      const_iterator& operator++(void)
+      {
+         auto node = path_[depth_ - 1];
+         if (node->right_ != nullptr)
+         {
+            pushLeftmost(node->right_.get());
+            return *this;
+         }
+
+         //climb until we come up from a left child
+         while (depth_ > 1)
+         {
+            auto child = path_[--depth_];
+            if (path_[depth_ - 1]->left_.get() == child)
+               return *this;
+         }
+
+         depth_ = 0;
+         return *this;
+      }
+
+      const_iterator operator++(int)
+      {
+         auto iter = *this;
+         ++(*this);
+         return iter;
+      }
+
+      const_iterator& operator--(void)
+      {
+         if (depth_ == 0)
+         {
+            //end() steps back to the last entry
+            pushRightmost(root_);
+            return *this;
+         }
+
+         auto node = path_[depth_ - 1];
+         if (node->left_ != nullptr)
+         {
+            pushRightmost(node->left_.get());
+            return *this;
+         }
+
+         while (depth_ > 1)
+         {
+            auto child = path_[--depth_];
+            if (path_[depth_ - 1]->right_.get() == child)
+               return *this;
+         }
+
+         depth_ = 0;
+         return *this;
+      }
+
+      const_iterator operator--(int)
+      {
+         auto iter = *this;
+         --(*this);
+         return iter;
+      }
+
+      bool operator==(const const_iterator& rhs) const
+      {
+         if (depth_ != rhs.depth_)
+            return false;
+
+         if (depth_ == 0)
+            return true;
+
+         return path_[depth_ - 1] == rhs.path_[depth_ - 1];
+      }
+
+      bool operator!=(const const_iterator& rhs) const
+      {
+         return !(*this == rhs);
+      }
+   };
+
+   typedef const_iterator iterator;
+   typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+   typedef const_reverse_iterator reverse_iterator;
+
+private:
+   NodePtr root_;
+   size_t size_ = 0;
+
+private:
+   static int height(const NodePtr& node)
+   {
+      return node == nullptr ? 0 : node->height_;
+   }
+
+   static const Key& keyOf(const Node* node)
+   {
+      return KeyOf()(*node->entry_);
+   }
+
+   static NodePtr makeNode(const shared_ptr<const Entry>& entry,
+      const NodePtr& left, const NodePtr& right)
+   {
+      auto node = make_shared<Node>();
+      node->entry_ = entry;
+      node->left_ = left;
+      node->right_ = right;
+      node->height_ = max(height(left), height(right)) + 1;
+
+      return node;
+   }
+
+   static NodePtr balance(const shared_ptr<const Entry>& entry,
+      const NodePtr& left, const NodePtr& right)
+   {
+      //subtree heights differ by 2 at most after a single insert or erase
+      auto hl = height(left);
+      auto hr = height(right);
+
+      if (hl > hr + 1)
+      {
+         if (height(left->left_) >= height(left->right_))
+         {
+            return makeNode(left->entry_, left->left_,
+               makeNode(entry, left->right_, right));
+         }
+
+         auto& lr = left->right_;
+         return makeNode(lr->entry_,
+            makeNode(left->entry_, left->left_, lr->left_),
+            makeNode(entry, lr->right_, right));
+      }
+
+      if (hr > hl + 1)
+      {
+         if (height(right->right_) >= height(right->left_))
+         {
+            return makeNode(right->entry_,
+               makeNode(entry, left, right->left_), right->right_);
+         }
+
+         auto& rl = right->left_;
+         return makeNode(rl->entry_,
+            makeNode(entry, left, rl->left_),
+            makeNode(right->entry_, rl->right_, right->right_));
+      }
+
+      return makeNode(entry, left, right);
+   }
+
+   static NodePtr insertNode(const NodePtr& node,
+      const shared_ptr<const Entry>& entry, bool overwrite, bool& added)
+   {
+      //returns node itself when nothing changed below it
+      if (node == nullptr)
+      {
+         added = true;
+         return makeNode(entry, nullptr, nullptr);
+      }
+
+      auto& key = KeyOf()(*entry);
+      auto& nodeKey = keyOf(node.get());
+
+      if (key < nodeKey)
+      {
+         auto left = insertNode(node->left_, entry, overwrite, added);
+         if (left == node->left_)
+            return node;
+
+         return balance(node->entry_, left, node->right_);
+      }
+
+      if (nodeKey < key)
+      {
+         auto right = insertNode(node->right_, entry, overwrite, added);
+         if (right == node->right_)
+            return node;
+
+         return balance(node->entry_, node->left_, right);
+      }
+
+      if (!overwrite)
+         return node;
+
+      auto newNode = make_shared<Node>(*node);
+      newNode->entry_ = entry;
+      return newNode;
+   }
+
+   static NodePtr eraseMin(const NodePtr& node,
+      shared_ptr<const Entry>& minEntry)
+   {
+      if (node->left_ == nullptr)
+      {
+         minEntry = node->entry_;
+         return node->right_;
+      }
+
+      auto left = eraseMin(node->left_, minEntry);
+      return balance(node->entry_, left, node->right_);
+   }
+
+   static NodePtr eraseNode(const NodePtr& node, const Key& key)
+   {
+      //returns node itself when the key is missing
+      if (node == nullptr)
+         return node;
+
+      auto& nodeKey = keyOf(node.get());
+      if (key < nodeKey)
+      {
+         auto left = eraseNode(node->left_, key);
+         if (left == node->left_)
+            return node;
+
+         return balance(node->entry_, left, node->right_);
+      }
+
+      if (nodeKey < key)
+      {
+         auto right = eraseNode(node->right_, key);
+         if (right == node->right_)
+            return node;
+
+         return balance(node->entry_, node->left_, right);
+      }
+
+      if (node->left_ == nullptr)
+         return node->right_;
+
+      if (node->right_ == nullptr)
+         return node->left_;
+
+      //replace with the next entry in order
+      shared_ptr<const Entry> minEntry;
+      auto right = eraseMin(node->right_, minEntry);
+      return balance(minEntry, node->left_, right);
+   }
+
+protected:
+   bool insertEntry(const shared_ptr<const Entry>& entry, bool overwrite)
+   {
+      bool added = false;
+      root_ = insertNode(root_, entry, overwrite, added);
+
+      if (added)
+         ++size_;
+
+      return added;
+   }
+
+   const Node* findNode(const Key& key) const
+   {
+      auto node = root_.get();
+      while (node != nullptr)
+      {
+         auto& nodeKey = keyOf(node);
+         if (key < nodeKey)
+            node = node->left_.get();
+         else if (nodeKey < key)
+            node = node->right_.get();
+         else
+            return node;
+      }
+
+      return nullptr;
+   }
+
+   template<typename Pred> const_iterator bound(
+      const Key& key, Pred goesLeft) const
+   {
+      //first entry for which goesLeft(key, entryKey) holds
+      const_iterator iter;
+      iter.root_ = root_.get();
+
+      unsigned boundDepth = 0;
+      auto node = root_.get();
+      while (node != nullptr)
+      {
+         iter.push(node);
+         if (goesLeft(key, keyOf(node)))
+         {
+            boundDepth = iter.depth_;
+            node = node->left_.get();
+         }
+         else
+         {
+            node = node->right_.get();
+         }
+      }
+
+      //the bound is an ancestor of the last node, trim the path to it
+      iter.depth_ = boundDepth;
+      return iter;
+   }
+
+public:
+   PersistentTree(void)
+   {}
+
+   size_t size(void) const { return size_; }
+   bool empty(void) const { return size_ == 0; }
+
+   void clear(void)
+   {
+      root_.reset();
+      size_ = 0;
+   }
+
+   const_iterator begin(void) const
+   {
+      const_iterator iter;
+      iter.root_ = root_.get();
+      iter.pushLeftmost(root_.get());
+      return iter;
+   }
+
+   const_iterator end(void) const
+   {
+      const_iterator iter;
+      iter.root_ = root_.get();
+      return iter;
+   }
+
+   const_iterator cbegin(void) const { return begin(); }
+   const_iterator cend(void) const { return end(); }
+
+   const_reverse_iterator rbegin(void) const
+   {
+      return const_reverse_iterator(end());
+   }
+
+   const_reverse_iterator rend(void) const
+   {
+      return const_reverse_iterator(begin());
+   }
+
+   const_iterator find(const Key& key) const
+   {
+      const_iterator iter;
+      iter.root_ = root_.get();
+
+      auto node = root_.get();
+      while (node != nullptr)
+      {
+         iter.push(node);
+
+         auto& nodeKey = keyOf(node);
+         if (key < nodeKey)
+            node = node->left_.get();
+         else if (nodeKey < key)
+            node = node->right_.get();
+         else
+            return iter;
+      }
+
+      return end();
+   }
+
+   size_t count(const Key& key) const
+   {
+      return findNode(key) == nullptr ? 0 : 1;
+   }
+
+   const_iterator lower_bound(const Key& key) const
+   {
+      return bound(key, [](const Key& lhs, const Key& rhs)->bool
+         { return !(rhs < lhs); });
+   }
+
+   const_iterator upper_bound(const Key& key) const
+   {
+      return bound(key, [](const Key& lhs, const Key& rhs)->bool
+         { return lhs < rhs; });
+   }
+
+   size_t erase(const Key& key)
+   {
+      auto root = eraseNode(root_, key);
+      if (root == root_)
+         return 0;
+
+      root_ = root;
+      --size_;
+      return 1;
+   }
+
+   template<typename InputIt> void erase(InputIt first, InputIt last)
+   {
+      //erases a range of keys, not of iterators into this tree
+      for (; first != last; ++first)
+         erase(*first);
+   }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+template<typename K, typename V> struct PersistentMapKeyOf
+{
+   const K& operator()(const pair<const K, V>& entry) const
+   {
+      return entry.first;
+   }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+template<typename K, typename V> class PersistentMap :
+   public PersistentTree<pair<const K, V>, K, PersistentMapKeyOf<K, V>>
+{
+   /***
+   std::map like read API over a PersistentTree. Writes mirror std::map
+   where they can: insert does not replace an existing value, use assign
+   for that. There is no operator[], entries cannot be modified in place.
+   ***/
+
+public:
+   typedef V mapped_type;
+   typedef pair<const K, V> value_type;
+
+   PersistentMap(void)
+   {}
+
+   template<typename InputIt> PersistentMap(InputIt first, InputIt last)
+   {
+      insert(first, last);
+   }
+
+   PersistentMap(initializer_list<value_type> entries)
+   {
+      insert(entries.begin(), entries.end());
+   }
+
+   bool insert(const value_type& entry)
+   {
+      return this->insertEntry(make_shared<value_type>(entry), false);
+   }
+
+   bool insert(value_type&& entry)
+   {
+      return this->insertEntry(make_shared<value_type>(move(entry)), false);
+   }
+
+   template<typename InputIt> void insert(InputIt first, InputIt last)
+   {
+      for (; first != last; ++first)
+         insert(*first);
+   }
+
+   bool assign(const K& key, V val)
+   {
+      //insert or replace, returns true if the key was not there
+      return this->insertEntry(
+         make_shared<value_type>(key, move(val)), true);
+   }
+
+   const V& at(const K& key) const
+   {
+      auto node = this->findNode(key);
+      if (node == nullptr)
+         throw out_of_range("invalid persistent map key");
+
+      return node->entry_->second;
+   }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+template<typename T> struct PersistentSetKeyOf
+{
+   const T& operator()(const T& entry) const { return entry; }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+template<typename T> class PersistentSet :
+   public PersistentTree<T, T, PersistentSetKeyOf<T>>
+{
+public:
+   PersistentSet(void)
+   {}
+
+   template<typename InputIt> PersistentSet(InputIt first, InputIt last)
+   {
+      insert(first, last);
+   }
+
+   bool insert(const T& entry)
+   {
+      return this->insertEntry(make_shared<T>(entry), false);
+   }
+
+   bool insert(T&& entry)
+   {
+      return this->insertEntry(make_shared<T>(move(entry)), false);
+   }
+
+   template<typename InputIt> void insert(InputIt first, InputIt last)
+   {
+      for (; first != last; ++first)
+         insert(*first);
+   }
+};
+
+#endif
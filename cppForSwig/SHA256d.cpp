@@ -0,0 +1,547 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (C) 2017, goatpig.                                              //
+//  Distributed under the MIT license                                         //
+//  See LICENSE-MIT or https://opensource.org/licenses/MIT                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+
+#include "SHA256d.h"
+#include "cryptopp/sha.h"
+
+#if defined(__x86_64__) || defined(__i386__) || \
+    defined(_M_X64) || defined(_M_IX86)
+#define SHA256D_X86
+
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace
+{
+   const uint32_t SHA256_IV[8] =
+   {
+      0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+      0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+   };
+
+   const uint32_t SHA256_K[64] =
+   {
+      0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+      0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+      0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+      0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+      0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+      0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+      0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+      0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+      0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+      0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+      0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+      0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+      0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+      0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+      0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+      0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+   };
+
+   inline uint32_t readBE32(const uint8_t* ptr)
+   {
+      return (uint32_t(ptr[0]) << 24) | (uint32_t(ptr[1]) << 16) |
+         (uint32_t(ptr[2]) << 8) | uint32_t(ptr[3]);
+   }
+
+   inline void writeBE32(uint8_t* ptr, uint32_t val)
+   {
+      ptr[0] = uint8_t(val >> 24);
+      ptr[1] = uint8_t(val >> 16);
+      ptr[2] = uint8_t(val >> 8);
+      ptr[3] = uint8_t(val);
+   }
+
+   /////////////////////////////////////////////////////////////////////////////
+   // scalar, Crypto++ backed
+   /////////////////////////////////////////////////////////////////////////////
+   void sha256_scalar(const uint8_t* data, size_t len, uint8_t* out)
+   {
+      CryptoPP::SHA256 sha256_;
+      sha256_.CalculateDigest(out, data, len);
+   }
+
+   void hash256_scalar(const uint8_t* data, size_t len, uint8_t* out)
+   {
+      CryptoPP::SHA256 sha256_;
+      sha256_.CalculateDigest(out, data, len);
+      sha256_.CalculateDigest(out, out, 32);
+   }
+
+   void hash256_64_scalar(const uint8_t* in, uint8_t* out, size_t count)
+   {
+      CryptoPP::SHA256 sha256_;
+      uint8_t digest[32];
+
+      for (size_t i = 0; i < count; i++)
+      {
+         sha256_.CalculateDigest(digest, in + i * 64, 64);
+         sha256_.CalculateDigest(out + i * 32, digest, 32);
+      }
+   }
+
+#ifdef SHA256D_X86
+   /////////////////////////////////////////////////////////////////////////////
+   // cpu feature detection
+   /////////////////////////////////////////////////////////////////////////////
+   void cpuid(uint32_t leaf, uint32_t subleaf,
+      uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d)
+   {
+#ifdef _MSC_VER
+      int regs[4];
+      __cpuidex(regs, leaf, subleaf);
+      a = regs[0]; b = regs[1]; c = regs[2]; d = regs[3];
+#else
+      __cpuid_count(leaf, subleaf, a, b, c, d);
+#endif
+   }
+
+   bool osSavesYmm(void)
+   {
+#ifdef _MSC_VER
+      return (_xgetbv(0) & 6) == 6;
+#else
+      uint32_t a, d;
+      __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+      return (a & 6) == 6;
+#endif
+   }
+
+   struct CpuFeatures
+   {
+      bool sse41_ = false;
+      bool avx2_ = false;
+      bool shani_ = false;
+
+      CpuFeatures(void)
+      {
+         uint32_t a, b, c, d;
+         cpuid(0, 0, a, b, c, d);
+         auto maxLeaf = a;
+         if (maxLeaf < 1)
+            return;
+
+         cpuid(1, 0, a, b, c, d);
+         bool ssse3 = (c >> 9) & 1;
+         sse41_ = (c >> 19) & 1;
+         bool avx = ((c >> 27) & 1) && ((c >> 28) & 1) && osSavesYmm();
+
+         if (maxLeaf < 7)
+            return;
+
+         cpuid(7, 0, a, b, c, d);
+         avx2_ = avx && ((b >> 5) & 1);
+         shani_ = ssse3 && sse41_ && ((b >> 29) & 1);
+      }
+   };
+
+   const CpuFeatures& cpuFeatures(void)
+   {
+      static CpuFeatures features;
+      return features;
+   }
+
+////////////////////////////////////////////////////////////////////////////////
+// SSE4.1, 4 lanes
+////////////////////////////////////////////////////////////////////////////////
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("sse4.1"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+#endif
+
+   namespace sse41
+   {
+      typedef __m128i V;
+      const unsigned LANES = 4;
+
+      inline V K(uint32_t x) { return _mm_set1_epi32((int)x); }
+      inline V Add(V x, V y) { return _mm_add_epi32(x, y); }
+      inline V Xor(V x, V y) { return _mm_xor_si128(x, y); }
+      inline V Or(V x, V y) { return _mm_or_si128(x, y); }
+      inline V And(V x, V y) { return _mm_and_si128(x, y); }
+      template<int n> inline V ShR(V x) { return _mm_srli_epi32(x, n); }
+      template<int n> inline V ShL(V x) { return _mm_slli_epi32(x, n); }
+
+      inline V Read(const uint8_t* in, int word)
+      {
+         return _mm_set_epi32(
+            (int)readBE32(in + 192 + word * 4),
+            (int)readBE32(in + 128 + word * 4),
+            (int)readBE32(in + 64 + word * 4),
+            (int)readBE32(in + word * 4));
+      }
+
+      inline void Write(uint8_t* out, int word, V v)
+      {
+         writeBE32(out + word * 4, (uint32_t)_mm_extract_epi32(v, 0));
+         writeBE32(out + 32 + word * 4, (uint32_t)_mm_extract_epi32(v, 1));
+         writeBE32(out + 64 + word * 4, (uint32_t)_mm_extract_epi32(v, 2));
+         writeBE32(out + 96 + word * 4, (uint32_t)_mm_extract_epi32(v, 3));
+      }
+
+#include "SHA256d_lanes.h"
+   }
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// AVX2, 8 lanes
+////////////////////////////////////////////////////////////////////////////////
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+   namespace avx2
+   {
+      typedef __m256i V;
+      const unsigned LANES = 8;
+
+      inline V K(uint32_t x) { return _mm256_set1_epi32((int)x); }
+      inline V Add(V x, V y) { return _mm256_add_epi32(x, y); }
+      inline V Xor(V x, V y) { return _mm256_xor_si256(x, y); }
+      inline V Or(V x, V y) { return _mm256_or_si256(x, y); }
+      inline V And(V x, V y) { return _mm256_and_si256(x, y); }
+      template<int n> inline V ShR(V x) { return _mm256_srli_epi32(x, n); }
+      template<int n> inline V ShL(V x) { return _mm256_slli_epi32(x, n); }
+
+      inline V Read(const uint8_t* in, int word)
+      {
+         return _mm256_set_epi32(
+            (int)readBE32(in + 448 + word * 4),
+            (int)readBE32(in + 384 + word * 4),
+            (int)readBE32(in + 320 + word * 4),
+            (int)readBE32(in + 256 + word * 4),
+            (int)readBE32(in + 192 + word * 4),
+            (int)readBE32(in + 128 + word * 4),
+            (int)readBE32(in + 64 + word * 4),
+            (int)readBE32(in + word * 4));
+      }
+
+      inline void Write(uint8_t* out, int word, V v)
+      {
+         uint32_t lanes[8];
+         _mm256_storeu_si256((__m256i*)lanes, v);
+
+         for (int i = 0; i < 8; i++)
+            writeBE32(out + i * 32 + word * 4, lanes[i]);
+      }
+
+#include "SHA256d_lanes.h"
+   }
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// SHA extensions, single stream
+////////////////////////////////////////////////////////////////////////////////
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("sha,sse4.1"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sha,sse4.1")
+#endif
+
+   namespace shani
+   {
+      void transform(uint32_t* s, const uint8_t* data, size_t blocks)
+      {
+         const __m128i shufMask =
+            _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+         //state is kept as ABEF/CDGH for the sha256rnds2 instruction
+         __m128i tmp = _mm_loadu_si128((const __m128i*)&s[0]);
+         __m128i state1 = _mm_loadu_si128((const __m128i*)&s[4]);
+
+         tmp = _mm_shuffle_epi32(tmp, 0xB1);
+         state1 = _mm_shuffle_epi32(state1, 0x1B);
+         __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+         state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+         while (blocks-- > 0)
+         {
+            __m128i abefSave = state0;
+            __m128i cdghSave = state1;
+            __m128i msg[4];
+
+            for (int i = 0; i < 16; i++)
+            {
+               __m128i& cur = msg[i & 3];
+
+               if (i < 4)
+               {
+                  cur = _mm_shuffle_epi8(
+                     _mm_loadu_si128((const __m128i*)(data + i * 16)),
+                     shufMask);
+               }
+               else
+               {
+                  //W[t-16] + s0(W[t-15]) + W[t-7], then + s1(W[t-2])
+                  __m128i sched = _mm_add_epi32(
+                     _mm_sha256msg1_epu32(cur, msg[(i + 1) & 3]),
+                     _mm_alignr_epi8(msg[(i + 3) & 3], msg[(i + 2) & 3], 4));
+                  cur = _mm_sha256msg2_epu32(sched, msg[(i + 3) & 3]);
+               }
+
+               __m128i wk = _mm_add_epi32(cur,
+                  _mm_loadu_si128((const __m128i*)&SHA256_K[i * 4]));
+               state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+               wk = _mm_shuffle_epi32(wk, 0x0E);
+               state0 = _mm_sha256rnds2_epu32(state0, state1, wk);
+            }
+
+            state0 = _mm_add_epi32(state0, abefSave);
+            state1 = _mm_add_epi32(state1, cdghSave);
+            data += 64;
+         }
+
+         //back to ABCD/EFGH
+         tmp = _mm_shuffle_epi32(state0, 0x1B);
+         state1 = _mm_shuffle_epi32(state1, 0xB1);
+         state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+         state1 = _mm_alignr_epi8(state1, tmp, 8);
+
+         _mm_storeu_si128((__m128i*)&s[0], state0);
+         _mm_storeu_si128((__m128i*)&s[4], state1);
+      }
+   }
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+   /////////////////////////////////////////////////////////////////////////////
+   void sha256_shani(const uint8_t* data, size_t len, uint8_t* out)
+   {
+      uint32_t state[8];
+      memcpy(state, SHA256_IV, sizeof(state));
+
+      auto fullBlocks = len / 64;
+      shani::transform(state, data, fullBlocks);
+
+      //pad the tail, 1 or 2 blocks
+      uint8_t tail[128];
+      memset(tail, 0, sizeof(tail));
+
+      auto rem = len % 64;
+      memcpy(tail, data + fullBlocks * 64, rem);
+      tail[rem] = 0x80;
+
+      size_t tailBlocks = rem + 9 <= 64 ? 1 : 2;
+      uint64_t bitLen = uint64_t(len) * 8;
+      writeBE32(tail + tailBlocks * 64 - 8, uint32_t(bitLen >> 32));
+      writeBE32(tail + tailBlocks * 64 - 4, uint32_t(bitLen));
+
+      shani::transform(state, tail, tailBlocks);
+
+      for (int i = 0; i < 8; i++)
+         writeBE32(out + i * 4, state[i]);
+   }
+
+   /////////////////////////////////////////////////////////////////////////////
+   void hash256_shani(const uint8_t* data, size_t len, uint8_t* out)
+   {
+      uint8_t block[64];
+      sha256_shani(data, len, block);
+
+      //second pass is a single block over the 32 byte digest
+      memset(block + 32, 0, 32);
+      block[32] = 0x80;
+      block[62] = 0x01; //256 bits
+
+      uint32_t state[8];
+      memcpy(state, SHA256_IV, sizeof(state));
+      shani::transform(state, block, 1);
+
+      for (int i = 0; i < 8; i++)
+         writeBE32(out + i * 4, state[i]);
+   }
+
+   /////////////////////////////////////////////////////////////////////////////
+   void hash256_64_shani(const uint8_t* in, uint8_t* out, size_t count)
+   {
+      size_t i = 0;
+
+      //8 AVX2 lanes outrun one SHA-NI stream on full batches
+      if (cpuFeatures().avx2_)
+      {
+         for (; i + avx2::LANES <= count; i += avx2::LANES)
+            avx2::Hash256_64(out + i * 32, in + i * 64);
+      }
+
+      for (; i < count; i++)
+         hash256_shani(in + i * 64, 64, out + i * 32);
+   }
+
+   /////////////////////////////////////////////////////////////////////////////
+   void hash256_64_sse41(const uint8_t* in, uint8_t* out, size_t count)
+   {
+      size_t i = 0;
+      for (; i + sse41::LANES <= count; i += sse41::LANES)
+         sse41::Hash256_64(out + i * 32, in + i * 64);
+
+      hash256_64_scalar(in + i * 64, out + i * 32, count - i);
+   }
+
+   /////////////////////////////////////////////////////////////////////////////
+   void hash256_64_avx2(const uint8_t* in, uint8_t* out, size_t count)
+   {
+      size_t i = 0;
+      for (; i + avx2::LANES <= count; i += avx2::LANES)
+         avx2::Hash256_64(out + i * 32, in + i * 64);
+
+      hash256_64_sse41(in + i * 64, out + i * 32, count - i);
+   }
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool SHA256d::isSupported(SHA256Impl implType)
+{
+   switch (implType)
+   {
+   case SHA256Impl_Scalar:
+      return true;
+
+#ifdef SHA256D_X86
+   case SHA256Impl_SSE41:
+      return cpuFeatures().sse41_;
+
+   case SHA256Impl_AVX2:
+      return cpuFeatures().avx2_ && cpuFeatures().sse41_;
+
+   case SHA256Impl_SHANI:
+      return cpuFeatures().shani_;
+#endif
+
+   default:
+      return false;
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+SHA256Impl& SHA256d::impl(void)
+{
+   static SHA256Impl implType =
+      isSupported(SHA256Impl_SHANI) ? SHA256Impl_SHANI :
+      isSupported(SHA256Impl_AVX2) ? SHA256Impl_AVX2 :
+      isSupported(SHA256Impl_SSE41) ? SHA256Impl_SSE41 :
+      SHA256Impl_Scalar;
+
+   return implType;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+SHA256Impl SHA256d::getImplementation(void)
+{
+   return impl();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool SHA256d::setImplementation(SHA256Impl implType)
+{
+   if (!isSupported(implType))
+      return false;
+
+   impl() = implType;
+   return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+string SHA256d::getImplementationName(SHA256Impl implType)
+{
+   switch (implType)
+   {
+   case SHA256Impl_SSE41:
+      return "sse4.1 4-way";
+
+   case SHA256Impl_AVX2:
+      return "avx2 8-way";
+
+   case SHA256Impl_SHANI:
+      return "sha-ni";
+
+   default:
+      return "scalar";
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void SHA256d::getSha256(const uint8_t* data, size_t len, uint8_t* out)
+{
+#ifdef SHA256D_X86
+   if (impl() == SHA256Impl_SHANI)
+   {
+      sha256_shani(data, len, out);
+      return;
+   }
+#endif
+
+   sha256_scalar(data, len, out);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void SHA256d::getHash256(const uint8_t* data, size_t len, uint8_t* out)
+{
+   //lanes only help batches, single streams use SHA-NI or Crypto++
+#ifdef SHA256D_X86
+   if (impl() == SHA256Impl_SHANI)
+   {
+      hash256_shani(data, len, out);
+      return;
+   }
+#endif
+
+   hash256_scalar(data, len, out);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void SHA256d::getHash256_64(const uint8_t* in, uint8_t* out, size_t count)
+{
+   switch (impl())
+   {
+#ifdef SHA256D_X86
+   case SHA256Impl_SHANI:
+      hash256_64_shani(in, out, count);
+      return;
+
+   case SHA256Impl_AVX2:
+      hash256_64_avx2(in, out, count);
+      return;
+
+   case SHA256Impl_SSE41:
+      hash256_64_sse41(in, out, count);
+      return;
+#endif
+
+   default:
+      hash256_64_scalar(in, out, count);
+   }
+}
@@ -0,0 +1,67 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (C) 2017, goatpig.                                              //
+//  Distributed under the MIT license                                         //
+//  See LICENSE-MIT or https://opensource.org/licenses/MIT                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _SHA256D_H
+#define _SHA256D_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////
+enum SHA256Impl
+{
+   SHA256Impl_Scalar,
+   SHA256Impl_SSE41,
+   SHA256Impl_AVX2,
+   SHA256Impl_SHANI
+};
+
+////////////////////////////////////////////////////////////////////////////////
+class SHA256d
+{
+   /***
+   SHA256 and double SHA256 engine.
+
+   Single stream hashing (txids, block headers) runs on the SHA extensions
+   when the CPU has them and falls back to Crypto++ otherwise.
+
+   Batches of 64 byte messages (merkle tree nodes) are hashed across SIMD
+   lanes: 8 at a time with AVX2, 4 at a time with SSE4.1. SHA-NI cpus with
+   AVX2 still run full batches of 8 on the lanes, it's faster.
+
+   The implementation is picked once at runtime from cpuid. The SIMD code
+   is compiled per function with target attributes, so the build doesn't
+   need any -m flag.
+   ***/
+
+private:
+   static SHA256Impl& impl(void);
+
+public:
+   //sha256(data)
+   static void getSha256(const uint8_t* data, size_t len, uint8_t* out);
+
+   //sha256(sha256(data))
+   static void getHash256(const uint8_t* data, size_t len, uint8_t* out);
+
+   //count x sha256(sha256(64 bytes)), in and out can alias
+   static void getHash256_64(
+      const uint8_t* in, uint8_t* out, size_t count);
+
+   static SHA256Impl getImplementation(void);
+   static bool isSupported(SHA256Impl);
+
+   //for tests and benchmarks, returns false if the cpu lacks support
+   static bool setImplementation(SHA256Impl);
+   static string getImplementationName(SHA256Impl);
+};
+
+#endif
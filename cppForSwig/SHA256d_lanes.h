@@ -0,0 +1,100 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (C) 2017, goatpig.                                              //
+//  Distributed under the MIT license                                         //
+//  See LICENSE-MIT or https://opensource.org/licenses/MIT                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+/***
+Lane generic double SHA256 of 64 byte messages.
+
+This file has no include guard on purpose: SHA256d.cpp includes it once per
+instruction set, inside a namespace and a target pragma region that provide:
+
+   V                       the lane vector type
+   LANES                   the number of 32 bit lanes in V
+   K(uint32_t)             broadcast a constant to all lanes
+   Add, Xor, Or, And       lane wise ops
+   ShR<n>, ShL<n>          lane wise shifts
+   Read(in, word)          gather big endian word #word of each lane's input
+   Write(out, word, v)     scatter v as big endian word #word of each output
+***/
+
+template<int n> inline V Rotr(V x) { return Or(ShR<n>(x), ShL<32 - n>(x)); }
+
+inline V Ch(V x, V y, V z) { return Xor(z, And(x, Xor(y, z))); }
+inline V Maj(V x, V y, V z) { return Or(And(x, y), And(z, Or(x, y))); }
+
+inline V Sigma0(V x) { return Xor(Xor(Rotr<2>(x), Rotr<13>(x)), Rotr<22>(x)); }
+inline V Sigma1(V x) { return Xor(Xor(Rotr<6>(x), Rotr<11>(x)), Rotr<25>(x)); }
+inline V sigma0(V x) { return Xor(Xor(Rotr<7>(x), Rotr<18>(x)), ShR<3>(x)); }
+inline V sigma1(V x) { return Xor(Xor(Rotr<17>(x), Rotr<19>(x)), ShR<10>(x)); }
+
+////////////////////////////////////////////////////////////////////////////////
+inline void Compress(V* state, V* w)
+{
+   //w is the 16 word block, it is used as the message schedule ring
+   V a = state[0], b = state[1], c = state[2], d = state[3];
+   V e = state[4], f = state[5], g = state[6], h = state[7];
+
+   for (int i = 0; i < 64; i++)
+   {
+      if (i >= 16)
+      {
+         w[i & 15] = Add(Add(w[i & 15], sigma1(w[(i - 2) & 15])),
+            Add(w[(i - 7) & 15], sigma0(w[(i - 15) & 15])));
+      }
+
+      V t1 = Add(Add(h, Sigma1(e)),
+         Add(Ch(e, f, g), Add(K(SHA256_K[i]), w[i & 15])));
+      V t2 = Add(Sigma0(a), Maj(a, b, c));
+
+      h = g; g = f; f = e;
+      e = Add(d, t1);
+      d = c; c = b; b = a;
+      a = Add(t1, t2);
+   }
+
+   state[0] = Add(state[0], a); state[1] = Add(state[1], b);
+   state[2] = Add(state[2], c); state[3] = Add(state[3], d);
+   state[4] = Add(state[4], e); state[5] = Add(state[5], f);
+   state[6] = Add(state[6], g); state[7] = Add(state[7], h);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Hash256_64(uint8_t* out, const uint8_t* in)
+{
+   //LANES x 64 bytes in, LANES x 32 bytes out. All input is read before
+   //any output is written so out can alias in.
+   V state[8], w[16];
+
+   //first sha256, message block
+   for (int i = 0; i < 8; i++)
+      state[i] = K(SHA256_IV[i]);
+   for (int i = 0; i < 16; i++)
+      w[i] = Read(in, i);
+   Compress(state, w);
+
+   //first sha256, padding block of a 64 byte message
+   w[0] = K(0x80000000);
+   for (int i = 1; i < 15; i++)
+      w[i] = K(0);
+   w[15] = K(512);
+   Compress(state, w);
+
+   //second sha256 over the 32 byte digest
+   for (int i = 0; i < 8; i++)
+   {
+      w[i] = state[i];
+      state[i] = K(SHA256_IV[i]);
+   }
+   w[8] = K(0x80000000);
+   for (int i = 9; i < 15; i++)
+      w[i] = K(0);
+   w[15] = K(256);
+   Compress(state, w);
+
+   for (int i = 0; i < 8; i++)
+      Write(out, i, state[i]);
+}
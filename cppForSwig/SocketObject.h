@@ -64,6 +64,10 @@ protected:
 
    bool verbose_ = true;
 
+   //encoding of the commands sent through this socket, set once the
+   //server agreed to it at registerBDV
+   WireEncoding wireEncoding_ = WireHex;
+
 private:
    void readFromSocketThread(SOCKET, ReadCallback);
 
@@ -95,6 +99,9 @@ public:
    }
 
    virtual SocketType type(void) const { return SocketBinary; }
+
+   WireEncoding wireEncoding(void) const { return wireEncoding_; }
+   void setWireEncoding(WireEncoding encoding) { wireEncoding_ = encoding; }
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -50,6 +50,7 @@ void StoredDBInfo::unserializeDBValue(BinaryRefReader & brr)
    }
 
    armoryType_ = (ARMORY_DB_TYPE)bitunpack.getBits(4);
+   valueEncoding_ = (DB_VALUE_ENCODING)bitunpack.getBits(4);
    
    topBlkHgt_    = brr.get_uint32_t();
    appliedToHgt_ = brr.get_uint32_t();
@@ -65,6 +66,7 @@ void StoredDBInfo::serializeDBValue(BinaryWriter & bw ) const
    BitPacker<uint32_t> bitpack;
    bitpack.putBits((uint32_t)armoryVer_,   16);
    bitpack.putBits((uint32_t)armoryType_,  4);
+   bitpack.putBits((uint32_t)valueEncoding_, 4);
 
    bw.put_BinaryData(magic_);
    bw.put_BitPacker(bitpack);
@@ -1014,6 +1016,184 @@ void StoredTx::pprintFullTx(uint32_t indent)
       stxoMap_[i].pprintOneLine(indent+3);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Compact value encoding helpers
+//
+// Integers are LEB128 style varints (7 bits per byte, low bits first), 
+// signed deltas are zigzag mapped onto them. Standard output scripts are 
+// reduced to a dictionary byte followed by their hash.
+////////////////////////////////////////////////////////////////////////////////
+enum COMPACT_SCRIPT_TYPE
+{
+   COMPACT_SCRIPT_P2PKH,
+   COMPACT_SCRIPT_P2SH,
+   COMPACT_SCRIPT_P2WPKH,
+   COMPACT_SCRIPT_RAW = 0xFF
+};
+
+////////////////////////////////////////////////////////////////////////////////
+static void putCompactInt(BinaryWriter& bw, uint64_t val)
+{
+   while (val >= 0x80)
+   {
+      bw.put_uint8_t((uint8_t)(val | 0x80));
+      val >>= 7;
+   }
+
+   bw.put_uint8_t((uint8_t)val);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static uint64_t getCompactInt(BinaryRefReader& brr)
+{
+   uint64_t val = 0;
+   for (unsigned shift = 0; shift < 64; shift += 7)
+   {
+      auto byte = brr.get_uint8_t();
+      val |= uint64_t(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0)
+         return val;
+   }
+
+   throw runtime_error("invalid compact int");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void putCompactDelta(BinaryWriter& bw, int64_t delta)
+{
+   putCompactInt(bw, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static int64_t getCompactDelta(BinaryRefReader& brr)
+{
+   auto val = getCompactInt(brr);
+   return (int64_t)(val >> 1) ^ -(int64_t)(val & 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void putCompactScript(BinaryWriter& bw, BinaryDataRef script)
+{
+   auto ptr = script.getPtr();
+   switch (script.getSize())
+   {
+   case 25:
+      //OP_DUP OP_HASH160 <20> OP_EQUALVERIFY OP_CHECKSIG
+      if (ptr[0] == 0x76 && ptr[1] == 0xa9 && ptr[2] == 0x14 &&
+          ptr[23] == 0x88 && ptr[24] == 0xac)
+      {
+         bw.put_uint8_t(COMPACT_SCRIPT_P2PKH);
+         bw.put_BinaryData(ptr + 3, 20);
+         return;
+      }
+      break;
+
+   case 23:
+      //OP_HASH160 <20> OP_EQUAL
+      if (ptr[0] == 0xa9 && ptr[1] == 0x14 && ptr[22] == 0x87)
+      {
+         bw.put_uint8_t(COMPACT_SCRIPT_P2SH);
+         bw.put_BinaryData(ptr + 2, 20);
+         return;
+      }
+      break;
+
+   case 22:
+      //OP_0 <20>
+      if (ptr[0] == 0x00 && ptr[1] == 0x14)
+      {
+         bw.put_uint8_t(COMPACT_SCRIPT_P2WPKH);
+         bw.put_BinaryData(ptr + 2, 20);
+         return;
+      }
+      break;
+
+   default:
+      break;
+   }
+
+   bw.put_uint8_t(COMPACT_SCRIPT_RAW);
+   putCompactInt(bw, script.getSize());
+   bw.put_BinaryData(script);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void getCompactScript(BinaryRefReader& brr, BinaryWriter& bw)
+{
+   //appends the script to bw, with its var_int size
+   auto scriptType = brr.get_uint8_t();
+   switch (scriptType)
+   {
+   case COMPACT_SCRIPT_P2PKH:
+      bw.put_var_int(25);
+      bw.put_uint8_t(0x76);
+      bw.put_uint8_t(0xa9);
+      bw.put_uint8_t(0x14);
+      bw.put_BinaryDataRef(brr.get_BinaryDataRef(20));
+      bw.put_uint8_t(0x88);
+      bw.put_uint8_t(0xac);
+      break;
+
+   case COMPACT_SCRIPT_P2SH:
+      bw.put_var_int(23);
+      bw.put_uint8_t(0xa9);
+      bw.put_uint8_t(0x14);
+      bw.put_BinaryDataRef(brr.get_BinaryDataRef(20));
+      bw.put_uint8_t(0x87);
+      break;
+
+   case COMPACT_SCRIPT_P2WPKH:
+      bw.put_var_int(22);
+      bw.put_uint8_t(0x00);
+      bw.put_uint8_t(0x14);
+      bw.put_BinaryDataRef(brr.get_BinaryDataRef(20));
+      break;
+
+   case COMPACT_SCRIPT_RAW:
+   {
+      auto scriptSize = getCompactInt(brr);
+      bw.put_var_int(scriptSize);
+      bw.put_BinaryDataRef(brr.get_BinaryDataRef((uint32_t)scriptSize));
+      break;
+   }
+
+   default:
+      throw runtime_error("unknown compact script type");
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void putCompactTxKey(BinaryWriter& bw, BinaryDataRef key8B)
+{
+   //hgtx (3 bytes height, 1 byte dup) | txIdx (BE) | txIn/OutIdx (BE)
+   //height is written + 1, 0 flags a missing key
+   if (key8B.getSize() != 8)
+   {
+      bw.put_uint8_t(0);
+      return;
+   }
+
+   auto hgtx = READ_UINT32_BE(key8B.getPtr());
+   putCompactInt(bw, uint64_t(hgtx >> 8) + 1);
+   bw.put_uint8_t((uint8_t)hgtx);
+   putCompactInt(bw, READ_UINT16_BE(key8B.getPtr() + 4));
+   putCompactInt(bw, READ_UINT16_BE(key8B.getPtr() + 6));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static BinaryData getCompactTxKey(BinaryRefReader& brr)
+{
+   auto height = getCompactInt(brr);
+   if (height == 0)
+      return BinaryData();
+
+   BinaryWriter bw(8);
+   bw.put_uint32_t((uint32_t)(((height - 1) << 8) | brr.get_uint8_t()), BE);
+   bw.put_uint16_t((uint16_t)getCompactInt(brr), BE);
+   bw.put_uint16_t((uint16_t)getCompactInt(brr), BE);
+   return bw.getData();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void StoredTxOut::unserialize(BinaryData const & data)
 {
@@ -1078,6 +1258,25 @@ void StoredTxOut::unserializeDBValue(BinaryRefReader & brr)
    isCoinbase_  =                  bitunpack.getBit();
    auto dbType  = (ARMORY_DB_TYPE) bitunpack.getBits(2);
 
+   if (unserArmVer_ == STXO_COMPACT_VERSION)
+   {
+      //rebuild the raw TxOut: 8-byte value, var_int sz, pkscript
+      BinaryWriter bw;
+      bw.put_uint64_t(getCompactInt(brr));
+      getCompactScript(brr, bw);
+      dataCopy_ = bw.getData();
+
+      if (spentness_ == TXOUT_SPENT)
+         spentByTxInKey_ = getCompactTxKey(brr);
+
+      if (dbType != ARMORY_DB_SUPER)
+         return;
+
+      brr.get_BinaryData(parentHash_, 32);
+      txOutIndex_ = (uint16_t)getCompactInt(brr);
+      return;
+   }
+
    unserialize(brr);
    if(spentness_ == TXOUT_SPENT && brr.getSizeRemaining()>=8)
       spentByTxInKey_ = brr.get_BinaryData(8); 
@@ -1091,11 +1290,13 @@ void StoredTxOut::unserializeDBValue(BinaryRefReader & brr)
 
 ////////////////////////////////////////////////////////////////////////////////
 void StoredTxOut::serializeDBValue(BinaryWriter & bw, ARMORY_DB_TYPE dbType,
-                                   bool forceSaveSpentness) const
+                                   bool forceSaveSpentness,
+                                   DB_VALUE_ENCODING encoding) const
 {
    serializeDBValue(bw, dbType, forceSaveSpentness,
       txVersion_, isCoinbase_, spentness_, dataCopy_.getRef(),
-      spentByTxInKey_.getRef(), parentHash_.getRef(), txOutIndex_);
+      spentByTxInKey_.getRef(), parentHash_.getRef(), txOutIndex_,
+      encoding);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1107,7 +1308,8 @@ void StoredTxOut::serializeDBValue(
    const BinaryDataRef dataRef,
    const BinaryDataRef spentByTxIn,
    const BinaryDataRef hash,
-   uint16_t txoutindex)
+   uint16_t txoutindex,
+   DB_VALUE_ENCODING encoding)
 {
    TXOUT_SPENTNESS writeSpent = spentness;
 
@@ -1126,14 +1328,41 @@ void StoredTxOut::serializeDBValue(
       }
    }
 
+   bool compact = encoding == DB_ENCODING_COMPACT;
+
    BitPacker<uint16_t> bitpack;
-   bitpack.putBits((uint16_t)ARMORY_DB_VERSION, 4);
+   bitpack.putBits(compact ? 
+      (uint16_t)STXO_COMPACT_VERSION : (uint16_t)ARMORY_DB_VERSION, 4);
    bitpack.putBits((uint16_t)txVersion, 2);
    bitpack.putBits((uint16_t)writeSpent, 2);
    bitpack.putBit(isCoinbase);
    bitpack.putBits((uint16_t)dbType, 2);
 
    bw.put_BitPacker(bitpack);
+
+   if (compact)
+   {
+      //varint value, script dictionary entry
+      BinaryRefReader brr(dataRef);
+      putCompactInt(bw, brr.get_uint64_t());
+      auto scriptSize = (uint32_t)brr.get_var_int();
+      putCompactScript(bw, brr.get_BinaryDataRef(scriptSize));
+
+      if (writeSpent == TXOUT_SPENT)
+      {
+         if (spentByTxIn.getSize() == 0)
+            LOGERR << "Need to write out spentByTxIn but no spentness data";
+         putCompactTxKey(bw, spentByTxIn);
+      }
+
+      if (dbType != ARMORY_DB_SUPER)
+         return;
+
+      bw.put_BinaryData(hash);
+      putCompactInt(bw, txoutindex);
+      return;
+   }
+
    bw.put_BinaryData(dataRef);  // 8-byte value, var_int sz, pkscript
 
    if (writeSpent == TXOUT_SPENT)
@@ -1760,6 +1989,13 @@ void StoredSubHistory::unserializeDBValue(BinaryRefReader & brr)
    BinaryData fullTxKey(8);
    hgtX_.copyTo(fullTxKey.getPtr());
 
+   if (brr.getSizeRemaining() > 0 &&
+       *brr.getCurrPtr() == SUBSSH_COMPACT_MARKER)
+   {
+      unserializeCompactDBValue(brr, fullTxKey);
+      return;
+   }
+
    txioCount_ = (uint32_t)(brr.get_var_int());
    for (uint32_t i = 0; i<txioCount_; i++)
    {
@@ -1820,14 +2056,94 @@ void StoredSubHistory::getSummary(BinaryRefReader & brr)
    BinaryData fullTxKey(8);
    hgtX_.copyTo(fullTxKey.getPtr());
 
+   if (brr.getSizeRemaining() > 0 &&
+       *brr.getCurrPtr() == SUBSSH_COMPACT_MARKER)
+   {
+      brr.advance(2);
+      txioCount_ = (uint32_t)getCompactInt(brr);
+      return;
+   }
+
    txioCount_ = (uint32_t)(brr.get_var_int());
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void StoredSubHistory::unserializeCompactDBValue(
+   BinaryRefReader & brr, BinaryData& fullTxKey)
+{
+   brr.advance(1);
+   if (brr.get_uint8_t() != SUBSSH_COMPACT_VERSION)
+      throw runtime_error("unknown subssh value encoding");
+
+   //txout keys of spent entries are delta coded against this height, 
+   //tx indexes of the entry suffixes against the previous entry
+   auto height = READ_UINT32_BE(hgtX_.getPtr()) >> 8;
+   int64_t txIdx = 0;
+
+   txioCount_ = (uint32_t)getCompactInt(brr);
+   for (uint32_t i = 0; i<txioCount_; i++)
+   {
+      BitUnpacker<uint8_t> bitunpack(brr);
+      bool isFromSelf      = bitunpack.getBit();
+      bool isCoinbase      = bitunpack.getBit();
+      bool isSpent         = bitunpack.getBit();
+      bool isMulti         = bitunpack.getBit();
+      bool isUTXO          = bitunpack.getBit();
+
+      TxIOPair txio;
+      txio.setValue(getCompactInt(brr));
+      txio.setUTXO(isUTXO);
+
+      if (isSpent)
+      {
+         auto txOutHeight = (int64_t)height - getCompactDelta(brr);
+         auto dupId = brr.get_uint8_t();
+
+         BinaryWriter bwTxOut(8);
+         bwTxOut.put_uint32_t((uint32_t)((txOutHeight << 8) | dupId), BE);
+         bwTxOut.put_uint16_t((uint16_t)getCompactInt(brr), BE);
+         bwTxOut.put_uint16_t((uint16_t)getCompactInt(brr), BE);
+         txio.setTxOut(bwTxOut.getData());
+      }
+
+      txIdx += getCompactDelta(brr);
+      auto index = getCompactInt(brr);
+
+      auto keyPtr = fullTxKey.getPtr();
+      keyPtr[4] = (uint8_t)(txIdx >> 8);
+      keyPtr[5] = (uint8_t)txIdx;
+      keyPtr[6] = (uint8_t)(index >> 8);
+      keyPtr[7] = (uint8_t)index;
+
+      if (isSpent)
+         txio.setTxIn(fullTxKey);
+      else
+         txio.setTxOut(fullTxKey);
+
+      txio.setTxOutFromSelf(isFromSelf);
+      txio.setFromCoinbase(isCoinbase);
+      txio.setMultisig(isMulti);
+
+      BinaryData key8B = txio.getDBKeyOfOutput();
+
+      pair<BinaryData, TxIOPair> txioInsertPair(
+         move(key8B), move(txio));
+      txioMap_.insert(move(txioInsertPair));
+   }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void StoredSubHistory::serializeDBValue(BinaryWriter & bw, 
                                         LMDBBlockDatabase *db, 
-                                        ARMORY_DB_TYPE dbType) const
+                                        ARMORY_DB_TYPE dbType,
+                                        DB_VALUE_ENCODING encoding) const
 {
+   if (encoding == DB_ENCODING_COMPACT)
+   {
+      serializeCompactDBValue(bw, db);
+      return;
+   }
+
    bw.put_var_int(txioMap_.size());
    for(const auto& txioPair : txioMap_)
    {
@@ -1880,6 +2196,75 @@ void StoredSubHistory::serializeDBValue(BinaryWriter & bw,
    }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void StoredSubHistory::serializeCompactDBValue(BinaryWriter & bw,
+   LMDBBlockDatabase *db) const
+{
+   //marker | version | varint count, then per txio:
+   //   flags | varint value |
+   //   [spent: height delta | dup | varint txIdx | varint txOutIdx] |
+   //   txIdx delta from previous entry | varint txOut/txInIdx
+   //
+   //entry keys all start with the hgtX of this subssh, which the reader 
+   //gets from the DB key. Scanners do not always set hgtX_ on the object, 
+   //so heights are taken from the entry keys here.
+   int64_t prevTxIdx = 0;
+   uint32_t count = 0;
+
+   BinaryWriter bwTxios;
+   for (const auto& txioPair : txioMap_)
+   {
+      TxIOPair const & txio = txioPair.second;
+      bool isSpent = txio.hasTxInInMain(db);
+
+      if (isSpent && !txio.getTxRefOfInput().isInitialized())
+      {
+         LOGERR << "TxIO is spent, but input is not initialized";
+         continue;
+      }
+
+      BinaryData key8B = isSpent ? 
+         txio.getDBKeyOfInput() : txio.getDBKeyOfOutput();
+
+      if (!key8B.startsWith(hgtX_))
+        LOGERR << "How did TxIO key not match hgtX_??";
+
+      BitPacker<uint8_t> bitpack;
+      bitpack.putBit(txio.isTxOutFromSelf());
+      bitpack.putBit(txio.isFromCoinbase());
+      bitpack.putBit(isSpent);
+      bitpack.putBit(txio.isMultisig());
+      bitpack.putBit(txio.isUTXO());
+      bwTxios.put_BitPacker(bitpack);
+
+      putCompactInt(bwTxios, txio.getValue());
+
+      if (isSpent)
+      {
+         //full TxOut key, relative to the TxIn height this is saved at
+         auto&& txOutKey = txio.getDBKeyOfOutput();
+         auto txOutHgtx = READ_UINT32_BE(txOutKey.getPtr());
+         auto height = READ_UINT32_BE(key8B.getPtr()) >> 8;
+         putCompactDelta(bwTxios, (int64_t)height - (txOutHgtx >> 8));
+         bwTxios.put_uint8_t((uint8_t)txOutHgtx);
+         putCompactInt(bwTxios, READ_UINT16_BE(txOutKey.getPtr() + 4));
+         putCompactInt(bwTxios, READ_UINT16_BE(txOutKey.getPtr() + 6));
+      }
+
+      int64_t txIdx = READ_UINT16_BE(key8B.getPtr() + 4);
+      putCompactDelta(bwTxios, txIdx - prevTxIdx);
+      putCompactInt(bwTxios, READ_UINT16_BE(key8B.getPtr() + 6));
+      prevTxIdx = txIdx;
+
+      ++count;
+   }
+
+   bw.put_uint8_t(SUBSSH_COMPACT_MARKER);
+   bw.put_uint8_t(SUBSSH_COMPACT_VERSION);
+   putCompactInt(bw, count);
+   bw.put_BinaryDataRef(bwTxios.getDataRef());
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void StoredSubHistory::unserializeDBValue(BinaryData const & bd)
 {
@@ -30,6 +30,14 @@
 #define ARMORY_DB_DEFAULT   ARMORY_DB_FULL
 #define UTXO_STORAGE        SCRIPT_UTXO_VECTOR
 
+//compact STXO values carry this in the 4 bit version field of their flags
+#define STXO_COMPACT_VERSION     0x0F
+
+//compact SUBSSH values start with this byte, which a legacy txio count 
+//never does (it would announce more than 4 billion txios), then a version
+#define SUBSSH_COMPACT_MARKER    0xFF
+#define SUBSSH_COMPACT_VERSION   0x01
+
 enum DB_TX_AVAIL
 {
   DB_TX_EXISTS,
@@ -67,6 +75,12 @@ enum TXOUT_SPENTNESS
   TXOUT_SPENTUNK,
 };
 
+enum DB_VALUE_ENCODING
+{
+  DB_ENCODING_LEGACY,
+  DB_ENCODING_COMPACT
+};
+
 enum MERKLE_SER_TYPE
 {
   MERKLE_SER_NONE,
@@ -127,6 +141,10 @@ public:
    uint32_t        appliedToHgt_=0;
    uint32_t        armoryVer_=ARMORY_DB_VERSION;
    ARMORY_DB_TYPE  armoryType_=ARMORY_DB_FULL; //default db mode
+   
+   //value layout of STXO & SUBSSH entries written to this DB, picked once 
+   //when the DB is created. Readers handle both layouts either way.
+   DB_VALUE_ENCODING valueEncoding_=DB_ENCODING_LEGACY;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -154,7 +172,8 @@ public:
 
    void       unserializeDBValue(BinaryRefReader &  brr);
    void       serializeDBValue(BinaryWriter & bw, ARMORY_DB_TYPE dbType,
-               bool forceSaveSpent = false) const;
+               bool forceSaveSpent = false,
+               DB_VALUE_ENCODING encoding = DB_ENCODING_LEGACY) const;
    void       unserializeDBValue(BinaryData const & bd);
    void       unserializeDBValue(BinaryDataRef      bd);
    void       unserializeDBKey(BinaryDataRef key);
@@ -167,7 +186,8 @@ public:
       const BinaryDataRef dataRef,
       const BinaryDataRef spentByTxIn,
       const BinaryDataRef hash,
-      uint16_t txoutindex);
+      uint16_t txoutindex,
+      DB_VALUE_ENCODING encoding = DB_ENCODING_LEGACY);
 
    BinaryData getDBKey(bool withPrefix = true) const;
    BinaryData getDBKeyOfParentTx(bool withPrefix = true) const;
@@ -447,12 +467,21 @@ public:
 
    void       unserializeDBValue(BinaryRefReader & brr);
    void       serializeDBValue(BinaryWriter    & bw, 
-               LMDBBlockDatabase *db, ARMORY_DB_TYPE dbType) const;
+               LMDBBlockDatabase *db, ARMORY_DB_TYPE dbType,
+               DB_VALUE_ENCODING encoding = DB_ENCODING_LEGACY) const;
    void       unserializeDBValue(BinaryData const & bd);
    void       unserializeDBValue(BinaryDataRef      bd);
    void       unserializeDBKey(BinaryDataRef key, bool withPrefix=true);
    void       getSummary(BinaryRefReader & brr);
 
+private:
+   void       unserializeCompactDBValue(BinaryRefReader & brr,
+               BinaryData& fullTxKey);
+   void       serializeCompactDBValue(BinaryWriter & bw,
+               LMDBBlockDatabase *db) const;
+
+public:
+
    BinaryData    getDBKey(bool withPrefix=true) const;
    SCRIPT_PREFIX getScriptType(void) const;
    //uint64_t      getTxioCount(void) const {return (uint64_t)txioMap_.size();}
@@ -45,21 +45,22 @@ void HttpSocket::resetHeaders()
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-int32_t HttpSocket::makePacket(char** packet, const char* msg)
+int32_t HttpSocket::makePacket(
+   char** packet, const char* msg, size_t msglen)
 {
    if (packet == nullptr)
       return -1;
 
    stringstream ss;
    ss << "Content-Length: ";
-   ss << strlen(msg);
+   ss << msglen;
    ss << "\r\n\r\n";
 
    size_t httpHeaderSize = 0;
    for (auto& header : headers_)
       httpHeaderSize += header.size();
 
-   *packet = new char[strlen(msg) +
+   *packet = new char[msglen +
       ss.str().size() +
       httpHeaderSize +
       1];
@@ -74,8 +75,8 @@ int32_t HttpSocket::makePacket(char** packet, const char* msg)
    memcpy(*packet + pos, ss.str().c_str(), ss.str().size());
    pos += ss.str().size();
 
-   memcpy(*packet + pos, msg, strlen(msg));
-   pos += strlen(msg);
+   memcpy(*packet + pos, msg, msglen);
+   pos += msglen;
 
    memset(*packet + pos, 0, 1);
    return pos;
@@ -85,7 +86,8 @@ int32_t HttpSocket::makePacket(char** packet, const char* msg)
 string HttpSocket::getBody(vector<uint8_t> msg)
 {
    /***
-   Always expect text data (null terminated)
+   The body is either hex text or a binary frame, which may carry null 
+   bytes. Only the header is parsed as text.
    ***/
 
    //look for double crlf http header end, return everything after that
@@ -115,7 +117,7 @@ string HttpSocket::writeAndRead(const string& msg, SOCKET sockfd)
 {
 
    char* packet = nullptr;
-   auto packetSize = makePacket(&packet, msg.c_str());
+   auto packetSize = makePacket(&packet, msg.c_str(), msg.size());
 
    typedef vector<char>::iterator vecIterType;
 
@@ -232,7 +234,7 @@ HttpSocket(obj)
 ///////////////////////////////////////////////////////////////////////////////
 string FcgiSocket::writeAndRead(const string& msg, SOCKET sockfd)
 {
-   auto&& fcgiMsg = FcgiMessage::makePacket(msg.c_str());
+   auto&& fcgiMsg = FcgiMessage::makePacket(msg.c_str(), msg.size());
    auto serdata = fcgiMsg.serialize();
    auto serdatalength = fcgiMsg.getSerializedDataLength();
 
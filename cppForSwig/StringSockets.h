@@ -77,7 +77,7 @@ private:
    };
 
 private:
-   int32_t makePacket(char** packet, const char* msg);
+   int32_t makePacket(char** packet, const char* msg, size_t msglen);
    string getBody(vector<uint8_t>);
    void setupHeaders(void);
 
@@ -45,16 +45,24 @@ void BlockDataViewer::registerWithDB(BinaryData magic_word)
    //get bdvID
    try
    {
+      //registration is always hex, it negotiates the binary wire for
+      //the commands that follow
       Command cmd;
       cmd.method_ = "registerBDV";
       BinaryDataObject bdo(move(magic_word));
       cmd.args_.push_back(move(bdo));
-      cmd.serialize();
+      cmd.args_.push_back(move(IntType(WIRE_BINARY_VERSION)));
+      cmd.serialize(WireHex);
 
       auto&& result = sock_->writeAndRead(cmd.command_);
       Arguments args(move(result));
       auto&& bdoID = args.get<BinaryDataObject>();
       bdvID_ = bdoID.toStr();
+
+      //older servers don't answer the binary wire offer
+      if (args.hasArgs() && 
+         args.get<IntType>().getVal() == WIRE_BINARY_VERSION)
+         sock_->setWireEncoding(WireBinary);
    }
    catch (runtime_error &e)
    {
@@ -69,7 +77,7 @@ void BlockDataViewer::unregisterFromDB()
    Command cmd;
    cmd.method_ = "unregisterBDV";
    cmd.ids_.push_back(bdvID_);
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
    auto&& result = sock_->writeAndRead(cmd.command_);
 }
 
@@ -79,7 +87,7 @@ void BlockDataViewer::goOnline()
    Command cmd;
    cmd.method_ = "goOnline";
    cmd.ids_.push_back(bdvID_);
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
    auto&& result = sock_->writeAndRead(cmd.command_);
 }
 
@@ -116,7 +124,7 @@ void BlockDataViewer::shutdown(const string& cookie)
       cmd.args_.push_back(move(bdo));
    }
 
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
    auto&& result = sock_->writeAndRead(cmd.command_);
 }
 
@@ -132,7 +140,7 @@ void BlockDataViewer::shutdownNode(const string& cookie)
       cmd.args_.push_back(move(bdo));
    }
 
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
    sock_->writeAndRead(cmd.command_);
 }
 
@@ -149,7 +157,7 @@ SwigClient::BtcWallet BlockDataViewer::registerWallet(
 
    cmd.method_ = "registerWallet";
    cmd.ids_.push_back(bdvID_);
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
    auto&& result = sock_->writeAndRead(cmd.command_);
 
    //check result
@@ -174,7 +182,7 @@ Lockbox BlockDataViewer::registerLockbox(
 
    cmd.method_ = "registerLockbox";
    cmd.ids_.push_back(bdvID_);
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
    auto&& result = sock_->writeAndRead(cmd.command_);
 
    //check result
@@ -193,7 +201,7 @@ LedgerDelegate BlockDataViewer::getLedgerDelegateForWallets()
 
    cmd.method_ = "getLedgerDelegateForWallets";
    cmd.ids_.push_back(bdvID_);
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
 
    auto&& result = sock_->writeAndRead(cmd.command_);
 
@@ -211,7 +219,7 @@ LedgerDelegate BlockDataViewer::getLedgerDelegateForLockboxes()
 
    cmd.method_ = "getLedgerDelegateForLockboxes";
    cmd.ids_.push_back(bdvID_);
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
 
    auto&& result = sock_->writeAndRead(cmd.command_);
 
@@ -240,7 +248,7 @@ void BlockDataViewer::broadcastZC(const BinaryData& rawTx)
    cmd.method_ = "broadcastZC";
    cmd.ids_.push_back(bdvID_);
    cmd.args_.push_back(BinaryDataObject(rawTx));
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
 
    sock_->writeAndRead(cmd.command_);
 }
@@ -270,7 +278,7 @@ Tx BlockDataViewer::getTxByHash(const BinaryData& txHash)
    cmd.method_ = "getTxByHash";
    cmd.ids_.push_back(bdvID_);
    cmd.args_.push_back(BinaryDataObject(bdRef));
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
 
    auto&& result = sock_->writeAndRead(cmd.command_);
 
@@ -308,7 +316,7 @@ BinaryData BlockDataViewer::getRawHeaderForTxHash(const BinaryData& txHash)
    cmd.method_ = "getRawHeaderForTxHash";
    cmd.ids_.push_back(bdvID_);
    cmd.args_.push_back(BinaryDataObject(bdRef));
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
 
    auto&& result = sock_->writeAndRead(cmd.command_);
 
@@ -332,7 +340,7 @@ LedgerDelegate BlockDataViewer::getLedgerDelegateForScrAddr(
    BinaryDataObject bdo(scrAddr);
    cmd.args_.push_back(move(bdo));
 
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
 
    auto&& result = sock_->writeAndRead(cmd.command_);
 
@@ -357,7 +365,7 @@ void BlockDataViewer::updateWalletsLedgerFilter(
       bdVec.push_back(move(bd));
 
    cmd.args_.push_back(move(bdVec));
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
 
    auto&& result = sock_->writeAndRead(cmd.command_);
 }
@@ -370,7 +378,7 @@ NodeStatusStruct BlockDataViewer::getNodeStatus()
    cmd.method_ = "getNodeStatus";
    cmd.ids_.push_back(bdvID_);
 
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
    auto&& result = sock_->writeAndRead(cmd.command_);
 
    Arguments retval(result);
@@ -393,7 +401,7 @@ float BlockDataViewer::estimateFee(unsigned blocksToConfirm)
    IntType inttype(blocksToConfirm);
 
    cmd.args_.push_back(move(inttype));
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
 
    auto&& result = sock_->writeAndRead(cmd.command_);
    Arguments args(result);
@@ -423,7 +431,7 @@ vector<LedgerEntryData> BlockDataViewer::getHistoryForWalletSelection(
 
    cmd.args_.push_back(move(bdVec));
    cmd.args_.push_back(move(bdo));
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
 
    auto&& result = sock_->writeAndRead(cmd.command_);
    Arguments args(result);
@@ -445,7 +453,7 @@ uint64_t BlockDataViewer::getValueForTxOut(
 
    cmd.args_.push_back(move(bdo));
    cmd.args_.push_back(move(it_inputid));
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
 
    auto&& result = sock_->writeAndRead(cmd.command_);
    Arguments args(result);
@@ -464,7 +472,7 @@ string BlockDataViewer::broadcastThroughRPC(const BinaryData& rawTx)
    BinaryDataObject bdo(rawTx);
 
    cmd.args_.push_back(move(bdo));
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
 
    auto&& result = sock_->writeAndRead(cmd.command_);
    Arguments args(result);
@@ -493,7 +501,7 @@ void BlockDataViewer::registerAddrList(
 
    cmd.args_.push_back(move(bdo));
    cmd.args_.push_back(move(bdVec));
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
 
    auto&& result = sock_->writeAndRead(cmd.command_);
 }
@@ -512,7 +520,7 @@ vector<UTXO> BlockDataViewer::getUtxosForAddrVec(
       bdVec.push_back(move(addr));
 
    cmd.args_.push_back(move(bdVec));
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
 
    auto&& result = sock_->writeAndRead(cmd.command_);
    Arguments arg(move(result));
@@ -551,7 +559,7 @@ vector<LedgerEntryData> LedgerDelegate::getHistoryPage(uint32_t id)
 
    cmd.args_.push_back(move(IntType(id)));
 
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
 
    auto&& retval = sock_->writeAndRead(cmd.command_);
    Arguments arg(retval);
@@ -582,7 +590,7 @@ vector<uint64_t> SwigClient::BtcWallet::getBalancesAndCount(
    unsigned int ignorezc = IGNOREZC;
    cmd.args_.push_back(move(IntType(blockheight)));
 
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
 
    auto&& retval = sock_->writeAndRead(cmd.command_);
    Arguments arg(retval);
@@ -611,7 +619,7 @@ vector<UTXO> SwigClient::BtcWallet::getSpendableTxOutListForValue(uint64_t val)
 
    cmd.args_.push_back(move(IntType(val)));
 
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
 
    auto&& retval = sock_->writeAndRead(cmd.command_);
    Arguments arg(move(retval));
@@ -638,7 +646,7 @@ vector<UTXO> SwigClient::BtcWallet::getSpendableZCList()
    cmd.ids_.push_back(bdvID_);
    cmd.ids_.push_back(walletID_);
 
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
 
    auto&& retval = sock_->writeAndRead(cmd.command_);
    Arguments arg(move(retval));
@@ -664,7 +672,7 @@ vector<UTXO> SwigClient::BtcWallet::getRBFTxOutList()
    cmd.ids_.push_back(bdvID_);
    cmd.ids_.push_back(walletID_);
 
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
 
    auto&& retval = sock_->writeAndRead(cmd.command_);
    Arguments arg(move(retval));
@@ -689,7 +697,7 @@ map<BinaryData, uint32_t> SwigClient::BtcWallet::getAddrTxnCountsFromDB()
    cmd.method_ = "getAddrTxnCounts";
    cmd.ids_.push_back(bdvID_);
    cmd.ids_.push_back(walletID_);
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
 
    auto&& retval = sock_->writeAndRead(cmd.command_);
    Arguments arg(move(retval));
@@ -716,7 +724,7 @@ SwigClient::BtcWallet::getAddrBalancesFromDB(void)
    cmd.method_ = "getAddrBalances";
    cmd.ids_.push_back(bdvID_);
    cmd.ids_.push_back(walletID_);
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
 
    auto&& retval = sock_->writeAndRead(cmd.command_);
    Arguments arg(move(retval));
@@ -748,7 +756,7 @@ vector<LedgerEntryData> SwigClient::BtcWallet::getHistoryPage(uint32_t id)
 
    cmd.args_.push_back(move(IntType(id)));
 
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
 
    auto&& retval = sock_->writeAndRead(cmd.command_);
    Arguments arg(retval);
@@ -771,7 +779,7 @@ LedgerEntryData SwigClient::BtcWallet::getLedgerEntryForTxHash(
    //the ledger entry for the tx instead of a page
    cmd.args_.push_back(move(BinaryDataObject(txhash)));
 
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
 
    auto&& retval = sock_->writeAndRead(cmd.command_);
    Arguments arg(retval);
@@ -797,7 +805,7 @@ vector<AddressBookEntry> SwigClient::BtcWallet::createAddressBook(void) const
    cmd.ids_.push_back(bdvID_);
    cmd.ids_.push_back(walletID_);
 
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
 
    auto&& retval = sock_->writeAndRead(cmd.command_);
    Arguments arg(move(retval));
@@ -874,7 +882,7 @@ vector<UTXO> ScrAddrObj::getSpendableTxOutList(bool ignoreZC)
    cmd.args_.push_back(move(bdo));
    cmd.args_.push_back(move(IntType(ignoreZC)));
 
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
 
    auto&& retval = sock_->writeAndRead(cmd.command_);
    Arguments arg(move(retval));
@@ -912,7 +920,7 @@ bool Blockchain::hasHeaderWithHash(const BinaryData& hash)
 
    BinaryDataObject bdo(hash);
    cmd.args_.push_back(move(bdo));
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
 
    auto&& retval = sock_->writeAndRead(cmd.command_);
    Arguments arg(retval);
@@ -929,7 +937,7 @@ BlockHeader Blockchain::getHeaderByHeight(unsigned height)
    cmd.method_ = "getHeaderByHeight";
    cmd.ids_.push_back(bdvID_);
    cmd.args_.push_back(move(IntType(height)));
-   cmd.serialize();
+   cmd.serialize(sock_->wireEncoding());
 
    auto&& result = sock_->writeAndRead(cmd.command_);
 
@@ -1017,7 +1025,7 @@ void PythonCallback::remoteLoop(void)
    sendCmd.ids_.push_back(bdvID_);
    BinaryDataObject bdo("waitOnBDV");
    sendCmd.args_.push_back(move(bdo));
-   sendCmd.serialize();
+   sendCmd.serialize(sock_->wireEncoding());
 
    bool isReady = false;
 
@@ -1087,7 +1095,7 @@ void PythonCallback::remoteLoop(void)
                sendCmd.args_.clear();
                BinaryDataObject status("getStatus");
                sendCmd.args_.push_back(move(status));
-               sendCmd.serialize();
+               sendCmd.serialize(sock_->wireEncoding());
 
                unsigned int topblock = args.get<IntType>().getVal();
                bdvPtr_->setTopBlock(topblock);
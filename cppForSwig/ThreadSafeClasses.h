@@ -21,6 +21,7 @@
 #include <iostream>
 
 #include "make_unique.h"
+#include "PersistentMap.h"
 
 using namespace std;
 
@@ -398,9 +399,15 @@ public:
 template<typename T, typename U> class TransactionalMap
 {
    //locked writes, lockless reads
+
+   /***
+   Readers get an immutable snapshot. Snapshots share their structure, 
+   a write path-copies O(log n) nodes instead of copying the whole map.
+   ***/
+
 private:
    mutable mutex mu_;
-   shared_ptr<map<T, U>> map_;
+   shared_ptr<const PersistentMap<T, U>> map_;
    atomic<size_t> count_;
 
 public:
@@ -408,15 +415,13 @@ public:
    TransactionalMap(void)
    {
       count_.store(0, memory_order_relaxed);
-      map_ = make_shared<map<T, U>>();
+      map_ = make_shared<PersistentMap<T, U>>();
    }
 
    void insert(pair<T, U>&& mv)
    {
-      auto newMap = make_shared<map<T, U>>();
-
       unique_lock<mutex> lock(mu_);
-      *newMap = *map_;
+      auto newMap = make_shared<PersistentMap<T, U>>(*map_);
 
       newMap->insert(move(mv));
       map_ = newMap;
@@ -425,10 +430,8 @@ public:
 
    void insert(const pair<T, U>& obj)
    {
-      auto newMap = make_shared<map<T, U>>();
-
       unique_lock<mutex> lock(mu_);
-      *newMap = *map_;
+      auto newMap = make_shared<PersistentMap<T, U>>(*map_);
 
       newMap->insert(obj);
       map_ = newMap;
@@ -437,13 +440,15 @@ public:
 
    void update(map<T, U> updatemap)
    {
+      //entries in updatemap replace existing ones
       if (updatemap.size() == 0)
          return;
 
-      auto newMap = make_shared<map<T, U>>( move(updatemap));
-
       unique_lock<mutex> lock(mu_);
-      newMap->insert(map_->begin(), map_->end());
+      auto newMap = make_shared<PersistentMap<T, U>>(*map_);
+
+      for (auto& entry : updatemap)
+         newMap->assign(entry.first, move(entry.second));
 
       map_ = newMap;
       count_.store(map_->size(), memory_order_relaxed);
@@ -453,14 +458,10 @@ public:
    {
       unique_lock<mutex> lock(mu_);
 
-      auto iter = map_->find(id);
-      if (iter == map_->end())
+      auto newMap = make_shared<PersistentMap<T, U>>(*map_);
+      if (newMap->erase(id) == 0)
          return;
 
-      auto newMap = make_shared<map<T, U>>();
-      *newMap = *map_;
-
-      newMap->erase(id);
       map_ = newMap;
       count_.store(map_->size(), memory_order_relaxed);
    }
@@ -470,10 +471,8 @@ public:
       if (idVec.size() == 0)
          return;
 
-      auto newMap = make_shared<map<T, U>>();
-
       unique_lock<mutex> lock(mu_);
-      *newMap = *map_;
+      auto newMap = make_shared<PersistentMap<T, U>>(*map_);
 
       bool erased = false;
       for (auto& id : idVec)
@@ -488,9 +487,9 @@ public:
       count_.store(map_->size(), memory_order_relaxed);
    }
 
-   shared_ptr<map<T, U>> pop_all(void)
+   shared_ptr<const PersistentMap<T, U>> pop_all(void)
    {
-      auto newMap = make_shared<map<T, U>>();
+      auto newMap = make_shared<PersistentMap<T, U>>();
       unique_lock<mutex> lock(mu_);
       
       auto retMap = map_;
@@ -500,7 +499,7 @@ public:
       return retMap;
    }
 
-   shared_ptr<map<T, U>> get(void) const
+   shared_ptr<const PersistentMap<T, U>> get(void) const
    {
       unique_lock<mutex> lock(mu_);
       return map_;
@@ -508,7 +507,7 @@ public:
 
    void clear(void)
    {
-      auto newMap = make_shared<map<T, U>>();
+      auto newMap = make_shared<PersistentMap<T, U>>();
       unique_lock<mutex> lock(mu_);
 
       map_ = newMap;
@@ -524,10 +523,10 @@ public:
 ////////////////////////////////////////////////////////////////////////////////
 template<typename T> class TransactionalSet
 {
-   //locked writes, lockless reads
+   //locked writes, lockless reads, structure sharing snapshots
 private:
    mutable mutex mu_;
-   shared_ptr<set<T>> set_;
+   shared_ptr<const PersistentSet<T>> set_;
    atomic<size_t> count_;
 
 public:
@@ -535,15 +534,13 @@ public:
    TransactionalSet(void)
    {
       count_.store(0, memory_order_relaxed);
-      set_ = make_shared<set<T>>();
+      set_ = make_shared<PersistentSet<T>>();
    }
 
    void insert(T&& mv)
    {
-      auto newSet = make_shared<set<T>>();
-
       unique_lock<mutex> lock(mu_);
-      *newSet = *set_;
+      auto newSet = make_shared<PersistentSet<T>>(*set_);
 
       newSet->insert(move(mv));
       set_ = newSet;
@@ -552,10 +549,8 @@ public:
 
    void insert(const T& obj)
    {
-      auto newSet = make_shared<set<T>>();
-
       unique_lock<mutex> lock(mu_);
-      *newSet = *set_;
+      auto newSet = make_shared<PersistentSet<T>>(*set_);
 
       newSet->insert(obj);
       set_ = newSet;
@@ -567,10 +562,8 @@ public:
       if (dataSet.size() == 0)
          return;
 
-      auto newSet = make_shared<set<T>>();
-
       unique_lock<mutex> lock(mu_);
-      *newSet = *set_;
+      auto newSet = make_shared<PersistentSet<T>>(*set_);
 
       newSet->insert(dataSet.begin(), dataSet.end());
       set_ = newSet;
@@ -581,14 +574,10 @@ public:
    {
       unique_lock<mutex> lock(mu_);
       
-      auto iter = set_->find(id);
-      if (iter == set_->end())
+      auto newSet = make_shared<PersistentSet<T>>(*set_);
+      if (newSet->erase(id) == 0)
          return;
 
-      auto newSet = make_shared<set<T>>();
-      *newSet = *set_;
-
-      newSet->erase(id);
       set_ = newSet;
       count_.store(set_->size(), memory_order_relaxed);
    }
@@ -598,10 +587,8 @@ public:
       if (idVec.size() == 0)
          return;
 
-      auto newSet = make_shared<set<T>>();
-
       unique_lock<mutex> lock(mu_);
-      *newSet = *set_;
+      auto newSet = make_shared<PersistentSet<T>>(*set_);
 
       bool erased = false;
       for (auto& id : idVec)
@@ -615,9 +602,9 @@ public:
       count_.store(set_->size(), memory_order_relaxed);
    }
 
-   shared_ptr<set<T>> pop_all(void)
+   shared_ptr<const PersistentSet<T>> pop_all(void)
    {
-      auto newSet = make_shared<set<T>>();
+      auto newSet = make_shared<PersistentSet<T>>();
       unique_lock<mutex> lock(mu_);
 
       auto retSet = set_;
@@ -627,7 +614,7 @@ public:
       return retSet;
    }
 
-   shared_ptr<set<T>> get(void) const
+   shared_ptr<const PersistentSet<T>> get(void) const
    {
       unique_lock<mutex> lock(mu_);
       return set_;
@@ -635,7 +622,7 @@ public:
 
    void clear(void)
    {
-      auto newSet = make_shared<set<T>>();
+      auto newSet = make_shared<PersistentSet<T>>();
       unique_lock<mutex> lock(mu_);
 
       set_ = newSet;
@@ -902,6 +889,12 @@ public:
       return T();
    }
 
+   T try_pop_front(void)
+   {
+      //throws IsEmpty instead of blocking
+      return move(Stack<T>::pop_front(false));
+   }
+
    void push_back(T&& obj)
    {
       auto completed = completed_.load(memory_order_acquire);
@@ -0,0 +1,343 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (C) 2017, goatpig.                                              //
+//  Distributed under the MIT license                                         //
+//  See LICENSE-MIT or https://opensource.org/licenses/MIT                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "UtxoSnapshot.h"
+
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
+
+#define UTXO_SNAPSHOT_HEADER_SIZE 48
+
+////////////////////////////////////////////////////////////////////////////////
+static bool syncFile(const string& path)
+{
+   //push the file content to disk, ofstream::flush only reaches the OS
+#ifdef _WIN32
+   auto fd = _open(path.c_str(), _O_RDWR | _O_BINARY);
+   if (fd == -1)
+      return false;
+
+   auto result = _commit(fd);
+   _close(fd);
+#else
+   auto fd = open(path.c_str(), O_RDONLY);
+   if (fd == -1)
+      return false;
+
+   auto result = fsync(fd);
+   close(fd);
+#endif
+
+   return result == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void syncParentDir(const string& path)
+{
+   //persists the rename. Best effort, Windows can't sync directories and 
+   //some file systems don't support it
+#ifndef _WIN32
+   auto pos = path.find_last_of('/');
+   string dir = pos == string::npos ? "." : path.substr(0, max(pos, size_t(1)));
+
+   auto fd = open(dir.c_str(), O_RDONLY);
+   if (fd == -1)
+      return;
+
+   fsync(fd);
+   close(fd);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+StoredTxOut UtxoSnapshot::Entry::getStoredTxOut() const
+{
+   StoredTxOut stxo;
+   stxo.unserializeDBKey(dbKey_);
+   stxo.unserializeDBValue(value_);
+   stxo.parentHash_ = txHash_;
+   stxo.scrAddr_ = scrAddr_;
+
+   return stxo;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+UtxoSnapshot::UtxoSnapshot(const string& path)
+{
+   load(path);
+
+   try
+   {
+      validate();
+   }
+   catch (exception&)
+   {
+      release();
+      throw;
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+UtxoSnapshot::~UtxoSnapshot()
+{
+   release();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void UtxoSnapshot::release()
+{
+   if (data_ == nullptr)
+      return;
+
+#ifndef _WIN32
+   if (mapped_)
+      munmap(data_, size_);
+   else
+#endif
+      delete[] data_;
+
+   data_ = nullptr;
+   size_ = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void UtxoSnapshot::load(const string& path)
+{
+#ifdef _WIN32
+   int fd = _open(path.c_str(), _O_RDONLY | _O_BINARY);
+   if (fd == -1)
+      throw runtime_error("failed to open utxo snapshot");
+
+   auto fileSize = (size_t)_lseeki64(fd, 0, SEEK_END);
+   _lseeki64(fd, 0, SEEK_SET);
+   if (fileSize < UTXO_SNAPSHOT_HEADER_SIZE)
+   {
+      _close(fd);
+      throw runtime_error("utxo snapshot is too short");
+   }
+
+   data_ = new uint8_t[fileSize];
+   size_t pos = 0;
+   while (pos < fileSize)
+   {
+      auto readCount = _read(fd, data_ + pos,
+         (unsigned)min(fileSize - pos, (size_t)(64 * 1024 * 1024)));
+      if (readCount <= 0)
+      {
+         delete[] data_;
+         data_ = nullptr;
+         _close(fd);
+         throw runtime_error("failed to read utxo snapshot");
+      }
+
+      pos += readCount;
+   }
+
+   _close(fd);
+   size_ = fileSize;
+#else
+   int fd = open(path.c_str(), O_RDONLY);
+   if (fd == -1)
+      throw runtime_error("failed to open utxo snapshot");
+
+   auto fileSize = (size_t)lseek(fd, 0, SEEK_END);
+   if (fileSize < UTXO_SNAPSHOT_HEADER_SIZE)
+   {
+      close(fd);
+      throw runtime_error("utxo snapshot is too short");
+   }
+
+   auto ptr = mmap(0, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+
+   if (ptr == MAP_FAILED)
+   {
+      stringstream errStr;
+      errStr << "Failed to map utxo snapshot. Error Code: " <<
+         errno << " (" << strerror(errno) << ")";
+      throw runtime_error(errStr.str());
+   }
+
+#ifdef MADV_SEQUENTIAL
+   madvise(ptr, fileSize, MADV_SEQUENTIAL);
+#endif
+
+   data_ = (uint8_t*)ptr;
+   size_ = fileSize;
+   mapped_ = true;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool UtxoSnapshot::readEntry(BinaryRefReader& brr, Entry& entry) const
+{
+   if (brr.getSizeRemaining() < 42)
+      return false;
+
+   entry.txHash_ = brr.get_BinaryDataRef(32);
+   entry.dbKey_ = brr.get_BinaryDataRef(9);
+
+   auto scrAddrSize = brr.get_uint8_t();
+   if (brr.getSizeRemaining() < (size_t)scrAddrSize + 4)
+      return false;
+   entry.scrAddr_ = brr.get_BinaryDataRef(scrAddrSize);
+
+   auto valSize = brr.get_uint32_t();
+   if (brr.getSizeRemaining() < valSize)
+      return false;
+   entry.value_ = brr.get_BinaryDataRef(valSize);
+
+   return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void UtxoSnapshot::validate()
+{
+   BinaryRefReader brr(data_, size_);
+   auto magic = brr.get_BinaryDataRef(8);
+   if (memcmp(magic.getPtr(), UTXO_SNAPSHOT_MAGIC, 8) != 0)
+      throw runtime_error("utxo snapshot magic mismatch");
+
+   topHash_ = brr.get_BinaryData(32);
+   count_ = brr.get_uint64_t();
+
+   //check every entry fits, so forEach can read without bound checks
+   Entry entry;
+   for (uint64_t i = 0; i < count_; i++)
+   {
+      if (!readEntry(brr, entry))
+         throw runtime_error("truncated utxo snapshot");
+
+      if (entry.dbKey_.getPtr()[0] != DB_PREFIX_TXDATA)
+         throw runtime_error("invalid utxo snapshot entry");
+   }
+
+   if (brr.getSizeRemaining() != 0)
+      throw runtime_error("trailing data in utxo snapshot");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void UtxoSnapshot::forEach(const function<void(const Entry&)>& callback) const
+{
+   BinaryRefReader brr(data_, size_);
+   brr.advance(UTXO_SNAPSHOT_HEADER_SIZE);
+
+   Entry entry;
+   for (uint64_t i = 0; i < count_; i++)
+   {
+      readEntry(brr, entry);
+      callback(entry);
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void UtxoSnapshot::write(const string& path, const BinaryData& topHash,
+   vector<const StoredTxOut*>& utxos)
+{
+   if (topHash.getSize() != 32)
+      throw runtime_error("invalid utxo snapshot top hash");
+
+   sort(utxos.begin(), utxos.end(),
+      [](const StoredTxOut* lhs, const StoredTxOut* rhs)->bool
+   {
+      auto cmp = memcmp(
+         lhs->parentHash_.getPtr(), rhs->parentHash_.getPtr(), 32);
+      if (cmp != 0)
+         return cmp < 0;
+
+      return lhs->txOutIndex_ < rhs->txOutIndex_;
+   });
+
+   auto tmpPath = path;
+   tmpPath.append(".tmp");
+
+   {
+      ofstream file(tmpPath, ios::binary | ios::trunc);
+      if (!file.is_open())
+         throw runtime_error("failed to create utxo snapshot");
+
+      BinaryWriter bw;
+      bw.put_BinaryData((const uint8_t*)UTXO_SNAPSHOT_MAGIC, 8);
+      bw.put_BinaryData(topHash);
+      bw.put_uint64_t(utxos.size());
+
+      //flush to disk in chunks to keep the write buffer small
+      const size_t flushSize = 4 * 1024 * 1024;
+      BinaryWriter valBw;
+      for (auto stxoPtr : utxos)
+      {
+         const auto& scrAddr = stxoPtr->getScrAddress();
+         auto&& dbKey = stxoPtr->getDBKey(true);
+         if (stxoPtr->parentHash_.getSize() != 32 || dbKey.getSize() != 9 ||
+            scrAddr.getSize() > 255)
+         {
+            file.close();
+            remove(tmpPath.c_str());
+            throw runtime_error("invalid utxo for snapshot");
+         }
+
+         valBw.reset();
+         stxoPtr->serializeDBValue(valBw, ARMORY_DB_BARE, true);
+
+         bw.put_BinaryData(stxoPtr->parentHash_);
+         bw.put_BinaryData(dbKey);
+         bw.put_uint8_t(scrAddr.getSize());
+         bw.put_BinaryData(scrAddr);
+         bw.put_uint32_t(valBw.getSize());
+         bw.put_BinaryDataRef(valBw.getDataRef());
+
+         if (bw.getSize() >= flushSize)
+         {
+            file.write((const char*)bw.getDataRef().getPtr(), bw.getSize());
+            bw.reset();
+         }
+      }
+
+      file.write((const char*)bw.getDataRef().getPtr(), bw.getSize());
+      file.flush();
+      if (!file.good())
+      {
+         file.close();
+         remove(tmpPath.c_str());
+         throw runtime_error("failed to write utxo snapshot");
+      }
+   }
+
+   //the snapshot has to be on disk before it replaces the previous one
+   if (!syncFile(tmpPath))
+   {
+      remove(tmpPath.c_str());
+      throw runtime_error("failed to sync utxo snapshot");
+   }
+
+#ifdef _WIN32
+   //rename does not overwrite on Windows
+   remove(path.c_str());
+#endif
+   if (rename(tmpPath.c_str(), path.c_str()) != 0)
+   {
+      remove(tmpPath.c_str());
+      throw runtime_error("failed to move utxo snapshot in place");
+   }
+
+   syncParentDir(path);
+}
@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (C) 2017, goatpig.                                              //
+//  Distributed under the MIT license                                         //
+//  See LICENSE-MIT or https://opensource.org/licenses/MIT                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _H_UTXO_SNAPSHOT
+#define _H_UTXO_SNAPSHOT
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <functional>
+#include <memory>
+
+#include "BinaryData.h"
+#include "StoredBlockObj.h"
+
+using namespace std;
+
+#define UTXO_SNAPSHOT_MAGIC "UTXOSNP1"
+#define UTXO_SNAPSHOT_FILENAME "utxo_snapshot"
+
+//minimum seconds between snapshot rewrites from new block scans
+#define UTXO_SNAPSHOT_INTERVAL 600
+
+////////////////////////////////////////////////////////////////////////////////
+class UtxoSnapshot
+{
+   /***
+   Flat file image of the relevant utxo set at the top scanned block, so the
+   scanner and utxo queries can load it in one pass without LMDB cursors.
+
+   layout:
+      magic (8) | top block hash (32) | entry count (uint64 LE)
+      entries, sorted by outpoint (txHash, txOutIndex):
+         txHash (32) | STXO DB key (9) | scrAddr size (1) | scrAddr |
+         value size (uint32 LE) | STXO DB value
+
+   The file is only ever valid as a whole: it is written to a temp file that
+   is then renamed over the snapshot path, and the DB deletes it on the first
+   STXO write that follows. The initial and address registration scans 
+   write one at the tip, new block scans rewrite it at most once every 
+   UTXO_SNAPSHOT_INTERVAL, and the BDM puts one back on shutdown if new 
+   blocks dropped it since.
+   ***/
+
+public:
+   struct Entry
+   {
+      BinaryDataRef txHash_;
+      BinaryDataRef dbKey_;
+      BinaryDataRef scrAddr_;
+      BinaryDataRef value_;
+
+      StoredTxOut getStoredTxOut(void) const;
+   };
+
+private:
+   uint8_t* data_ = nullptr;
+   size_t size_ = 0;
+   bool mapped_ = false;
+
+   BinaryData topHash_;
+   uint64_t count_ = 0;
+
+private:
+   UtxoSnapshot(const UtxoSnapshot&) = delete;
+   UtxoSnapshot& operator=(const UtxoSnapshot&) = delete;
+
+   void load(const string& path);
+   void release(void);
+   void validate(void);
+   bool readEntry(BinaryRefReader&, Entry&) const;
+
+public:
+   //throws runtime_error if the file is missing or malformed
+   UtxoSnapshot(const string& path);
+   ~UtxoSnapshot(void);
+
+   const BinaryData& topHash(void) const { return topHash_; }
+   uint64_t count(void) const { return count_; }
+   size_t size(void) const { return size_; }
+
+   void forEach(const function<void(const Entry&)>&) const;
+
+   //sorts utxos by outpoint, writes them to path.tmp then renames it to path
+   static void write(const string& path, const BinaryData& topHash,
+      vector<const StoredTxOut*>& utxos);
+};
+
+#endif
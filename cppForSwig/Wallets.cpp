@@ -1452,10 +1452,20 @@ void AssetWallet_Single::fillHashIndexMap()
    if ((assets_.size() > 0 && lastKnownIndex_ != assets_.rbegin()->first) ||
       lastAssetMapSize_ != assets_.size())
    {
-      hashMaps_.clear();
+      //if the chain was only extended, hash the new assets alone, otherwise
+      //(imports, deletions) rebuild the maps
+      auto assetIter = assets_.upper_bound(lastKnownIndex_);
+      size_t appended = distance(assetIter, assets_.end());
+      if (lastAssetMapSize_ == 0 ||
+         (size_t)lastAssetMapSize_ + appended != assets_.size())
+      {
+         hashMaps_.clear();
+         assetIter = assets_.begin();
+      }
 
-      for (auto& entry : assets_)
+      for (; assetIter != assets_.end(); ++assetIter)
       {
+         auto& entry = *assetIter;
          auto assetSingle = dynamic_pointer_cast<AssetEntry_Single>(entry.second);
          auto&& hashMap = assetSingle->getScriptHashMap();
          
@@ -1941,55 +1951,50 @@ shared_ptr<DerivationScheme> DerivationScheme::deserialize(BinaryDataRef data)
 vector<shared_ptr<AssetEntry>> DerivationScheme_ArmoryLegacy::extendChain(
    shared_ptr<AssetEntry> firstAsset, unsigned count)
 {
-   auto nextAsset = [this](
-      shared_ptr<AssetEntry> assetPtr)->shared_ptr<AssetEntry>
-   {
-      auto assetSingle =
-         dynamic_pointer_cast<AssetEntry_Single>(assetPtr);
+   auto assetSingle =
+      dynamic_pointer_cast<AssetEntry_Single>(firstAsset);
+   if (assetSingle == nullptr)
+      throw WalletException("unexpected asset entry type");
 
-      //get pubkey
-      auto pubkey = assetSingle->getPubKey();
-      auto& pubkeyData = pubkey->getUncompressedKey();
+   //get pubkey
+   auto pubkey = assetSingle->getPubKey();
+   auto& pubkeyData = pubkey->getUncompressedKey();
 
-      auto&& nextPubkey = CryptoECDSA().ComputeChainedPublicKey(
-         pubkeyData, chainCode_, nullptr);
+   //try to get priv key
+   auto privkey = assetSingle->getPrivKey();
+   SecureBinaryData privkeyData;
+   try
+   {
+      privkeyData = privkey->getKey();
+   }
+   catch (AssetUnavailableException&)
+   {
+      //no priv key, ignore
+   }
+   catch (CypherException&)
+   {
+      //ignore, not going to prompt user for password with priv key derivation
+   }
 
-      //try to get priv key
-      auto privkey = assetSingle->getPrivKey();
-      SecureBinaryData nextPrivkey;
-      try
-      {
-         auto& privkeyData = privkey->getKey();
+   //derive the whole batch in one go
+   auto&& chainedKeys = CryptoECDSA().ComputeChainedKeys(
+      pubkeyData, privkeyData, chainCode_, count);
 
-         nextPrivkey = move(CryptoECDSA().ComputeChainedPrivateKey(
-            privkeyData, chainCode_, pubkeyData, nullptr));
-      }
-      catch (AssetUnavailableException&)
-      {
-         //no priv key, ignore
-      }
-      catch (CypherException&)
-      {
-         //ignore, not going to prompt user for password with priv key derivation
-      }
+   vector<shared_ptr<AssetEntry>> assetVec;
+   assetVec.reserve(count);
+   auto id = assetSingle->getId();
 
+   for (auto& chainedKey : chainedKeys)
+   {
       //no need to encrypt the new data, asset ctor will deal with it
       unique_ptr<Cypher> cypher;
       if (privkey->cypher_ != nullptr)
          cypher = move(privkey->cypher_->getCopy());
 
-      return make_shared<AssetEntry_Single>(
-         assetSingle->getId() + 1,
-         move(nextPubkey), move(nextPrivkey), move(cypher));
-   };
-   
-   vector<shared_ptr<AssetEntry>> assetVec;
-   auto currentAsset = firstAsset;
-
-   for (unsigned i = 0; i < count; i++)
-   { 
-      currentAsset = nextAsset(currentAsset);
-      assetVec.push_back(currentAsset);
+      assetVec.push_back(make_shared<AssetEntry_Single>(
+         ++id,
+         move(chainedKey.pubKey_), move(chainedKey.pubKeyCompressed_),
+         move(chainedKey.privKey_), move(cypher)));
    }
 
    return assetVec;
@@ -72,12 +72,24 @@ enum SocketType
    SocketFcgi
 };
 
+enum WireEncoding
+{
+   WireHex,
+   WireBinary
+};
+
 enum NodeType
 {
    Node_BTC,
    Node_UnitTest
 };
 
+enum BlockFileReadMode
+{
+   BlockFileRead_Mmap,
+   BlockFileRead_Stream
+};
+
 enum BDV_Action
 {
    BDV_Init,
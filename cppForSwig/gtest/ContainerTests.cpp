@@ -12,6 +12,8 @@
 #include "gtest.h"
 
 #include "../ThreadSafeClasses.h"
+#include "../FlatHashMap.h"
+#include "../PersistentMap.h"
 
 using namespace std;
 
@@ -694,6 +696,396 @@ TEST_F(ContainerTests, TimedStackTest_Concurrent)
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(ContainerTests, FlatHashMap)
+{
+   //32 byte keys from a counter, spread over the first and last words
+   auto makeKey = [](uint64_t val)->BinaryData
+   {
+      BinaryData key(32);
+      memset(key.getPtr(), 0, 32);
+      memcpy(key.getPtr(), &val, 8);
+      memcpy(key.getPtr() + 24, &val, 8);
+      return key;
+   };
+
+   FlatHashMap<32, map<unsigned, uint64_t>> theMap;
+   EXPECT_EQ(theMap.size(), 0);
+   EXPECT_TRUE(theMap.find(makeKey(1)) == theMap.end());
+
+   unsigned count = 10000;
+   for (unsigned i = 0; i < count; i++)
+      theMap[makeKey(i)][i % 7] = i;
+   EXPECT_EQ(theMap.size(), count);
+
+   for (unsigned i = 0; i < count; i++)
+   {
+      auto iter = theMap.find(makeKey(i));
+      ASSERT_TRUE(iter != theMap.end());
+      auto&& key = makeKey(i);
+      EXPECT_EQ(memcmp(iter->first.getPtr(), key.getPtr(), 32), 0);
+      EXPECT_EQ(iter->second[i % 7], i);
+   }
+
+   //existing keys are not overwritten by insert
+   auto insertResult = theMap.insert(
+      make_pair(makeKey(5), map<unsigned, uint64_t>()));
+   EXPECT_FALSE(insertResult.second);
+   EXPECT_EQ(insertResult.first->second.size(), 1);
+
+   //erase every other key, then refill the tombstones
+   for (unsigned i = 0; i < count; i += 2)
+      EXPECT_EQ(theMap.erase(makeKey(i)), 1);
+   EXPECT_EQ(theMap.erase(makeKey(0)), 0);
+   EXPECT_EQ(theMap.size(), count / 2);
+
+   unsigned iterCount = 0;
+   for (auto& val_pair : theMap)
+   {
+      auto val = val_pair.second.begin()->second;
+      EXPECT_EQ(val % 2, 1);
+      ++iterCount;
+   }
+   EXPECT_EQ(iterCount, count / 2);
+
+   for (unsigned i = 0; i < count; i += 2)
+      theMap[makeKey(i)][0] = i;
+   EXPECT_EQ(theMap.size(), count);
+
+   //copies are deep
+   auto mapCopy = theMap;
+   mapCopy[makeKey(1)][0] = 0;
+   EXPECT_EQ(theMap[makeKey(1)].size(), 1);
+   EXPECT_EQ(mapCopy[makeKey(1)].size(), 2);
+
+   //erase while iterating
+   auto iter = mapCopy.begin();
+   while (iter != mapCopy.end())
+      iter = mapCopy.erase(iter);
+   EXPECT_EQ(mapCopy.size(), 0);
+   EXPECT_TRUE(mapCopy.begin() == mapCopy.end());
+
+   //wrong key size
+   BinaryData shortKey(20);
+   memset(shortKey.getPtr(), 0, 20);
+   EXPECT_TRUE(theMap.find(shortKey) == theMap.end());
+   EXPECT_THROW(theMap[shortKey], runtime_error);
+
+   //8 byte db keys
+   FlatHashMap<8, unsigned> keyMap;
+   for (unsigned i = 0; i < count; i++)
+   {
+      BinaryData key(8);
+      memset(key.getPtr(), 0, 8);
+      memcpy(key.getPtr(), &i, 4);
+      keyMap.emplace(key, i);
+   }
+
+   EXPECT_EQ(keyMap.size(), count);
+   for (unsigned i = 0; i < count; i++)
+   {
+      BinaryData key(8);
+      memset(key.getPtr(), 0, 8);
+      memcpy(key.getPtr(), &i, 4);
+      EXPECT_EQ(keyMap.at(key), i);
+   }
+
+   keyMap.clear();
+   EXPECT_EQ(keyMap.size(), 0);
+
+   //keys read from the map's own values survive the rehash of the emplace
+   auto makeDbKey = [](unsigned val)->BinaryData
+   {
+      BinaryData key(8);
+      memset(key.getPtr(), 0, 8);
+      memcpy(key.getPtr(), &val, 4);
+      return key;
+   };
+
+   FlatHashMap<8, BinaryData> chainMap;
+   chainMap.emplace(makeDbKey(0), makeDbKey(1));
+   for (unsigned i = 1; i < 1000; i++)
+   {
+      auto iter = chainMap.find(makeDbKey(i - 1));
+      ASSERT_TRUE(iter != chainMap.end());
+      BinaryDataRef nextKey(iter->second.getPtr(), iter->second.getSize());
+      auto result = chainMap.emplace(nextKey, makeDbKey(i + 1));
+      ASSERT_TRUE(result.second);
+   }
+
+   EXPECT_EQ(chainMap.size(), 1000);
+   for (unsigned i = 0; i < 1000; i++)
+      EXPECT_EQ(chainMap.at(makeDbKey(i)), makeDbKey(i + 1));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+template<typename MapType> double runMapBench(
+   MapType& theMap, const vector<BinaryData>& keys, unsigned count)
+{
+   //utxo map like workload: insert, lookup hits and misses, erase
+   auto start = chrono::steady_clock::now();
+
+   for (unsigned i = 0; i < count; i++)
+      theMap[keys[i]][i & 3] = i;
+
+   size_t hits = 0;
+   for (unsigned i = 0; i < count * 2; i++)
+   {
+      if (theMap.find(keys[i]) != theMap.end())
+         ++hits;
+   }
+
+   for (unsigned i = 0; i < count; i += 2)
+      theMap.erase(theMap.find(keys[i]));
+
+   auto stop = chrono::steady_clock::now();
+
+   EXPECT_EQ(hits, count);
+   EXPECT_EQ(theMap.size(), count / 2);
+   return chrono::duration<double>(stop - start).count();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(ContainerTests, FlatHashMap_Benchmark)
+{
+   //random 32 byte keys, half of them are never inserted
+   unsigned count = 500000;
+   vector<BinaryData> keys;
+   keys.reserve(count * 2);
+
+   srand(time(0));
+   for (unsigned i = 0; i < count * 2; i++)
+   {
+      BinaryData key(32);
+      for (unsigned y = 0; y < 32; y++)
+         key.getPtr()[y] = rand() & 0xFF;
+      keys.push_back(move(key));
+   }
+
+   map<BinaryData, map<unsigned, unsigned>> stdMap;
+   auto stdTime = runMapBench(stdMap, keys, count);
+
+   FlatHashMap<32, map<unsigned, unsigned>> flatMap;
+   auto flatTime = runMapBench(flatMap, keys, count);
+
+   cout << "std::map: " << stdTime << "s, FlatHashMap: " << flatTime << "s" 
+      << endl;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(ContainerTests, PersistentMap)
+{
+   PersistentMap<unsigned, unsigned> theMap;
+   EXPECT_EQ(theMap.size(), 0);
+   EXPECT_TRUE(theMap.begin() == theMap.end());
+
+   //reference map run through the same operations
+   map<unsigned, unsigned> refMap;
+
+   srand(time(0));
+   unsigned count = 20000;
+   for (unsigned i = 0; i < count; i++)
+   {
+      auto key = rand() % (count * 2);
+      EXPECT_EQ(theMap.insert(make_pair(key, i)), 
+         refMap.insert(make_pair(key, i)).second);
+   }
+   EXPECT_EQ(theMap.size(), refMap.size());
+
+   //snapshot before mutating, copies are O(1) and share all nodes
+   auto snapshot = theMap;
+   auto refSnapshot = refMap;
+
+   for (unsigned i = 0; i < count; i += 3)
+   {
+      theMap.assign(i, i);
+      refMap[i] = i;
+   }
+
+   for (unsigned i = 1; i < count * 2; i += 5)
+      EXPECT_EQ(theMap.erase(i), refMap.erase(i));
+   EXPECT_EQ(theMap.erase(count * 3), 0);
+
+   //ordered iteration matches
+   auto checkEqual = [](const PersistentMap<unsigned, unsigned>& pMap,
+      const map<unsigned, unsigned>& sMap)->void
+   {
+      ASSERT_EQ(pMap.size(), sMap.size());
+      auto sIter = sMap.begin();
+      for (auto& val_pair : pMap)
+      {
+         EXPECT_EQ(val_pair.first, sIter->first);
+         EXPECT_EQ(val_pair.second, sIter->second);
+         ++sIter;
+      }
+      EXPECT_TRUE(sIter == sMap.end());
+   };
+
+   checkEqual(theMap, refMap);
+
+   //the snapshot did not see any of it
+   checkEqual(snapshot, refSnapshot);
+
+   //lookups and bounds
+   for (unsigned i = 0; i < count * 2; i += 7)
+   {
+      auto iter = theMap.find(i);
+      auto refIter = refMap.find(i);
+      EXPECT_EQ(iter == theMap.end(), refIter == refMap.end());
+      EXPECT_EQ(theMap.count(i), refMap.count(i));
+
+      auto lb = theMap.lower_bound(i);
+      auto refLb = refMap.lower_bound(i);
+      if (refLb == refMap.end())
+         EXPECT_TRUE(lb == theMap.end());
+      else
+         EXPECT_EQ(lb->first, refLb->first);
+
+      auto ub = theMap.upper_bound(i);
+      auto refUb = refMap.upper_bound(i);
+      if (refUb == refMap.end())
+         EXPECT_TRUE(ub == theMap.end());
+      else
+         EXPECT_EQ(ub->first, refUb->first);
+   }
+
+   //reverse iteration, and stepping back from end()
+   auto rIter = theMap.rbegin();
+   auto refRIter = refMap.rbegin();
+   while (refRIter != refMap.rend())
+   {
+      ASSERT_TRUE(rIter != theMap.rend());
+      EXPECT_EQ(rIter->first, refRIter->first);
+      ++rIter;
+      ++refRIter;
+   }
+   EXPECT_TRUE(rIter == theMap.rend());
+
+   auto endIter = theMap.end();
+   --endIter;
+   EXPECT_EQ(endIter->first, refMap.rbegin()->first);
+
+   EXPECT_EQ(theMap.at(0), 0);
+   EXPECT_THROW(theMap.at(count * 3), out_of_range);
+
+   //erase everything in the snapshot, theMap is unaffected
+   vector<unsigned> snapshotKeys;
+   for (auto& val_pair : snapshot)
+      snapshotKeys.push_back(val_pair.first);
+   snapshot.erase(snapshotKeys.begin(), snapshotKeys.end());
+   EXPECT_EQ(snapshot.size(), 0);
+   checkEqual(theMap, refMap);
+
+   theMap.clear();
+   EXPECT_EQ(theMap.size(), 0);
+   EXPECT_TRUE(theMap.begin() == theMap.end());
+
+   //sets
+   PersistentSet<BinaryData> theSet;
+   for (unsigned i = 0; i < 100; i++)
+   {
+      BinaryData val(4);
+      memcpy(val.getPtr(), &i, 4);
+      EXPECT_TRUE(theSet.insert(val));
+      EXPECT_FALSE(theSet.insert(val));
+   }
+
+   auto setCopy = theSet;
+   BinaryData zero(4);
+   memset(zero.getPtr(), 0, 4);
+   EXPECT_EQ(setCopy.erase(zero), 1);
+   EXPECT_EQ(setCopy.size(), 99);
+   EXPECT_EQ(theSet.size(), 100);
+   EXPECT_TRUE(theSet.find(zero) != theSet.end());
+   EXPECT_TRUE(setCopy.find(zero) == setCopy.end());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(ContainerTests, TransactionalMap_Snapshots)
+{
+   TransactionalMap<unsigned, unsigned> theMap;
+   for (unsigned i = 0; i < 100; i++)
+      theMap.insert(make_pair(i, i));
+
+   auto snapshot = theMap.get();
+   EXPECT_EQ(snapshot->size(), 100);
+
+   //update replaces existing values
+   map<unsigned, unsigned> updateMap;
+   updateMap[5] = 500;
+   updateMap[200] = 200;
+   theMap.update(updateMap);
+   theMap.erase(0);
+
+   EXPECT_EQ(theMap.size(), 100);
+   EXPECT_EQ(theMap.get()->at(5), 500);
+   EXPECT_EQ(theMap.get()->count(0), 0);
+
+   //snapshots taken before are untouched
+   EXPECT_EQ(snapshot->size(), 100);
+   EXPECT_EQ(snapshot->at(5), 5);
+   EXPECT_EQ(snapshot->count(200), 0);
+
+   auto popped = theMap.pop_all();
+   EXPECT_EQ(popped->size(), 100);
+   EXPECT_EQ(theMap.size(), 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(ContainerTests, TransactionalMap_Benchmark)
+{
+   //cost of a single insert into a map that already holds N entries, 
+   //against copying a std::map on every write
+   unsigned insertCount = 50;
+
+   for (unsigned size : {1000, 10000, 100000})
+   {
+      TransactionalMap<BinaryData, unsigned> txMap;
+      auto cowMap = make_shared<map<BinaryData, unsigned>>();
+
+      vector<BinaryData> keys;
+      for (unsigned i = 0; i < size + insertCount; i++)
+      {
+         BinaryData key(32);
+         for (unsigned y = 0; y < 32; y++)
+            key.getPtr()[y] = rand() & 0xFF;
+         keys.push_back(move(key));
+      }
+
+      map<BinaryData, unsigned> fillMap;
+      for (unsigned i = 0; i < size; i++)
+      {
+         fillMap.insert(make_pair(keys[i], i));
+         cowMap->insert(make_pair(keys[i], i));
+      }
+      txMap.update(move(fillMap));
+
+      auto start = chrono::steady_clock::now();
+      for (unsigned i = size; i < size + insertCount; i++)
+         txMap.insert(make_pair(keys[i], i));
+      auto txTime = chrono::duration<double>(
+         chrono::steady_clock::now() - start).count();
+
+      start = chrono::steady_clock::now();
+      for (unsigned i = size; i < size + insertCount; i++)
+      {
+         auto newMap = make_shared<map<BinaryData, unsigned>>(*cowMap);
+         newMap->insert(make_pair(keys[i], i));
+         cowMap = newMap;
+      }
+      auto cowTime = chrono::duration<double>(
+         chrono::steady_clock::now() - start).count();
+
+      EXPECT_EQ(txMap.size(), size + insertCount);
+      EXPECT_EQ(cowMap->size(), size + insertCount);
+
+      cout << size << " entries, " << insertCount << " inserts: " <<
+         "TransactionalMap: " << txTime << "s, copy on write std::map: " <<
+         cowTime << "s" << endl;
+   }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 GTEST_API_ int main(int argc, char **argv)
 {
@@ -26,6 +26,7 @@
 #include "../EncryptionUtils.h"
 #include "../lmdb_wrapper.h"
 #include "../BlockUtils.h"
+#include "../BlockchainScanner.h"
 #include "../ScrAddrObj.h"
 #include "../BtcWallet.h"
 #include "../BlockDataViewer.h"
@@ -186,6 +187,43 @@ static BinaryData getTx(unsigned height, unsigned id)
    return stx.dataCopy_;
 }
 
+//unsigned 1 in 1 out tx spending hash:id to a classic P2PKH script
+static BinaryData makeP2PKHTx(const BinaryData& hash, unsigned id,
+   const BinaryData& addr, uint64_t value, uint32_t sequence = UINT32_MAX)
+{
+   BinaryWriter bw;
+   bw.put_uint32_t(1); //version number
+
+   //input
+   bw.put_var_int(1);
+   bw.put_BinaryData(hash);
+   bw.put_uint32_t(id);
+   bw.put_var_int(0);
+   bw.put_uint32_t(sequence);
+
+   //spend script, classic P2PKH
+   BinaryWriter spendScript;
+   spendScript.put_uint8_t(OP_DUP);
+   spendScript.put_uint8_t(OP_HASH160);
+   spendScript.put_var_int(addr.getSize());
+   spendScript.put_BinaryData(addr);
+   spendScript.put_uint8_t(OP_EQUALVERIFY);
+   spendScript.put_uint8_t(OP_CHECKSIG);
+
+   auto& spendScriptbd = spendScript.getData();
+
+   //output
+   bw.put_var_int(1);
+   bw.put_uint64_t(value);
+   bw.put_var_int(spendScriptbd.getSize());
+   bw.put_BinaryData(spendScriptbd);
+
+   //locktime
+   bw.put_uint32_t(UINT32_MAX);
+
+   return bw.getData();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -1247,6 +1285,91 @@ TEST_F(BinaryDataTest, b58Tests)
    EXPECT_EQ(decoded, h_160);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BinaryDataTest, SmallBuffer)
+{
+   //hashes and compressed pubkeys fit inline
+   BinaryData hash(32);
+   for (unsigned i = 0; i < 32; i++)
+      hash[i] = i;
+
+   BinaryData pubkey(33);
+   pubkey.fill(0x02);
+
+   //growing past the inline buffer, then appending to self
+   BinaryData grown(hash);
+   grown.append(pubkey);
+   EXPECT_EQ(grown.getSize(), 65);
+   EXPECT_EQ(grown.getSliceRef(0, 32), hash.getRef());
+   EXPECT_EQ(grown.getSliceRef(32, 33), pubkey.getRef());
+
+   grown.append(grown);
+   EXPECT_EQ(grown.getSize(), 130);
+   EXPECT_EQ(grown.getSliceRef(65, 32), hash.getRef());
+
+   BinaryData selfAppend(hash);
+   selfAppend.append(selfAppend);
+   EXPECT_EQ(selfAppend.getSize(), 64);
+   EXPECT_EQ(selfAppend.getSliceRef(32, 32), hash.getRef());
+
+   //resize zeroes new bytes, both inline and on the heap
+   BinaryData resized(hash);
+   resized.resize(4);
+   resized.resize(40);
+   EXPECT_EQ(resized.getSliceRef(0, 4), hash.getSliceRef(0, 4));
+   EXPECT_EQ(resized.getSliceRef(4, 36), BinaryData(36).getRef());
+   resized.resize(100);
+   EXPECT_EQ(resized[99], 0);
+
+   //moves, inline and heap, leave the source empty
+   BinaryData inlineCopy(hash);
+   BinaryData movedInline(move(inlineCopy));
+   EXPECT_EQ(movedInline, hash);
+   EXPECT_EQ(inlineCopy.getSize(), 0);
+
+   BinaryData heapCopy(grown);
+   auto heapPtr = heapCopy.getPtr();
+   BinaryData movedHeap(move(heapCopy));
+   EXPECT_EQ(movedHeap, grown);
+   EXPECT_EQ(movedHeap.getPtr(), heapPtr);
+   EXPECT_EQ(heapCopy.getSize(), 0);
+
+   //moving to the heap explicitly wipes the inline buffer
+   BinaryData wiped(hash);
+   auto inlinePtr = wiped.getPtr();
+   wiped.keepOnHeap();
+   EXPECT_NE(wiped.getPtr(), inlinePtr);
+   EXPECT_EQ(wiped, hash);
+   for (unsigned i = sizeof(uint8_t*); i < 32; i++)
+      EXPECT_EQ(inlinePtr[i], 0);
+
+   //key material stays on the heap, refs to it survive moves
+   SecureBinaryData privKey(hash);
+   auto keyPtr = privKey.getPtr();
+   BinaryData movedKey(move((BinaryData&)privKey));
+   EXPECT_EQ(movedKey.getPtr(), keyPtr);
+   EXPECT_EQ(movedKey, hash);
+
+   //move assignment swaps
+   BinaryData a(hash), b(grown);
+   a = move(b);
+   EXPECT_EQ(a, grown);
+   EXPECT_EQ(b, hash);
+
+   //copy assignment across modes
+   a = hash;
+   EXPECT_EQ(a, hash);
+   b = grown;
+   EXPECT_EQ(b, grown);
+
+   //in containers
+   vector<BinaryData> bdVec;
+   for (unsigned i = 0; i < 100; i++)
+      bdVec.push_back(i % 2 ? hash : grown);
+   for (unsigned i = 0; i < 100; i++)
+      EXPECT_EQ(bdVec[i], i % 2 ? hash : grown);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //TEST_F(BinaryDataTest, GenerateRandom)
 //{
@@ -2228,6 +2351,174 @@ TEST_F(BtcUtilsTest, SimpleHash)
    EXPECT_EQ(hashOut, satoshiHash160_);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BtcUtilsTest, SHA256d_Implementations)
+{
+   //every implementation the cpu supports has to match Crypto++
+   CryptoPP::SHA256 sha256_;
+   auto defaultImpl = SHA256d::getImplementation();
+
+   //lengths around the padding boundaries
+   vector<size_t> lengths = { 0, 1, 31, 32, 55, 56, 63, 64, 65, 119, 120,
+      127, 128, 200, 1000 };
+   BinaryData msg(1000);
+   for (unsigned i = 0; i < msg.getSize(); i++)
+      msg.getPtr()[i] = uint8_t(i * 7 + 3);
+
+   //37 is an odd count, exercises lane remainders
+   const size_t batchCount = 37;
+   BinaryData batchIn(batchCount * 64);
+   for (unsigned i = 0; i < batchIn.getSize(); i++)
+      batchIn.getPtr()[i] = uint8_t(i * 13 + 5);
+
+   BinaryData batchRef(batchCount * 32);
+   for (unsigned i = 0; i < batchCount; i++)
+   {
+      auto outPtr = batchRef.getPtr() + i * 32;
+      sha256_.CalculateDigest(outPtr, batchIn.getPtr() + i * 64, 64);
+      sha256_.CalculateDigest(outPtr, outPtr, 32);
+   }
+
+   vector<SHA256Impl> impls = { SHA256Impl_Scalar, SHA256Impl_SSE41, 
+      SHA256Impl_AVX2, SHA256Impl_SHANI };
+
+   for (auto& implType : impls)
+   {
+      if (!SHA256d::setImplementation(implType))
+         continue;
+
+      auto&& name = SHA256d::getImplementationName(implType);
+
+      for (auto& len : lengths)
+      {
+         BinaryData refOut(32), out(32);
+
+         sha256_.CalculateDigest(refOut.getPtr(), msg.getPtr(), len);
+         SHA256d::getSha256(msg.getPtr(), len, out.getPtr());
+         EXPECT_EQ(out, refOut) << name << ", sha256 len " << len;
+
+         sha256_.CalculateDigest(refOut.getPtr(), refOut.getPtr(), 32);
+         SHA256d::getHash256(msg.getPtr(), len, out.getPtr());
+         EXPECT_EQ(out, refOut) << name << ", hash256 len " << len;
+      }
+
+      BinaryData batchOut(batchCount * 32);
+      SHA256d::getHash256_64(
+         batchIn.getPtr(), batchOut.getPtr(), batchCount);
+      EXPECT_EQ(batchOut, batchRef) << name;
+
+      //in place
+      BinaryData inPlace(batchIn);
+      SHA256d::getHash256_64(inPlace.getPtr(), inPlace.getPtr(), batchCount);
+      inPlace.resize(batchCount * 32);
+      EXPECT_EQ(inPlace, batchRef) << name;
+
+      auto&& headHash = BtcUtils::getHash256(rawHead_);
+      EXPECT_EQ(headHash, headHashLE_) << name;
+   }
+
+   EXPECT_FALSE(SHA256d::setImplementation((SHA256Impl)100));
+   SHA256d::setImplementation(defaultImpl);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BtcUtilsTest, MerkleRoot_Benchmark)
+{
+   //reference merkle root, per pair Crypto++ hashing
+   auto refMerkleRoot = [](vector<BinaryData> level)->BinaryData
+   {
+      CryptoPP::SHA256 sha256_;
+      while (level.size() > 1)
+      {
+         if (level.size() % 2)
+            level.push_back(level.back());
+
+         vector<BinaryData> nextLevel;
+         for (unsigned i = 0; i < level.size(); i += 2)
+         {
+            BinaryData pair(level[i]);
+            pair.append(level[i + 1]);
+
+            BinaryData hash(32);
+            sha256_.CalculateDigest(hash.getPtr(), pair.getPtr(), 64);
+            sha256_.CalculateDigest(hash.getPtr(), hash.getPtr(), 32);
+            nextLevel.push_back(move(hash));
+         }
+
+         level = move(nextLevel);
+      }
+
+      return level[0];
+   };
+
+   EXPECT_EQ(BtcUtils::calculateMerkleRoot(nullptr, 0).getSize(), 0);
+
+   vector<BinaryData> hashes;
+   for (unsigned i = 0; i < 3000; i++)
+   {
+      BinaryWriter bw;
+      bw.put_uint32_t(i);
+      hashes.push_back(BtcUtils::getHash256(bw.getData()));
+   }
+
+   //odd and even counts at every level
+   vector<size_t> counts = { 1, 2, 3, 5, 8, 9, 17, 100, 2999, 3000 };
+   auto defaultImpl = SHA256d::getImplementation();
+
+   vector<SHA256Impl> impls = { SHA256Impl_Scalar, SHA256Impl_SSE41,
+      SHA256Impl_AVX2, SHA256Impl_SHANI };
+
+   for (auto& count : counts)
+   {
+      vector<BinaryData> subset(hashes.begin(), hashes.begin() + count);
+      auto&& refRoot = refMerkleRoot(subset);
+
+      for (auto& implType : impls)
+      {
+         if (!SHA256d::setImplementation(implType))
+            continue;
+
+         EXPECT_EQ(BtcUtils::calculateMerkleRoot(subset), refRoot);
+         auto&& mtree = BtcUtils::calculateMerkleTree(subset);
+         EXPECT_EQ(mtree.back(), refRoot);
+      }
+   }
+
+   //throughput, 3000 tx blocks
+   const unsigned rounds = 200;
+   BinaryData flatHashes(hashes.size() * 32);
+   for (unsigned i = 0; i < hashes.size(); i++)
+      hashes[i].copyTo(flatHashes.getPtr() + i * 32, 32);
+
+   {
+      auto start = chrono::steady_clock::now();
+      for (unsigned i = 0; i < rounds; i++)
+         refMerkleRoot(hashes);
+      auto elapsed = chrono::duration_cast<chrono::milliseconds>(
+         chrono::steady_clock::now() - start).count();
+
+      cout << "merkle root, per pair Crypto++: " << elapsed << "ms for " <<
+         rounds << " blocks of " << hashes.size() << " txs" << endl;
+   }
+
+   for (auto& implType : impls)
+   {
+      if (!SHA256d::setImplementation(implType))
+         continue;
+
+      auto start = chrono::steady_clock::now();
+      for (unsigned i = 0; i < rounds; i++)
+         BtcUtils::calculateMerkleRoot(flatHashes.getPtr(), hashes.size());
+      auto elapsed = chrono::duration_cast<chrono::milliseconds>(
+         chrono::steady_clock::now() - start).count();
+
+      cout << "merkle root, " << SHA256d::getImplementationName(implType) <<
+         ": " << elapsed << "ms" << endl;
+   }
+
+   SHA256d::setImplementation(defaultImpl);
+}
+
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -3038,6 +3329,284 @@ TEST_F(BlockObjTest, TxUnserialize)
    }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockObjTest, TxFilterPool_MultiHash)
+{
+   //3 blocks worth of tx hashes, with a prefix collision across blocks
+   vector<vector<BinaryData>> blockHashes(3);
+   for (unsigned blk = 0; blk < 3; blk++)
+   {
+      for (unsigned i = 0; i < 11; i++)
+      {
+         BinaryWriter bw;
+         bw.put_uint32_t(blk * 100 + i);
+         bw.put_BinaryData(BinaryData(28));
+         blockHashes[blk].push_back(bw.getData());
+      }
+   }
+
+   blockHashes[2][7] = blockHashes[0][3];
+   blockHashes[2][7].getPtr()[31] = 0xFF;
+
+   set<TxFilter<TxFilterType>> filters;
+   for (unsigned blk = 0; blk < 3; blk++)
+   {
+      TxFilter<TxFilterType> filter(blk, blockHashes[blk].size());
+      filter.update(blockHashes[blk]);
+      filters.insert(filter);
+   }
+
+   TxFilterPool<TxFilterType> pool(filters);
+   BinaryWriter bw;
+   pool.serialize(bw);
+   auto poolData = bw.getData();
+   TxFilterPool<TxFilterType> poolRef(poolData.getPtr(), poolData.getSize());
+
+   set<BinaryData> hashSet;
+   hashSet.insert(blockHashes[0][3]);
+   hashSet.insert(blockHashes[1][10]);
+   hashSet.insert(blockHashes[2][0]);
+   hashSet.insert(READHEX(
+      "ffffffff00000000000000000000000000000000000000000000000000000000"));
+
+   //larger set to go through the bitmap path
+   auto largeSet = hashSet;
+   for (unsigned i = 0; i < 8; i++)
+      largeSet.insert(blockHashes[1][i]);
+
+   for (auto poolPtr : { &pool, &poolRef })
+   {
+      for (auto setPtr : { &hashSet, &largeSet })
+      {
+         vector<BinaryData> hashVec(setPtr->begin(), setPtr->end());
+         auto&& hits = poolPtr->compareBatch(hashVec);
+
+         ASSERT_EQ(hits.size(), hashVec.size());
+         unsigned hitCount = 0;
+         map<uint32_t, set<uint32_t>> collision;
+         for (unsigned i = 0; i < hashVec.size(); i++)
+         {
+            EXPECT_EQ(hits[i], poolPtr->compare(hashVec[i]));
+            if (hits[i].size() > 0)
+               ++hitCount;
+
+            if (hashVec[i] == blockHashes[0][3])
+               collision = hits[i];
+         }
+
+         EXPECT_EQ(hitCount, hashVec.size() - 1);
+         ASSERT_EQ(collision.size(), 2);
+         EXPECT_EQ(collision[0], set<uint32_t>({ 3 }));
+         EXPECT_EQ(collision[2], set<uint32_t>({ 7 }));
+      }
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockObjTest, TxFilterPool_BatchBenchmark)
+{
+   //serialized pool of 64 blocks x 256 txs, queried like resolveTxHashes does
+   auto randomHash = [](void)->BinaryData
+   {
+      BinaryData hash(32);
+      for (unsigned i = 0; i < 32; i++)
+         hash.getPtr()[i] = rand() & 0xFF;
+      return hash;
+   };
+
+   vector<BinaryData> poolHashes;
+   set<TxFilter<TxFilterType>> filters;
+   for (unsigned blk = 0; blk < 64; blk++)
+   {
+      vector<BinaryData> blockHashes;
+      for (unsigned i = 0; i < 256; i++)
+         blockHashes.push_back(randomHash());
+
+      TxFilter<TxFilterType> filter(blk, blockHashes.size());
+      filter.update(blockHashes);
+      filters.insert(filter);
+
+      poolHashes.insert(
+         poolHashes.end(), blockHashes.begin(), blockHashes.end());
+   }
+
+   BinaryWriter bw;
+   TxFilterPool<TxFilterType>(filters).serialize(bw);
+   auto poolData = bw.getData();
+   TxFilterPool<TxFilterType> pool(poolData.getPtr(), poolData.getSize());
+
+   for (unsigned count : { 1000, 10000, 100000 })
+   {
+      //1 in 10 queried hashes is in the pool
+      vector<BinaryData> hashVec;
+      for (unsigned i = 0; i < count; i++)
+      {
+         if (i % 10 == 0)
+            hashVec.push_back(poolHashes[rand() % poolHashes.size()]);
+         else
+            hashVec.push_back(randomHash());
+      }
+
+      auto start = chrono::steady_clock::now();
+      vector<map<uint32_t, set<uint32_t>>> perHash;
+      for (auto& hash : hashVec)
+         perHash.push_back(pool.compare(hash));
+      auto perHashTime = chrono::steady_clock::now() - start;
+
+      start = chrono::steady_clock::now();
+      auto&& batch = pool.compareBatch(hashVec);
+      auto batchTime = chrono::steady_clock::now() - start;
+
+      ASSERT_EQ(batch.size(), hashVec.size());
+      for (unsigned i = 0; i < count; i++)
+         EXPECT_EQ(batch[i], perHash[i]);
+
+      cout << count << " hashes: per hash " << 
+         chrono::duration_cast<chrono::milliseconds>(perHashTime).count() <<
+         "ms, batch " << 
+         chrono::duration_cast<chrono::milliseconds>(batchTime).count() <<
+         "ms" << endl;
+   }
+
+   //malformed hashes are rejected whether they hit the pool or not
+   BinaryData shortHash(20);
+   memset(shortHash.getPtr(), 0xFF, shortHash.getSize());
+   vector<BinaryData> badVec;
+   badVec.push_back(poolHashes[0]);
+   badVec.push_back(shortHash);
+   EXPECT_THROW(pool.compareBatch(badVec), runtime_error);
+
+   //hashes shorter than a prefix fail the same check
+   badVec.push_back(BinaryData(2));
+   try
+   {
+      pool.compareBatch(badVec);
+      ADD_FAILURE();
+   }
+   catch (range_error&)
+   {
+      ADD_FAILURE();
+   }
+   catch (runtime_error& e)
+   {
+      EXPECT_EQ(string(e.what()), "hash is 32 bytes long");
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockObjTest, BlockData_ParseBenchmark)
+{
+   auto getID = [](const BinaryData&)->unsigned int { return 0; };
+
+   BlockData smallBlock;
+   smallBlock.deserialize(rawBlock_.getPtr(), rawBlock_.getSize(),
+      nullptr, getID, true, false);
+   auto& smallTxns = smallBlock.getTxns();
+   ASSERT_EQ(smallTxns.size(), 3);
+
+   //build a 2000 tx block out of the test block's txns
+   const unsigned txCount = 2000;
+   BinaryWriter bw;
+   bw.put_BinaryData(rawBlock_.getSliceRef(0, HEADER_SIZE));
+   bw.put_var_int(txCount);
+   for (unsigned i = 0; i < txCount; i++)
+   {
+      auto& txn = smallTxns[i % 3];
+      bw.put_BinaryData(txn->data_, txn->size_);
+   }
+   auto rawBlock = bw.getData();
+
+   //arena parse vs one BCTX per tx
+   const unsigned rounds = 50;
+   auto start = chrono::steady_clock::now();
+   for (unsigned i = 0; i < rounds; i++)
+   {
+      BlockData bdata;
+      bdata.deserialize(rawBlock.getPtr(), rawBlock.getSize(),
+         nullptr, getID, false, false);
+      ASSERT_EQ(bdata.getTxns().size(), txCount);
+   }
+   auto arenaTime = chrono::steady_clock::now() - start;
+
+   start = chrono::steady_clock::now();
+   for (unsigned i = 0; i < rounds; i++)
+   {
+      BinaryRefReader brr(rawBlock.getPtr(), rawBlock.getSize());
+      brr.advance(HEADER_SIZE);
+      auto numTx = (unsigned)brr.get_var_int();
+
+      vector<shared_ptr<BCTX>> txns;
+      for (unsigned y = 0; y < numTx; y++)
+      {
+         auto tx = BCTX::parse(brr);
+         brr.advance(tx->size_);
+         txns.push_back(move(tx));
+      }
+      ASSERT_EQ(txns.size(), txCount);
+   }
+   auto perTxTime = chrono::steady_clock::now() - start;
+
+   auto toBlocksPerSec = [rounds](chrono::steady_clock::duration dur)->double
+   {
+      auto sec = chrono::duration<double>(dur).count();
+      return sec > 0 ? rounds / sec : 0;
+   };
+
+   cout << "2000 tx block parse: arena " << 
+      unsigned(toBlocksPerSec(arenaTime)) << " blocks/s, per tx " << 
+      unsigned(toBlocksPerSec(perTxTime)) << " blocks/s" << endl;
+
+   //both paths yield the same offsets, copies outlive the block
+   BCTX txCopy(*smallTxns[1]);
+   BCTX arenaCopy(nullptr, 0);
+   {
+      BlockData bdata;
+      bdata.deserialize(rawBlock.getPtr(), rawBlock.getSize(),
+         nullptr, getID, false, false);
+      auto& txns = bdata.getTxns();
+      arenaCopy = *txns[1];
+
+      BinaryRefReader brr(rawBlock.getPtr(), rawBlock.getSize());
+      brr.advance(HEADER_SIZE);
+      brr.get_var_int();
+
+      for (unsigned y = 0; y < txCount; y++)
+      {
+         auto tx = BCTX::parse(brr);
+         brr.advance(tx->size_);
+
+         ASSERT_EQ(tx->size_, txns[y]->size_);
+         ASSERT_EQ(tx->txins_.size(), txns[y]->txins_.size());
+         ASSERT_EQ(tx->txouts_.size(), txns[y]->txouts_.size());
+         EXPECT_EQ(tx->isCoinbase_, txns[y]->isCoinbase_);
+         EXPECT_EQ(tx->lockTime_, txns[y]->lockTime_);
+
+         for (unsigned z = 0; z < tx->txins_.size(); z++)
+            EXPECT_EQ(tx->getTxInRef(z), txns[y]->getTxInRef(z));
+         for (unsigned z = 0; z < tx->txouts_.size(); z++)
+            EXPECT_EQ(tx->getTxOutRef(z), txns[y]->getTxOutRef(z));
+      }
+   }
+
+   auto standalone = BCTX::parse(smallTxns[1]->data_, smallTxns[1]->size_);
+   BCTX standaloneCopy(*standalone);
+   standalone.reset();
+
+   EXPECT_EQ(txCopy.txins_.size(), 3);
+   EXPECT_EQ(standaloneCopy.txins_.size(), 3);
+   for (unsigned z = 0; z < txCopy.txins_.size(); z++)
+      EXPECT_EQ(txCopy.getTxInRef(z), standaloneCopy.getTxInRef(z));
+   EXPECT_EQ(txCopy.getHash(), standaloneCopy.getHash());
+
+   //copies of arena bound txs own their offsets
+   ASSERT_EQ(arenaCopy.txins_.size(), 3);
+   ASSERT_EQ(arenaCopy.txouts_.size(), txCopy.txouts_.size());
+   for (unsigned z = 0; z < arenaCopy.txins_.size(); z++)
+      EXPECT_EQ(arenaCopy.getTxInRef(z), txCopy.getTxInRef(z));
+   for (unsigned z = 0; z < arenaCopy.txouts_.size(); z++)
+      EXPECT_EQ(arenaCopy.getTxOutRef(z), txCopy.getTxOutRef(z));
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 TEST_F(BlockObjTest, DISABLED_FullBlock)
 {
@@ -3059,6 +3628,221 @@ TEST_F(BlockObjTest, DISABLED_RegisteredTxStuff)
    EXPECT_TRUE(false);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+static shared_ptr<BlockHeader> makeTestHeader(
+   const BinaryData& prevHash, uint32_t nonce, unsigned& id)
+{
+   //difficulty 1 header, the nonce makes the hash unique
+   BinaryWriter bw;
+   bw.put_uint32_t(1);
+   bw.put_BinaryData(prevHash);
+   bw.put_BinaryData(BinaryData(32));
+   bw.put_uint32_t(1231006505 + nonce);
+   bw.put_BinaryData(READHEX("ffff001d"));
+   bw.put_uint32_t(nonce);
+
+   auto header = make_shared<BlockHeader>(bw.getData());
+   header->setUniqueID(id);
+   id++;
+   return header;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockObjTest, Blockchain_OrganizeIncremental)
+{
+   unsigned id = 0;
+   uint32_t nonce = 0;
+   auto genesis = makeTestHeader(BinaryData(32), nonce++, id);
+
+   Blockchain bc(genesis->getThisHash());
+   bc.addBlock(genesis->getThisHash(), genesis, true);
+
+   auto extend = [&](shared_ptr<BlockHeader> from, unsigned count)->
+      vector<shared_ptr<BlockHeader>>
+   {
+      vector<shared_ptr<BlockHeader>> branch;
+      for (unsigned i = 0; i < count; i++)
+      {
+         auto header = makeTestHeader(from->getThisHash(), nonce++, id);
+         bc.addBlock(header->getThisHash(), header, true);
+         branch.push_back(header);
+         from = header;
+      }
+
+      return branch;
+   };
+
+   //main chain, heights 1 to 2000
+   auto mainBranch = extend(genesis, 2000);
+   auto&& state = bc.forceOrganize();
+   EXPECT_EQ(bc.top(), mainBranch.back());
+   EXPECT_EQ(bc.top()->getBlockHeight(), 2000);
+   for (unsigned i = 0; i < mainBranch.size(); i++)
+   {
+      ASSERT_EQ(bc.getHeaderByHeight(i + 1), mainBranch[i]);
+      EXPECT_TRUE(mainBranch[i]->isMainBranch());
+   }
+
+   //one new block, no reorg
+   auto tip = extend(mainBranch.back(), 1);
+   state = bc.organize(false);
+   EXPECT_TRUE(state.prevTopStillValid_);
+   EXPECT_TRUE(state.hasNewTop_);
+   EXPECT_EQ(bc.top(), tip[0]);
+   EXPECT_EQ(bc.top()->getBlockHeight(), 2001);
+   EXPECT_EQ(mainBranch.back()->getNextHash(), tip[0]->getThisHash());
+
+   //shorter fork doesn't move the top
+   auto forkPoint = mainBranch[1989];
+   auto fork = extend(forkPoint, 5);
+   state = bc.organize(false);
+   EXPECT_TRUE(state.prevTopStillValid_);
+   EXPECT_FALSE(state.hasNewTop_);
+   EXPECT_FALSE(fork.back()->isMainBranch());
+   EXPECT_EQ(fork.back()->getBlockHeight(), 1995);
+
+   //extending it past the top reorgs down to the fork point
+   auto forkTip = extend(fork.back(), 10);
+   state = bc.organize(false);
+   EXPECT_FALSE(state.prevTopStillValid_);
+   EXPECT_EQ(state.reorgBranchPoint_, forkPoint);
+   EXPECT_EQ(bc.top(), forkTip.back());
+   EXPECT_EQ(bc.top()->getBlockHeight(), 2005);
+   EXPECT_EQ(forkPoint->getNextHash(), fork[0]->getThisHash());
+
+   for (unsigned i = 1990; i < mainBranch.size(); i++)
+      EXPECT_FALSE(mainBranch[i]->isMainBranch());
+   EXPECT_FALSE(tip[0]->isMainBranch());
+   EXPECT_TRUE(forkPoint->isMainBranch());
+   EXPECT_EQ(bc.getHeaderByHeight(1990), forkPoint);
+   EXPECT_EQ(bc.getHeaderByHeight(1991), fork[0]);
+   EXPECT_EQ(bc.getHeaderByHeight(2005), forkTip.back());
+   EXPECT_FALSE(bc.hasHeaderByHeight(2006));
+
+   //headers with an unknown parent wait for it
+   auto parent = makeTestHeader(forkTip.back()->getThisHash(), nonce++, id);
+   auto orphan = makeTestHeader(parent->getThisHash(), nonce++, id);
+   bc.addBlock(orphan->getThisHash(), orphan, true);
+   state = bc.organize(false);
+   EXPECT_FALSE(state.hasNewTop_);
+   EXPECT_TRUE(orphan->isOrphan());
+
+   bc.addBlock(parent->getThisHash(), parent, true);
+   state = bc.organize(false);
+   EXPECT_TRUE(state.prevTopStillValid_);
+   EXPECT_EQ(bc.top(), orphan);
+   EXPECT_EQ(orphan->getBlockHeight(), 2007);
+   EXPECT_FALSE(orphan->isOrphan());
+
+   //a rebuild lands on the same chain
+   state = bc.forceOrganize();
+   EXPECT_EQ(bc.top(), orphan);
+   EXPECT_EQ(bc.getHeaderByHeight(1991), fork[0]);
+   EXPECT_FALSE(mainBranch[1990]->isMainBranch());
+   EXPECT_DOUBLE_EQ(orphan->getDifficultySum(), 2008.0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockObjTest, Blockchain_OrganizeBenchmark)
+{
+   const unsigned chainLength = 500000;
+
+   unsigned id = 0;
+   auto genesis = makeTestHeader(BinaryData(32), 0, id);
+   Blockchain bc(genesis->getThisHash());
+   bc.addBlock(genesis->getThisHash(), genesis, true);
+
+   auto prev = genesis;
+   for (unsigned i = 1; i <= chainLength; i++)
+   {
+      auto header = makeTestHeader(prev->getThisHash(), i, id);
+      bc.addBlock(header->getThisHash(), header, true);
+      prev = header;
+   }
+
+   auto start = chrono::steady_clock::now();
+   bc.forceOrganize();
+   auto fullTime = chrono::duration<double>(
+      chrono::steady_clock::now() - start).count();
+   EXPECT_EQ(bc.top()->getBlockHeight(), chainLength);
+
+   auto header = makeTestHeader(prev->getThisHash(), chainLength + 1, id);
+   bc.addBlock(header->getThisHash(), header, true);
+
+   start = chrono::steady_clock::now();
+   bc.organize(false);
+   auto newBlockTime = chrono::duration<double>(
+      chrono::steady_clock::now() - start).count();
+   EXPECT_EQ(bc.top(), header);
+
+   cout << "organized " << chainLength << " headers in " << 
+      fullTime << "s, new block in " << newBlockTime << "s" << endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockObjTest, WireEncoding_LedgerPageBenchmark)
+{
+   //a large history page, serialized by the server and parsed by the client
+   //once per encoding
+   const unsigned pageSize = 5000;
+   const unsigned requestCount = 20;
+
+   vector<LedgerEntryData> leVec;
+   for (unsigned i = 0; i < pageSize; i++)
+   {
+      BinaryWriter bw;
+      bw.put_uint32_t(i);
+      bw.put_BinaryData(BtcUtils::EmptyHash().getSliceRef(0, 28));
+      auto&& txHash = BtcUtils::getHash256(bw.getData());
+
+      set<BinaryData> scrAddrSet;
+      scrAddrSet.insert(TestChain::scrAddrA);
+      scrAddrSet.insert(TestChain::scrAddrB);
+
+      LedgerEntryData led("wallet1", (int64_t)i * 1000 - 2500000, 
+         400000 + i, txHash, i % 7, 1500000000 + i, 
+         false, false, i % 3 == 0, false, false, i % 2 == 0, scrAddrSet);
+      leVec.push_back(move(led));
+   }
+
+   auto runRequests = [&](WireEncoding encoding, size_t& bytes)->double
+   {
+      auto cpuStart = clock();
+      for (unsigned i = 0; i < requestCount; i++)
+      {
+         Arguments reply;
+         reply.push_back(move(LedgerEntryVector(leVec)));
+         auto& replyStr = reply.serialize(encoding);
+         bytes = replyStr.size();
+
+         Arguments clientArgs(replyStr);
+         auto&& lev = clientArgs.get<LedgerEntryVector>();
+         EXPECT_EQ(lev.toVector().size(), pageSize);
+      }
+
+      return double(clock() - cpuStart) / CLOCKS_PER_SEC;
+   };
+
+   size_t hexBytes, binBytes;
+   auto hexTime = runRequests(WireHex, hexBytes);
+   auto binTime = runRequests(WireBinary, binBytes);
+
+   //hex doubles the payload, the frame header is all binary adds
+   EXPECT_EQ(hexBytes, (binBytes - WIRE_BINARY_HEADER_SIZE) * 2);
+
+   auto report = [&](const string& name, double cpuTime, size_t bytes)->void
+   {
+      cout << name << ": " << bytes << " bytes per page, " << 
+         cpuTime * 1000.0 / requestCount << "ms cpu per request, " <<
+         requestCount / cpuTime << " requests/s, " <<
+         double(bytes) * requestCount / cpuTime / 1024.0 / 1024.0 << 
+         " MB/s on the wire" << endl;
+   };
+
+   report("hex", hexTime, hexBytes);
+   report("binary", binTime, binBytes);
+}
+
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -4088,6 +4872,131 @@ TEST_F(StoredBlockObjTest, STxOutUnserDBValue_3)
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(StoredBlockObjTest, STxOutCompactDBValue)
+{
+   StoredTxOut stxo0;
+   stxo0.unserialize(rawTxOut0_);
+   stxo0.txVersion_ = 1;
+   stxo0.spentness_ = TXOUT_UNSPENT;
+
+   // P2PKH script goes in the dictionary: type byte + 20 byte hash, 
+   // value takes 5 bytes as a varint
+   auto&& compact = serializeDBValue(stxo0, ARMORY_DB_FULL, false, 
+      DB_ENCODING_COMPACT);
+   EXPECT_EQ(compact.getSize(), 2 + 5 + 21);
+   EXPECT_EQ(compact.getPtr()[0] >> 4, STXO_COMPACT_VERSION);
+
+   StoredTxOut stxo;
+   stxo.unserializeDBValue(compact);
+   EXPECT_EQ(   stxo.dataCopy_,     rawTxOut0_);
+   EXPECT_EQ(   stxo.txVersion_,    1);
+   EXPECT_EQ(   stxo.spentness_,    TXOUT_UNSPENT);
+   EXPECT_EQ(   stxo.spentByTxInKey_.getSize(), 0);
+   EXPECT_FALSE(stxo.isCoinbase_);
+
+   // Spent, the spender key shrinks to varints
+   BinaryData spentStr = DBUtils::getBlkDataKeyNoPrefix( 100000, 1, 127, 15);
+   stxo0.spentness_ = TXOUT_SPENT;
+   stxo0.spentByTxInKey_ = spentStr;
+   stxo0.isCoinbase_ = true;
+   compact = serializeDBValue(stxo0, ARMORY_DB_FULL, false, 
+      DB_ENCODING_COMPACT);
+   EXPECT_EQ(compact.getSize(), 2 + 5 + 21 + 6);
+
+   stxo = StoredTxOut();
+   stxo.unserializeDBValue(compact);
+   EXPECT_EQ(   stxo.dataCopy_,     rawTxOut0_);
+   EXPECT_EQ(   stxo.spentness_,    TXOUT_SPENT);
+   EXPECT_EQ(   stxo.spentByTxInKey_, spentStr);
+   EXPECT_TRUE( stxo.isCoinbase_);
+
+   // Supernode entries carry the parent hash and txout index
+   stxo0.parentHash_ = READHEX(
+      "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef");
+   stxo0.txOutIndex_ = 300;
+   compact = serializeDBValue(stxo0, ARMORY_DB_SUPER, false, 
+      DB_ENCODING_COMPACT);
+
+   stxo = StoredTxOut();
+   stxo.unserializeDBValue(compact);
+   EXPECT_EQ(   stxo.dataCopy_,     rawTxOut0_);
+   EXPECT_EQ(   stxo.spentByTxInKey_, spentStr);
+   EXPECT_EQ(   stxo.parentHash_,   stxo0.parentHash_);
+   EXPECT_EQ(   stxo.txOutIndex_,   300);
+
+   // Non standard scripts are stored as is
+   BinaryData rawTxOut = READHEX("00e1f50500000000""066a04deadbeef");
+   stxo0 = StoredTxOut();
+   stxo0.unserialize(rawTxOut);
+   stxo0.txVersion_ = 1;
+   stxo0.spentness_ = TXOUT_UNSPENT;
+   compact = serializeDBValue(stxo0, ARMORY_DB_BARE, true, 
+      DB_ENCODING_COMPACT);
+
+   stxo = StoredTxOut();
+   stxo.unserializeDBValue(compact);
+   EXPECT_EQ(   stxo.dataCopy_,     rawTxOut);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(StoredBlockObjTest, SSubHistoryCompactDBValue)
+{
+   BinaryData uniq  = READHEX("00""0000ffff0000ffff0000ffff0000ffff0000ffff");
+   BinaryData hgtX0 = READHEX("0186a000");
+
+   BinaryWriter bw;
+   bw.put_uint8_t(DB_PREFIX_SCRIPT);
+   BinaryData DBPREF = bw.getData();
+
+   StoredSubHistory subssh;
+   subssh.unserializeDBKey(DBPREF + uniq + hgtX0);
+
+   TxIOPair txio0(hgtX0 + READHEX("0004""0001"), 
+      READ_UINT64_HEX_LE("00f2052a01000000"));
+   txio0.setFromCoinbase(true);
+   TxIOPair txio1(hgtX0 + READHEX("0009""0000"), 
+      READ_UINT64_HEX_LE("0000030000000000"));
+   TxIOPair txio2(hgtX0 + READHEX("0109""0002"), 
+      READ_UINT64_HEX_LE("0000000400000000"));
+   txio2.setMultisig(true);
+
+   subssh.txioMap_[txio0.getDBKeyOfOutput()] = txio0;
+   subssh.txioMap_[txio1.getDBKeyOfOutput()] = txio1;
+   subssh.txioMap_[txio2.getDBKeyOfOutput()] = txio2;
+
+   auto&& legacy = serializeDBValue(subssh, nullptr, ARMORY_DB_BARE);
+   auto&& compact = serializeDBValue(subssh, nullptr, ARMORY_DB_BARE, 
+      DB_ENCODING_COMPACT);
+   EXPECT_EQ(compact.getPtr()[0], SUBSSH_COMPACT_MARKER);
+   EXPECT_EQ(compact.getPtr()[1], SUBSSH_COMPACT_VERSION);
+   EXPECT_LT(compact.getSize(), legacy.getSize());
+
+   StoredSubHistory subsshCompact;
+   subsshCompact.unserializeDBKey(DBPREF + uniq + hgtX0);
+   subsshCompact.unserializeDBValue(compact);
+   EXPECT_EQ(subsshCompact.txioCount_, 3);
+   ASSERT_EQ(subsshCompact.txioMap_.size(), 3);
+
+   for (auto& txioPair : subssh.txioMap_)
+   {
+      auto iter = subsshCompact.txioMap_.find(txioPair.first);
+      ASSERT_NE(iter, subsshCompact.txioMap_.end());
+      EXPECT_EQ(iter->second.getValue(), txioPair.second.getValue());
+      EXPECT_EQ(iter->second.getDBKeyOfOutput(), 
+         txioPair.second.getDBKeyOfOutput());
+      EXPECT_EQ(iter->second.isFromCoinbase(), 
+         txioPair.second.isFromCoinbase());
+      EXPECT_EQ(iter->second.isMultisig(), txioPair.second.isMultisig());
+   }
+
+   StoredSubHistory summary;
+   summary.unserializeDBKey(DBPREF + uniq + hgtX0);
+   BinaryRefReader brr(compact);
+   summary.getSummary(brr);
+   EXPECT_EQ(summary.txioCount_, 3);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 TEST_F(StoredBlockObjTest, SHeaderFullBlock)
 {
@@ -5392,10 +6301,126 @@ TEST_F(LMDBTest, PutGetStoredTxHints)
 
 
 ////////////////////////////////////////////////////////////////////////////////
-TEST_F(LMDBTest, PutGetStoredScriptHistory)
+TEST_F(LMDBTest, PutValues_Bulk)
 {
    ASSERT_TRUE(standardOpenDBs());
-   LMDBEnv::Transaction tx(iface_->dbEnv_[SSH].get(), LMDB::ReadWrite);
+
+   //prefixed 8 byte stxo keys from a counter, big endian to sort in order
+   auto makeKey = [](unsigned val, unsigned size)->BinaryData
+   {
+      BinaryWriter bw;
+      bw.put_uint8_t((uint8_t)DB_PREFIX_TXDATA);
+      bw.put_BinaryData(BinaryData(size - 4));
+      bw.put_uint32_t(val, BE);
+      return bw.getData();
+   };
+
+   auto getLastKey = [this](DB_SELECT db)->BinaryData
+   {
+      auto dbIter = iface_->dbs_[db].begin();
+      dbIter.toLast();
+      if (!dbIter.isValid())
+         return BinaryData();
+
+      return BinaryData(
+         (uint8_t*)dbIter.key().mv_data, dbIter.key().mv_size);
+   };
+
+   vector<BinaryData> keys, vals;
+   for (unsigned i = 0; i < 100; i++)
+   {
+      keys.push_back(makeKey(i * 2 + 100, 8));
+      vals.push_back(READHEX("abcd") + WRITE_UINT32_BE(i));
+   }
+
+   //in order batch past the last key, hooks run once per entry
+   {
+      LMDBEnv::Transaction tx;
+      iface_->beginDBTransaction(&tx, STXO, LMDB::ReadWrite);
+
+      vector<pair<BinaryDataRef, BinaryDataRef>> batch;
+      for (unsigned i = 0; i < 50; i++)
+         batch.push_back(make_pair(keys[i].getRef(), vals[i].getRef()));
+
+      auto writeCount = iface_->getStxoWriteCount();
+      iface_->putValues(STXO, batch);
+      EXPECT_EQ(iface_->getStxoWriteCount(), writeCount + 50);
+      EXPECT_EQ(getLastKey(STXO), keys[49]);
+   }
+
+   //out of order batch, straddling the last key and below it
+   {
+      LMDBEnv::Transaction tx;
+      iface_->beginDBTransaction(&tx, STXO, LMDB::ReadWrite);
+
+      vector<BinaryData> lowKeys;
+      for (unsigned i = 0; i < 20; i++)
+         lowKeys.push_back(makeKey(i * 2 + 101, 8));
+
+      vector<pair<BinaryDataRef, BinaryDataRef>> batch;
+      for (unsigned i = 99; i >= 50; i--)
+         batch.push_back(make_pair(keys[i].getRef(), vals[i].getRef()));
+      for (auto& key : lowKeys)
+         batch.push_back(make_pair(key.getRef(), vals[0].getRef()));
+
+      auto writeCount = iface_->getStxoWriteCount();
+      iface_->putValues(STXO, batch);
+      EXPECT_EQ(iface_->getStxoWriteCount(), writeCount + 70);
+      EXPECT_EQ(getLastKey(STXO), keys[99]);
+
+      for (unsigned i = 0; i < 100; i++)
+         EXPECT_EQ(iface_->getValueNoCopy(STXO, keys[i]), vals[i]);
+      for (auto& key : lowKeys)
+         EXPECT_EQ(iface_->getValueNoCopy(STXO, key), vals[0]);
+   }
+
+   //TXHINTS with the hash index: the index entries sort past the tx keys,
+   //so entries can't be appended and go through the insert fallback
+   ASSERT_TRUE(iface_->hasTxHashIndex());
+   for (unsigned round = 0; round < 2; round++)
+   {
+      LMDBEnv::Transaction tx;
+      iface_->beginDBTransaction(&tx, TXHINTS, LMDB::ReadWrite);
+
+      vector<BinaryData> txKeys, txVals;
+      for (unsigned i = 0; i < 10; i++)
+      {
+         txKeys.push_back(makeKey(round * 10 + i, 6));
+
+         BinaryData hash(32);
+         hash.fill(round * 10 + i);
+         txVals.push_back(WRITE_UINT32_LE(1) + hash);
+      }
+
+      vector<pair<BinaryDataRef, BinaryDataRef>> batch;
+      for (unsigned i = 0; i < 10; i++)
+         batch.push_back(make_pair(txKeys[i].getRef(), txVals[i].getRef()));
+      iface_->putValues(TXHINTS, batch);
+
+      BinaryData lastIdxKey = 
+         WRITE_UINT8_BE((uint8_t)DB_PREFIX_TXHASH) + txVals[0].getSliceCopy(4, 32);
+      for (unsigned i = 0; i < 10; i++)
+      {
+         EXPECT_EQ(iface_->getValueNoCopy(TXHINTS, txKeys[i]), txVals[i]);
+
+         auto&& idxKey = WRITE_UINT8_BE((uint8_t)DB_PREFIX_TXHASH) + 
+            txVals[i].getSliceCopy(4, 32);
+         EXPECT_EQ(iface_->getValueNoCopy(TXHINTS, idxKey), 
+            txKeys[i].getSliceRef(1, 6));
+
+         if (lastIdxKey < idxKey)
+            lastIdxKey = idxKey;
+      }
+
+      EXPECT_EQ(getLastKey(TXHINTS), lastIdxKey);
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(LMDBTest, PutGetStoredScriptHistory)
+{
+   ASSERT_TRUE(standardOpenDBs());
+   LMDBEnv::Transaction tx(iface_->dbEnv_[SSH].get(), LMDB::ReadWrite);
    LMDBEnv::Transaction sshtx(iface_->dbEnv_[SUBSSH].get(), LMDB::ReadWrite);
 
    ///////////////////////////////////////////////////////////////////////////
@@ -5561,6 +6586,95 @@ TEST_F(LMDBTest, PutGetStoredScriptHistory)
    EXPECT_TRUE(txioptr->isMultisig());
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(LMDBTest, PutGetAppendedTxFilters)
+{
+   ASSERT_TRUE(standardOpenDBs());
+
+   //4 blocks worth of tx hashes, block ids 10 to 13
+   vector<TxFilter<TxFilterType>> filters;
+   vector<BinaryData> hashes;
+   for (unsigned blk = 0; blk < 4; blk++)
+   {
+      vector<BinaryData> blockHashes;
+      for (unsigned i = 0; i < 5; i++)
+      {
+         BinaryWriter bw;
+         bw.put_uint32_t(blk * 100 + i);
+         bw.put_BinaryData(BinaryData(28));
+         blockHashes.push_back(bw.getData());
+      }
+
+      TxFilter<TxFilterType> filter(10 + blk, blockHashes.size());
+      filter.update(blockHashes);
+      filters.push_back(filter);
+      hashes.push_back(blockHashes[blk]);
+   }
+
+   auto checkPool = [&](uint32_t fileNum, unsigned appendedCount)->void
+   {
+      LMDBEnv::Transaction tx;
+      iface_->beginDBTransaction(&tx, TXFILTERS, LMDB::ReadOnly);
+
+      auto&& poolRef = 
+         iface_->getFilterPoolRefForFileNum<TxFilterType>(fileNum);
+      EXPECT_EQ(poolRef.getAppendedCount(), appendedCount);
+
+      set<uint32_t> ids;
+      for (auto& filter : poolRef.getFilterPoolPtr())
+         ids.insert(filter.getBlockKey());
+      EXPECT_EQ(ids, set<uint32_t>({ 10, 11, 12, 13 }));
+
+      auto&& pool = iface_->getFilterPoolForFileNum<TxFilterType>(fileNum);
+      for (auto poolPtr : { &poolRef, &pool })
+      {
+         for (unsigned blk = 0; blk < 4; blk++)
+         {
+            auto&& hits = poolPtr->compare(hashes[blk]);
+            ASSERT_EQ(hits.size(), 1);
+            EXPECT_EQ(hits.begin()->first, 10 + blk);
+            EXPECT_EQ(hits.begin()->second, set<uint32_t>({ blk }));
+         }
+      }
+   };
+
+   //compacted pool for the first 2 blocks, the other 2 are appended
+   set<TxFilter<TxFilterType>> baseFilters;
+   baseFilters.insert(filters[0]);
+   baseFilters.insert(filters[1]);
+   iface_->putFilterPoolForFileNum(3, TxFilterPool<TxFilterType>(baseFilters));
+   iface_->appendFilterForFileNum(3, filters[2]);
+   iface_->appendFilterForFileNum(3, filters[3]);
+
+   //neighbouring pools should not bleed into file 3
+   iface_->appendFilterForFileNum(2, filters[0]);
+   iface_->appendFilterForFileNum(4, filters[0]);
+
+   EXPECT_TRUE(iface_->hasFilterPoolForFileNum(3));
+   EXPECT_FALSE(iface_->hasFilterPoolForFileNum(5));
+   EXPECT_EQ(iface_->getAppendedFilterCount(3), 2);
+   checkPool(3, 2);
+
+   //compaction folds the appended filters into the pool
+   EXPECT_EQ(iface_->compactFilterPoolForFileNum<TxFilterType>(3), 2);
+   EXPECT_EQ(iface_->getAppendedFilterCount(3), 0);
+   EXPECT_EQ(iface_->compactFilterPoolForFileNum<TxFilterType>(3), 0);
+   checkPool(3, 0);
+   EXPECT_EQ(iface_->getAppendedFilterCount(2), 1);
+   EXPECT_EQ(iface_->getAppendedFilterCount(4), 1);
+
+   //pool made of appended filters only
+   for (auto& filter : filters)
+      iface_->appendFilterForFileNum(6, filter);
+   checkPool(6, 4);
+
+   iface_->deleteFilterPoolForFileNum(6);
+   EXPECT_FALSE(iface_->hasFilterPoolForFileNum(6));
+   EXPECT_THROW(
+      iface_->getFilterPoolRefForFileNum<TxFilterType>(6), runtime_error);
+   EXPECT_TRUE(iface_->hasFilterPoolForFileNum(3));
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 class TxRefTest : public ::testing::Test
@@ -5713,6 +6827,66 @@ TEST_F(WalletsTest, CreateWOCopy_Test)
    ASSERT_EQ(hashSet, hashSetWO);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(WalletsTest, ChainedKeys_Batch)
+{
+   auto&& privRoot = SecureBinaryData().GenerateRandom(32);
+   auto&& chainCode = SecureBinaryData().GenerateRandom(32);
+   auto&& pubRoot = CryptoECDSA().ComputePublicKey(privRoot);
+
+   //batch derivation has to match the link by link one
+   unsigned linkCount = 20;
+   auto&& chainedKeys = CryptoECDSA().ComputeChainedKeys(
+      pubRoot, privRoot, chainCode, linkCount);
+   ASSERT_EQ(chainedKeys.size(), linkCount);
+
+   auto&& pubOnlyKeys = CryptoECDSA().ComputeChainedKeys(
+      pubRoot, SecureBinaryData(), chainCode, linkCount);
+   ASSERT_EQ(pubOnlyKeys.size(), linkCount);
+
+   SecureBinaryData pubKey = pubRoot;
+   SecureBinaryData privKey = privRoot;
+   for (unsigned i = 0; i < linkCount; i++)
+   {
+      auto&& nextPrivKey = CryptoECDSA().ComputeChainedPrivateKey(
+         privKey, chainCode, pubKey);
+      auto&& nextPubKey = CryptoECDSA().ComputeChainedPublicKey(
+         pubKey, chainCode);
+
+      EXPECT_EQ(chainedKeys[i].pubKey_, nextPubKey);
+      EXPECT_EQ(chainedKeys[i].pubKeyCompressed_,
+         CryptoECDSA().CompressPoint(nextPubKey));
+      EXPECT_EQ(chainedKeys[i].privKey_, nextPrivKey);
+      EXPECT_EQ(CryptoECDSA().ComputePublicKey(nextPrivKey), nextPubKey);
+
+      EXPECT_EQ(pubOnlyKeys[i].pubKey_, nextPubKey);
+      EXPECT_EQ(pubOnlyKeys[i].privKey_.getSize(), 0);
+
+      pubKey = move(nextPubKey);
+      privKey = move(nextPrivKey);
+   }
+
+   //extend a wallet chain and report the throughput
+   auto assetWlt = AssetWallet_Single::createFromPrivateRoot_Armory135(
+      homedir_,
+      AddressEntryType_P2PKH,
+      move(privRoot),
+      4);
+
+   unsigned keyCount = 2000;
+   auto start = chrono::steady_clock::now();
+   assetWlt->extendChain(keyCount);
+   auto&& hashSet = assetWlt->getAddrHashSet();
+   auto elapsed = chrono::duration<double>(
+      chrono::steady_clock::now() - start).count();
+
+   cout << keyCount << " keys derived in " << elapsed << "s, " <<
+      unsigned(keyCount / elapsed) << " keys/s" << endl;
+
+   EXPECT_EQ(assetWlt->getLastComputedIndex(), 3 + keyCount);
+   EXPECT_EQ(hashSet.size(), (4 + keyCount) * 3);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -10062,6 +11236,253 @@ TEST_F(BlockUtilsBare, Load5Blocks)
    wltLB2.reset();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockUtilsBare, BlockDataLoader_StreamWindows)
+{
+   BlockDataLoader mmapLoader(blkdir_);
+   BlockDataLoader streamLoader(blkdir_, BlockFileRead_Stream);
+
+   auto fullMap = mmapLoader.get(0);
+   ASSERT_NE(fullMap->getPtr(), nullptr);
+   auto fileSize = fullMap->size();
+
+   //mmap loader hands the whole file for ranged gets
+   auto rangedMap = mmapLoader.get(0, 100, 200);
+   EXPECT_FALSE(rangedMap->isWindow());
+   EXPECT_EQ(rangedMap->size(), fileSize);
+   EXPECT_EQ(rangedMap->getPtr(100, 200), rangedMap->getPtr() + 100);
+
+   //stream window, offsets stay relative to the file
+   auto window = streamLoader.get(0, 100, 200);
+   EXPECT_TRUE(window->isWindow());
+   EXPECT_EQ(window->size(), 200);
+   EXPECT_EQ(window->getPtr(), nullptr);
+   EXPECT_EQ(BinaryDataRef(window->getPtr(100, 200), 200),
+      BinaryDataRef(fullMap->getPtr() + 100, 200));
+   EXPECT_EQ(BinaryDataRef(window->getPtr(250, 50), 50),
+      BinaryDataRef(fullMap->getPtr() + 250, 50));
+
+   EXPECT_THROW(window->getPtr(99, 10), runtime_error);
+   EXPECT_THROW(window->getPtr(250, 51), runtime_error);
+
+   //windows past the end of file are clamped
+   auto tail = streamLoader.get(0, fileSize - 10, 100);
+   EXPECT_EQ(tail->size(), 10);
+   EXPECT_EQ(BinaryDataRef(tail->getPtr(fileSize - 10, 10), 10),
+      BinaryDataRef(fullMap->getPtr() + fileSize - 10, 10));
+
+   EXPECT_THROW(streamLoader.get(0, fileSize + 1, 10), runtime_error);
+
+   //budget, 2 holders always go through
+   BlockStreamBudget budget(1000);
+   budget.acquire(600);
+   budget.acquire(700);
+   EXPECT_EQ(budget.inFlight(), 1300);
+   budget.release(700);
+   budget.acquire(400);
+
+   //3rd holder over budget, blocks until released
+   promise<void> acquiredProm;
+   auto acquiredFut = acquiredProm.get_future();
+   thread waiter([&budget, &acquiredProm](void)->void
+   {
+      budget.acquire(500);
+      acquiredProm.set_value();
+   });
+
+   EXPECT_EQ(acquiredFut.wait_for(chrono::milliseconds(100)),
+      future_status::timeout);
+   budget.release(600);
+   EXPECT_EQ(acquiredFut.wait_for(chrono::seconds(10)),
+      future_status::ready);
+   waiter.join();
+
+   EXPECT_EQ(budget.inFlight(), 900);
+   budget.release(400);
+   budget.release(500);
+   EXPECT_EQ(budget.inFlight(), 0);
+
+   //3rd holder within budget
+   budget.acquire(300);
+   budget.acquire(300);
+   budget.acquire(300);
+   EXPECT_EQ(budget.inFlight(), 900);
+   EXPECT_EQ(budget.peak(), 1300);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockUtilsBare, Load5Blocks_StreamReader)
+{
+   //restart the bdm with the stream reader and a budget smaller than a 
+   //block, so every block is its own batch and each waits on the batch
+   //before the previous one to be committed
+   clients_->exitRequestLoop();
+   clients_->shutdown();
+
+   delete clients_;
+   delete theBDMt_;
+
+   config.blkFileReadMode_ = BlockFileRead_Stream;
+   config.streamBudget_ = 1;
+   initBDM();
+
+   theBDMt_->start(config.initMode_);
+   auto&& bdvID = registerBDV(clients_, magic_);
+   
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   scrAddrVec.push_back(TestChain::scrAddrC);
+   scrAddrVec.push_back(TestChain::scrAddrD);
+   scrAddrVec.push_back(TestChain::scrAddrE);
+   scrAddrVec.push_back(TestChain::scrAddrF);
+
+   regWallet(clients_, bdvID, scrAddrVec, "wallet1");
+
+   auto bdvPtr = getBDV(clients_, bdvID);
+
+   //wait on signals
+   goOnline(clients_, bdvID);
+   waitOnBDMReady(clients_, bdvID);
+   auto wlt = bdvPtr->getWalletOrLockbox(wallet1id);
+
+   const ScrAddrObj* scrObj;
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrA);
+   EXPECT_EQ(scrObj->getFullBalance(), 50*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrB);
+   EXPECT_EQ(scrObj->getFullBalance(), 70*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrC);
+   EXPECT_EQ(scrObj->getFullBalance(), 20*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrD);
+   EXPECT_EQ(scrObj->getFullBalance(), 65*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrE);
+   EXPECT_EQ(scrObj->getFullBalance(), 30*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrF);
+   EXPECT_EQ(scrObj->getFullBalance(),  5*COIN);
+
+   EXPECT_EQ(wlt->getFullBalance(), 240*COIN);
+
+   //cleanup
+   bdvPtr.reset();
+   wlt.reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockUtilsBare, Load5Blocks_BatchMemoryCap)
+{
+   //tracker, waiters hold until usage is back under budget
+   {
+      ScanMemoryTracker tracker(1000);
+      tracker.add(800);
+      tracker.add(400);
+      EXPECT_EQ(tracker.current(), 1200);
+
+      promise<void> belowProm;
+      auto belowFut = belowProm.get_future();
+      thread waiter([&tracker, &belowProm](void)->void
+      {
+         tracker.waitBelowBudget();
+         belowProm.set_value();
+      });
+
+      EXPECT_EQ(belowFut.wait_for(chrono::milliseconds(100)),
+         future_status::timeout);
+      tracker.remove(800);
+      EXPECT_EQ(belowFut.wait_for(chrono::seconds(10)),
+         future_status::ready);
+      waiter.join();
+
+      tracker.remove(1000);
+      EXPECT_EQ(tracker.current(), 0);
+      EXPECT_EQ(tracker.peak(), 1200);
+   }
+
+   //batches split off the blocks past the cap
+   {
+      auto scrRefMap = make_shared<map<TxOutScriptRef, int>>();
+      auto tracker = make_shared<ScanMemoryTracker>(100);
+      auto batch = make_unique<ParserBatch>(10, 20, 0, 0, scrRefMap);
+      batch->memTracker_ = tracker;
+      batch->memCap_ = 50;
+
+      batch->addMemUsage(30);
+      EXPECT_FALSE(batch->flush_.load());
+      batch->addMemUsage(30);
+      EXPECT_TRUE(batch->flush_.load());
+      EXPECT_EQ(tracker->current(), 60);
+
+      //blocks 10 to 13 were picked up
+      batch->blockCounter_.store(14);
+      auto remainder = batch->splitAfterProcessed();
+      ASSERT_NE(remainder, nullptr);
+      EXPECT_EQ(batch->end_, 13);
+      EXPECT_EQ(remainder->start_, 14);
+      EXPECT_EQ(remainder->end_, 20);
+      EXPECT_FALSE(remainder->flush_.load());
+      EXPECT_EQ(remainder->memTracker_, tracker);
+
+      //nothing left past the end
+      remainder->blockCounter_.store(21);
+      EXPECT_EQ(remainder->splitAfterProcessed(), nullptr);
+
+      batch.reset();
+      EXPECT_EQ(tracker->current(), 0);
+   }
+
+   //restart the bdm with one ram usage level of a single byte, every 
+   //batch is cut after its first block and waits on the previous batches 
+   //to be committed before it is parsed
+   clients_->exitRequestLoop();
+   clients_->shutdown();
+
+   delete clients_;
+   delete theBDMt_;
+
+   config.ramUsage_ = 1;
+   config.ramLevelSize_ = 1;
+   initBDM();
+
+   theBDMt_->start(config.initMode_);
+   auto&& bdvID = registerBDV(clients_, magic_);
+   
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   scrAddrVec.push_back(TestChain::scrAddrC);
+   scrAddrVec.push_back(TestChain::scrAddrD);
+   scrAddrVec.push_back(TestChain::scrAddrE);
+   scrAddrVec.push_back(TestChain::scrAddrF);
+
+   regWallet(clients_, bdvID, scrAddrVec, "wallet1");
+
+   auto bdvPtr = getBDV(clients_, bdvID);
+
+   //wait on signals
+   goOnline(clients_, bdvID);
+   waitOnBDMReady(clients_, bdvID);
+   auto wlt = bdvPtr->getWalletOrLockbox(wallet1id);
+
+   const ScrAddrObj* scrObj;
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrA);
+   EXPECT_EQ(scrObj->getFullBalance(), 50*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrB);
+   EXPECT_EQ(scrObj->getFullBalance(), 70*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrC);
+   EXPECT_EQ(scrObj->getFullBalance(), 20*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrD);
+   EXPECT_EQ(scrObj->getFullBalance(), 65*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrE);
+   EXPECT_EQ(scrObj->getFullBalance(), 30*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrF);
+   EXPECT_EQ(scrObj->getFullBalance(),  5*COIN);
+
+   EXPECT_EQ(wlt->getFullBalance(), 240*COIN);
+
+   //cleanup
+   bdvPtr.reset();
+   wlt.reset();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 TEST_F(BlockUtilsBare, Load5Blocks_DamagedBlkFile)
 {
@@ -10207,10 +11628,10 @@ TEST_F(BlockUtilsBare, Load4Blocks_Plus2)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-TEST_F(BlockUtilsBare, Load4Blocks_ReloadBDM_ZC_Plus2)
+TEST_F(BlockUtilsBare, Load4Blocks_Plus2_UtxoSnapshot)
 {
    setBlocks({ "0", "1", "2", "3" }, blk0dat_);
-   
+
    theBDMt_->start(config.initMode_);
    auto&& bdvID = registerBDV(clients_, magic_);
 
@@ -10218,46 +11639,602 @@ TEST_F(BlockUtilsBare, Load4Blocks_ReloadBDM_ZC_Plus2)
    scrAddrVec.push_back(TestChain::scrAddrA);
    scrAddrVec.push_back(TestChain::scrAddrB);
    scrAddrVec.push_back(TestChain::scrAddrC);
+   scrAddrVec.push_back(TestChain::scrAddrD);
    scrAddrVec.push_back(TestChain::scrAddrE);
-
-   const vector<BinaryData> lb1ScrAddrs
-   {
-      TestChain::lb1ScrAddr,
-      TestChain::lb1ScrAddrP2SH
-   };
-   const vector<BinaryData> lb2ScrAddrs
-   {
-      TestChain::lb2ScrAddr,
-      TestChain::lb2ScrAddrP2SH
-   };
+   scrAddrVec.push_back(TestChain::scrAddrF);
 
    regWallet(clients_, bdvID, scrAddrVec, "wallet1");
-   regLockbox(clients_, bdvID, lb1ScrAddrs, TestChain::lb1B58ID);
-   regLockbox(clients_, bdvID, lb2ScrAddrs, TestChain::lb2B58ID);
 
    auto bdvPtr = getBDV(clients_, bdvID);
 
-   
    //wait on signals
    goOnline(clients_, bdvID);
    waitOnBDMReady(clients_, bdvID);
    auto wlt = bdvPtr->getWalletOrLockbox(wallet1id);
-   auto wltLB1 = bdvPtr->getWalletOrLockbox(LB1ID);
-   auto wltLB2 = bdvPtr->getWalletOrLockbox(LB2ID);
 
-   EXPECT_EQ(iface_->getTopBlockHeight(HEADERS), 3);
-   EXPECT_EQ(iface_->getTopBlockHash(HEADERS), TestChain::blkHash3);
-   EXPECT_TRUE(theBDMt_->bdm()->blockchain()->getHeaderByHash(TestChain::blkHash3)->isMainBranch());
+   //utxos per address have to add up to the address balance
+   auto checkUtxos = [&bdvPtr, &wlt, &scrAddrVec](void)->void
+   {
+      for (auto& scrAddr : scrAddrVec)
+      {
+         vector<BinaryData> addrVec;
+         addrVec.push_back(scrAddr);
+         auto&& utxoVec =
+            bdvPtr->getUnspentTxoutsForAddr160List(addrVec, true);
 
-   const ScrAddrObj* scrObj;
-   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrA);
-   EXPECT_EQ(scrObj->getFullBalance(), 50*COIN);
-   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrB);
-   EXPECT_EQ(scrObj->getFullBalance(), 30*COIN);
-   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrC);
-   EXPECT_EQ(scrObj->getFullBalance(), 55*COIN);
+         uint64_t total = 0;
+         for (auto& utxo : utxoVec)
+         {
+            EXPECT_EQ(utxo.getTxHash().getSize(), 32);
+            EXPECT_EQ(utxo.getRecipientScrAddr(), scrAddr);
+            total += utxo.getValue();
+         }
 
-   uint64_t fullBalance = wlt->getFullBalance();
+         auto scrObj = wlt->getScrAddrObjByKey(scrAddr);
+         EXPECT_EQ(total, scrObj->getFullBalance());
+      }
+   };
+
+   //the initial scan leaves a snapshot at the top block
+   auto snapshot = iface_->getUtxoSnapshot();
+   ASSERT_NE(snapshot, nullptr);
+   EXPECT_EQ(snapshot->topHash(), TestChain::blkHash3);
+
+   //entries are sorted by outpoint
+   BinaryData prevOutpoint, stxoKey;
+   snapshot->forEach([&](const UtxoSnapshot::Entry& entry)->void
+   {
+      BinaryData outpoint(entry.txHash_);
+      outpoint.append(entry.dbKey_.getSliceRef(7, 2));
+      EXPECT_TRUE(prevOutpoint < outpoint);
+      prevOutpoint = outpoint;
+
+      stxoKey = entry.dbKey_;
+   });
+   snapshot.reset();
+
+   EXPECT_EQ(wlt->getFullBalance(), 175 * COIN);
+   checkUtxos();
+
+   //the next scan preloads from the snapshot and invalidates it with its 
+   //own STXO writes, new block scans only rewrite it once in a while
+   setBlocks({ "0", "1", "2", "3", "4" }, blk0dat_);
+   triggerNewBlockNotification(theBDMt_);
+   waitOnNewBlockSignal(clients_, bdvID);
+   EXPECT_EQ(iface_->getUtxoSnapshot(), nullptr);
+
+   //shutting down puts the snapshot back at the top block
+   bdvPtr.reset();
+   wlt.reset();
+
+   clients_->exitRequestLoop();
+   clients_->shutdown();
+
+   snapshot = iface_->getUtxoSnapshot();
+   ASSERT_NE(snapshot, nullptr);
+   EXPECT_EQ(snapshot->topHash(), TestChain::blkHash4);
+   snapshot.reset();
+
+   delete clients_;
+   delete theBDMt_;
+
+   initBDM();
+   EXPECT_TRUE(iface_->hasUtxoSnapshot());
+
+   theBDMt_->start(config.initMode_);
+   bdvID = registerBDV(clients_, magic_);
+   regWallet(clients_, bdvID, scrAddrVec, "wallet1");
+   bdvPtr = getBDV(clients_, bdvID);
+
+   goOnline(clients_, bdvID);
+   waitOnBDMReady(clients_, bdvID);
+   wlt = bdvPtr->getWalletOrLockbox(wallet1id);
+   checkUtxos();
+
+   //the first new block after the restart preloads from the snapshot 
+   //instead of rebuilding the utxo set out of STXO
+   auto loadCount = iface_->getUtxoSnapshotLoadCount();
+   setBlocks({ "0", "1", "2", "3", "4", "5" }, blk0dat_);
+   triggerNewBlockNotification(theBDMt_);
+   waitOnNewBlockSignal(clients_, bdvID);
+
+   EXPECT_GT(iface_->getUtxoSnapshotLoadCount(), loadCount);
+   EXPECT_EQ(iface_->getUtxoSnapshot(), nullptr);
+   EXPECT_EQ(wlt->getFullBalance(), 240 * COIN);
+
+   //any STXO write drops the snapshot
+   vector<const StoredTxOut*> noUtxos;
+   auto writeCount = iface_->getStxoWriteCount();
+   ASSERT_TRUE(iface_->putUtxoSnapshot(
+      TestChain::blkHash5, noUtxos, writeCount));
+   ASSERT_NE(iface_->getUtxoSnapshot(), nullptr);
+   {
+      LMDBEnv::Transaction tx;
+      iface_->beginDBTransaction(&tx, STXO, LMDB::ReadWrite);
+      BinaryData stxoVal(iface_->getValueNoCopy(STXO, stxoKey.getRef()));
+      ASSERT_GT(stxoVal.getSize(), 0);
+      iface_->putValue(STXO, stxoKey.getRef(), stxoVal.getRef());
+   }
+
+   EXPECT_EQ(iface_->getUtxoSnapshot(), nullptr);
+   EXPECT_FALSE(DBUtils::fileExists(iface_->getUtxoSnapshotPath(), 0));
+
+   //a snapshot built against a stale write count is refused
+   EXPECT_FALSE(iface_->putUtxoSnapshot(
+      TestChain::blkHash5, noUtxos, writeCount));
+   EXPECT_EQ(iface_->getUtxoSnapshot(), nullptr);
+
+   //cleanup
+   bdvPtr.reset();
+   wlt.reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockUtilsBare, Load5Blocks_MultiGet)
+{
+   setBlocks({ "0", "1", "2", "3", "4", "5" }, blk0dat_);
+
+   theBDMt_->start(config.initMode_);
+   auto&& bdvID = registerBDV(clients_, magic_);
+
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   scrAddrVec.push_back(TestChain::scrAddrC);
+   scrAddrVec.push_back(TestChain::scrAddrD);
+   scrAddrVec.push_back(TestChain::scrAddrE);
+   scrAddrVec.push_back(TestChain::scrAddrF);
+
+   regWallet(clients_, bdvID, scrAddrVec, "wallet1");
+
+   auto bdvPtr = getBDV(clients_, bdvID);
+
+   //wait on signals
+   goOnline(clients_, bdvID);
+   waitOnBDMReady(clients_, bdvID);
+
+   {
+      LMDBEnv::Transaction tx;
+      iface_->beginDBTransaction(&tx, STXO, LMDB::ReadOnly);
+
+      vector<BinaryData> keys;
+      auto dbIter = iface_->getIterator(STXO);
+      dbIter.seekToFirst();
+      while (dbIter.isValid())
+      {
+         keys.push_back(dbIter.getKey());
+         if (!dbIter.advanceAndRead())
+            break;
+      }
+      ASSERT_GT(keys.size(), 2);
+
+      //reversed order, a duplicate and a missing key
+      vector<BinaryDataRef> keyRefs;
+      for (auto iter = keys.rbegin(); iter != keys.rend(); ++iter)
+         keyRefs.push_back(iter->getRef());
+      keyRefs.push_back(keys[1].getRef());
+
+      BinaryData missingKey = keys[0];
+      missingKey.append(0xFF);
+      keyRefs.push_back(missingKey.getRef());
+
+      auto&& values = iface_->multiGet(STXO, keyRefs);
+      ASSERT_EQ(values.size(), keyRefs.size());
+      for (unsigned i = 0; i < keyRefs.size() - 1; i++)
+      {
+         EXPECT_GT(values[i].getSize(), 0);
+         EXPECT_EQ(values[i], iface_->getValueNoCopy(STXO, keyRefs[i]));
+      }
+
+      EXPECT_EQ(values.back().getSize(), 0);
+      EXPECT_EQ(iface_->multiGet(STXO, vector<BinaryDataRef>()).size(), 0);
+   }
+
+   //batched utxo map has to match the snapshot one
+   unsigned checkedCount = 0;
+   for (auto& scrAddr : scrAddrVec)
+   {
+      vector<BinaryData> addrVec;
+      addrVec.push_back(scrAddr);
+      auto&& utxoVec = bdvPtr->getUnspentTxoutsForAddr160List(addrVec, true);
+
+      StoredScriptHistory ssh;
+      iface_->getStoredScriptHistory(ssh, scrAddr);
+      map<BinaryData, UnspentTxOut> utxoMap;
+      //the map is only built when the txio count matches the ssh summary
+      if (!iface_->getFullUTXOMapForSSH(ssh, utxoMap))
+         continue;
+      ++checkedCount;
+
+      ASSERT_EQ(utxoMap.size(), utxoVec.size());
+      for (auto& utxo : utxoVec)
+      {
+         bool found = false;
+         for (auto& utxoPair : utxoMap)
+         {
+            if (utxoPair.second.getTxHash() != utxo.getTxHash() ||
+               utxoPair.second.getTxOutIndex() != utxo.getTxOutIndex())
+               continue;
+
+            EXPECT_EQ(utxoPair.second.getValue(), utxo.getValue());
+            EXPECT_EQ(utxoPair.second.getScript(), utxo.getScript());
+            EXPECT_EQ(utxoPair.second.getTxHeight(), utxo.getTxHeight());
+            found = true;
+         }
+
+         EXPECT_TRUE(found);
+      }
+   }
+
+   EXPECT_GT(checkedCount, 0);
+
+   //cleanup
+   bdvPtr.reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockUtilsBare, Load5Blocks_CompactValues)
+{
+   //the encoding only applies to new DBs, restart the bdm on an empty dbdir
+   clients_->exitRequestLoop();
+   clients_->shutdown();
+
+   delete clients_;
+   delete theBDMt_;
+
+   rmdir(ldbdir_);
+   mkdir(ldbdir_);
+
+   config.compactDbValues_ = true;
+   initBDM();
+
+   theBDMt_->start(config.initMode_);
+   auto&& bdvID = registerBDV(clients_, magic_);
+
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   scrAddrVec.push_back(TestChain::scrAddrC);
+   scrAddrVec.push_back(TestChain::scrAddrD);
+   scrAddrVec.push_back(TestChain::scrAddrE);
+   scrAddrVec.push_back(TestChain::scrAddrF);
+
+   const vector<BinaryData> lb1ScrAddrs
+   {
+      TestChain::lb1ScrAddr,
+      TestChain::lb1ScrAddrP2SH
+   };
+
+   regWallet(clients_, bdvID, scrAddrVec, "wallet1");
+   regLockbox(clients_, bdvID, lb1ScrAddrs, TestChain::lb1B58ID);
+
+   auto bdvPtr = getBDV(clients_, bdvID);
+
+   //wait on signals
+   goOnline(clients_, bdvID);
+   waitOnBDMReady(clients_, bdvID);
+   auto wlt = bdvPtr->getWalletOrLockbox(wallet1id);
+   auto wltLB1 = bdvPtr->getWalletOrLockbox(LB1ID);
+
+   EXPECT_EQ(iface_->getValueEncoding(STXO), DB_ENCODING_COMPACT);
+   EXPECT_EQ(iface_->getValueEncoding(SUBSSH), DB_ENCODING_COMPACT);
+   EXPECT_EQ(iface_->getValueEncoding(SSH), DB_ENCODING_LEGACY);
+
+   const ScrAddrObj* scrObj;
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrA);
+   EXPECT_EQ(scrObj->getFullBalance(), 50*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrB);
+   EXPECT_EQ(scrObj->getFullBalance(), 70*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrC);
+   EXPECT_EQ(scrObj->getFullBalance(), 20*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrD);
+   EXPECT_EQ(scrObj->getFullBalance(), 65*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrE);
+   EXPECT_EQ(scrObj->getFullBalance(), 30*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrF);
+   EXPECT_EQ(scrObj->getFullBalance(),  5*COIN);
+
+   scrObj = wltLB1->getScrAddrObjByKey(TestChain::lb1ScrAddr);
+   EXPECT_EQ(scrObj->getFullBalance(), 5*COIN);
+   scrObj = wltLB1->getScrAddrObjByKey(TestChain::lb1ScrAddrP2SH);
+   EXPECT_EQ(scrObj->getFullBalance(), 25*COIN);
+
+   auto&& utxoVec = bdvPtr->getUnspentTxoutsForAddr160List(scrAddrVec, true);
+   uint64_t utxoTotal = 0;
+   for (auto& utxo : utxoVec)
+      utxoTotal += utxo.getValue();
+   EXPECT_EQ(utxoTotal, 240 * COIN);
+
+   //value sizes and decode speed against the legacy encoding
+   vector<BinaryData> compactStxos, legacyStxos;
+   {
+      LMDBEnv::Transaction tx;
+      iface_->beginDBTransaction(&tx, STXO, LMDB::ReadOnly);
+
+      auto dbIter = iface_->getIterator(STXO);
+      dbIter.seekToFirst();
+      while (dbIter.isValid())
+      {
+         auto key = dbIter.getKeyRef();
+         if (key.getSize() == 9 && key.getPtr()[0] == DB_PREFIX_TXDATA)
+         {
+            auto value = dbIter.getValueRef();
+            EXPECT_EQ(value.getPtr()[0] >> 4, STXO_COMPACT_VERSION);
+
+            StoredTxOut stxo;
+            stxo.unserializeDBValue(value);
+            compactStxos.push_back(value);
+            legacyStxos.push_back(
+               serializeDBValue(stxo, ARMORY_DB_BARE, true));
+
+            StoredTxOut stxoLegacy;
+            stxoLegacy.unserializeDBValue(legacyStxos.back());
+            EXPECT_EQ(stxoLegacy.dataCopy_, stxo.dataCopy_);
+            EXPECT_EQ(stxoLegacy.spentByTxInKey_, stxo.spentByTxInKey_);
+         }
+
+         if (!dbIter.advanceAndRead())
+            break;
+      }
+   }
+
+   vector<pair<BinaryData, BinaryData>> compactSubssh, legacySubssh;
+   {
+      LMDBEnv::Transaction tx;
+      iface_->beginDBTransaction(&tx, SUBSSH, LMDB::ReadOnly);
+
+      auto dbIter = iface_->getIterator(SUBSSH);
+      dbIter.seekToFirst();
+      while (dbIter.isValid())
+      {
+         auto key = dbIter.getKeyRef();
+         if (key.getPtr()[0] == DB_PREFIX_SCRIPT)
+         {
+            auto value = dbIter.getValueRef();
+            EXPECT_EQ(value.getPtr()[0], SUBSSH_COMPACT_MARKER);
+
+            StoredSubHistory subssh;
+            subssh.unserializeDBKey(key);
+            subssh.unserializeDBValue(value);
+            compactSubssh.push_back(make_pair(key, value));
+            legacySubssh.push_back(make_pair(key, serializeDBValue(
+               subssh, iface_, ARMORY_DB_BARE, DB_ENCODING_LEGACY)));
+
+            StoredSubHistory subsshLegacy;
+            subsshLegacy.unserializeDBKey(key);
+            subsshLegacy.unserializeDBValue(legacySubssh.back().second);
+            ASSERT_EQ(subsshLegacy.txioMap_.size(), subssh.txioMap_.size());
+            for (auto& txioPair : subssh.txioMap_)
+            {
+               auto iter = subsshLegacy.txioMap_.find(txioPair.first);
+               ASSERT_NE(iter, subsshLegacy.txioMap_.end());
+               EXPECT_EQ(iter->second.getValue(), txioPair.second.getValue());
+               EXPECT_EQ(iter->second.getDBKeyOfInput(), 
+                  txioPair.second.getDBKeyOfInput());
+            }
+         }
+
+         if (!dbIter.advanceAndRead())
+            break;
+      }
+   }
+
+   ASSERT_GT(compactStxos.size(), 0);
+   ASSERT_GT(compactSubssh.size(), 0);
+
+   auto totalSize = [](const vector<BinaryData>& values)->size_t
+   {
+      size_t total = 0;
+      for (auto& val : values)
+         total += val.getSize();
+      return total;
+   };
+
+   vector<BinaryData> compactSubsshVals, legacySubsshVals;
+   for (unsigned i = 0; i < compactSubssh.size(); i++)
+   {
+      compactSubsshVals.push_back(compactSubssh[i].second);
+      legacySubsshVals.push_back(legacySubssh[i].second);
+   }
+
+   const unsigned passCount = 2000;
+   auto timeDecode = [&](const string& name, 
+      const vector<BinaryData>& stxos, 
+      const vector<pair<BinaryData, BinaryData>>& subsshs)->void
+   {
+      auto start = chrono::steady_clock::now();
+      for (unsigned i = 0; i < passCount; i++)
+      {
+         for (auto& val : stxos)
+         {
+            StoredTxOut stxo;
+            stxo.unserializeDBValue(val);
+         }
+
+         for (auto& keyVal : subsshs)
+         {
+            StoredSubHistory subssh;
+            subssh.unserializeDBKey(keyVal.first);
+            subssh.unserializeDBValue(keyVal.second);
+         }
+      }
+
+      auto elapsed = chrono::duration_cast<chrono::nanoseconds>(
+         chrono::steady_clock::now() - start).count();
+      cout << name << ": " << 
+         elapsed / (passCount * (stxos.size() + subsshs.size())) <<
+         "ns per value" << endl;
+   };
+
+   cout << "stxo values: " << compactStxos.size() << ", legacy " << 
+      totalSize(legacyStxos) << " bytes, compact " << 
+      totalSize(compactStxos) << " bytes" << endl;
+   cout << "subssh values: " << compactSubssh.size() << ", legacy " << 
+      totalSize(legacySubsshVals) << " bytes, compact " << 
+      totalSize(compactSubsshVals) << " bytes" << endl;
+   timeDecode("legacy decode", legacyStxos, legacySubssh);
+   timeDecode("compact decode", compactStxos, compactSubssh);
+
+   EXPECT_LT(totalSize(compactStxos), totalSize(legacyStxos));
+   EXPECT_LT(totalSize(compactSubsshVals), totalSize(legacySubsshVals));
+
+   //cleanup
+   bdvPtr.reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockUtilsBare, Load4Blocks_Plus2_AppendedTxFilters)
+{
+   //txfilters are only kept in DB_FULL, restart the bdm on an empty dbdir
+   clients_->exitRequestLoop();
+   clients_->shutdown();
+
+   delete clients_;
+   delete theBDMt_;
+
+   rmdir(ldbdir_);
+   mkdir(ldbdir_);
+
+   setBlocks({ "0", "1", "2", "3" }, blk0dat_);
+   config.armoryDbType_ = ARMORY_DB_FULL;
+   initBDM();
+
+   theBDMt_->start(config.initMode_);
+   auto&& bdvID = registerBDV(clients_, magic_);
+
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   scrAddrVec.push_back(TestChain::scrAddrC);
+   scrAddrVec.push_back(TestChain::scrAddrD);
+
+   regWallet(clients_, bdvID, scrAddrVec, "wallet1");
+   auto bdvPtr = getBDV(clients_, bdvID);
+
+   //wait on signals
+   goOnline(clients_, bdvID);
+   waitOnBDMReady(clients_, bdvID);
+   auto wlt = bdvPtr->getWalletOrLockbox(wallet1id);
+
+   auto blockchain = theBDMt_->bdm()->blockchain();
+   auto getPoolIds = [this](uint32_t fileNum)->set<uint32_t>
+   {
+      LMDBEnv::Transaction tx;
+      iface_->beginDBTransaction(&tx, TXFILTERS, LMDB::ReadOnly);
+
+      auto&& pool = iface_->getFilterPoolRefForFileNum<TxFilterType>(fileNum);
+
+      set<uint32_t> ids;
+      for (auto& filter : pool.getFilterPoolPtr())
+         ids.insert(filter.getBlockKey());
+      return ids;
+   };
+
+   auto getChainIds = [&blockchain](unsigned from, unsigned to)->set<uint32_t>
+   {
+      set<uint32_t> ids;
+      for (unsigned i = from; i <= to; i++)
+         ids.insert(blockchain->getHeaderByHeight(i)->getThisID());
+      return ids;
+   };
+
+   //initial pool is written compacted
+   EXPECT_EQ(iface_->getAppendedFilterCount(0), 0);
+   EXPECT_EQ(getPoolIds(0), getChainIds(0, 3));
+
+   //a new block in the same blk file is appended to its pool
+   setBlocks({ "0", "1", "2", "3", "4" }, blk0dat_);
+   triggerNewBlockNotification(theBDMt_);
+   waitOnNewBlockSignal(clients_, bdvID);
+
+   EXPECT_EQ(iface_->getTopBlockHeight(HEADERS), 4);
+   EXPECT_EQ(iface_->getAppendedFilterCount(0), 1);
+   EXPECT_EQ(getPoolIds(0), getChainIds(0, 4));
+
+   //moving on to the next blk file gets the previous pool compacted
+   std::string blk1dat = BtcUtils::getBlkFilename(blkdir_, 1);
+   setBlocks({ "5" }, blk1dat);
+   triggerNewBlockNotification(theBDMt_);
+   waitOnNewBlockSignal(clients_, bdvID);
+
+   EXPECT_EQ(iface_->getTopBlockHeight(HEADERS), 5);
+   EXPECT_EQ(iface_->getAppendedFilterCount(1), 0);
+   EXPECT_EQ(getPoolIds(1), getChainIds(5, 5));
+
+   //compaction runs in the background
+   unsigned waitCount = 0;
+   while (iface_->getAppendedFilterCount(0) != 0 && waitCount++ < 50)
+      this_thread::sleep_for(chrono::milliseconds(100));
+   EXPECT_EQ(iface_->getAppendedFilterCount(0), 0);
+   EXPECT_EQ(getPoolIds(0), getChainIds(0, 4));
+
+   const ScrAddrObj* scrObj;
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrA);
+   EXPECT_EQ(scrObj->getFullBalance(), 50*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrB);
+   EXPECT_EQ(scrObj->getFullBalance(), 70*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrC);
+   EXPECT_EQ(scrObj->getFullBalance(), 20*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrD);
+   EXPECT_EQ(scrObj->getFullBalance(), 65*COIN);
+
+   //cleanup
+   bdvPtr.reset();
+   wlt.reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockUtilsBare, Load4Blocks_ReloadBDM_ZC_Plus2)
+{
+   setBlocks({ "0", "1", "2", "3" }, blk0dat_);
+   
+   theBDMt_->start(config.initMode_);
+   auto&& bdvID = registerBDV(clients_, magic_);
+
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   scrAddrVec.push_back(TestChain::scrAddrC);
+   scrAddrVec.push_back(TestChain::scrAddrE);
+
+   const vector<BinaryData> lb1ScrAddrs
+   {
+      TestChain::lb1ScrAddr,
+      TestChain::lb1ScrAddrP2SH
+   };
+   const vector<BinaryData> lb2ScrAddrs
+   {
+      TestChain::lb2ScrAddr,
+      TestChain::lb2ScrAddrP2SH
+   };
+
+   regWallet(clients_, bdvID, scrAddrVec, "wallet1");
+   regLockbox(clients_, bdvID, lb1ScrAddrs, TestChain::lb1B58ID);
+   regLockbox(clients_, bdvID, lb2ScrAddrs, TestChain::lb2B58ID);
+
+   auto bdvPtr = getBDV(clients_, bdvID);
+
+   
+   //wait on signals
+   goOnline(clients_, bdvID);
+   waitOnBDMReady(clients_, bdvID);
+   auto wlt = bdvPtr->getWalletOrLockbox(wallet1id);
+   auto wltLB1 = bdvPtr->getWalletOrLockbox(LB1ID);
+   auto wltLB2 = bdvPtr->getWalletOrLockbox(LB2ID);
+
+   EXPECT_EQ(iface_->getTopBlockHeight(HEADERS), 3);
+   EXPECT_EQ(iface_->getTopBlockHash(HEADERS), TestChain::blkHash3);
+   EXPECT_TRUE(theBDMt_->bdm()->blockchain()->getHeaderByHash(TestChain::blkHash3)->isMainBranch());
+
+   const ScrAddrObj* scrObj;
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrA);
+   EXPECT_EQ(scrObj->getFullBalance(), 50*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrB);
+   EXPECT_EQ(scrObj->getFullBalance(), 30*COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrC);
+   EXPECT_EQ(scrObj->getFullBalance(), 55*COIN);
+
+   uint64_t fullBalance = wlt->getFullBalance();
    uint64_t spendableBalance = wlt->getSpendableBalance(4);
    uint64_t unconfirmedBalance = wlt->getUnconfirmedBalance(4);
    EXPECT_EQ(fullBalance, 165*COIN);
@@ -10931,28 +12908,287 @@ TEST_F(BlockUtilsBare, Load3Blocks_RBF)
       spendScript.put_uint8_t(OP_EQUALVERIFY);
       spendScript.put_uint8_t(OP_CHECKSIG);
 
-      auto& spendScriptbd = spendScript.getData();
+      auto& spendScriptbd = spendScript.getData();
+
+      //output
+      bw.put_var_int(1);
+      bw.put_uint64_t(30 * COIN); //value
+      bw.put_var_int(spendScriptbd.getSize()); //script length
+      bw.put_BinaryData(spendScriptbd); //spend script
+
+      //locktime
+      bw.put_uint32_t(UINT32_MAX);
+
+      spendRBF = bw.getData();
+   }
+
+   auto&& RBFhash       = BtcUtils::getHash256(rawRBF);
+   auto&& spendRBFhash  = BtcUtils::getHash256(spendRBF);
+
+   ZcVector rawRBFVec;
+   ZcVector spendRBFVec;
+
+   rawRBFVec.push_back(move(rawRBF), 1400000000);
+   spendRBFVec.push_back(move(spendRBF), 1500000000);
+
+   //copy the first 4 blocks
+   setBlocks({ "0", "1", "2", "3" }, blk0dat_);
+
+   theBDMt_->start(config.initMode_);
+   auto&& bdvID = registerBDV(clients_, magic_);
+
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   scrAddrVec.push_back(TestChain::scrAddrC);
+
+   const vector<BinaryData> lb1ScrAddrs
+   {
+      TestChain::lb1ScrAddr,
+      TestChain::lb1ScrAddrP2SH
+   };
+   const vector<BinaryData> lb2ScrAddrs
+   {
+      TestChain::lb2ScrAddr,
+      TestChain::lb2ScrAddrP2SH
+   };
+
+   regWallet(clients_, bdvID, scrAddrVec, "wallet1");
+   regLockbox(clients_, bdvID, lb1ScrAddrs, TestChain::lb1B58ID);
+   regLockbox(clients_, bdvID, lb2ScrAddrs, TestChain::lb2B58ID);
+
+   auto bdvPtr = getBDV(clients_, bdvID);
+
+
+   //wait on signals
+   goOnline(clients_, bdvID);
+   waitOnBDMReady(clients_, bdvID);
+   auto wlt = bdvPtr->getWalletOrLockbox(wallet1id);
+   auto wltLB1 = bdvPtr->getWalletOrLockbox(LB1ID);
+   auto wltLB2 = bdvPtr->getWalletOrLockbox(LB2ID);
+
+   const ScrAddrObj* scrObj;
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrA);
+   EXPECT_EQ(scrObj->getFullBalance(), 50 * COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrB);
+   EXPECT_EQ(scrObj->getFullBalance(), 30 * COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrC);
+   EXPECT_EQ(scrObj->getFullBalance(), 55 * COIN);
+
+   uint64_t fullBalance = wlt->getFullBalance();
+   uint64_t spendableBalance = wlt->getSpendableBalance(3);
+   uint64_t unconfirmedBalance = wlt->getUnconfirmedBalance(3);
+   EXPECT_EQ(fullBalance, 135 * COIN);
+   EXPECT_EQ(spendableBalance, 35 * COIN);
+   EXPECT_EQ(unconfirmedBalance, 135 * COIN);
+
+   //add RBF ZC
+   pushNewZc(theBDMt_, rawRBFVec);
+   waitOnNewZcSignal(clients_, bdvID);
+
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrA);
+   EXPECT_EQ(scrObj->getFullBalance(), 50 * COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrB);
+   EXPECT_EQ(scrObj->getFullBalance(), 0 * COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrC);
+   EXPECT_EQ(scrObj->getFullBalance(), 55 * COIN);
+
+   fullBalance = wlt->getFullBalance();
+   spendableBalance = wlt->getSpendableBalance(3);
+   unconfirmedBalance = wlt->getUnconfirmedBalance(3);
+   EXPECT_EQ(fullBalance, 105 * COIN);
+   EXPECT_EQ(spendableBalance, 5 * COIN);
+   EXPECT_EQ(unconfirmedBalance, 105 * COIN);
+
+   //check ledger
+   auto le = wlt->getLedgerEntryForTx(RBFhash);
+   EXPECT_EQ(le.getTxTime(), 1400000000);
+   EXPECT_EQ(le.getValue(), -30 * COIN);
+   EXPECT_EQ(le.getBlockNum(), UINT32_MAX);
+   EXPECT_TRUE(le.isOptInRBF());
+
+   //replace it
+   pushNewZc(theBDMt_, spendRBFVec);
+   waitOnNewZcSignal(clients_, bdvID);
+
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrA);
+   EXPECT_EQ(scrObj->getFullBalance(), 80 * COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrB);
+   EXPECT_EQ(scrObj->getFullBalance(), 0 * COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrC);
+   EXPECT_EQ(scrObj->getFullBalance(), 55 * COIN);
+
+   fullBalance = wlt->getFullBalance();
+   spendableBalance = wlt->getSpendableBalance(3);
+   unconfirmedBalance = wlt->getUnconfirmedBalance(3);
+   EXPECT_EQ(fullBalance, 135 * COIN);
+   EXPECT_EQ(spendableBalance, 5 * COIN);
+   EXPECT_EQ(unconfirmedBalance, 135 * COIN);
+
+   //verify replacement in ledgers
+   le = wlt->getLedgerEntryForTx(RBFhash);
+   EXPECT_EQ(le.getTxHash(), BtcUtils::EmptyHash_);
+
+   le = wlt->getLedgerEntryForTx(spendRBFhash);
+   EXPECT_EQ(le.getTxTime(), 1500000000);
+   EXPECT_EQ(le.getValue(), 30 * COIN);
+   EXPECT_EQ(le.getBlockNum(), UINT32_MAX);
+   EXPECT_TRUE(le.isOptInRBF());
+
+   //add last blocks
+   setBlocks({ "0", "1", "2", "3", "4", "5" }, blk0dat_);
+   triggerNewBlockNotification(theBDMt_);
+   waitOnNewBlockSignal(clients_, bdvID);
+
+   EXPECT_EQ(iface_->getTopBlockHeight(HEADERS), 5);
+   EXPECT_EQ(iface_->getTopBlockHash(HEADERS), TestChain::blkHash5);
+   EXPECT_TRUE(theBDMt_->bdm()->blockchain()->getHeaderByHash(TestChain::blkHash5)->isMainBranch());
+
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrA);
+   EXPECT_EQ(scrObj->getFullBalance(), 50 * COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrB);
+   EXPECT_EQ(scrObj->getFullBalance(), 70 * COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrC);
+   EXPECT_EQ(scrObj->getFullBalance(), 20 * COIN);
+
+   fullBalance = wlt->getFullBalance();
+   spendableBalance = wlt->getSpendableBalance(5);
+   unconfirmedBalance = wlt->getUnconfirmedBalance(5);
+   EXPECT_EQ(fullBalance, 140 * COIN);
+   EXPECT_EQ(spendableBalance, 40 * COIN);
+   EXPECT_EQ(unconfirmedBalance, 140 * COIN);
+   
+   //verify replacement ZC is invalid now
+   le = wlt->getLedgerEntryForTx(spendRBFhash);
+   EXPECT_EQ(le.getTxHash(), BtcUtils::EmptyHash_);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockUtilsBare, Load3Blocks_RBF_Descendants)
+{
+   //RBF ZC spending 5|1 to A, a chain of 2 ZCs descending from it, then a
+   //replacement of the RBF ZC that should evict the whole chain
+   auto&& ZC1 = getTx(5, 1);
+   Tx zcTx1(ZC1);
+   OutPoint op0 = zcTx1.getTxInCopy(0).getOutPoint();
+
+   //sequence 1 flags the txs as RBF
+   auto&& rawRBF = makeP2PKHTx(
+      op0.getTxHash(), op0.getTxOutIndex(), TestChain::addrA, 30 * COIN, 1);
+   auto&& RBFhash = BtcUtils::getHash256(rawRBF);
+   auto&& rawChild = makeP2PKHTx(
+      RBFhash, 0, TestChain::addrC, 30 * COIN, 1);
+   auto&& childHash = BtcUtils::getHash256(rawChild);
+   auto&& rawGrandChild = makeP2PKHTx(
+      childHash, 0, TestChain::addrA, 30 * COIN, 1);
+   auto&& grandChildHash = BtcUtils::getHash256(rawGrandChild);
+   auto&& rawReplacement = makeP2PKHTx(
+      op0.getTxHash(), op0.getTxOutIndex(), TestChain::addrC, 30 * COIN, 1);
+   auto&& replacementHash = BtcUtils::getHash256(rawReplacement);
+
+   ZcVector rbfVec, chainVec, replacementVec;
+   rbfVec.push_back(move(rawRBF), 1400000000);
+   chainVec.push_back(move(rawChild), 1500000000);
+   chainVec.push_back(move(rawGrandChild), 1500000000);
+   replacementVec.push_back(move(rawReplacement), 1600000000);
+
+   //copy the first 4 blocks
+   setBlocks({ "0", "1", "2", "3" }, blk0dat_);
+
+   theBDMt_->start(config.initMode_);
+   auto&& bdvID = registerBDV(clients_, magic_);
+
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   scrAddrVec.push_back(TestChain::scrAddrC);
+   regWallet(clients_, bdvID, scrAddrVec, "wallet1");
+
+   auto bdvPtr = getBDV(clients_, bdvID);
+
+   //wait on signals
+   goOnline(clients_, bdvID);
+   waitOnBDMReady(clients_, bdvID);
+   auto wlt = bdvPtr->getWalletOrLockbox(wallet1id);
+
+   const ScrAddrObj* scrObj;
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrA);
+   EXPECT_EQ(scrObj->getFullBalance(), 50 * COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrB);
+   EXPECT_EQ(scrObj->getFullBalance(), 30 * COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrC);
+   EXPECT_EQ(scrObj->getFullBalance(), 55 * COIN);
+
+   //push the RBF ZC, then its descendants
+   pushNewZc(theBDMt_, rbfVec);
+   waitOnNewZcSignal(clients_, bdvID);
+
+   pushNewZc(theBDMt_, chainVec);
+   waitOnNewZcSignal(clients_, bdvID);
+
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrA);
+   EXPECT_EQ(scrObj->getFullBalance(), 80 * COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrB);
+   EXPECT_EQ(scrObj->getFullBalance(), 0 * COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrC);
+   EXPECT_EQ(scrObj->getFullBalance(), 55 * COIN);
+
+   auto le = wlt->getLedgerEntryForTx(grandChildHash);
+   EXPECT_EQ(le.getBlockNum(), UINT32_MAX);
+   EXPECT_TRUE(le.isChainedZC());
+
+   //replace the RBF ZC, the chain goes with it
+   pushNewZc(theBDMt_, replacementVec);
+   waitOnNewZcSignal(clients_, bdvID);
+
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrA);
+   EXPECT_EQ(scrObj->getFullBalance(), 50 * COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrB);
+   EXPECT_EQ(scrObj->getFullBalance(), 0 * COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrC);
+   EXPECT_EQ(scrObj->getFullBalance(), 85 * COIN);
+
+   le = wlt->getLedgerEntryForTx(RBFhash);
+   EXPECT_EQ(le.getTxHash(), BtcUtils::EmptyHash_);
+   le = wlt->getLedgerEntryForTx(childHash);
+   EXPECT_EQ(le.getTxHash(), BtcUtils::EmptyHash_);
+   le = wlt->getLedgerEntryForTx(grandChildHash);
+   EXPECT_EQ(le.getTxHash(), BtcUtils::EmptyHash_);
 
-      //output
-      bw.put_var_int(1);
-      bw.put_uint64_t(30 * COIN); //value
-      bw.put_var_int(spendScriptbd.getSize()); //script length
-      bw.put_BinaryData(spendScriptbd); //spend script
+   le = wlt->getLedgerEntryForTx(replacementHash);
+   EXPECT_EQ(le.getTxTime(), 1600000000);
+   EXPECT_EQ(le.getValue(), 30 * COIN);
+   EXPECT_TRUE(le.isOptInRBF());
 
-      //locktime
-      bw.put_uint32_t(UINT32_MAX);
+   //only the replacement is left in the zc container
+   auto zcMap = theBDMt_->bdm()->zeroConfCont()->getFullTxioMap();
+   EXPECT_EQ(zcMap->size(), 2);
 
-      spendRBF = bw.getData();
-   }
+   auto zcConf = theBDMt_->bdm()->zeroConfCont();
+   EXPECT_FALSE(zcConf->hasTxByHash(childHash));
+   EXPECT_FALSE(zcConf->hasTxByHash(grandChildHash));
+   EXPECT_TRUE(zcConf->hasTxByHash(replacementHash));
+}
 
-   auto&& RBFhash       = BtcUtils::getHash256(rawRBF);
-   auto&& spendRBFhash  = BtcUtils::getHash256(spendRBF);
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockUtilsBare, Load4Blocks_ZCConflict_Mined)
+{
+   //5|1 spends this outpoint once block 5 is mined
+   auto&& ZC1 = getTx(5, 1);
+   Tx zcTx1(ZC1);
+   OutPoint op0 = zcTx1.getTxInCopy(0).getOutPoint();
 
-   ZcVector rawRBFVec;
-   ZcVector spendRBFVec;
+   //ZC double spending 5|1 to A, and its child spending to C
+   auto&& rawConflict = makeP2PKHTx(
+      op0.getTxHash(), op0.getTxOutIndex(), TestChain::addrA, 30 * COIN);
+   auto&& conflictHash = BtcUtils::getHash256(rawConflict);
+   auto&& rawChild = makeP2PKHTx(
+      conflictHash, 0, TestChain::addrC, 30 * COIN);
+   auto&& childHash = BtcUtils::getHash256(rawChild);
 
-   rawRBFVec.push_back(move(rawRBF), 1400000000);
-   spendRBFVec.push_back(move(spendRBF), 1500000000);
+   ZcVector zcVec;
+   zcVec.push_back(move(rawConflict), 1400000000);
+   zcVec.push_back(move(rawChild), 1500000000);
 
    //copy the first 4 blocks
    setBlocks({ "0", "1", "2", "3" }, blk0dat_);
@@ -10964,31 +13200,14 @@ TEST_F(BlockUtilsBare, Load3Blocks_RBF)
    scrAddrVec.push_back(TestChain::scrAddrA);
    scrAddrVec.push_back(TestChain::scrAddrB);
    scrAddrVec.push_back(TestChain::scrAddrC);
-
-   const vector<BinaryData> lb1ScrAddrs
-   {
-      TestChain::lb1ScrAddr,
-      TestChain::lb1ScrAddrP2SH
-   };
-   const vector<BinaryData> lb2ScrAddrs
-   {
-      TestChain::lb2ScrAddr,
-      TestChain::lb2ScrAddrP2SH
-   };
-
    regWallet(clients_, bdvID, scrAddrVec, "wallet1");
-   regLockbox(clients_, bdvID, lb1ScrAddrs, TestChain::lb1B58ID);
-   regLockbox(clients_, bdvID, lb2ScrAddrs, TestChain::lb2B58ID);
 
    auto bdvPtr = getBDV(clients_, bdvID);
 
-
    //wait on signals
    goOnline(clients_, bdvID);
    waitOnBDMReady(clients_, bdvID);
    auto wlt = bdvPtr->getWalletOrLockbox(wallet1id);
-   auto wltLB1 = bdvPtr->getWalletOrLockbox(LB1ID);
-   auto wltLB2 = bdvPtr->getWalletOrLockbox(LB2ID);
 
    const ScrAddrObj* scrObj;
    scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrA);
@@ -10998,15 +13217,8 @@ TEST_F(BlockUtilsBare, Load3Blocks_RBF)
    scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrC);
    EXPECT_EQ(scrObj->getFullBalance(), 55 * COIN);
 
-   uint64_t fullBalance = wlt->getFullBalance();
-   uint64_t spendableBalance = wlt->getSpendableBalance(3);
-   uint64_t unconfirmedBalance = wlt->getUnconfirmedBalance(3);
-   EXPECT_EQ(fullBalance, 135 * COIN);
-   EXPECT_EQ(spendableBalance, 35 * COIN);
-   EXPECT_EQ(unconfirmedBalance, 135 * COIN);
-
-   //add RBF ZC
-   pushNewZc(theBDMt_, rawRBFVec);
+   //push the ZCs
+   pushNewZc(theBDMt_, zcVec);
    waitOnNewZcSignal(clients_, bdvID);
 
    scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrA);
@@ -11014,58 +13226,19 @@ TEST_F(BlockUtilsBare, Load3Blocks_RBF)
    scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrB);
    EXPECT_EQ(scrObj->getFullBalance(), 0 * COIN);
    scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrC);
-   EXPECT_EQ(scrObj->getFullBalance(), 55 * COIN);
-
-   fullBalance = wlt->getFullBalance();
-   spendableBalance = wlt->getSpendableBalance(3);
-   unconfirmedBalance = wlt->getUnconfirmedBalance(3);
-   EXPECT_EQ(fullBalance, 105 * COIN);
-   EXPECT_EQ(spendableBalance, 5 * COIN);
-   EXPECT_EQ(unconfirmedBalance, 105 * COIN);
-
-   //check ledger
-   auto le = wlt->getLedgerEntryForTx(RBFhash);
-   EXPECT_EQ(le.getTxTime(), 1400000000);
-   EXPECT_EQ(le.getValue(), -30 * COIN);
-   EXPECT_EQ(le.getBlockNum(), UINT32_MAX);
-   EXPECT_TRUE(le.isOptInRBF());
-
-   //replace it
-   pushNewZc(theBDMt_, spendRBFVec);
-   waitOnNewZcSignal(clients_, bdvID);
-
-   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrA);
-   EXPECT_EQ(scrObj->getFullBalance(), 80 * COIN);
-   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrB);
-   EXPECT_EQ(scrObj->getFullBalance(), 0 * COIN);
-   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrC);
-   EXPECT_EQ(scrObj->getFullBalance(), 55 * COIN);
-
-   fullBalance = wlt->getFullBalance();
-   spendableBalance = wlt->getSpendableBalance(3);
-   unconfirmedBalance = wlt->getUnconfirmedBalance(3);
-   EXPECT_EQ(fullBalance, 135 * COIN);
-   EXPECT_EQ(spendableBalance, 5 * COIN);
-   EXPECT_EQ(unconfirmedBalance, 135 * COIN);
-
-   //verify replacement in ledgers
-   le = wlt->getLedgerEntryForTx(RBFhash);
-   EXPECT_EQ(le.getTxHash(), BtcUtils::EmptyHash_);
+   EXPECT_EQ(scrObj->getFullBalance(), 85 * COIN);
 
-   le = wlt->getLedgerEntryForTx(spendRBFhash);
+   auto le = wlt->getLedgerEntryForTx(childHash);
    EXPECT_EQ(le.getTxTime(), 1500000000);
-   EXPECT_EQ(le.getValue(), 30 * COIN);
    EXPECT_EQ(le.getBlockNum(), UINT32_MAX);
-   EXPECT_TRUE(le.isOptInRBF());
+   EXPECT_TRUE(le.isChainedZC());
 
-   //add last blocks
+   //mine 5|1, both ZCs are invalid now
    setBlocks({ "0", "1", "2", "3", "4", "5" }, blk0dat_);
    triggerNewBlockNotification(theBDMt_);
    waitOnNewBlockSignal(clients_, bdvID);
 
    EXPECT_EQ(iface_->getTopBlockHeight(HEADERS), 5);
-   EXPECT_EQ(iface_->getTopBlockHash(HEADERS), TestChain::blkHash5);
-   EXPECT_TRUE(theBDMt_->bdm()->blockchain()->getHeaderByHash(TestChain::blkHash5)->isMainBranch());
 
    scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrA);
    EXPECT_EQ(scrObj->getFullBalance(), 50 * COIN);
@@ -11074,16 +13247,102 @@ TEST_F(BlockUtilsBare, Load3Blocks_RBF)
    scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrC);
    EXPECT_EQ(scrObj->getFullBalance(), 20 * COIN);
 
-   fullBalance = wlt->getFullBalance();
-   spendableBalance = wlt->getSpendableBalance(5);
-   unconfirmedBalance = wlt->getUnconfirmedBalance(5);
+   uint64_t fullBalance = wlt->getFullBalance();
+   uint64_t unconfirmedBalance = wlt->getUnconfirmedBalance(5);
    EXPECT_EQ(fullBalance, 140 * COIN);
-   EXPECT_EQ(spendableBalance, 40 * COIN);
    EXPECT_EQ(unconfirmedBalance, 140 * COIN);
-   
-   //verify replacement ZC is invalid now
-   le = wlt->getLedgerEntryForTx(spendRBFhash);
+
+   le = wlt->getLedgerEntryForTx(conflictHash);
+   EXPECT_EQ(le.getTxHash(), BtcUtils::EmptyHash_);
+   le = wlt->getLedgerEntryForTx(childHash);
    EXPECT_EQ(le.getTxHash(), BtcUtils::EmptyHash_);
+
+   //and gone from the zc container
+   auto zcMap = theBDMt_->bdm()->zeroConfCont()->getFullTxioMap();
+   EXPECT_EQ(zcMap->size(), 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockUtilsBare, Load4Blocks_ZC_ParallelBatch)
+{
+   //a large batch of ZCs funding A, every 10th one spends the previous ZC
+   //so that the batch carries dependent chains
+   unsigned zcCount = 2000;
+   ZcVector zcVec;
+   vector<BinaryData> zcHashes;
+   for (unsigned i = 0; i < zcCount; i++)
+   {
+      BinaryData rawTx;
+      if (i % 10 == 9)
+      {
+         rawTx = makeP2PKHTx(zcHashes.back(), 0, TestChain::addrA, COIN);
+      }
+      else
+      {
+         //unknown outpoint
+         BinaryData bogusHash(32);
+         memset(bogusHash.getPtr(), 0xAB, 32);
+         memcpy(bogusHash.getPtr(), &i, 4);
+         rawTx = makeP2PKHTx(bogusHash, 0, TestChain::addrA, COIN);
+      }
+
+      zcHashes.push_back(BtcUtils::getHash256(rawTx));
+      zcVec.push_back(move(rawTx), 1400000000 + i);
+   }
+
+   setBlocks({ "0", "1", "2", "3" }, blk0dat_);
+
+   theBDMt_->start(config.initMode_);
+   auto&& bdvID = registerBDV(clients_, magic_);
+
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   scrAddrVec.push_back(TestChain::scrAddrC);
+   regWallet(clients_, bdvID, scrAddrVec, "wallet1");
+
+   auto bdvPtr = getBDV(clients_, bdvID);
+
+   //wait on signals
+   goOnline(clients_, bdvID);
+   waitOnBDMReady(clients_, bdvID);
+   auto wlt = bdvPtr->getWalletOrLockbox(wallet1id);
+
+   const ScrAddrObj* scrObj;
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrA);
+   EXPECT_EQ(scrObj->getFullBalance(), 50 * COIN);
+
+   auto start = chrono::steady_clock::now();
+   pushNewZc(theBDMt_, zcVec);
+   waitOnNewZcSignal(clients_, bdvID);
+   auto elapsed = chrono::duration<double>(
+      chrono::steady_clock::now() - start).count();
+
+   cout << zcCount << " zc parsed in " << elapsed << "s, " <<
+      unsigned(zcCount / elapsed) << " zc/s" << endl;
+
+   //every chained ZC consumes its parent's output
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrA);
+   EXPECT_EQ(scrObj->getFullBalance(), 
+      50 * COIN + (zcCount - zcCount / 10) * COIN);
+
+   auto le = wlt->getLedgerEntryForTx(zcHashes[0]);
+   EXPECT_EQ(le.getTxTime(), 1400000000);
+   EXPECT_EQ(le.getValue(), COIN);
+   EXPECT_FALSE(le.isChainedZC());
+
+   le = wlt->getLedgerEntryForTx(zcHashes[9]);
+   EXPECT_EQ(le.getTxTime(), 1400000009);
+   EXPECT_TRUE(le.isChainedZC());
+
+   le = wlt->getLedgerEntryForTx(zcHashes[zcCount - 1]);
+   EXPECT_EQ(le.getTxTime(), 1400000000 + zcCount - 1);
+   EXPECT_TRUE(le.isChainedZC());
+
+   auto zcMap = theBDMt_->bdm()->zeroConfCont()->getFullTxioMap();
+   auto saIter = zcMap->find(TestChain::scrAddrA);
+   ASSERT_TRUE(saIter != zcMap->end());
+   EXPECT_EQ(saIter->second->size(), zcCount);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -12000,6 +14259,270 @@ TEST_F(BlockUtilsBare, Load4Blocks_ZC_GetUtxos)
    EXPECT_EQ(spendableBalance, totalUtxoVal);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockUtilsBare, Load4Blocks_BinaryWire)
+{
+   setBlocks({ "0", "1", "2", "3" }, blk0dat_);
+   theBDMt_->start(config.initMode_);
+
+   //offer the binary wire at registration, the reply is still hex
+   Command regCmd;
+   regCmd.method_ = "registerBDV";
+   regCmd.args_.push_back(move(BinaryDataObject(magic_)));
+   regCmd.args_.push_back(move(IntType(WIRE_BINARY_VERSION)));
+   regCmd.serialize();
+
+   auto&& regResult = clients_->runCommand(regCmd.command_);
+   Arguments regArgs(regResult.serialize());
+   auto&& bdvID = regArgs.get<BinaryDataObject>().toStr();
+   ASSERT_TRUE(regArgs.hasArgs());
+   EXPECT_EQ(regArgs.get<IntType>().getVal(), WIRE_BINARY_VERSION);
+
+   //legacy registration doesn't get the offer answered
+   Command legacyCmd;
+   legacyCmd.method_ = "registerBDV";
+   legacyCmd.args_.push_back(move(BinaryDataObject(magic_)));
+   legacyCmd.serialize();
+   auto&& legacyResult = clients_->runCommand(legacyCmd.command_);
+   EXPECT_EQ(legacyResult.getArgVector().size(), 1);
+
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   scrAddrVec.push_back(TestChain::scrAddrC);
+
+   regWallet(clients_, bdvID, scrAddrVec, "wallet1");
+   goOnline(clients_, bdvID);
+   waitOnBDMReady(clients_, bdvID);
+   auto&& delegateID = getLedgerDelegate(clients_, bdvID);
+
+   //fetch the same page through both encodings
+   auto getPage = [&](WireEncoding encoding)->vector<LedgerEntryData>
+   {
+      Command cmd;
+      cmd.method_ = "getHistoryPage";
+      cmd.ids_.push_back(bdvID);
+      cmd.ids_.push_back(delegateID);
+      cmd.args_.push_back(move(IntType(0)));
+      cmd.serialize(encoding);
+      EXPECT_EQ(BinaryWireFrame::getEncoding(cmd.command_), encoding);
+
+      auto&& result = clients_->runCommand(cmd.command_);
+      auto& reply = result.serialize(encoding);
+      EXPECT_EQ(BinaryWireFrame::getEncoding(reply), encoding);
+
+      Arguments args(reply);
+      return args.get<LedgerEntryVector>().toVector();
+   };
+
+   auto&& hexPage = getPage(WireHex);
+   auto&& binPage = getPage(WireBinary);
+
+   ASSERT_EQ(hexPage.size(), binPage.size());
+   EXPECT_GT(binPage.size(), 0);
+   for (unsigned i = 0; i < hexPage.size(); i++)
+   {
+      EXPECT_EQ(hexPage[i].getValue(), binPage[i].getValue());
+      EXPECT_EQ(hexPage[i].getBlockNum(), binPage[i].getBlockNum());
+      EXPECT_EQ(hexPage[i].getTxHash(), binPage[i].getTxHash());
+      EXPECT_EQ(hexPage[i].getIndex(), binPage[i].getIndex());
+   }
+
+   //binary commands are checked against their length prefix
+   Command cmd;
+   cmd.method_ = "getHistoryPage";
+   cmd.ids_.push_back(bdvID);
+   cmd.ids_.push_back(delegateID);
+   cmd.args_.push_back(move(IntType(0)));
+   cmd.serialize(WireBinary);
+
+   Command truncated(cmd.command_.substr(0, cmd.command_.size() - 1));
+   EXPECT_THROW(truncated.deserialize(), runtime_error);
+
+   Command roundTrip(cmd.command_);
+   roundTrip.deserialize();
+   EXPECT_EQ(roundTrip.encoding_, WireBinary);
+   EXPECT_EQ(roundTrip.method_, "getHistoryPage");
+   ASSERT_EQ(roundTrip.ids_.size(), 2);
+   EXPECT_EQ(roundTrip.ids_[1], delegateID);
+   EXPECT_EQ(roundTrip.args_.get<IntType>().getVal(), 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockUtilsBare, WorkerPool_Bounded)
+{
+   const unsigned threadCount = 3;
+   const unsigned jobCount = 30;
+
+   WorkerPool requestPool("request pool", threadCount);
+   WorkerPool longPollPool("long poll pool", 2);
+
+   atomic<unsigned> running, maxRunning, handedOver;
+   running.store(0);
+   maxRunning.store(0);
+   handedOver.store(0);
+
+   //long polls block until released, they shouldn't hold up requests
+   promise<bool> releaseProm;
+   shared_future<bool> releaseFut = releaseProm.get_future();
+
+   for (unsigned i = 0; i < jobCount; i++)
+   {
+      auto job = [&, i](void)->void
+      {
+         auto count = running.fetch_add(1) + 1;
+         auto maxCount = maxRunning.load();
+         while (count > maxCount &&
+            !maxRunning.compare_exchange_weak(maxCount, count))
+         {}
+
+         this_thread::sleep_for(chrono::milliseconds(5));
+         running.fetch_sub(1);
+
+         if (i % 10 == 0)
+         {
+            auto longPoll = [&](void)->void
+            {
+               releaseFut.wait();
+               handedOver.fetch_add(1);
+            };
+
+            longPollPool.push(longPoll);
+         }
+      };
+
+      requestPool.push(job);
+   }
+
+   //the request pool drains while the long polls are still parked
+   requestPool.shutdown();
+   EXPECT_EQ(handedOver.load(), 0);
+
+   releaseProm.set_value(true);
+   longPollPool.shutdown();
+   EXPECT_EQ(handedOver.load(), jobCount / 10);
+
+   auto&& stats = requestPool.getStats();
+   EXPECT_EQ(stats.completed_, jobCount);
+   EXPECT_EQ(stats.queueDepth_, 0);
+   EXPECT_GT(stats.maxQueueDepth_, threadCount);
+   EXPECT_GT(stats.maxWaitMs_, 0.0);
+   EXPECT_LE(maxRunning.load(), threadCount);
+   EXPECT_EQ(requestPool.threadCount(), threadCount);
+
+   EXPECT_EQ(longPollPool.getStats().completed_, jobCount / 10);
+}
+
+#ifdef __linux__
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockUtilsBare, NotificationHub_Load)
+{
+   const unsigned clientCount = 5000;
+   NotificationHub hub(chrono::seconds(30));
+
+   auto notReadyLbd = [](void)->unsigned { return UINT32_MAX; };
+
+   vector<shared_ptr<SocketCallback>> callbacks;
+   vector<string> replies(clientCount);
+   atomic<unsigned> replyCount;
+   replyCount.store(0);
+
+   //first entry of a reply
+   auto getReplyStr = [](Arguments& arg)->string
+   {
+      auto& argVector = arg.getArgVector();
+      if (argVector.size() == 0)
+         return string();
+
+      auto bdoPtr = (DataObject<BinaryDataObject>*)argVector[0].get();
+      return bdoPtr->getObj().toStr();
+   };
+
+   auto getReplyLbd = [&](unsigned id)->NotificationHub::ReplyLambda
+   {
+      return [&replies, &replyCount, getReplyStr, id](Arguments& arg)->void
+      {
+         replies[id] = getReplyStr(arg);
+         replyCount.fetch_add(1);
+      };
+   };
+
+   //park all clients, none of them has anything to return yet
+   for (unsigned i = 0; i < clientCount; i++)
+   {
+      auto cbPtr = make_shared<SocketCallback>(notReadyLbd);
+      callbacks.push_back(cbPtr);
+      hub.park(cbPtr, "getStatus", getReplyLbd(i));
+   }
+
+   this_thread::sleep_for(chrono::milliseconds(200));
+   EXPECT_EQ(replyCount.load(), 0);
+   EXPECT_EQ(hub.parkedCount(), clientCount);
+
+   //parked callbacks do not expire
+   for (unsigned i = 0; i < CALLBACK_EXPIRE_COUNT + 1; i++)
+      EXPECT_TRUE(callbacks[0]->isValid());
+
+   //notify all clients
+   auto start = chrono::steady_clock::now();
+   for (unsigned i = 0; i < clientCount; i++)
+   {
+      Arguments args;
+      BinaryDataObject bdo("NewBlock");
+      args.push_back(move(bdo));
+      args.push_back(move(IntType(i)));
+      callbacks[i]->callback(move(args), OrderNewBlock);
+   }
+
+   while (replyCount.load() < clientCount &&
+      chrono::steady_clock::now() - start < chrono::seconds(30))
+      this_thread::sleep_for(chrono::milliseconds(1));
+
+   auto elapsed = chrono::duration_cast<chrono::milliseconds>(
+      chrono::steady_clock::now() - start);
+   cout << clientCount << " parked callbacks notified in " << 
+      elapsed.count() << "ms" << endl;
+
+   ASSERT_EQ(replyCount.load(), clientCount);
+   EXPECT_EQ(hub.parkedCount(), 0);
+
+   unsigned newBlockCount = 0;
+   for (auto& reply : replies)
+   {
+      if (reply == "NewBlock")
+         ++newBlockCount;
+   }
+   EXPECT_EQ(newBlockCount, clientCount);
+
+   //a client that waits too long gets a continue packet
+   {
+      NotificationHub shortHub(chrono::milliseconds(100));
+      auto replyProm = make_shared<promise<string>>();
+      auto replyFut = replyProm->get_future();
+
+      auto replyLbd = [replyProm, getReplyStr](Arguments& arg)->void
+      {
+         replyProm->set_value(getReplyStr(arg));
+      };
+
+      shortHub.park(callbacks[0], "getStatus", replyLbd);
+      ASSERT_EQ(replyFut.wait_for(chrono::seconds(5)), future_status::ready);
+      EXPECT_EQ(replyFut.get(), "continue");
+      EXPECT_EQ(shortHub.parkedCount(), 0);
+   }
+
+   //shutdown releases the clients still parked
+   replyCount.store(0);
+   for (unsigned i = 0; i < 10; i++)
+      hub.park(callbacks[i], "getStatus", getReplyLbd(i));
+
+   hub.shutdown();
+   EXPECT_EQ(replyCount.load(), 10);
+   EXPECT_EQ(replies[0], "continue");
+   EXPECT_EQ(hub.parkedCount(), 0);
+}
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////
 TEST_F(BlockUtilsBare, FCGIStack)
 {
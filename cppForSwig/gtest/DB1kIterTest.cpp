@@ -522,6 +522,160 @@ TEST_F(DB1kIter, DbInit1kIter)
    initBDM();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(DB1kIter, DbRead_MultiThreaded)
+{
+   theBDMt_->start(config.initMode_);
+   auto&& bdvID = registerBDV(clients_, magic_);
+
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   scrAddrVec.push_back(TestChain::scrAddrC);
+
+   regWallet(clients_, bdvID, scrAddrVec, "wallet1");
+
+   goOnline(clients_, bdvID);
+   waitOnBDMReady(clients_, bdvID);
+
+   //grab the hashes of all tx in the test chain
+   vector<BinaryData> txHashes;
+   for (unsigned height = 0; height <= 5; height++)
+   {
+      for (unsigned id = 0;; id++)
+      {
+         try
+         {
+            Tx tx(getTx(height, id));
+
+            //bare DBs only carry the tx relevant to registered addresses
+            StoredTx stx;
+            if (iface_->getStoredTx_byHash(tx.getThisHash(), &stx))
+               txHashes.push_back(tx.getThisHash());
+         }
+         catch (range_error&)
+         {
+            break;
+         }
+      }
+   }
+
+   ASSERT_GT(txHashes.size(), 3);
+
+   //every lookup opens and closes its own read transactions
+   const unsigned lookupCount = 200000;
+   auto maxThreads = max(thread::hardware_concurrency(), 4U);
+   
+   for (unsigned threadCount = 1; threadCount <= maxThreads; threadCount *= 2)
+   {
+      atomic<unsigned> failed;
+      failed.store(0);
+
+      auto readLbd = [&](unsigned offset)->void
+      {
+         StoredTx stx;
+         for (unsigned i = offset; i < lookupCount; i += threadCount)
+         {
+            auto& txHash = txHashes[i % txHashes.size()];
+            if (!iface_->getStoredTx_byHash(txHash, &stx))
+               failed.fetch_add(1);
+         }
+      };
+
+      auto start = chrono::steady_clock::now();
+      vector<thread> threads;
+      for (unsigned i = 0; i < threadCount; i++)
+         threads.push_back(thread(readLbd, i));
+
+      for (auto& thr : threads)
+         thr.join();
+
+      auto elapsed = chrono::duration_cast<chrono::milliseconds>(
+         chrono::steady_clock::now() - start).count();
+      cout << threadCount << " threads: " << lookupCount << 
+         " tx lookups in " << elapsed << "ms (" << 
+         lookupCount * 1000ULL / max(elapsed, (decltype(elapsed))1) << 
+         " lookups/s)" << endl;
+
+      EXPECT_EQ(failed.load(), 0);
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(DB1kIter, DbKeyForHash_Latency)
+{
+   theBDMt_->start(config.initMode_);
+   auto&& bdvID = registerBDV(clients_, magic_);
+
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   scrAddrVec.push_back(TestChain::scrAddrC);
+
+   regWallet(clients_, bdvID, scrAddrVec, "wallet1");
+
+   goOnline(clients_, bdvID);
+   waitOnBDMReady(clients_, bdvID);
+
+   //hashes of the relevant tx, the bare DB doesn't hint the others
+   vector<BinaryData> txHashes, dbKeys;
+   for (unsigned height = 0; height <= 5; height++)
+   {
+      for (unsigned id = 0;; id++)
+      {
+         try
+         {
+            Tx tx(getTx(height, id));
+            auto&& dbKey = iface_->getDBKeyForHash(tx.getThisHash());
+            if (dbKey.getSize() != 6)
+               continue;
+
+            txHashes.push_back(tx.getThisHash());
+            dbKeys.push_back(dbKey);
+         }
+         catch (range_error&)
+         {
+            break;
+         }
+      }
+   }
+
+   ASSERT_GT(txHashes.size(), 3);
+   ASSERT_TRUE(iface_->hasTxHashIndex());
+
+   const unsigned lookupCount = 200000;
+   auto timeLookups = [&](const string& name)->void
+   {
+      unsigned failed = 0;
+      auto start = chrono::steady_clock::now();
+      for (unsigned i = 0; i < lookupCount; i++)
+      {
+         auto id = i % txHashes.size();
+         if (iface_->getDBKeyForHash(txHashes[id]) != dbKeys[id])
+            failed++;
+      }
+
+      auto elapsed = chrono::duration_cast<chrono::nanoseconds>(
+         chrono::steady_clock::now() - start).count();
+      cout << name << ": " << lookupCount << " lookups, " << 
+         elapsed / lookupCount << "ns per lookup" << endl;
+
+      EXPECT_EQ(failed, 0);
+   };
+
+   timeLookups("txhash index");
+
+   //unknown hashes miss the index and the hints alike
+   BinaryData unknownHash = READHEX(
+      "00112233445566778899aabbccddeeff00112233445566778899aabbccddeeff");
+   EXPECT_EQ(iface_->getDBKeyForHash(unknownHash).getSize(), 0);
+
+   iface_->setTxHashIndex(false);
+   timeLookups("4 byte hints");
+   EXPECT_EQ(iface_->getDBKeyForHash(unknownHash).getSize(), 0);
+   iface_->setTxHashIndex(true);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 TEST_F(DB1kIter, DbInit1kIter_WithSignals)
 {
@@ -25,6 +25,41 @@ static std::string errorString(int rc)
    return mdb_strerror(rc);
 }
 
+static std::atomic<uint64_t> envIdCounter(0);
+
+// abort the slot's cached read txn, once
+static void releaseThreadTx(LMDBThreadTxInfo& thTx)
+{
+   std::unique_lock<std::mutex> lock(thTx.releaseMutex_);
+   if (thTx.released_)
+      return;
+
+   if (thTx.readTxn_ != nullptr)
+      mdb_txn_abort(thTx.readTxn_);
+   
+   thTx.readTxn_ = nullptr;
+   thTx.txn_ = nullptr;
+   thTx.released_ = true;
+}
+
+namespace
+{
+   // per thread transaction slots, by env
+   struct ThreadTxCache
+   {
+      std::unordered_map<const LMDBEnv*, 
+         std::shared_ptr<LMDBThreadTxInfo>> slots_;
+
+      ~ThreadTxCache()
+      {
+         for (auto& slot : slots_)
+            releaseThreadTx(*slot.second);
+      }
+   };
+
+   thread_local ThreadTxCache threadTxCache;
+}
+
 inline void LMDB::Iterator::checkHasDb() const
 {
    if (!db_)
@@ -63,20 +98,11 @@ inline void LMDB::Iterator::checkOk() const
 
 void LMDB::Iterator::openCursor()
 {
-   auto tID = std::this_thread::get_id();
-   LMDBEnv *const _env = db_->env;
-   std::unique_lock<std::mutex> lock(_env->threadTxMutex_);
-   
-   auto txnIter = _env->txForThreads_.find(tID);
-   if (txnIter == _env->txForThreads_.end())
+   auto thTx = db_->env->getThreadTx();
+   if (thTx == nullptr || thTx->transactionLevel_ == 0)
       throw std::runtime_error("Iterator must be created within Transaction");
    
-   lock.unlock();
-   
-   if (txnIter->second.transactionLevel_ == 0)
-      throw std::runtime_error("Iterator must be created within Transaction");
-   
-   txnPtr_ = &txnIter->second;
+   txnPtr_ = thTx;
   
    int rc = mdb_cursor_open(txnPtr_->txn_, db_->dbi, &csr_);
    if (rc != MDB_SUCCESS)
@@ -261,6 +287,27 @@ void LMDB::Iterator::toFirst()
    }
 }
 
+void LMDB::Iterator::toLast()
+{
+   checkHasDb();
+   
+   MDB_val mkey;
+   MDB_val mval;
+   
+   int rc = mdb_cursor_get(csr_, &mkey, &mval, MDB_LAST);
+
+   if (rc == MDB_NOTFOUND)
+      has_ = false;
+   else if (rc != MDB_SUCCESS)
+      throw LMDBException("Failed to seek (" + errorString(rc) +")");
+   else
+   {
+      has_ = true;
+      key_ = mkey;
+      val_ = mval;
+   }
+}
+
 void LMDB::Iterator::seek(const CharacterArrayRef &key, SeekBy e)
 {
    checkHasDb();
@@ -328,12 +375,48 @@ LMDBEnv::~LMDBEnv()
    close();
 }
 
+LMDBThreadTxInfo* LMDBEnv::getThreadTx()
+{
+   auto iter = threadTxCache.slots_.find(this);
+   if (iter == threadTxCache.slots_.end() || iter->second->envId_ != envId_)
+      return nullptr;
+
+   return iter->second.get();
+}
+
+LMDBThreadTxInfo& LMDBEnv::getOrCreateThreadTx()
+{
+   auto& slot = threadTxCache.slots_[this];
+   if (slot != nullptr && slot->envId_ == envId_)
+      return *slot;
+
+   // first transaction of this thread since the env was opened
+   slot = std::make_shared<LMDBThreadTxInfo>();
+   slot->envId_ = envId_;
+
+   std::unique_lock<std::mutex> lock(threadTxMutex_);
+
+   // drop the slots of threads that have exited
+   auto isReleased = [](const std::shared_ptr<LMDBThreadTxInfo>& thTx)->bool
+   {
+      std::unique_lock<std::mutex> lock(thTx->releaseMutex_);
+      return thTx->released_;
+   };
+
+   threadTxSlots_.erase(
+      std::remove_if(threadTxSlots_.begin(), threadTxSlots_.end(), isReleased),
+      threadTxSlots_.end());
+   threadTxSlots_.push_back(slot);
+
+   return *slot;
+}
+
 void LMDBEnv::open(const char *filename)
 {
    if (dbenv)
       throw std::logic_error("Database environment already open (close it first)");
 
-   txForThreads_.clear();
+   envId_ = envIdCounter.fetch_add(1, std::memory_order_relaxed) + 1;
    
    int rc;
 
@@ -354,6 +437,14 @@ void LMDBEnv::close()
 {
    if (dbenv)
    {
+      // read txns have to go before the env
+      {
+         std::unique_lock<std::mutex> lock(threadTxMutex_);
+         for (auto& slot : threadTxSlots_)
+            releaseThreadTx(*slot);
+         threadTxSlots_.clear();
+      }
+
       mdb_env_close(dbenv);
       dbenv = nullptr;
    }
@@ -391,11 +482,7 @@ void LMDBEnv::Transaction::begin()
    
    began = true;
 
-   auto tID = std::this_thread::get_id();
-   
-   std::unique_lock<std::mutex> lock(env->threadTxMutex_);
-   LMDBThreadTxInfo& thTx = env->txForThreads_[tID];
-   lock.unlock();
+   LMDBThreadTxInfo& thTx = env->getOrCreateThreadTx();
    
    if (thTx.transactionLevel_ != 0 && mode_ == LMDB::ReadWrite && thTx.mode_ == LMDB::ReadOnly)
       throw LMDBException("Cannot access ReadOnly Transaction in ReadWrite mode");
@@ -404,27 +491,54 @@ void LMDBEnv::Transaction::begin()
       return;
       
    if (!env->dbenv)
+   {
+      thTx.transactionLevel_ = 0;
+      began = false;
       throw LMDBException("Cannot start transaction without db env");
+   }
       
-   int modef = MDB_RDONLY;
-   thTx.mode_ = LMDB::ReadOnly;
-   
+   int rc;
    if (mode_ == LMDB::ReadWrite)
    {
-      modef = 0;
       thTx.mode_ = LMDB::ReadWrite;
+      rc = mdb_txn_begin(env->dbenv, nullptr, 0, &thTx.txn_);
+   }
+   else
+   {
+      thTx.mode_ = LMDB::ReadOnly;
+
+      // recycle the reset read txn of this thread if there is one
+      rc = MDB_BAD_TXN;
+      if (thTx.readTxn_ != nullptr)
+      {
+         rc = mdb_txn_renew(thTx.readTxn_);
+         if (rc != MDB_SUCCESS)
+         {
+            mdb_txn_abort(thTx.readTxn_);
+            thTx.readTxn_ = nullptr;
+         }
+      }
+
+      if (thTx.readTxn_ == nullptr)
+      {
+         rc = mdb_txn_begin(env->dbenv, nullptr, MDB_RDONLY, &thTx.readTxn_);
+         if (rc != MDB_SUCCESS)
+            thTx.readTxn_ = nullptr;
+      }
+
+      thTx.txn_ = thTx.readTxn_;
    }
 
-   int rc = mdb_txn_begin(env->dbenv, nullptr, modef, &thTx.txn_);
    if (rc != MDB_SUCCESS)
    {
-      lock.lock();
-      env->txForThreads_.erase(tID);
-      lock.unlock();
+      thTx.transactionLevel_ = 0;
+      thTx.txn_ = nullptr;
       
       began = false;
       throw LMDBException("Failed to create transaction (" + errorString(rc) +")");
    }
+
+   env->activeTxCount_.fetch_add(1, std::memory_order_relaxed);
 }
 
 void LMDBEnv::Transaction::open(LMDBEnv *_env, LMDB::Mode mode)
@@ -446,33 +560,38 @@ void LMDBEnv::Transaction::commit()
    began=false;
 
    //look for an existing transaction in this thread
-   auto tID = std::this_thread::get_id();
-   std::unique_lock<std::mutex> lock(env->threadTxMutex_);
-   auto txnIter = env->txForThreads_.find(tID);
-
-   if (txnIter == env->txForThreads_.end())
+   auto thTxPtr = env->getThreadTx();
+   if (thTxPtr == nullptr || thTxPtr->transactionLevel_ == 0)
       throw LMDBException("Transaction bound to unknown thread");
-   lock.unlock();
 
-   LMDBThreadTxInfo& thTx = txnIter->second;
+   LMDBThreadTxInfo& thTx = *thTxPtr;
 
    if (thTx.transactionLevel_-- == 1)
    {
-      int rc = mdb_txn_commit(thTx.txn_);
-      
+      // read txns do not free their cursors, close them all before the
+      // txn ends
       for (LMDB::Iterator *i : thTx.iterators_)
       {
+         if (i->csr_ != nullptr)
+            mdb_cursor_close(i->csr_);
+
          i->hasTx=false;
          i->csr_=nullptr;
       }
       
+      int rc = MDB_SUCCESS;
+      if (thTx.mode_ == LMDB::ReadOnly)
+         mdb_txn_reset(thTx.txn_);
+      else
+         rc = mdb_txn_commit(thTx.txn_);
+
+      thTx.txn_ = nullptr;
+      env->activeTxCount_.fetch_sub(1, std::memory_order_relaxed);
+      
       if (rc != MDB_SUCCESS)
       {
          throw LMDBException("Failed to close env tx (" + errorString(rc) +")");
       }
-      
-      lock.lock();
-      env->txForThreads_.erase(txnIter);
    }
 }
 
@@ -499,11 +618,8 @@ void LMDB::close()
 {
    if (dbi != 0)
    {
-      {
-         std::unique_lock<std::mutex> lock(env->threadTxMutex_);
-         if (!env->txForThreads_.empty())
-            throw std::runtime_error("Tried to close database with open txes");
-      }
+      if (env->activeTxCount_.load(std::memory_order_relaxed) != 0)
+         throw std::runtime_error("Tried to close database with open txes");
       mdb_dbi_close(env->dbenv, dbi);
       dbi=0;
       
@@ -520,15 +636,11 @@ void LMDB::open(LMDBEnv *_env, const std::string &name)
    this->env = _env;
    
    LMDBEnv::Transaction tx(_env);
-   auto tID = std::this_thread::get_id();
-   std::unique_lock<std::mutex> lock(_env->threadTxMutex_);
-   auto txnIter = _env->txForThreads_.find(tID);
-
-   if (txnIter == _env->txForThreads_.end())
+   auto thTx = _env->getThreadTx();
+   if (thTx == nullptr || thTx->transactionLevel_ == 0)
       throw LMDBException("Failed to insert: need transaction");
-   lock.unlock();
       
-   int rc = mdb_open(txnIter->second.txn_, name.c_str(), MDB_CREATE, &dbi);
+   int rc = mdb_open(thTx->txn_, name.c_str(), MDB_CREATE, &dbi);
    if (rc != MDB_SUCCESS)
    {
       // cleanup here
@@ -544,17 +656,11 @@ void LMDB::insert(
    MDB_val mkey = { key.len, const_cast<char*>(key.data) };
    MDB_val mval = { value.len, const_cast<char*>(value.data) };
    
-   auto tID = std::this_thread::get_id();
-
-   std::unique_lock<std::mutex> lock(env->threadTxMutex_);
-   
-   auto txnIter = env->txForThreads_.find(tID);
-
-   if (txnIter == env->txForThreads_.end())
+   auto thTx = env->getThreadTx();
+   if (thTx == nullptr || thTx->transactionLevel_ == 0)
       throw LMDBException("Failed to insert: need transaction");
-   lock.unlock();
    
-   int rc = mdb_put(txnIter->second.txn_, dbi, &mkey, &mval, 0);
+   int rc = mdb_put(thTx->txn_, dbi, &mkey, &mval, 0);
    if (rc != MDB_SUCCESS)
    {
       std::cout << "failed to insert data, returned following error string: " << errorString(rc) << std::endl;
@@ -562,18 +668,39 @@ void LMDB::insert(
    }
 }
 
-void LMDB::erase(const CharacterArrayRef& key)
+bool LMDB::append(
+   const CharacterArrayRef& key,
+   const CharacterArrayRef& value
+)
 {
-   auto tID = std::this_thread::get_id();
-   std::unique_lock<std::mutex> lock(env->threadTxMutex_);
-   auto txnIter = env->txForThreads_.find(tID);
+   MDB_val mkey = { key.len, const_cast<char*>(key.data) };
+   MDB_val mval = { value.len, const_cast<char*>(value.data) };
+   
+   auto thTx = env->getThreadTx();
+   if (thTx == nullptr || thTx->transactionLevel_ == 0)
+      throw LMDBException("Failed to append: need transaction");
+   
+   int rc = mdb_put(thTx->txn_, dbi, &mkey, &mval, MDB_APPEND);
+   if (rc == MDB_KEYEXIST)
+      return false;
+
+   if (rc != MDB_SUCCESS)
+   {
+      std::cout << "failed to append data, returned following error string: " << errorString(rc) << std::endl;
+      throw LMDBException("Failed to append (" + errorString(rc) + ")");
+   }
+
+   return true;
+}
 
-   if (txnIter == env->txForThreads_.end())
+void LMDB::erase(const CharacterArrayRef& key)
+{
+   auto thTx = env->getThreadTx();
+   if (thTx == nullptr || thTx->transactionLevel_ == 0)
       throw LMDBException("Failed to insert: need transaction");
-   lock.unlock();
       
    MDB_val mkey = { key.len, const_cast<char*>(key.data) };
-   int rc = mdb_del(txnIter->second.txn_, dbi, &mkey, 0);
+   int rc = mdb_del(thTx->txn_, dbi, &mkey, 0);
    if (rc != MDB_SUCCESS && rc != MDB_NOTFOUND)
    {
       std::cout << "failed to erase data, returned following error string: " << errorString(rc) << std::endl;
@@ -594,19 +721,14 @@ CharacterArrayRef LMDB::get_NoCopy(const CharacterArrayRef& key) const
 {
    //simple get without the use of iterators
 
-   auto tID = std::this_thread::get_id();
-   std::unique_lock<std::mutex> lock(env->threadTxMutex_);
-   
-   auto txnIter = env->txForThreads_.find(tID);
-   if (txnIter == env->txForThreads_.end())
+   auto thTx = env->getThreadTx();
+   if (thTx == nullptr || thTx->transactionLevel_ == 0)
       throw std::runtime_error("Need transaction to get data");
-   
-   lock.unlock();
 
    MDB_val mkey = { key.len, const_cast<char*>(key.data) };
    MDB_val mdata = { 0, 0 };
 
-   int rc = mdb_get(txnIter->second.txn_, dbi, &mkey, &mdata);
+   int rc = mdb_get(thTx->txn_, dbi, &mkey, &mdata);
    if (rc == MDB_NOTFOUND)
       return CharacterArrayRef(0, (char*)nullptr);
    
@@ -619,16 +741,11 @@ CharacterArrayRef LMDB::get_NoCopy(const CharacterArrayRef& key) const
 
 void LMDB::drop(void)
 {
-   auto tID = std::this_thread::get_id();
-   std::unique_lock<std::mutex> lock(env->threadTxMutex_);
-
-   auto txnIter = env->txForThreads_.find(tID);
-   if (txnIter == env->txForThreads_.end())
+   auto thTx = env->getThreadTx();
+   if (thTx == nullptr || thTx->transactionLevel_ == 0)
       throw std::runtime_error("Need transaction to get data");
 
-   lock.unlock();
-
-   if (mdb_drop(txnIter->second.txn_, dbi, 0) != MDB_SUCCESS)
+   if (mdb_drop(thTx->txn_, dbi, 0) != MDB_SUCCESS)
       throw std::runtime_error("Failed to drop DB!");
 }
 
@@ -9,11 +9,14 @@
 #define LMDBPP_H
 
 #include <string>
+#include <cstdint>
 #include <stdexcept>
 #include <vector>
 #include <unordered_map>
 #include <thread>
 #include <mutex>
+#include <memory>
+#include <atomic>
 #include "lmdb.h"
 
 struct MDB_env;
@@ -160,6 +163,9 @@ public:
       // seek this iterator to the first sequence
       void toFirst();
       
+      // seek this iterator to the last sequence
+      void toLast();
+      
       // returns the key currently pointed to, if no key is being pointed to
       // std::logic_error is returned (not LSMException). LSMException may
       // be thrown for other reasons. You can avoid logic_error by
@@ -192,6 +198,14 @@ public:
       const CharacterArrayRef& value
    );
    
+   // insert a value past the last key of the database (MDB_APPEND),
+   // without a tree search. Returns false and writes nothing if the key
+   // doesn't sort after the current last key
+   bool append(
+      const CharacterArrayRef& key,
+      const CharacterArrayRef& value
+   );
+   
    // delete the entry with the given key, doing nothing
    // if such a key does not exist
    void erase(const CharacterArrayRef& key);
@@ -244,6 +258,16 @@ struct LMDBThreadTxInfo
    std::vector<LMDB::Iterator*> iterators_;
    unsigned transactionLevel_=0;
    LMDB::Mode mode_;
+
+   // read txn handle, reset when the thread's read transaction ends and
+   // renewed by the next one
+   MDB_txn *readTxn_=nullptr;
+
+   // the env open this slot belongs to. The slot is released by whichever
+   // comes first of its thread exiting or the env closing
+   uint64_t envId_=0;
+   std::mutex releaseMutex_;
+   bool released_=false;
 };
 
 
@@ -256,11 +280,24 @@ private:
    MDB_env *dbenv=nullptr;
    unsigned dbCount_ = 1;
 
+   // unique per open(), tells thread slots from a previous open apart
+   uint64_t envId_ = 0;
+
+   // threads find their slot in a thread local map, the env only tracks
+   // them to release the cached read txns on close. Registering is the
+   // only time a thread takes this mutex
    std::mutex threadTxMutex_;
-   std::unordered_map<std::thread::id, LMDBThreadTxInfo> txForThreads_;
+   std::vector<std::shared_ptr<LMDBThreadTxInfo>> threadTxSlots_;
+
+   // count of threads with a transaction open
+   std::atomic<unsigned> activeTxCount_;
    
    friend class LMDB;
 
+   // this thread's slot, nullptr if it has none for the current open
+   LMDBThreadTxInfo* getThreadTx();
+   LMDBThreadTxInfo& getOrCreateThreadTx();
+
 public:
    class Transaction
    {
@@ -297,8 +334,12 @@ public:
       Transaction(const Transaction&); // no copies
    };
 
-   LMDBEnv() { }
-   LMDBEnv(unsigned dbCount) { dbCount_ = dbCount; }
+   LMDBEnv() { activeTxCount_.store(0, std::memory_order_relaxed); }
+   LMDBEnv(unsigned dbCount) 
+   { 
+      dbCount_ = dbCount;
+      activeTxCount_.store(0, std::memory_order_relaxed);
+   }
    ~LMDBEnv();
    
    // open a database by filename
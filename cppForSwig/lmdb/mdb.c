@@ -2875,6 +2875,20 @@ mdb_txn_reset(MDB_txn *txn)
 	if (!(txn->mt_flags & MDB_TXN_RDONLY))
 		return;
 
+   /* release the map reference the txn took, like commit does. A reset
+    * txn has mt_dbxs==NULL and holds no reference */
+   if (txn->mt_dbxs)
+   {
+      MDB_env *env = txn->mt_env;
+      MDB_mapinfo* mi = txn->mt_map.current_map;
+      mi->sema--;
+      if (mi->sema == 0 && mi != &env->me_maps[env->me_currentmap])
+      {
+         munmap(mi->me_map, mi->me_mapsize);
+         mi->me_map = 0;
+      }
+   }
+
 	mdb_txn_reset0(txn, "reset");
 }
 
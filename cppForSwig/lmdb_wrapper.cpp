@@ -17,6 +17,8 @@
 #include <list>
 #include <vector>
 #include <set>
+#include <algorithm>
+#include <chrono>
 #include "BinaryData.h"
 #include "BtcUtils.h"
 #include "BlockObj.h"
@@ -24,6 +26,7 @@
 #include "lmdb_wrapper.h"
 #include "txio.h"
 #include "BlockDataMap.h"
+#include "UtxoSnapshot.h"
 
 #include "Blockchain.h"
 
@@ -354,6 +357,11 @@ LMDBBlockDatabase::LMDBBlockDatabase(
    ARMORY_DB_TYPE dbtype) :
    blockchainPtr_(bcPtr), blkFolder_(blkFolder), armoryDbType_(dbtype)
 {
+   stxoWriteCount_.store(0, memory_order_relaxed);
+   utxoSnapshotOnDisk_.store(false, memory_order_relaxed);
+   utxoSnapshotLoads_.store(0, memory_order_relaxed);
+   lastUtxoSnapshot_ = chrono::steady_clock::now();
+
    //for some reason the WRITE_UINT16 macros create 4 byte long BinaryData 
    //instead of 2, so I'm doing this the hard way instead
    uint8_t* ptr = const_cast<uint8_t*>(ZCprefix_.getPtr());
@@ -435,6 +443,9 @@ void LMDBBlockDatabase::openDatabases(
       }
    }
 
+   utxoSnapshotOnDisk_.store(
+      DBUtils::fileExists(getUtxoSnapshotPath(), 0), memory_order_seq_cst);
+
    dbIsOpen_ = true;
 }
 
@@ -514,6 +525,8 @@ void LMDBBlockDatabase::swapDatabases(DB_SELECT db, const string& swap_path)
 ////////////////////////////////////////////////////////////////////////////////
 void LMDBBlockDatabase::resetHistoryDatabases(void)
 {
+   dropUtxoSnapshot();
+
    if (armoryDbType_ != ARMORY_DB_SUPER)
    {
       resetSSHdb();
@@ -545,6 +558,7 @@ void LMDBBlockDatabase::destroyAndResetDatabases(void)
    // We want to make sure the database is restarted with the same parameters
    // it was called with originally
    {
+      dropUtxoSnapshot();
       closeDatabases();
       for (unsigned db = HEADERS; db != COUNT; db++)
          remove(getDbPath(static_cast<DB_SELECT>(db)).c_str());
@@ -595,6 +609,45 @@ BinaryDataRef LMDBBlockDatabase::getValueNoCopy(DB_SELECT db,
       return BinaryDataRef();
 }
 
+/////////////////////////////////////////////////////////////////////////////
+vector<BinaryDataRef> LMDBBlockDatabase::multiGet(
+   DB_SELECT db, const vector<BinaryDataRef>& keys) const
+{
+   vector<BinaryDataRef> values(keys.size());
+   if (keys.size() == 0)
+      return values;
+
+   //sorted keys keep the cursor moving forward, mostly within the leaf page
+   //of the previous hit
+   vector<size_t> order(keys.size());
+   for (size_t i = 0; i < keys.size(); i++)
+      order[i] = i;
+
+   sort(order.begin(), order.end(), [&keys](size_t lhs, size_t rhs)->bool
+   {
+      return keys[lhs] < keys[rhs];
+   });
+
+   LDBIter dbIter = getIterator(db);
+   size_t prevIdx = SIZE_MAX;
+   for (auto idx : order)
+   {
+      auto& key = keys[idx];
+      if (prevIdx != SIZE_MAX && keys[prevIdx] == key)
+      {
+         values[idx] = values[prevIdx];
+         continue;
+      }
+
+      if (dbIter.seekToExact(key))
+         values[idx] = dbIter.getValueRef();
+
+      prevIdx = idx;
+   }
+
+   return values;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // Get value using BinaryDataRef object.  The data from the get* call is 
 // actually copied to a member variable, and thus the refs are valid only 
@@ -709,9 +762,15 @@ BinaryData LMDBBlockDatabase::getDBKeyForHash(const BinaryData& txhash,
       return BinaryData();
    }
 
-   BinaryData hash4(txhash.getSliceRef(0, 4));
-
    LMDBEnv::Transaction txHints(dbEnv_[TXHINTS].get(), LMDB::ReadOnly);
+   if (hasTxHashIndex() && txhash.getSize() == 32)
+   {
+      auto&& dbKey = getDBKeyFromTxHashIndex(txhash, expectedDupId);
+      if (dbKey.getSize() == 6)
+         return dbKey;
+   }
+
+   BinaryData hash4(txhash.getSliceRef(0, 4));
    BinaryRefReader brrHints = getValueRef(TXHINTS, DB_PREFIX_TXHINTS, hash4);
 
    uint32_t valSize = brrHints.getSize();
@@ -769,12 +828,77 @@ BinaryData LMDBBlockDatabase::getDBKeyForHash(const BinaryData& txhash,
    return BinaryData();
 }
 
+/////////////////////////////////////////////////////////////////////////////
+BinaryData LMDBBlockDatabase::getDBKeyFromTxHashIndex(
+   const BinaryData& txhash, uint8_t expectedDupId) const
+{
+   //caller holds the TXHINTS read txn
+   BinaryWriter bw(33);
+   bw.put_uint8_t((uint8_t)DB_PREFIX_TXHASH);
+   bw.put_BinaryData(txhash);
+
+   auto val = getValueNoCopy(TXHINTS, bw.getDataRef());
+   if (val.getSize() != 6)
+      return BinaryData();
+
+   //a tx mined in several branches keeps the last key written, let the 
+   //hints sort out the ones that aren't on the main branch
+   BinaryRefReader brr(val);
+   uint32_t height;
+   uint8_t dup;
+   uint16_t txIdx;
+   DBUtils::readBlkDataKeyNoPrefix(brr, height, dup, txIdx);
+
+   if (dup != expectedDupId && dup != getValidDupIDForHeight(height))
+      return BinaryData();
+
+   return BinaryData(val);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+void LMDBBlockDatabase::updateTxHashIndex(
+   BinaryDataRef key, BinaryDataRef value, bool erase)
+{
+   //only tx entries (prefix + 6 byte key -> count + hash) are indexed
+   if (!hasTxHashIndex() || key.getSize() != 7 || 
+      key.getPtr()[0] != (uint8_t)DB_PREFIX_TXDATA)
+      return;
+
+   if (erase)
+      value = getValueNoCopy(TXHINTS, key);
+
+   if (value.getSize() < 36)
+      return;
+
+   BinaryWriter bw(33);
+   bw.put_uint8_t((uint8_t)DB_PREFIX_TXHASH);
+   bw.put_BinaryDataRef(value.getSliceRef(4, 32));
+   CharacterArrayRef idxKey(bw.getSize(), bw.getDataRef().getPtr());
+
+   auto txKey = key.getSliceRef(1, 6);
+   if (erase)
+   {
+      //leave the entry alone if it points at another branch
+      if (getValueNoCopy(TXHINTS, bw.getDataRef()) == txKey)
+         dbs_[TXHINTS].erase(idxKey);
+      return;
+   }
+
+   dbs_[TXHINTS].insert(idxKey,
+      CharacterArrayRef(txKey.getSize(), txKey.getPtr()));
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // Put value based on BinaryData key.  If batch writing, pass in the batch
 void LMDBBlockDatabase::putValue(DB_SELECT db, 
                                   BinaryDataRef key, 
                                   BinaryDataRef value)
 {
+   if (db == STXO)
+      stxoWillChange();
+   else if (db == TXHINTS)
+      updateTxHashIndex(key, value, false);
+
    dbs_[db].insert(
       CharacterArrayRef(key.getSize(), key.getPtr()),
       CharacterArrayRef(value.getSize(), value.getPtr())
@@ -808,6 +932,11 @@ void LMDBBlockDatabase::deleteValue(DB_SELECT db,
                                  BinaryDataRef key)
                  
 {
+   if (db == STXO)
+      stxoWillChange();
+   else if (db == TXHINTS)
+      updateTxHashIndex(key, BinaryDataRef(), true);
+
    dbs_[db].erase( CharacterArrayRef(key.getSize(), key.getPtr() ) );
 }
 
@@ -824,6 +953,211 @@ void LMDBBlockDatabase::deleteValue(DB_SELECT db,
    deleteValue(db, bw.getDataRef());
 }
 
+/////////////////////////////////////////////////////////////////////////////
+void LMDBBlockDatabase::putValues(DB_SELECT db,
+   vector<pair<BinaryDataRef, BinaryDataRef>>& keyValPairs)
+{
+   if (keyValPairs.size() == 0)
+      return;
+
+   auto start = chrono::steady_clock::now();
+
+   auto keyLess = [](const pair<BinaryDataRef, BinaryDataRef>& lhs,
+      const pair<BinaryDataRef, BinaryDataRef>& rhs)->bool
+   {
+      return lhs.first < rhs.first;
+   };
+
+   if (!is_sorted(keyValPairs.begin(), keyValPairs.end(), keyLess))
+      sort(keyValPairs.begin(), keyValPairs.end(), keyLess);
+
+   //anything past the current last key can go at the end of the tree
+   BinaryData lastKey;
+   {
+      auto dbIter = dbs_[db].begin();
+      dbIter.toLast();
+      if (dbIter.isValid())
+      {
+         lastKey = BinaryData(
+            (uint8_t*)dbIter.key().mv_data, dbIter.key().mv_size);
+      }
+   }
+
+   BinaryDataRef lastKeyRef = lastKey.getRef();
+
+   //the tx hash index lives in TXHINTS and sorts after the tx entries, 
+   //nothing can be appended past it
+   bool canAppend = db != TXHINTS || !hasTxHashIndex();
+
+   BulkWriteStats stats;
+   for (auto& keyVal : keyValPairs)
+   {
+      //same hooks as putValue, once per entry whichever way it is written
+      if (db == STXO)
+         stxoWillChange();
+      else if (db == TXHINTS)
+         updateTxHashIndex(keyVal.first, keyVal.second, false);
+
+      CharacterArrayRef key(keyVal.first.getSize(), keyVal.first.getPtr());
+      CharacterArrayRef val(keyVal.second.getSize(), keyVal.second.getPtr());
+      stats.byteCount_ += key.len + val.len;
+
+      if (canAppend && lastKeyRef < keyVal.first)
+      {
+         if (dbs_[db].append(key, val))
+         {
+            lastKeyRef = keyVal.first;
+            ++stats.appendCount_;
+            continue;
+         }
+
+         canAppend = false;
+      }
+
+      dbs_[db].insert(key, val);
+      ++stats.putCount_;
+   }
+
+   stats.seconds_ = chrono::duration<double>(
+      chrono::steady_clock::now() - start).count();
+
+   unique_lock<mutex> lock(bulkWriteStatsMutex_);
+   auto& dbStats = bulkWriteStats_[db];
+   dbStats.byteCount_ += stats.byteCount_;
+   dbStats.appendCount_ += stats.appendCount_;
+   dbStats.putCount_ += stats.putCount_;
+   dbStats.seconds_ += stats.seconds_;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+void LMDBBlockDatabase::putValues(DB_SELECT db,
+   map<BinaryData, BinaryWriter>& batch)
+{
+   vector<pair<BinaryDataRef, BinaryDataRef>> keyValPairs;
+   keyValPairs.reserve(batch.size());
+   for (auto& keyVal : batch)
+   {
+      keyValPairs.push_back(make_pair(
+         keyVal.first.getRef(), keyVal.second.getDataRef()));
+   }
+
+   putValues(db, keyValPairs);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+void LMDBBlockDatabase::logBulkWriteStats()
+{
+   unique_lock<mutex> lock(bulkWriteStatsMutex_);
+   for (int i = 0; i < COUNT; i++)
+   {
+      auto& stats = bulkWriteStats_[i];
+      if (stats.appendCount_ + stats.putCount_ == 0)
+         continue;
+
+      double mb = stats.byteCount_ / (1024.0 * 1024.0);
+      double rate = stats.seconds_ > 0 ? mb / stats.seconds_ : 0;
+      LOGINFO << getDbName((DB_SELECT)i) << ": wrote " << mb << " MB in " <<
+         stats.seconds_ << "s (" << rate << " MB/s), " << 
+         stats.appendCount_ << " appends, " << 
+         stats.putCount_ << " puts";
+
+      stats = BulkWriteStats();
+   }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+string LMDBBlockDatabase::getUtxoSnapshotPath() const
+{
+   return getDbPath(UTXO_SNAPSHOT_FILENAME);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+void LMDBBlockDatabase::stxoWillChange()
+{
+   /***
+   Runs ahead of every STXO put/delete. The snapshot is removed before the
+   DB changes, so a crash can't leave a stale snapshot behind. 
+   
+   putUtxoSnapshot sets the on disk flag then checks the write count, this 
+   bumps the count then checks the flag: with seq_cst ordering at least one
+   side sees the other and the snapshot goes.
+   ***/
+
+   stxoWriteCount_.fetch_add(1, memory_order_seq_cst);
+   if (utxoSnapshotOnDisk_.load(memory_order_seq_cst) &&
+      utxoSnapshotOnDisk_.exchange(false, memory_order_seq_cst))
+      remove(getUtxoSnapshotPath().c_str());
+}
+
+/////////////////////////////////////////////////////////////////////////////
+bool LMDBBlockDatabase::putUtxoSnapshot(const BinaryData& topHash,
+   vector<const StoredTxOut*>& utxos, uint64_t expectedWriteCount)
+{
+   unique_lock<mutex> lock(utxoSnapshotMutex_);
+
+   if (stxoWriteCount_.load(memory_order_seq_cst) != expectedWriteCount)
+      return false;
+
+   try
+   {
+      UtxoSnapshot::write(getUtxoSnapshotPath(), topHash, utxos);
+   }
+   catch (exception& e)
+   {
+      LOGWARN << "failed to write utxo snapshot: " << e.what();
+      return false;
+   }
+
+   utxoSnapshotOnDisk_.store(true, memory_order_seq_cst);
+   if (stxoWriteCount_.load(memory_order_seq_cst) == expectedWriteCount)
+   {
+      lastUtxoSnapshot_ = chrono::steady_clock::now();
+      return true;
+   }
+
+   //a STXO write raced with us
+   if (utxoSnapshotOnDisk_.exchange(false, memory_order_seq_cst))
+      remove(getUtxoSnapshotPath().c_str());
+
+   return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+shared_ptr<UtxoSnapshot> LMDBBlockDatabase::getUtxoSnapshot() const
+{
+   if (!utxoSnapshotOnDisk_.load(memory_order_acquire))
+      return nullptr;
+
+   try
+   {
+      auto snapshot = make_shared<UtxoSnapshot>(getUtxoSnapshotPath());
+      utxoSnapshotLoads_.fetch_add(1, memory_order_release);
+      return snapshot;
+   }
+   catch (exception& e)
+   {
+      //removed under our feet or unusable, callers fall back to the DB
+      LOGWARN << "ignoring utxo snapshot: " << e.what();
+   }
+
+   return nullptr;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+chrono::steady_clock::time_point LMDBBlockDatabase::getLastUtxoSnapshotTime()
+{
+   unique_lock<mutex> lock(utxoSnapshotMutex_);
+   return lastUtxoSnapshot_;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+void LMDBBlockDatabase::dropUtxoSnapshot()
+{
+   unique_lock<mutex> lock(utxoSnapshotMutex_);
+   utxoSnapshotOnDisk_.store(false, memory_order_seq_cst);
+   remove(getUtxoSnapshotPath().c_str());
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // Not sure why this is useful over getHeaderMap() ... this iterates over
 // the headers in hash-ID-order, instead of height-order
@@ -997,7 +1331,8 @@ void LMDBBlockDatabase::putStoredScriptHistory( StoredScriptHistory & ssh)
          StoredSubHistory & subssh = iter->second;
          if (subssh.txioMap_.size() > 0)
             putValue(SUBSSH, subssh.getDBKey(),
-            serializeDBValue(subssh, this, armoryDbType_)
+            serializeDBValue(subssh, this, armoryDbType_, 
+               valueEncoding_[SUBSSH])
             );
       }
    }
@@ -1024,7 +1359,7 @@ void LMDBBlockDatabase::putStoredSubHistory(StoredSubHistory & subssh)
 
    if (subssh.txioMap_.size() > 0)
       putValue(db, subssh.getDBKey(),
-         serializeDBValue(subssh, this, armoryDbType_));
+         serializeDBValue(subssh, this, armoryDbType_, valueEncoding_[db]));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1190,33 +1525,82 @@ bool LMDBBlockDatabase::getFullUTXOMapForSSH(
    beginDBTransaction(&stxotx, STXO, LMDB::ReadOnly);
    beginDBTransaction(&hinttx, TXHINTS, LMDB::ReadOnly);
 
+   vector<const TxIOPair*> utxoVec;
+   for (const auto& ssPair : ssh.subHistMap_)
    {
-      for (const auto& ssPair : ssh.subHistMap_)
+      const StoredSubHistory & subSSH = ssPair.second;
+      for (const auto& txioPair : subSSH.txioMap_)
       {
-         const StoredSubHistory & subSSH = ssPair.second;
-         for (const auto& txioPair : subSSH.txioMap_)
-         {
-            const TxIOPair & txio = txioPair.second;
-            if (txio.isUTXO())
-            {
-               BinaryData txoKey = txio.getDBKeyOfOutput();
-               BinaryData txKey = txio.getTxRefOfOutput().getDBKey();
-               uint16_t txoIdx = txio.getIndexOfOutput();
+         if (txioPair.second.isUTXO())
+            utxoVec.push_back(&txioPair.second);
+      }
+   }
 
+   //fullnode keeps the relevant stxos and tx hashes in the DB, grab them in 
+   //one sorted pass per DB
+   vector<BinaryDataRef> stxoVals(utxoVec.size()), hintVals(utxoVec.size());
+   if (armoryDbType_ != ARMORY_DB_SUPER && utxoVec.size() > 0)
+   {
+      vector<BinaryData> stxoKeys, hintKeys;
+      vector<BinaryDataRef> stxoKeyRefs, hintKeyRefs;
+      stxoKeys.reserve(utxoVec.size());
+      hintKeys.reserve(utxoVec.size());
 
-               StoredTxOut stxo;
-               getStoredTxOut(stxo, txoKey);
-               BinaryData txHash = getTxHashForLdbKey(txKey);
+      for (auto txioPtr : utxoVec)
+      {
+         BinaryWriter bwStxo;
+         bwStxo.put_uint8_t((uint8_t)DB_PREFIX_TXDATA);
+         bwStxo.put_BinaryData(txioPtr->getDBKeyOfOutput());
+         stxoKeys.push_back(bwStxo.getData());
+
+         BinaryWriter bwHint;
+         bwHint.put_uint8_t((uint8_t)DB_PREFIX_TXDATA);
+         bwHint.put_BinaryData(txioPtr->getTxRefOfOutput().getDBKey());
+         hintKeys.push_back(bwHint.getData());
+      }
 
-               mapToFill[txoKey] = UnspentTxOut(
-                  txHash,
-                  txoIdx,
-                  stxo.blockHeight_,
-                  txio.getValue(),
-                  stxo.getScriptRef());
-            }
-         }
+      //grab the refs once the key vectors are done growing
+      for (size_t i = 0; i < utxoVec.size(); i++)
+      {
+         stxoKeyRefs.push_back(stxoKeys[i].getRef());
+         hintKeyRefs.push_back(hintKeys[i].getRef());
       }
+
+      stxoVals = multiGet(STXO, stxoKeyRefs);
+      hintVals = multiGet(TXHINTS, hintKeyRefs);
+   }
+
+   for (size_t i = 0; i < utxoVec.size(); i++)
+   {
+      const TxIOPair & txio = *utxoVec[i];
+      BinaryData txoKey = txio.getDBKeyOfOutput();
+      BinaryData txKey = txio.getTxRefOfOutput().getDBKey();
+      uint16_t txoIdx = txio.getIndexOfOutput();
+
+      //misses (zc keys, supernode) go through the regular getters
+      StoredTxOut stxo;
+      if (stxoVals[i].getSize() > 0)
+      {
+         BinaryRefReader brr(stxoVals[i]);
+         readStxoEntry(stxo, txoKey.getRef(), brr);
+      }
+      else
+      {
+         getStoredTxOut(stxo, txoKey);
+      }
+
+      BinaryData txHash;
+      if (hintVals[i].getSize() >= 36)
+         txHash = hintVals[i].getSliceRef(4, 32);
+      else
+         txHash = getTxHashForLdbKey(txKey);
+
+      mapToFill[txoKey] = UnspentTxOut(
+         txHash,
+         txoIdx,
+         stxo.blockHeight_,
+         txio.getValue(),
+         stxo.getScriptRef());
    }
 
    return true;
@@ -1827,6 +2211,16 @@ TxOut LMDBBlockDatabase::getTxOutCopy(
 
    TxRef parent(ldbKey6B);
 
+   if ((brr.getCurrPtr()[0] >> 4) == STXO_COMPACT_VERSION)
+   {
+      //compact values do not carry the raw TxOut, rebuild it
+      StoredTxOut stxo;
+      stxo.unserializeDBValue(brr.getRawRef());
+      auto&& txout_raw = stxo.getSerializedTxOut();
+      txoOut.unserialize(txout_raw, txout_raw.getSize(), parent, txOutIdx);
+      return txoOut;
+   }
+
    brr.advance(2);
    txoOut.unserialize_checked(
       brr.getCurrPtr(), brr.getSizeRemaining(), 0, parent, (uint32_t)txOutIdx);
@@ -2194,7 +2588,8 @@ void LMDBBlockDatabase::putStoredTxOut( StoredTxOut const & stxo)
    SCOPED_TIMER("putStoredTx");
 
    BinaryData ldbKey = stxo.getDBKey(false);
-   BinaryData bw = serializeDBValue(stxo, armoryDbType_);
+   BinaryData bw = serializeDBValue(
+      stxo, armoryDbType_, false, valueEncoding_[STXO]);
    putValue(STXO, DB_PREFIX_TXDATA, ldbKey, bw);
 }
 
@@ -2259,6 +2654,21 @@ bool LMDBBlockDatabase::getStoredTxOut(
    return false;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void LMDBBlockDatabase::readStxoEntry(StoredTxOut& stxo,
+   const BinaryDataRef& dbKey, BinaryRefReader& brrVal)
+{
+   //STXO entry to StoredTxOut: the height, dupID and indexes come from the
+   //8 byte key (no prefix), unserializeDBValue handles both value encodings
+   BinaryData hgtx(dbKey.getSliceRef(0, 4));
+   stxo.blockHeight_ = DBUtils::hgtxToHeight(hgtx);
+   stxo.duplicateID_ = DBUtils::hgtxToDupID(hgtx);
+   stxo.txIndex_ = READ_UINT16_BE(dbKey.getSliceRef(4, 2));
+   stxo.txOutIndex_ = READ_UINT16_BE(dbKey.getSliceRef(6, 2));
+
+   stxo.unserializeDBValue(brrVal);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 bool LMDBBlockDatabase::getStoredTxOut(
    StoredTxOut & stxo, const BinaryData& DBkey) const
@@ -2281,12 +2691,7 @@ bool LMDBBlockDatabase::getStoredTxOut(
 
       if (brr.getSize() > 0)
       {
-         stxo.blockHeight_ = DBUtils::hgtxToHeight(DBkey.getSliceRef(0, 4));
-         stxo.duplicateID_ = DBUtils::hgtxToDupID(DBkey.getSliceRef(0, 4));
-         stxo.txIndex_ = READ_UINT16_BE(DBkey.getSliceRef(4, 2));
-         stxo.txOutIndex_ = READ_UINT16_BE(DBkey.getSliceRef(6, 2));
-
-         stxo.unserializeDBValue(brr);
+         readStxoEntry(stxo, DBkey.getRef(), brr);
          return true;
       }
    }
@@ -2908,9 +3313,12 @@ StoredDBInfo LMDBBlockDatabase::openDB(DB_SELECT db)
       sdbi.metaHash_ = BtcUtils::EmptyHash_;
       sdbi.topBlkHgt_ = 0;
       sdbi.armoryType_ = armoryDbType_;
+      if (db == STXO || db == SUBSSH)
+         sdbi.valueEncoding_ = newDbEncoding_;
       putStoredDBInfo(db, sdbi, 0);
    }
 
+   valueEncoding_[db] = sdbi.valueEncoding_;
    return sdbi;
 }
 
@@ -3027,6 +3435,84 @@ void LMDBBlockDatabase::resetSSHdb()
    }
 }
 
+/////////////////////////////////////////////////////////////////////////////
+void LMDBBlockDatabase::forEachFilterPoolRecord(uint32_t fileNum,
+   const function<void(BinaryDataRef, BinaryDataRef)>& callback) const
+{
+   //the compacted pool sits under the 4 byte pool key, appended filters 
+   //follow it under the pool key + block id. the caller holds the tx
+   auto&& poolKey = DBUtils::getFilterPoolKey(fileNum);
+
+   auto dbIter = getIterator(TXFILTERS);
+   if (!dbIter.seekToStartsWith(poolKey))
+      return;
+
+   do
+   {
+      auto keyRef = dbIter.getKeyRef();
+      if (keyRef.getSize() != 4 && keyRef.getSize() != 8)
+         continue;
+
+      callback(keyRef, dbIter.getValueRef());
+   } while (dbIter.advanceAndRead() && dbIter.checkKeyStartsWith(poolKey));
+}
+
+/////////////////////////////////////////////////////////////////////////////
+bool LMDBBlockDatabase::hasFilterPoolForFileNum(uint32_t fileNum) const
+{
+   LMDBEnv::Transaction tx;
+   beginDBTransaction(&tx, TXFILTERS, LMDB::ReadOnly);
+
+   auto&& poolKey = DBUtils::getFilterPoolKey(fileNum);
+   auto dbIter = getIterator(TXFILTERS);
+   return dbIter.seekToStartsWith(poolKey);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+unsigned LMDBBlockDatabase::getAppendedFilterCount(uint32_t fileNum) const
+{
+   LMDBEnv::Transaction tx;
+   beginDBTransaction(&tx, TXFILTERS, LMDB::ReadOnly);
+
+   unsigned count = 0;
+   auto countRecord = [&count](BinaryDataRef key, BinaryDataRef)->void
+   {
+      if (key.getSize() == 8)
+         ++count;
+   };
+
+   forEachFilterPoolRecord(fileNum, countRecord);
+   return count;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+void LMDBBlockDatabase::deleteFilterPoolRecords(
+   uint32_t fileNum, bool appendedOnly)
+{
+   LMDBEnv::Transaction tx;
+   beginDBTransaction(&tx, TXFILTERS, LMDB::ReadWrite);
+
+   vector<BinaryData> keys;
+   auto tallyKey = [&keys, appendedOnly](BinaryDataRef key, BinaryDataRef)->void
+   {
+      if (appendedOnly && key.getSize() != 8)
+         return;
+
+      keys.push_back(key);
+   };
+
+   forEachFilterPoolRecord(fileNum, tallyKey);
+
+   for (auto& key : keys)
+      deleteValue(TXFILTERS, key);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+void LMDBBlockDatabase::deleteFilterPoolForFileNum(uint32_t fileNum)
+{
+   deleteFilterPoolRecords(fileNum, false);
+}
+
 /////////////////////////////////////////////////////////////////////////////
 void LMDBBlockDatabase::putMissingHashes(
    const set<BinaryData>& hashSet, uint32_t id)
@@ -16,6 +16,9 @@
 
 #include <list>
 #include <vector>
+#include <atomic>
+#include <mutex>
+#include <chrono>
 #include "log.h"
 #include "BinaryData.h"
 #include "BtcUtils.h"
@@ -26,6 +29,7 @@
 #include "lmdb/lmdbpp.h"
 
 class Blockchain;
+class UtxoSnapshot;
 
 ////////////////////////////////////////////////////////////////////////////////
 //
@@ -191,6 +195,9 @@ private:
    const uint8_t* poolPtr_ = nullptr;
    size_t len_ = SIZE_MAX;
 
+   //filters appended on top of the compacted pool, one per new block
+   vector<const uint8_t*> appendedPtrs_;
+
 public:
    TxFilterPool(void) 
    {}
@@ -200,7 +207,8 @@ public:
    {}
 
    TxFilterPool(const TxFilterPool<T>& filter) :
-      pool_(filter.pool_), len_(filter.len_)
+      pool_(filter.pool_), poolPtr_(filter.poolPtr_), len_(filter.len_),
+      appendedPtrs_(filter.appendedPtrs_)
    {}
 
    TxFilterPool(const uint8_t* ptr, size_t len) :
@@ -213,92 +221,149 @@ public:
       len_ = pool_.size();
    }
 
-   bool isValid(void) const { return len_ != SIZE_MAX; }
+   bool isValid(void) const 
+   { 
+      return len_ != SIZE_MAX || appendedPtrs_.size() > 0; 
+   }
+
+   void appendFilterPtr(const uint8_t* ptr, size_t len)
+   {
+      //ptr has to outlive the pool, as with the compacted pool ptr
+      if (ptr == nullptr || len < 12 || *(uint32_t*)ptr != len)
+         throw runtime_error("invalid appended filter");
+
+      appendedPtrs_.push_back(ptr);
+   }
+
+   void deserializeAppended(uint8_t* ptr, size_t len)
+   {
+      if (ptr == nullptr || len < 12 || *(uint32_t*)ptr != len)
+         throw runtime_error("invalid appended filter");
+
+      TxFilter<T> filter;
+      filter.deserialize(ptr);
+      pool_.insert(move(filter));
+
+      len_ = pool_.size();
+   }
+
+   size_t getAppendedCount(void) const { return appendedPtrs_.size(); }
 
    map<uint32_t, set<uint32_t>> compare(const BinaryData& hash) const
    {
       if (hash.getSize() != 32)
          throw runtime_error("hash is 32 bytes long");
 
-      if (!isValid())
-         throw runtime_error("invalid pool");
-
-      //get key
-
       map<uint32_t, set<uint32_t>> returnMap;
 
-      if (pool_.size())
+      auto compareFilter = [&hash, &returnMap](const TxFilter<T>& filter)->void
       {
-         for (auto& filter : pool_)
+         auto&& resultSet = filter.compare(hash);
+         if (resultSet.size() > 0)
          {
-            auto&& resultSet = filter.compare(hash);
-            if (resultSet.size() > 0)
-            {
-               returnMap.insert(make_pair(
-                  filter.getBlockKey(),
-                  move(resultSet)));
-            }
+            returnMap.insert(make_pair(
+               filter.getBlockKey(),
+               move(resultSet)));
          }
+      };
+
+      forEachFilter(compareFilter);
+      return returnMap;
+   }
+
+   static void checkHashSizes(const vector<BinaryData>& hashVec)
+   {
+      //run before building a prefix set out of hashVec, so that short 
+      //hashes fail here rather than in the prefix set
+      for (auto& hash : hashVec)
+      {
+         if (hash.getSize() != 32)
+            throw runtime_error("hash is 32 bytes long");
       }
-      else if (poolPtr_ != nullptr) //running against a pointer
+   }
+
+   vector<map<uint32_t, set<uint32_t>>> compareBatch(
+      const vector<BinaryData>& hashVec) const
+   {
+      checkHashSizes(hashVec);
+      TxFilterPrefixSet<T> prefixSet(hashVec);
+      return compareBatch(hashVec, prefixSet);
+   }
+
+   vector<map<uint32_t, set<uint32_t>>> compareBatch(
+      const vector<BinaryData>& hashVec,
+      const TxFilterPrefixSet<T>& prefixSet) const
+   {
+      /***
+      Streams the pool once for the whole batch. Entry i of the result 
+      holds the hits for hashVec[i], empty if there are none. The prefix 
+      set has to be built from hashVec, callers running the same batch 
+      against several pools should build it once and pass it along.
+      ***/
+
+      vector<map<uint32_t, set<uint32_t>>> result(hashVec.size());
+      if (hashVec.size() == 0)
+         return result;
+
+      checkHashSizes(hashVec);
+
+      auto&& prefixHits = compare(prefixSet);
+      if (prefixHits.size() == 0)
+         return result;
+
+      for (unsigned i = 0; i < hashVec.size(); i++)
       {
-         //get count
-         auto size = (uint32_t*)poolPtr_;
-         uint32_t* filterSize;
-         size_t pos = 4;
+         auto& hash = hashVec[i];
+         T key;
+         memcpy(&key, hash.getPtr(), sizeof(T));
 
-         for (uint32_t i = 0; i < *size; i++)
-         {
-            if (pos >= len_)
-               throw runtime_error("overflow while reading pool ptr");
+         auto hitIter = prefixHits.find(key);
+         if (hitIter == prefixHits.end())
+            continue;
 
-            //iterate through entries
-            filterSize = (uint32_t*)(poolPtr_ + pos);
+         result[i] = hitIter->second;
+      }
 
-            TxFilter<T> filterPtr(poolPtr_ + pos);
-            auto&& resultSet = filterPtr.compare(hash);
-            if (resultSet.size() > 0)
-            {
-               returnMap.insert(make_pair(
-                  filterPtr.getBlockKey(),
-                  move(resultSet)));
-            }
+      return result;
+   }
 
-            pos += *filterSize;
+   map<T, map<uint32_t, set<uint32_t>>> compare(
+      const TxFilterPrefixSet<T>& prefixSet) const
+   {
+      //map<prefix, map<blockId, set<tx offset>>>
+      map<T, map<uint32_t, set<uint32_t>>> returnMap;
+
+      auto compareFilter = [&prefixSet, &returnMap]
+         (const TxFilter<T>& filter)->void
+      {
+         map<T, set<uint32_t>> hits;
+         filter.compare(prefixSet, hits);
+
+         for (auto& hit : hits)
+         {
+            auto& blockMap = returnMap[hit.first];
+            blockMap.insert(make_pair(
+               filter.getBlockKey(), move(hit.second)));
          }
-      }
-      else
-         throw runtime_error("invalid pool");
+      };
 
+      forEachFilter(compareFilter);
       return returnMap;
    }
 
    vector<TxFilter<T>> getFilterPoolPtr(void)
    {
-      if (poolPtr_ == nullptr)
+      if (poolPtr_ == nullptr && appendedPtrs_.size() == 0)
          throw runtime_error("missing pool ptr");
 
       vector<TxFilter<T>> filters;
 
-      //get count
-      auto size = (uint32_t*)poolPtr_;
-      uint32_t* filterSize;
-      size_t pos = 4;
-
-      for (uint32_t i = 0; i < *size; i++)
+      auto pushFilter = [&filters](const TxFilter<T>& filter)->void
       {
-         if (pos >= len_)
-            throw runtime_error("overflow while reading pool ptr");
-
-         //iterate through entries
-         filterSize = (uint32_t*)(poolPtr_ + pos);
-
-         TxFilter<T> filterPtr(poolPtr_ + pos);
-         filters.push_back(filterPtr);
-
-         pos += *filterSize;
-      }
+         filters.push_back(filter);
+      };
 
+      forEachFilterPtr(pushFilter);
       return filters;
    }
 
@@ -351,6 +416,58 @@ public:
 
       return *filterIter;
    }
+
+private:
+   void forEachFilter(const function<void(const TxFilter<T>&)>& callback) const
+   {
+      if (!isValid())
+         throw runtime_error("invalid pool");
+
+      if (pool_.size())
+      {
+         for (auto& filter : pool_)
+            callback(filter);
+      }
+      else if (poolPtr_ != nullptr || appendedPtrs_.size() > 0)
+      {
+         //running against a pointer
+         forEachFilterPtr(callback);
+      }
+      else
+         throw runtime_error("invalid pool");
+   }
+
+   void forEachFilterPtr(
+      const function<void(const TxFilter<T>&)>& callback) const
+   {
+      if (poolPtr_ != nullptr)
+      {
+         //get count
+         auto size = (uint32_t*)poolPtr_;
+         uint32_t* filterSize;
+         size_t pos = 4;
+
+         for (uint32_t i = 0; i < *size; i++)
+         {
+            if (pos >= len_)
+               throw runtime_error("overflow while reading pool ptr");
+
+            //iterate through entries
+            filterSize = (uint32_t*)(poolPtr_ + pos);
+
+            TxFilter<T> filterPtr(poolPtr_ + pos);
+            callback(filterPtr);
+
+            pos += *filterSize;
+         }
+      }
+
+      for (auto ptr : appendedPtrs_)
+      {
+         TxFilter<T> filterPtr(ptr);
+         callback(filterPtr);
+      }
+   }
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -429,8 +546,35 @@ public:
    BinaryRefReader getValueReader(DB_SELECT db, BinaryDataRef keyWithPrefix) const;
    BinaryRefReader getValueReader(DB_SELECT db, DB_PREFIX prefix, BinaryDataRef key) const;
 
+   /////////////////////////////////////////////////////////////////////////////
+   // Point lookups for a batch of keys (with prefix). Keys are visited in DB 
+   // order with a single cursor. Values come back in the order of the keys, 
+   // empty for missing keys. Like getValueNoCopy, the caller has to hold a 
+   // read transaction on db, the refs are only valid as long as it does.
+   vector<BinaryDataRef> multiGet(
+      DB_SELECT db, const vector<BinaryDataRef>& keysWithPrefix) const;
+
    BinaryData getDBKeyForHash(const BinaryData& txhash,
       uint8_t dupId = UINT8_MAX) const;
+
+   /////////////////////////////////////////////////////////////////////////////
+   // Full txid index: TXHINTS entries under DB_PREFIX_TXHASH map the 32 byte 
+   // hash to the 6 byte tx key, maintained along with the hash & count 
+   // entries (fullnode only). Lets getDBKeyForHash answer in one probe, tx 
+   // missing from the index (DBs predating it) go through the hints.
+   void setTxHashIndex(bool enabled) { txHashIndex_ = enabled; }
+   bool hasTxHashIndex(void) const 
+   { return txHashIndex_ && armoryDbType_ != ARMORY_DB_SUPER; }
+
+   /////////////////////////////////////////////////////////////////////////////
+   // Value layout for STXO & SUBSSH entries. The encoding is recorded in the 
+   // sdbi when these DBs are created and sticks to them afterwards, 
+   // setValueEncoding only affects DBs that do not exist yet.
+   void setValueEncoding(DB_VALUE_ENCODING encoding) 
+   { newDbEncoding_ = encoding; }
+   DB_VALUE_ENCODING getValueEncoding(DB_SELECT db) const
+   { return valueEncoding_[db]; }
+
    BinaryData getHashForDBKey(BinaryData dbkey) const;
    BinaryData getHashForDBKey(uint32_t hgt,
       uint8_t  dup,
@@ -448,6 +592,37 @@ public:
    void deleteValue(DB_SELECT db, BinaryDataRef key);
    void deleteValue(DB_SELECT db, DB_PREFIX pref, BinaryDataRef key);
 
+   /////////////////////////////////////////////////////////////////////////////
+   // Bulk writes for scans and builds, under the caller's write txn on db. 
+   // The batch is sorted by key, keys past the last one in the db are 
+   // appended (MDB_APPEND), the rest go through regular puts. Throughput 
+   // adds up per db until logBulkWriteStats.
+   void putValues(DB_SELECT db, 
+      vector<pair<BinaryDataRef, BinaryDataRef>>& keyValPairs);
+   void putValues(DB_SELECT db, map<BinaryData, BinaryWriter>& batch);
+   void logBulkWriteStats(void);
+
+   /////////////////////////////////////////////////////////////////////////////
+   // UTXO snapshot: flat image of the unspent STXO entries, valid until the
+   // next STXO write. Writers pass the STXO write count they expect, the 
+   // snapshot is dropped if another write got in.
+   string getUtxoSnapshotPath(void) const;
+   uint64_t getStxoWriteCount(void) const 
+   { return stxoWriteCount_.load(memory_order_acquire); }
+
+   bool putUtxoSnapshot(const BinaryData& topHash, 
+      vector<const StoredTxOut*>& utxos, uint64_t expectedWriteCount);
+   shared_ptr<UtxoSnapshot> getUtxoSnapshot(void) const;
+   void dropUtxoSnapshot(void);
+
+   bool hasUtxoSnapshot(void) const
+   { return utxoSnapshotOnDisk_.load(memory_order_acquire); }
+   uint64_t getUtxoSnapshotLoadCount(void) const
+   { return utxoSnapshotLoads_.load(memory_order_acquire); }
+
+   //time of the last snapshot written, or of the DB object's creation
+   chrono::steady_clock::time_point getLastUtxoSnapshotTime(void);
+
    // Move the iterator in DB to the lowest entry with key >= inputKey
    bool seekTo(DB_SELECT db,
       BinaryDataRef key);
@@ -712,22 +887,29 @@ public:
    template <typename T> TxFilterPool<T> getFilterPoolForFileNum(
       uint32_t fileNum) const
    {
-      auto&& key = DBUtils::getFilterPoolKey(fileNum);
+      /***
+      Returns a copy of the pool with the appended filters merged in.
+      ***/
 
       auto db = TXFILTERS;
       LMDBEnv::Transaction tx;
       beginDBTransaction(&tx, db, LMDB::ReadOnly);
 
-      auto val = getValueNoCopy(TXFILTERS, key);
-
       TxFilterPool<T> pool;
-      try
+      auto mergeRecord = [&pool](BinaryDataRef key, BinaryDataRef val)->void
       {
-         pool.deserialize((uint8_t*)val.getPtr(), val.getSize());
-      }
-      catch (exception&)
-      { }
+         try
+         {
+            if (key.getSize() == 4)
+               pool.deserialize((uint8_t*)val.getPtr(), val.getSize());
+            else
+               pool.deserializeAppended((uint8_t*)val.getPtr(), val.getSize());
+         }
+         catch (exception&)
+         { }
+      };
 
+      forEachFilterPoolRecord(fileNum, mergeRecord);
       return pool;
    }
 
@@ -735,17 +917,35 @@ public:
    template <typename T> TxFilterPool<T> getFilterPoolRefForFileNum(
       uint32_t fileNum) const
    {
-      auto&& key = DBUtils::getFilterPoolKey(fileNum);
+      /***
+      The pool points into the db, the caller has to hold a TXFILTERS 
+      transaction for as long as it uses it.
+      ***/
 
       auto db = TXFILTERS;
       LMDBEnv::Transaction tx;
       beginDBTransaction(&tx, db, LMDB::ReadOnly);
 
-      auto val = getValueNoCopy(TXFILTERS, key);
-      if (val.getSize() == 0)
+      BinaryDataRef poolVal;
+      vector<BinaryDataRef> appendedVals;
+      auto tallyRecord = [&](BinaryDataRef key, BinaryDataRef val)->void
+      {
+         if (key.getSize() == 4)
+            poolVal = val;
+         else
+            appendedVals.push_back(val);
+      };
+
+      forEachFilterPoolRecord(fileNum, tallyRecord);
+      if (poolVal.getSize() == 0 && appendedVals.size() == 0)
          throw runtime_error("invalid txfilter key");
 
-      return TxFilterPool<T>(val.getPtr(), val.getSize());
+      TxFilterPool<T> pool(poolVal.getPtr(), 
+         poolVal.getSize() == 0 ? SIZE_MAX : poolVal.getSize());
+      for (auto& val : appendedVals)
+         pool.appendFilterPtr(val.getPtr(), val.getSize());
+
+      return pool;
    }
 
 
@@ -753,6 +953,11 @@ public:
    template <typename T> void putFilterPoolForFileNum(
       uint32_t fileNum, const TxFilterPool<T>& pool)
    {
+      /***
+      Writes the compacted pool for this file, replacing the appended 
+      filters if there are any. The pool has to hold them.
+      ***/
+
       if (!pool.isValid())
          throw runtime_error("invalid filterpool");
 
@@ -761,6 +966,8 @@ public:
       LMDBEnv::Transaction tx;
       beginDBTransaction(&tx, db, LMDB::ReadWrite);
 
+      deleteFilterPoolRecords(fileNum, true);
+
       auto&& key = DBUtils::getFilterPoolKey(fileNum);
       BinaryWriter bw;
       pool.serialize(bw);
@@ -771,6 +978,56 @@ public:
          CharacterArrayRef(dataref.getSize(), dataref.getPtr()));
    }
 
+   /////////////////////////////////////////////////////////////////////////////
+   template <typename T> void appendFilterForFileNum(
+      uint32_t fileNum, const TxFilter<T>& filter)
+   {
+      /***
+      Adds a single block filter to the pool of this file without rewriting
+      the pool. Readers merge appended filters with the compacted pool 
+      until compactFilterPoolForFileNum folds them in.
+      ***/
+
+      auto db = TXFILTERS;
+      LMDBEnv::Transaction tx;
+      beginDBTransaction(&tx, db, LMDB::ReadWrite);
+
+      auto&& key = DBUtils::getFilterPoolAppendKey(
+         fileNum, filter.getBlockKey());
+      BinaryWriter bw;
+      filter.serialize(bw);
+
+      auto dataref = bw.getDataRef();
+      dbs_[db].insert(
+         CharacterArrayRef(key.getSize(), key.getPtr()),
+         CharacterArrayRef(dataref.getSize(), dataref.getPtr()));
+   }
+
+   /////////////////////////////////////////////////////////////////////////////
+   template <typename T> unsigned compactFilterPoolForFileNum(
+      uint32_t fileNum)
+   {
+      //returns the count of appended filters folded into the pool
+      auto db = TXFILTERS;
+      LMDBEnv::Transaction tx;
+      beginDBTransaction(&tx, db, LMDB::ReadWrite);
+
+      auto count = getAppendedFilterCount(fileNum);
+      if (count == 0)
+         return 0;
+
+      auto&& pool = getFilterPoolForFileNum<T>(fileNum);
+      if (!pool.isValid())
+         throw runtime_error("invalid filterpool");
+
+      putFilterPoolForFileNum(fileNum, pool);
+      return count;
+   }
+
+   bool hasFilterPoolForFileNum(uint32_t fileNum) const;
+   unsigned getAppendedFilterCount(uint32_t fileNum) const;
+   void deleteFilterPoolForFileNum(uint32_t fileNum);
+
    void putMissingHashes(const set<BinaryData>&, uint32_t);
    set<BinaryData> getMissingHashes(uint32_t) const;
 
@@ -805,6 +1062,39 @@ private:
    string blkFolder_;
 
    const shared_ptr<Blockchain> blockchainPtr_;
+
+   atomic<uint64_t> stxoWriteCount_;
+   atomic<bool> utxoSnapshotOnDisk_;
+   mutable atomic<uint64_t> utxoSnapshotLoads_;
+   mutex utxoSnapshotMutex_;
+   chrono::steady_clock::time_point lastUtxoSnapshot_;
+
+   void stxoWillChange(void);
+   static void readStxoEntry(StoredTxOut& stxo, 
+      const BinaryDataRef& dbKey, BinaryRefReader& brrVal);
+
+   struct BulkWriteStats
+   {
+      uint64_t byteCount_ = 0;
+      uint64_t appendCount_ = 0;
+      uint64_t putCount_ = 0;
+      double seconds_ = 0;
+   };
+
+   BulkWriteStats bulkWriteStats_[COUNT];
+   mutex bulkWriteStatsMutex_;
+
+   bool txHashIndex_ = true;
+   DB_VALUE_ENCODING newDbEncoding_ = DB_ENCODING_LEGACY;
+   DB_VALUE_ENCODING valueEncoding_[COUNT] = {};
+
+   BinaryData getDBKeyFromTxHashIndex(const BinaryData& txhash,
+      uint8_t expectedDupId) const;
+   void updateTxHashIndex(BinaryDataRef key, BinaryDataRef value, bool erase);
+
+   void forEachFilterPoolRecord(uint32_t fileNum,
+      const function<void(BinaryDataRef, BinaryDataRef)>&) const;
+   void deleteFilterPoolRecords(uint32_t fileNum, bool appendedOnly);
 };
 
 #endif